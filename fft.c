@@ -32,6 +32,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
 
 
 #ifdef __MACH__
@@ -79,6 +80,15 @@ static int clock_gettime(int clk_id, struct mach_timespec *t)
 
 #include "fft_autocorrelation.h"
 #include "fft_structure_function.h"
+#include "fft_correlation.h"
+#include "fft_registration.h"
+#include "fft_plancache.h"
+#include "fft_planpolicy.h"
+#include "fft_shift.h"
+#include "fft_batch.h"
+#include "fft_workerpool.h"
+#include "fft_wisdom.h"
+#include "fft_wisdomgen.h"
 
 #include "fft/fft.h"
 
@@ -87,54 +97,18 @@ static int clock_gettime(int clk_id, struct mach_timespec *t)
 
 
 
-#define SWAPf(x,y) do { \
-float swaptmp = x; \
-x = y;   \
-y = swaptmp;   \
-} while(0)
-
-#define SWAPd(x,y) do { \
-double swaptmp = x; \
-x = y;   \
-y = swaptmp;   \
-} while(0)
-
-
-#define CSWAPcf(x,y) do { \
-float swaptmp = x.re;  \
-x.re = y.re; \
-y.re = swaptmp;    \
-swaptmp = x.im;  \
-x.im = y.im; \
-y.im = swaptmp;    \
-} while(0)
-
-
-#define CSWAPcd(x,y) do { \
-double swaptmp = (x.re);  \
-x.re = y.re; \
-y.re = swaptmp;    \
-swaptmp = x.im;  \
-x.im = y.im; \
-y.im = swaptmp;    \
-} while(0)
-
-
 #define SBUFFERSIZE 1000
 
-#define FFTWOPTMODE FFTW_ESTIMATE
-//#define FFTWOPTMODE FFTW_MEASURE
-//#define FFTWOPTMODE FFTW_PATIENT
-//#define FFTWOPTMODE FFTW_EXHAUSTIVE
-
 
-//#define FFTWMT 1
 //static int NB_FFTW_THREADS = 2;
 
 //extern DATA data;
 
 static int INITSTATUS_module = 0;
 
+// duration of init_module_CLI [sec]
+static double module_inittime = 0.0;
+
 
 
 
@@ -175,16 +149,15 @@ errno_t fft_permut_cli()
 }
 
 
-//int do2dfft(char *in_name, char *out_name);
 
-errno_t fft_do1dfft_cli()
+errno_t fft_permut_copy_cli()
 {
     if(
         CLI_checkarg(1, CLIARG_IMG) +
         CLI_checkarg(2, CLIARG_STR_NOT_IMG)
         == 0)
     {
-        do1dfft(
+        permut_copy(
             data.cmdargtoken[1].val.string,
             data.cmdargtoken[2].val.string
         );
@@ -198,16 +171,17 @@ errno_t fft_do1dfft_cli()
 }
 
 
-errno_t fft_do1drfft_cli()
+
+errno_t fft_fftshift_cli()
 {
     if(
         CLI_checkarg(1, CLIARG_IMG) +
-        CLI_checkarg(2, CLIARG_STR_NOT_IMG)
+        CLI_checkarg(2, CLIARG_LONG)
         == 0)
     {
-        do1drfft(
+        fftshift(
             data.cmdargtoken[1].val.string,
-            data.cmdargtoken[2].val.string
+            data.cmdargtoken[2].val.numl
         );
 
         return CLICMD_SUCCESS;
@@ -219,16 +193,17 @@ errno_t fft_do1drfft_cli()
 }
 
 
-errno_t fft_do2dfft_cli()
+
+errno_t fft_ifftshift_cli()
 {
     if(
         CLI_checkarg(1, CLIARG_IMG) +
-        CLI_checkarg(2, CLIARG_STR_NOT_IMG)
+        CLI_checkarg(2, CLIARG_LONG)
         == 0)
     {
-        do2dfft(
+        ifftshift(
             data.cmdargtoken[1].val.string,
-            data.cmdargtoken[2].val.string
+            data.cmdargtoken[2].val.numl
         );
 
         return CLICMD_SUCCESS;
@@ -240,17 +215,20 @@ errno_t fft_do2dfft_cli()
 }
 
 
+//int do2dfft(char *in_name, char *out_name);
 
-
-errno_t test_fftspeed_cli()
+errno_t fft_do1dfft_cli()
 {
     if(
-        CLI_checkarg(1, CLIARG_LONG)
+        CLI_checkarg(1, CLIARG_IMG) +
+        CLI_checkarg(2, CLIARG_STR_NOT_IMG)
         == 0)
     {
-        test_fftspeed(
-            (int) data.cmdargtoken[1].val.numl
+        do1dfft(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.string
         );
+
         return CLICMD_SUCCESS;
     }
     else
@@ -260,21 +238,20 @@ errno_t test_fftspeed_cli()
 }
 
 
-
-errno_t fft_image_translate_cli()
+errno_t fft_do1dfft_axis_cli()
 {
     if(
         CLI_checkarg(1, CLIARG_IMG) +
-        CLI_checkarg(2, CLIARG_STR_NOT_IMG) +
-        CLI_checkarg(3, CLIARG_FLOAT) +
-        CLI_checkarg(4, CLIARG_FLOAT)
+        CLI_checkarg(2, CLIARG_STR) +
+        CLI_checkarg(3, CLIARG_LONG) +
+        CLI_checkarg(4, CLIARG_LONG)
         == 0)
     {
-        fft_image_translate(
+        FFT_do1dfft_axis(
             data.cmdargtoken[1].val.string,
             data.cmdargtoken[2].val.string,
-            data.cmdargtoken[3].val.numf,
-            data.cmdargtoken[4].val.numf
+            (int) data.cmdargtoken[3].val.numl,
+            (data.cmdargtoken[4].val.numl < 0) ? -1 : 1
         );
 
         return CLICMD_SUCCESS;
@@ -287,18 +264,18 @@ errno_t fft_image_translate_cli()
 
 
 
-errno_t fft_correlation_cli()
+errno_t fft_do1drfft_axis_cli()
 {
     if(
         CLI_checkarg(1, CLIARG_IMG) +
-        CLI_checkarg(2, CLIARG_IMG) +
-        CLI_checkarg(3, CLIARG_STR_NOT_IMG)
+        CLI_checkarg(2, CLIARG_STR_NOT_IMG) +
+        CLI_checkarg(3, CLIARG_LONG)
         == 0)
     {
-        fft_correlation(
+        do1drfft_axis(
             data.cmdargtoken[1].val.string,
             data.cmdargtoken[2].val.string,
-            data.cmdargtoken[3].val.string
+            (int) data.cmdargtoken[3].val.numl
         );
 
         return CLICMD_SUCCESS;
@@ -311,1276 +288,2210 @@ errno_t fft_correlation_cli()
 
 
 
-
-
-
-
-
-
-static errno_t init_module_CLI()
+errno_t fft_dondfft_cli()
 {
+    if(
+        CLI_checkarg(1, CLIARG_IMG) +
+        CLI_checkarg(2, CLIARG_STR) +
+        CLI_checkarg(3, CLIARG_LONG) +
+        CLI_checkarg(4, CLIARG_LONG)
+        == 0)
+    {
+        FFT_dondfft(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.string,
+            data.cmdargtoken[3].val.numl,
+            (data.cmdargtoken[4].val.numl < 0) ? -1 : 1
+        );
 
-# ifdef FFTWMT
-    printf("Multi-threaded fft enabled, max threads = %d\n", omp_get_max_threads());
-    fftwf_init_threads();
-    fftwf_plan_with_nthreads(omp_get_max_threads());
-# endif
-
-
-    // FFTW init
-
-    // load fftw wisdom
-    import_wisdom();
-
-
-    //fftwf_set_timelimit(1000.0);
-    //fftw_set_timelimit(1000.0);
-
-
-
-    RegisterCLIcommand(
-        "initfft",
-        __FILE__,
-        init_fftw_plans0,
-        "init FFTW",
-        "no argument",
-        "initfft",
-        "int init_fftw_plans0()");
-
-
-    RegisterCLIcommand(
-        "dofft",
-        __FILE__,
-        fft_do2dfft_cli,
-        "perform FFT",
-        "<input> <output>",
-        "fofft in out",
-        "int do2dfft(const char *in_name, const char *out_name)");
-
-
-    RegisterCLIcommand(
-        "do1Dfft",
-        __FILE__,
-        fft_do1dfft_cli,
-        "perform 1D complex->complex FFT",
-        "<input> <output>",
-        "do1Dfft in out",
-        "int do1dfft(const char *in_name, const char *out_name)");
-
-
-    RegisterCLIcommand(
-        "do1Drfft",
-        __FILE__,
-        fft_do1drfft_cli,
-        "perform 1D real->complex FFT",
-        "<input> <output>",
-        "do1drfft in out",
-        "int do1drfft(const char *in_name, const char *out_name)");
-
-
-    RegisterCLIcommand(
-        "permut",
-        __FILE__,
-        fft_permut_cli,
-        "permut image quadrants",
-        "<image>",
-        "permut im1",
-        "int permut(const char *ID_name)");
-
-
-    RegisterCLIcommand(
-        "testfftspeed",
-        __FILE__,
-        test_fftspeed_cli,
-        "test FFTW speed",
-        "no argument",
-        "testfftspeed",
-        "int test_fftwspeed(int nmax)");
-
-    RegisterCLIcommand(
-        "transl",
-        __FILE__,
-        fft_image_translate_cli,
-        "translate image",
-        "<imagein> <imageout> <xtransl> <ytransl>",
-        "transl im1 im2 2.3 -2.1",
-        "int fft_image_translate(const char *ID_name, const char *ID_out, double xtransl, double ytransl)");
-
-
-    RegisterCLIcommand(
-        "fcorrel",
-        __FILE__,
-        fft_correlation_cli,
-        "correlate two images",
-        "<imagein1> <imagein2> <correlout>",
-        "fcorrel im1 im2 outim",
-        "long fft_correlation(const char *ID_name1, const char *ID_name2, const char *ID_nameout)");
-
-    return RETURN_SUCCESS;
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
 }
 
 
 
-
-
-
-static void __attribute__((destructor)) close_fftwlib()
+errno_t fft_dondrffti_cli()
 {
-    if(INITSTATUS_module == 1)
+    if(
+        CLI_checkarg(1, CLIARG_IMG) +
+        CLI_checkarg(2, CLIARG_STR_NOT_IMG) +
+        CLI_checkarg(3, CLIARG_LONG) +
+        CLI_checkarg(4, CLIARG_LONG)
+        == 0)
     {
-        fftw_forget_wisdom();
-        fftwf_forget_wisdom();
-
-# ifdef FFTWMT
-        fftw_cleanup_threads();
-        fftwf_cleanup_threads();
-# endif
+        FFT_dondrffti(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.string,
+            data.cmdargtoken[3].val.numl,
+            data.cmdargtoken[4].val.numl
+        );
 
-# ifndef FFTWMT
-        fftw_cleanup();
-        fftwf_cleanup();
-# endif
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
     }
 }
 
 
 
-
-
-
-
-
-
-
-
-
-
-
-
-int fft_setNthreads(
-    __attribute__((unused)) int nt
-)
+errno_t fft_dondfft_split_cli()
 {
-//   printf("set number of thread to %d (FFTWMT)\n",nt);
-# ifdef FFTWMT
-    fftwf_cleanup_threads();
-    fftwf_cleanup();
-
-    //  printf("Multi-threaded fft enabled, max threads = %d\n",nt);
-    fftwf_init_threads();
-    fftwf_plan_with_nthreads(nt);
-# endif
-
-
-    import_wisdom();
+    if(
+        CLI_checkarg(1, CLIARG_IMG) +
+        CLI_checkarg(2, CLIARG_IMG) +
+        CLI_checkarg(3, CLIARG_STR) +
+        CLI_checkarg(4, CLIARG_STR) +
+        CLI_checkarg(5, CLIARG_LONG) +
+        CLI_checkarg(6, CLIARG_LONG)
+        == 0)
+    {
+        FFT_dondfft_split(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.string,
+            data.cmdargtoken[3].val.string,
+            data.cmdargtoken[4].val.string,
+            data.cmdargtoken[5].val.numl,
+            (data.cmdargtoken[6].val.numl < 0) ? -1 : 1
+        );
 
-    return(0);
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
 }
 
 
 
-
-errno_t import_wisdom()
+errno_t fft_do1dr2r_cli()
 {
-    FILE *fp;
-    char wisdom_file_single[STRINGMAXLEN_FULLFILENAME];
-    char wisdom_file_double[STRINGMAXLEN_FULLFILENAME];
-
-
-# ifdef FFTWMT
-    WRITE_FULLFILENAME(wisdom_file_single, "%s/fftwf_mt_wisdom.dat", FFTCONFIGDIR);
-    WRITE_FULLFILENAME(wisdom_file_double, "%s/fftw_mt_wisdom.dat", FFTCONFIGDIR);
-# endif
-
-# ifndef FFTWMT
-    WRITE_FULLFILENAME(wisdom_file_single, "%s/fftwf_wisdom.dat", FFTCONFIGDIR);
-    WRITE_FULLFILENAME(wisdom_file_double, "%s/fftw_wisdom.dat", FFTCONFIGDIR);
-# endif
-
-
-    int nowisdomWarning = 0;
-
-    if((fp = fopen(wisdom_file_single, "r")) == NULL)
+    if(
+        CLI_checkarg(1, CLIARG_IMG) +
+        CLI_checkarg(2, CLIARG_STR) +
+        CLI_checkarg(3, CLIARG_STR)
+        == 0)
     {
-        nowisdomWarning = 1;
-        /*
-        n = snprintf(
-                warnmessg,
-                SBUFFERSIZE,
-                "No single precision wisdom file in %s\n FFTs will not be optimized,"
-                " and may run slower than if a wisdom file is used\n type \"initfft\""
-                " to create the wisdom file (this will take time)",
-                wisdom_file_single);
+        int kind = fft_r2rkind(data.cmdargtoken[3].val.string);
 
-        if(n >= SBUFFERSIZE)
-            PRINT_ERROR("Attempted to write string buffer with too many characters");
-        PRINT_WARNING(warnmessg);
-        */
-    }
-    else
-    {
-        if(fftwf_import_wisdom_from_file(fp) == 0)
+        if(kind < 0)
         {
-            PRINT_ERROR("Error reading wisdom");
+            PRINT_ERROR("unknown r2r kind %s", data.cmdargtoken[3].val.string);
+            return CLICMD_INVALID_ARG;
         }
-        fclose(fp);
-    }
-
+        do1dr2r(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.string,
+            kind
+        );
 
-    if((fp = fopen(wisdom_file_double, "r")) == NULL)
-    {
-        nowisdomWarning = 1;
-        /*  n = snprintf(
-                  warnmessg,
-                  SBUFFERSIZE,
-                  "No double precision wisdom file in %s\n FFTs will not be optimized,"
-                  " and may run slower than if a wisdom file is used\n type \"initfft\""
-                  " to create the wisdom file (this will take time)",
-                  wisdom_file_double);
-          if(n >= SBUFFERSIZE)
-              PRINT_ERROR("Attempted to write string buffer with too many characters");
-          PRINT_WARNING(warnmessg);*/
+        return CLICMD_SUCCESS;
     }
     else
     {
-        if(fftw_import_wisdom_from_file(fp) == 0)
-        {
-            PRINT_ERROR("Error reading wisdom");
-        }
-        fclose(fp);
-    }
-
-    if(nowisdomWarning == 1)
-    {
-        printf("(no fftw wisdom file, run initfft to create)");
+        return CLICMD_INVALID_ARG;
     }
-
-    return RETURN_SUCCESS;
 }
 
 
 
-
-errno_t export_wisdom()
+errno_t fft_do2dr2r_cli()
 {
-    FILE *fp;
-    char wisdom_file_single[STRINGMAXLEN_FULLFILENAME];
-    char wisdom_file_double[STRINGMAXLEN_FULLFILENAME];
-
-    EXECUTE_SYSTEM_COMMAND("mkdir -p %s", FFTCONFIGDIR);
-
-# ifdef FFTWMT
-    WRITE_FULLFILENAME(wisdom_file_single, "%s/fftwf_mt_wisdom.dat", FFTCONFIGDIR);
-    WRITE_FULLFILENAME(wisdom_file_double, "%s/fftw_mt_wisdom.dat", FFTCONFIGDIR);
-# endif
-
-# ifndef FFTWMT
-    WRITE_FULLFILENAME(wisdom_file_single, "%s/fftwf_wisdom.dat", FFTCONFIGDIR);
-    WRITE_FULLFILENAME(wisdom_file_double, "%s/fftw_wisdom.dat", FFTCONFIGDIR);
-# endif
+    if(
+        CLI_checkarg(1, CLIARG_IMG) +
+        CLI_checkarg(2, CLIARG_STR) +
+        CLI_checkarg(3, CLIARG_STR) +
+        CLI_checkarg(4, CLIARG_STR)
+        == 0)
+    {
+        int kind0 = fft_r2rkind(data.cmdargtoken[3].val.string);
+        int kind1 = fft_r2rkind(data.cmdargtoken[4].val.string);
 
+        if((kind0 < 0) || (kind1 < 0))
+        {
+            PRINT_ERROR("unknown r2r kind %s %s", data.cmdargtoken[3].val.string,
+                        data.cmdargtoken[4].val.string);
+            return CLICMD_INVALID_ARG;
+        }
+        do2dr2r(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.string,
+            kind0,
+            kind1
+        );
 
-    if((fp = fopen(wisdom_file_single, "w")) == NULL)
-    {
-        PRINT_ERROR("Error creating wisdom file \"%s\"", wisdom_file_single);
-        abort();
+        return CLICMD_SUCCESS;
     }
-    fftwf_export_wisdom_to_file(fp);
-    fclose(fp);
-
-    if((fp = fopen(wisdom_file_double, "w")) == NULL)
+    else
     {
-        PRINT_ERROR("Error creating wisdom file \"%s\"", wisdom_file_double);
-        abort();
+        return CLICMD_INVALID_ARG;
     }
-    fftw_export_wisdom_to_file(fp);
-    fclose(fp);
+}
+
+
+
+errno_t fft_do1drfft_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_IMG) +
+        CLI_checkarg(2, CLIARG_STR_NOT_IMG)
+        == 0)
+    {
+        do1drfft(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.string
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+errno_t fft_do2dfft_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_IMG) +
+        CLI_checkarg(2, CLIARG_STR_NOT_IMG)
+        == 0)
+    {
+        do2dfft(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.string
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+
+errno_t fft_wisdomgen_run_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_STR) +
+        CLI_checkarg(2, CLIARG_LONG)
+        == 0)
+    {
+        fft_wisdomgen_run(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.numl
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+errno_t fft_planpolicy_set_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_STR) +
+        CLI_checkarg(2, CLIARG_FLOAT)
+        == 0)
+    {
+        fft_planpolicy_set(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.numf
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+errno_t fft_planpolicy_setsize_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_STR) +
+        CLI_checkarg(2, CLIARG_LONG) +
+        CLI_checkarg(3, CLIARG_LONG)
+        == 0)
+    {
+        fft_planpolicy_setsize(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.numl,
+            data.cmdargtoken[3].val.numl
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+
+errno_t fft_planpolicy_setbackground_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_LONG)
+        == 0)
+    {
+        fft_planpolicy_setbackground(
+            data.cmdargtoken[1].val.numl
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+
+errno_t fft_planpolicy_setnthreads_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_LONG)
+        == 0)
+    {
+        fft_planpolicy_setnthreads(
+            data.cmdargtoken[1].val.numl
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+
+errno_t fft_planpolicy_setsizenthreads_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_LONG) +
+        CLI_checkarg(2, CLIARG_LONG) +
+        CLI_checkarg(3, CLIARG_LONG)
+        == 0)
+    {
+        fft_planpolicy_setsizenthreads(
+            data.cmdargtoken[1].val.numl,
+            data.cmdargtoken[2].val.numl,
+            data.cmdargtoken[3].val.numl
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+
+errno_t fft_batch_setmode_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_STR)
+        == 0)
+    {
+        fft_batch_setmode(
+            data.cmdargtoken[1].val.string
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+
+errno_t fft_workerpool_set_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_LONG) +
+        CLI_checkarg(2, CLIARG_STR) +
+        CLI_checkarg(3, CLIARG_LONG) +
+        CLI_checkarg(4, CLIARG_LONG) +
+        CLI_checkarg(5, CLIARG_LONG)
+        == 0)
+    {
+        fft_workerpool_set(
+            data.cmdargtoken[1].val.numl,
+            data.cmdargtoken[2].val.string,
+            data.cmdargtoken[3].val.numl,
+            data.cmdargtoken[4].val.numl,
+            data.cmdargtoken[5].val.numl
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+
+errno_t fft_wisdom_info_cli()
+{
+    printf("fft module init time : %.3f ms\n", module_inittime * 1000.0);
+    return fft_wisdom_info();
+}
+
+
+
+errno_t test_fftspeed_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_LONG)
+        == 0)
+    {
+        test_fftspeed(
+            (int) data.cmdargtoken[1].val.numl
+        );
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+errno_t fft_image_translate_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_IMG) +
+        CLI_checkarg(2, CLIARG_STR_NOT_IMG) +
+        CLI_checkarg(3, CLIARG_FLOAT) +
+        CLI_checkarg(4, CLIARG_FLOAT)
+        == 0)
+    {
+        fft_image_translate(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.string,
+            data.cmdargtoken[3].val.numf,
+            data.cmdargtoken[4].val.numf
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+errno_t fft_correlation_ref_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_IMG) +
+        CLI_checkarg(2, CLIARG_IMG) +
+        CLI_checkarg(3, CLIARG_STR) +
+        CLI_checkarg(4, CLIARG_LONG)
+        == 0)
+    {
+        fft_correlation_ref(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.string,
+            data.cmdargtoken[3].val.string,
+            (int) data.cmdargtoken[4].val.numl
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+errno_t fft_registration_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_IMG) +
+        CLI_checkarg(2, CLIARG_IMG) +
+        CLI_checkarg(3, CLIARG_STR) +
+        CLI_checkarg(4, CLIARG_LONG) +
+        CLI_checkarg(5, CLIARG_LONG)
+        == 0)
+    {
+        fft_registration(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.string,
+            data.cmdargtoken[3].val.string,
+            data.cmdargtoken[4].val.numl,
+            (int) data.cmdargtoken[5].val.numl
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+errno_t fft_autocorrelation_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_IMG) +
+        CLI_checkarg(2, CLIARG_STR_NOT_IMG) +
+        CLI_checkarg(3, CLIARG_LONG)
+        == 0)
+    {
+        fft_autocorrelation(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.string,
+            (int) data.cmdargtoken[3].val.numl
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+errno_t fft_structure_function_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_IMG) +
+        CLI_checkarg(2, CLIARG_STR_NOT_IMG) +
+        CLI_checkarg(3, CLIARG_LONG)
+        == 0)
+    {
+        fft_structure_function_ensemble(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.string,
+            (int) data.cmdargtoken[3].val.numl
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+errno_t fft_correlation_cli()
+{
+    if(
+        CLI_checkarg(1, CLIARG_IMG) +
+        CLI_checkarg(2, CLIARG_IMG) +
+        CLI_checkarg(3, CLIARG_STR_NOT_IMG)
+        == 0)
+    {
+        fft_correlation(
+            data.cmdargtoken[1].val.string,
+            data.cmdargtoken[2].val.string,
+            data.cmdargtoken[3].val.string
+        );
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
+
+
+
+
+
+
+
+
+static errno_t init_module_CLI()
+{
+    struct timespec t0, t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    // FFTW init
+    // threads and wisdom are initialized on first plan request
+
+    // planning mode and time limit
+    fft_planpolicy_loadconf();
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    module_inittime = 1.0 * (t1.tv_sec - t0.tv_sec) + 1.0e-9 * (t1.tv_nsec - t0.tv_nsec);
+
+
+
+    RegisterCLIcommand(
+        "initfft",
+        __FILE__,
+        init_fftw_plans0,
+        "init FFTW",
+        "no argument",
+        "initfft",
+        "int init_fftw_plans0()");
+
+
+    RegisterCLIcommand(
+        "initfftm",
+        __FILE__,
+        fft_wisdomgen_run_cli,
+        "init FFTW for sizes listed in manifest file, using NBproc processes",
+        "<manifest> <NBproc>",
+        "initfftm fftsizes.txt 4",
+        "errno_t fft_wisdomgen_run(const char *manifest_fname, long NBproc)");
+
+
+    RegisterCLIcommand(
+        "dofft",
+        __FILE__,
+        fft_do2dfft_cli,
+        "perform FFT",
+        "<input> <output>",
+        "fofft in out",
+        "int do2dfft(const char *in_name, const char *out_name)");
+
+
+    RegisterCLIcommand(
+        "do1Dfft",
+        __FILE__,
+        fft_do1dfft_cli,
+        "perform 1D complex->complex FFT",
+        "<input> <output>",
+        "do1Dfft in out",
+        "int do1dfft(const char *in_name, const char *out_name)");
+
+
+    RegisterCLIcommand(
+        "do1Drfft",
+        __FILE__,
+        fft_do1drfft_cli,
+        "perform 1D real->complex FFT",
+        "<input> <output>",
+        "do1drfft in out",
+        "int do1drfft(const char *in_name, const char *out_name)");
+
+
+    RegisterCLIcommand(
+        "do1Dfftaxis",
+        __FILE__,
+        fft_do1dfft_axis_cli,
+        "perform 1D complex->complex FFT along axis, in place if output is input",
+        "<input> <output> <axis> <direction (-1: forward, 1: inverse)>",
+        "do1Dfftaxis in out 2 -1",
+        "long FFT_do1dfft_axis(const char *in_name, const char *out_name, int axis, int dir)");
+
+
+    RegisterCLIcommand(
+        "do1Drfftaxis",
+        __FILE__,
+        fft_do1drfft_axis_cli,
+        "perform 1D real->complex FFT along axis",
+        "<input> <output> <axis>",
+        "do1Drfftaxis in out 2",
+        "imageID do1drfft_axis(const char *in_name, const char *out_name, int axis)");
+
+
+    RegisterCLIcommand(
+        "doNDfft",
+        __FILE__,
+        fft_dondfft_cli,
+        "perform FFT over axes of mask (complex->complex or real->complex)",
+        "<input> <output> <axis mask> <direction (-1: forward, 1: inverse)>",
+        "doNDfft in out 7 -1",
+        "imageID FFT_dondfft(const char *in_name, const char *out_name, long axismask, int dir)");
+
+
+    RegisterCLIcommand(
+        "doNDrffti",
+        __FILE__,
+        fft_dondrffti_cli,
+        "perform complex->real inverse FFT over axes of mask",
+        "<input> <output> <axis mask> <real size of fastest axis, 0: even>",
+        "doNDrffti in out 7 0",
+        "imageID FFT_dondrffti(const char *in_name, const char *out_name, long axismask, long naxes)");
+
+
+    RegisterCLIcommand(
+        "doNDfftsplit",
+        __FILE__,
+        fft_dondfft_split_cli,
+        "perform complex FFT over axes of mask on separate real and imaginary images",
+        "<input re> <input im> <output re> <output im> <axis mask> <direction (-1: forward, 1: inverse)>",
+        "doNDfftsplit re im fre fim 3 -1",
+        "imageID FFT_dondfft_split(const char *re_name, const char *im_name, const char *reout_name, const char *imout_name, long axismask, int dir)");
+
+
+    RegisterCLIcommand(
+        "do1Dr2r",
+        __FILE__,
+        fft_do1dr2r_cli,
+        "perform 1D real->real FFT (DCT/DST) along rows, in place if output is input",
+        "<input> <output> <kind (REDFT00..RODFT11, DCT1..DCT4, DST1..DST4)>",
+        "do1Dr2r in out REDFT10",
+        "imageID do1dr2r(const char *in_name, const char *out_name, int kind)");
+
+
+    RegisterCLIcommand(
+        "do2Dr2r",
+        __FILE__,
+        fft_do2dr2r_cli,
+        "perform 2D real->real FFT (DCT/DST) on each slice, in place if output is input",
+        "<input> <output> <kind axis 0> <kind axis 1>",
+        "do2Dr2r in out REDFT10 REDFT10",
+        "imageID do2dr2r(const char *in_name, const char *out_name, int kind0, int kind1)");
+
+
+    RegisterCLIcommand(
+        "permut",
+        __FILE__,
+        fft_permut_cli,
+        "permut image quadrants",
+        "<image>",
+        "permut im1",
+        "int permut(const char *ID_name)");
+
+    RegisterCLIcommand(
+        "permutcopy",
+        __FILE__,
+        fft_permut_copy_cli,
+        "permut image quadrants to new image",
+        "<input> <output>",
+        "permutcopy im1 im2",
+        "imageID permut_copy(const char *ID_name, const char *IDout_name)");
+
+    RegisterCLIcommand(
+        "fftshift",
+        __FILE__,
+        fft_fftshift_cli,
+        "fftshift image in place, exact for odd sizes",
+        "<image> <axis mask, 0: all axes>",
+        "fftshift im1 0",
+        "imageID fftshift(const char *ID_name, long axismask)");
+
+    RegisterCLIcommand(
+        "ifftshift",
+        __FILE__,
+        fft_ifftshift_cli,
+        "ifftshift image in place, exact for odd sizes",
+        "<image> <axis mask, 0: all axes>",
+        "ifftshift im1 0",
+        "imageID ifftshift(const char *ID_name, long axismask)");
+
+
+    RegisterCLIcommand(
+        "fftplanlist",
+        __FILE__,
+        fft_plancache_list,
+        "list cached FFTW plans",
+        "no argument",
+        "fftplanlist",
+        "errno_t fft_plancache_list()");
+
+
+    RegisterCLIcommand(
+        "fftplanflush",
+        __FILE__,
+        fft_plancache_flush,
+        "destroy all cached FFTW plans",
+        "no argument",
+        "fftplanflush",
+        "errno_t fft_plancache_flush()");
+
+
+    RegisterCLIcommand(
+        "fftplanmode",
+        __FILE__,
+        fft_planpolicy_set_cli,
+        "set FFTW planning mode and time limit",
+        "<estimate|measure|patient|exhaustive> <timelimit [sec], <=0 for none>",
+        "fftplanmode measure 5.0",
+        "errno_t fft_planpolicy_set(const char *modestr, double timelimit)");
+
+
+    RegisterCLIcommand(
+        "fftplanmodesize",
+        __FILE__,
+        fft_planpolicy_setsize_cli,
+        "set FFTW planning mode for a transform size",
+        "<estimate|measure|patient|exhaustive> <size0> <size1, 0 for 1D>",
+        "fftplanmodesize patient 120 120",
+        "errno_t fft_planpolicy_setsize(const char *modestr, long size0, long size1)");
+
+
+    RegisterCLIcommand(
+        "fftplanbg",
+        __FILE__,
+        fft_planpolicy_setbackground_cli,
+        "background FFTW plan optimization, estimate plan used meanwhile",
+        "<0|1>",
+        "fftplanbg 1",
+        "errno_t fft_planpolicy_setbackground(long mode)");
+
+
+    RegisterCLIcommand(
+        "fftnthreads",
+        __FILE__,
+        fft_planpolicy_setnthreads_cli,
+        "default number of FFTW threads, 0 for automatic",
+        "<nthreads>",
+        "fftnthreads 8",
+        "errno_t fft_planpolicy_setnthreads(long nthreads)");
+
+
+    RegisterCLIcommand(
+        "fftnthreadssize",
+        __FILE__,
+        fft_planpolicy_setsizenthreads_cli,
+        "number of FFTW threads for transform size, size1 = 0 for 1D",
+        "<size0> <size1> <nthreads>",
+        "fftnthreadssize 2048 2048 8",
+        "errno_t fft_planpolicy_setsizenthreads(long size0, long size1, long nthreads)");
+
+
+    RegisterCLIcommand(
+        "fftslicemode",
+        __FILE__,
+        fft_batch_setmode_cli,
+        "parallelization of cube transforms: slices, FFTW threads or both",
+        "<auto|transform|slice|measure>",
+        "fftslicemode measure",
+        "errno_t fft_batch_setmode(const char *modestr)");
+
+
+    RegisterCLIcommand(
+        "fftpool",
+        __FILE__,
+        fft_workerpool_set_cli,
+        "FFT worker pool: threads (0: all CPUs), CPU list (- for none), SCHED_FIFO priority (0: none), mlock stacks, stack size (0: default)",
+        "<nthreads> <cpulist> <rtprio> <mlock> <stack KiB>",
+        "fftpool 8 4:11 80 1 256",
+        "errno_t fft_workerpool_set(long nthreads, const char *cpulist, long rtprio, long mlockstack, long stackKiB)");
+
+
+    RegisterCLIcommand(
+        "fftplanmodelist",
+        __FILE__,
+        fft_planpolicy_list,
+        "list FFTW planning modes",
+        "no argument",
+        "fftplanmodelist",
+        "errno_t fft_planpolicy_list()");
+
+
+    RegisterCLIcommand(
+        "fftwisdominfo",
+        __FILE__,
+        fft_wisdom_info_cli,
+        "FFTW wisdom files and module startup time",
+        "no argument",
+        "fftwisdominfo",
+        "errno_t fft_wisdom_info()");
+
+
+    RegisterCLIcommand(
+        "testfftspeed",
+        __FILE__,
+        test_fftspeed_cli,
+        "test FFTW speed",
+        "no argument",
+        "testfftspeed",
+        "int test_fftwspeed(int nmax)");
+
+    RegisterCLIcommand(
+        "transl",
+        __FILE__,
+        fft_image_translate_cli,
+        "translate image",
+        "<imagein> <imageout> <xtransl> <ytransl>",
+        "transl im1 im2 2.3 -2.1",
+        "int fft_image_translate(const char *ID_name, const char *ID_out, double xtransl, double ytransl)");
+
+
+    RegisterCLIcommand(
+        "fcorrel",
+        __FILE__,
+        fft_correlation_cli,
+        "correlate two images, or each slice of a cube with an image",
+        "<imagein1> <imagein2> <correlout>",
+        "fcorrel im1 im2 outim",
+        "long fft_correlation(const char *ID_name1, const char *ID_name2, const char *ID_nameout)");
+
+
+    RegisterCLIcommand(
+        "fautocorrel",
+        __FILE__,
+        fft_autocorrelation_cli,
+        "autocorrelation of image or of each cube slice, zero lag at (0,0)",
+        "<imagein> <autocorrelout> <zero padding to 2N (0: circular, 1: linear)>",
+        "fautocorrel im1 outim 1",
+        "imageID fft_autocorrelation(const char *IDin_name, const char *IDout_name, int zeropad)");
+
+
+    RegisterCLIcommand(
+        "fstructfunc",
+        __FILE__,
+        fft_structure_function_cli,
+        "structure function of image, averaged over cube slices",
+        "<imagein> <structfuncout> <radial profile (0: 2D, 1: 1D)>",
+        "fstructfunc screens outsf 1",
+        "imageID fft_structure_function_ensemble(const char *ID_in, const char *ID_out, int radial)");
+
+
+    RegisterCLIcommand(
+        "fcorrelref",
+        __FILE__,
+        fft_correlation_ref_cli,
+        "correlate image or cube with reference, reference spectrum kept between calls",
+        "<reference> <imagein> <correlout> <flags (1: convolve, 2: phase correlation)>",
+        "fcorrelref imref im1 outim 0",
+        "imageID fft_correlation_ref(const char *IDref_name, const char *ID_name, const char *ID_nameout, int flags)");
+
+
+    RegisterCLIcommand(
+        "fregister",
+        __FILE__,
+        fft_registration_cli,
+        "subpixel shift of image or cube slices relative to reference, output (dx, dy, peak) per slice",
+        "<reference> <imagein> <output stream> <upsampling factor> <flags (1: phase correlation)>",
+        "fregister imref imcube regout 100 0",
+        "imageID fft_registration(const char *IDref_name, const char *ID_name, const char *IDout_name, long upsample, int flags)");
+
+
+    RegisterCLIcommand(
+        "fcorrelreflist",
+        __FILE__,
+        fft_correlation_reflist,
+        "list correlation reference contexts",
+        "no argument",
+        "fcorrelreflist",
+        "errno_t fft_correlation_reflist()");
+
+
+    RegisterCLIcommand(
+        "fcorrelrefflush",
+        __FILE__,
+        fft_correlation_refflush,
+        "free all correlation reference contexts",
+        "no argument",
+        "fcorrelrefflush",
+        "errno_t fft_correlation_refflush()");
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+
+
+static void __attribute__((destructor)) close_fftwlib()
+{
+    if(INITSTATUS_module == 1)
+    {
+        fft_plancache_cleanupthreads();
+        fft_workerpool_stop();
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/**
+ * @brief Set default number of FFTW threads, both precisions
+ *
+ * nt = 0 for automatic choice from transform size (see fft_planpolicy.c)
+ */
+int fft_setNthreads(
+    int nt
+)
+{
+    fft_planpolicy_setnthreads(nt);
+
+    return(0);
+}
+
+
+
+
+/**
+ * @brief Optimize FFTW for standard sizes
+ *
+ * Uses size manifest FFTCONFIGDIR/fftsizes.txt if it exists, otherwise
+ * 2^n x 2^n 2D and 2^n 1D sizes. See fft_wisdomgen.c
+ */
+errno_t init_fftw_plans(
+    __attribute__((unused)) int mode
+)
+{
+    return fft_wisdomgen_run(NULL, 1);
+}
+
+
+
+
+errno_t init_fftw_plans0()
+{
+    init_fftw_plans(0);
 
     return RETURN_SUCCESS;
 }
 
 
-/*^-----------------------------------------------------------------------------
-|
-|
-|
-|
-|
-|
-|
-+-----------------------------------------------------------------------------*/
-errno_t init_fftw_plans(int mode)
-{
-    int n;
-    int size;
 
-    fftwf_complex *inf = NULL;
-    fftwf_complex *outf = NULL;
-    float *rinf = NULL;
 
-    fftw_complex *ind = NULL;
-    fftw_complex *outd = NULL;
-    double *rind = NULL;
+// array and element size of image ID for permut, NULL if datatype not supported
+static void *fft_permut_array(
+    imageID ID,
+    size_t *eltsize
+)
+{
+    switch(data.image[ID].md[0].datatype)
+    {
+        case _DATATYPE_FLOAT:
+            *eltsize = sizeof(float);
+            return (void *) data.image[ID].array.F;
+
+        case _DATATYPE_DOUBLE:
+            *eltsize = sizeof(double);
+            return (void *) data.image[ID].array.D;
+
+        case _DATATYPE_COMPLEX_FLOAT:
+            *eltsize = sizeof(complex_float);
+            return (void *) data.image[ID].array.CF;
+
+        case _DATATYPE_COMPLEX_DOUBLE:
+            *eltsize = sizeof(complex_double);
+            return (void *) data.image[ID].array.CD;
+
+        default:
+            *eltsize = 0;
+            return NULL;
+    }
+}
+
+
+
+/**
+ * @brief Swap quadrants of image (or of each cube slice) in place
+ *
+ * For even sizes this is fftshift = ifftshift. For odd sizes the layout is
+ * that of the original permut, which is neither: see fftshift / ifftshift.
+ * permut_copy gives the same layout out of place.
+ */
+int permut(const char *ID_name)
+{
+    long naxes0, naxes1, naxes2;
+    imageID ID;
+    long naxis;
+    size_t eltsize;
+    void *array;
+
+    //  printf("permut image %s ...", ID_name);
+    // fflush(stdout);
+
+    ID = image_ID(ID_name);
+    naxis = data.image[ID].md[0].naxis;
+
+    naxes0 = data.image[ID].md[0].size[0];
+    naxes1 = 1;
+    naxes2 = 1;
+    if(naxis > 1)
+    {
+        naxes1 = data.image[ID].md[0].size[1];
+    }
+    if(naxis > 2)
+    {
+        naxes2 = data.image[ID].md[0].size[2];
+    }
+
+    //  printf(" [%ld %ld %ld] ", naxes0, naxes1, naxes2);
+
+    array = fft_permut_array(ID, &eltsize);
+
+    if((array == NULL) || (naxis < 1) || (naxis > 3))
+    {
+        printf("Error : data format not supported by permut\n");
+        return(0);
+    }
+
+    fft_shift_quadrant(array, eltsize, naxes0, naxes1, naxes2);
+
+    //  printf(" done\n");
+    // fflush(stdout);
+
+
+    return(0);
+}
+
+
+
+
+/**
+ * @brief Out-of-place permut: IDout_name is created with the quadrants of ID_name swapped
+ *
+ * Same layout as copy + permut for all sizes. For odd sizes, neither is an
+ * exact fftshift or ifftshift: use fftshift / ifftshift (fft_shift_axes).
+ */
+imageID permut_copy(
+    const char *ID_name,
+    const char *IDout_name
+)
+{
+    imageID ID;
+    imageID IDout;
+    long naxis;
+    long naxes[3] = {1, 1, 1};
+    size_t eltsize;
+    void *array;
+    void *arrayout;
+
+    ID = image_ID(ID_name);
+    naxis = data.image[ID].md[0].naxis;
+    array = fft_permut_array(ID, &eltsize);
+
+    if((array == NULL) || (naxis < 1) || (naxis > 3))
+    {
+        PRINT_ERROR("data format not supported by permut_copy");
+        return -1;
+    }
+
+    for(int axis = 0; axis < naxis; axis++)
+    {
+        naxes[axis] = data.image[ID].md[0].size[axis];
+    }
+
+    IDout = create_image_ID(IDout_name, naxis, data.image[ID].md[0].size,
+                            data.image[ID].md[0].datatype, 0, 0);
+    arrayout = fft_permut_array(IDout, &eltsize);
+
+    if((naxes[0] % 2 == 0) && (naxes[1] % 2 == 0))
+    {
+        fft_shift_quadrantcopy(array, arrayout,
+                               eltsize, naxes[0], naxes[1], naxes[2]);
+    }
+    else
+    {
+        // odd sizes: the out-of-place shift is circular, permut is not
+        memcpy(arrayout, array, eltsize * naxes[0] * naxes[1] * naxes[2]);
+        fft_shift_quadrant(arrayout, eltsize, naxes[0], naxes[1], naxes[2]);
+    }
+
+    return IDout;
+}
+
+
+
+
+static imageID fft_shift_image(
+    const char *ID_name,
+    long        axismask,
+    int         inverse
+)
+{
+    imageID ID;
+    long naxis;
+    long size[3];
+    size_t eltsize;
+    void *array;
+
+    ID = image_ID(ID_name);
+    naxis = data.image[ID].md[0].naxis;
+    array = fft_permut_array(ID, &eltsize);
+
+    if((array == NULL) || (naxis < 1) || (naxis > 3))
+    {
+        PRINT_ERROR("data format not supported by fftshift");
+        return -1;
+    }
+
+    for(int axis = 0; axis < naxis; axis++)
+    {
+        size[axis] = data.image[ID].md[0].size[axis];
+    }
+
+    if(fft_shift_axes(array, eltsize, naxis, size, (int) axismask, inverse)
+            != RETURN_SUCCESS)
+    {
+        return -1;
+    }
+
+    return ID;
+}
+
+
+
+/**
+ * @brief In-place fftshift: element 0 moves to n/2 along each selected axis
+ *
+ * Bit a of axismask selects axis a, 0 selects all axes.
+ * Unlike permut, exact for odd sizes.
+ */
+imageID fftshift(
+    const char *ID_name,
+    long        axismask
+)
+{
+    return fft_shift_image(ID_name, axismask, 0);
+}
+
+
+
+/**
+ * @brief In-place ifftshift, inverse of fftshift
+ */
+imageID ifftshift(
+    const char *ID_name,
+    long        axismask
+)
+{
+    return fft_shift_image(ID_name, axismask, 1);
+}
+
+
+
+int array_index(long size)
+{
+    int i;
+
+    switch(size)
+    {
+        case 1:
+            i = 0;
+            break;
+        case 2:
+            i = 1;
+            break;
+        case 4:
+            i = 2;
+            break;
+        case 8:
+            i = 3;
+            break;
+        case 16:
+            i = 4;
+            break;
+        case 32:
+            i = 5;
+            break;
+        case 64:
+            i = 6;
+            break;
+        case 128:
+            i = 7;
+            break;
+        case 256:
+            i = 8;
+            break;
+        case 512:
+            i = 9;
+            break;
+        case 1024:
+            i = 10;
+            break;
+        case 2048:
+            i = 11;
+            break;
+        case 4096:
+            i = 12;
+            break;
+        case 8192:
+            i = 13;
+            break;
+        case 16384:
+            i = 14;
+            break;
+        default:
+            i = 100;
+    }
+
+    return(i);
+}
+
+
+
+
+
+/* 1d complex -> complex fft */
+// supports single and double precisions
+// one transform per row along axis 0, all rows (naxis 1 to 3) in one batched plan
+long FFT_do1dfft(const char *in_name, const char *out_name, int dir)
+{
+    uint32_t naxesl[3];
+    long naxis;
+    long IDin, IDout;
+    long nbrow = 1;
+    uint8_t datatype;
+    FFT_PLANKEY key;
+    int precision;
+    void *inarray;
+    void *outarray;
+
+    IDin = image_ID(in_name);
+    naxis = data.image[IDin].md[0].naxis;
+    datatype = data.image[IDin].md[0].datatype;
+
+    if((naxis < 1) || (naxis > 3))
+    {
+        printf("Error : image dimension not appropriate for FFT\n");
+        return -1;
+    }
+    if((datatype != _DATATYPE_COMPLEX_FLOAT) && (datatype != _DATATYPE_COMPLEX_DOUBLE))
+    {
+        PRINT_ERROR("image %s not appropriate for complex FFT", in_name);
+        return -1;
+    }
+
+    for(int i = 0; i < naxis; i++)
+    {
+        naxesl[i] = data.image[IDin].md[0].size[i];
+        if(i > 0)
+        {
+            nbrow *= naxesl[i];
+        }
+    }
+    IDout = create_image_ID(out_name, naxis, naxesl, datatype, data.SHARED_DFT,
+                            data.NBKEWORD_DFT);
+
+    if(datatype == _DATATYPE_COMPLEX_FLOAT)
+    {
+        precision = FFT_PRECISION_SINGLE;
+        inarray = (void *) data.image[IDin].array.CF;
+        outarray = (void *) data.image[IDout].array.CF;
+    }
+    else
+    {
+        precision = FFT_PRECISION_DOUBLE;
+        inarray = (void *) data.image[IDin].array.CD;
+        outarray = (void *) data.image[IDout].array.CD;
+    }
+
+    fft_plankey_init(&key, precision, FFT_KIND_C2C, dir);
+    fft_plankey_adddim(&key, naxesl[0], 1, 1);
+    if(nbrow > 1)
+    {
+        fft_plankey_addhowmany(&key, nbrow, naxesl[0], naxesl[0]);
+    }
+
+    fft_batch_execute(&key, inarray, outarray);
+
+    return(IDout);
+}
+
 
-    unsigned int plan_mode;
 
 
-    printf("Optimization of FFTW\n");
-    printf("The optimization is done for 2D complex to complex FFTs, with size equal to 2^n x 2^n\n");
-    printf("You can kill the optimization anytime, and resume later where it previously stopped.\nAfter each size is optimized, the result is saved\n");
-    printf("It might be a good idea to run this overnight or when your computer is not busy\n");
+/* 1d real -> complex fft */
+// supports single and double precision
+// one transform per row along axis 0, all rows (naxis 1 to 3) in one batched plan
+// output rows hold naxes0/2+1 complex elements
+imageID do1drfft(
+    const char *in_name,
+    const char *out_name
+)
+{
+    uint32_t naxesout[3];
+    long naxis;
+    long naxes0;
+    long nbrow = 1;
+    imageID IDin;
+    imageID IDout;
+    uint8_t datatype;
+    FFT_PLANKEY key;
 
-    fflush(stdout);
 
-    size = 1;
+    IDin = image_ID(in_name);
+    naxis = data.image[IDin].md[0].naxis;
+    datatype = data.image[IDin].md[0].datatype;
 
-    //  plan_mode = FFTWOPTMODE;
-    plan_mode = FFTW_EXHAUSTIVE;
+    if((naxis < 1) || (naxis > 3))
+    {
+        printf("Error : image dimension not appropriate for FFT\n");
+        return -1;
+    }
+    if((datatype != _DATATYPE_FLOAT) && (datatype != _DATATYPE_DOUBLE))
+    {
+        PRINT_ERROR("image %s not appropriate for real FFT", in_name);
+        return -1;
+    }
 
-    for(n = 0; n < 14; n++)
+    for(int i = 0; i < naxis; i++)
     {
-        if(mode == 0)
+        naxesout[i] = data.image[IDin].md[0].size[i];
+        if(i > 0)
         {
-            printf("Optimizing 2D FFTs - size = %d\n", size);
-            fflush(stdout);
+            nbrow *= naxesout[i];
         }
-        rinf = (float *) fftwf_malloc(size * size * sizeof(float));
-        inf = (fftwf_complex *) fftwf_malloc(size * size * sizeof(fftwf_complex));
-        outf = (fftwf_complex *) fftwf_malloc(size * size * sizeof(fftwf_complex));
+    }
+    naxes0 = naxesout[0];
+    naxesout[0] = naxes0 / 2 + 1;
+
+    if(datatype == _DATATYPE_FLOAT)
+    {
+        IDout = create_image_ID(out_name, naxis, naxesout, _DATATYPE_COMPLEX_FLOAT,
+                                data.SHARED_DFT, data.NBKEWORD_DFT);
+        fft_plankey_init(&key, FFT_PRECISION_SINGLE, FFT_KIND_R2C, FFTW_FORWARD);
+    }
+    else
+    {
+        IDout = create_image_ID(out_name, naxis, naxesout, _DATATYPE_COMPLEX_DOUBLE,
+                                data.SHARED_DFT, data.NBKEWORD_DFT);
+        fft_plankey_init(&key, FFT_PRECISION_DOUBLE, FFT_KIND_R2C, FFTW_FORWARD);
+    }
+    fft_plankey_adddim(&key, naxes0, 1, 1);
+    if(nbrow > 1)
+    {
+        fft_plankey_addhowmany(&key, nbrow, naxes0, naxesout[0]);
+    }
+
+    if(datatype == _DATATYPE_FLOAT)
+    {
+        fft_batch_execute(&key, data.image[IDin].array.F,
+                          data.image[IDout].array.CF);
+    }
+    else
+    {
+        fft_batch_execute(&key, data.image[IDin].array.D,
+                          data.image[IDout].array.CD);
+    }
+
+    return(IDout);
+}
 
-        fftwf_plan_dft_2d(size, size, inf, outf, FFTW_FORWARD, plan_mode);
-        fftwf_plan_dft_2d(size, size, inf, outf, FFTW_BACKWARD, plan_mode);
-        fftwf_plan_dft_r2c_2d(size, size, rinf, outf, plan_mode);
 
-        fftwf_free(inf);
-        fftwf_free(rinf);
-        fftwf_free(outf);
 
 
-        rind = (double *) fftw_malloc(size * size * sizeof(double));
-        ind = (fftw_complex *) fftw_malloc(size * size * sizeof(fftw_complex));
-        outd = (fftw_complex *) fftw_malloc(size * size * sizeof(fftw_complex));
+long do1dfft(const char *in_name, const char *out_name)
+{
+    long IDout;
 
-        fftw_plan_dft_2d(size, size, ind, outd, FFTW_FORWARD, plan_mode);
-        fftw_plan_dft_2d(size, size, ind, outd, FFTW_BACKWARD, plan_mode);
-        fftw_plan_dft_r2c_2d(size, size, rind, outd, plan_mode);
+    IDout = FFT_do1dfft(in_name, out_name, -1);
 
-        fftw_free(ind);
-        fftw_free(rind);
-        fftw_free(outd);
+    return(IDout);
+}
 
 
-        size *= 2;
-        if(mode == 0)
-        {
-            export_wisdom();
-        }
-    }
-    size = 1;
-    for(n = 0; n < 15; n++)
+long do1dffti(const char *in_name, const char *out_name)
+{
+    long IDout;
+
+    IDout = FFT_do1dfft(in_name, out_name, 1);
+
+    return(IDout);
+}
+
+
+
+
+
+// guru key for transforms over the axes of axismask of image ID
+static errno_t fft_image_plankey(
+    FFT_PLANKEY *key,
+    imageID      ID,
+    long         axismask
+)
+{
+    long size[3];
+    long naxis = data.image[ID].md[0].naxis;
+
+    for(int i = 0; i < naxis; i++)
     {
-        if(mode == 0)
-        {
-            printf("Optimizing 1D FFTs - size = %d\n", size);
-            fflush(stdout);
-        }
-        rinf = (float *) fftwf_malloc(size * sizeof(float));
-        inf = (fftwf_complex *) fftwf_malloc(size * sizeof(fftwf_complex));
-        outf = (fftwf_complex *) fftwf_malloc(size * sizeof(fftwf_complex));
+        size[i] = data.image[ID].md[0].size[i];
+    }
 
-        fftwf_plan_dft_1d(size, inf, outf, FFTW_FORWARD, plan_mode);
-        fftwf_plan_dft_1d(size, inf, outf, FFTW_BACKWARD, plan_mode);
-        fftwf_plan_dft_r2c_1d(size, rinf, outf, plan_mode);
+    return fft_plankey_addaxes(key, naxis, size, (int) axismask);
+}
 
-        fftwf_free(inf);
-        fftwf_free(rinf);
-        fftwf_free(outf);
 
 
 
-        rind = (double *) fftw_malloc(size * sizeof(double));
-        ind = (fftw_complex *) fftw_malloc(size * sizeof(fftw_complex));
-        outd = (fftw_complex *) fftw_malloc(size * sizeof(fftw_complex));
+/* 1d complex -> complex fft along axis */
+// supports single and double precisions, naxis 1 to 3
+// e.g. axis = 2: temporal spectrum of each pixel of a (x, y, time) cube
+// in place if out_name is in_name
+long FFT_do1dfft_axis(
+    const char *in_name,
+    const char *out_name,
+    int         axis,
+    int         dir
+)
+{
+    long naxis;
+    imageID IDin;
+    imageID IDout;
+    uint8_t datatype;
+    FFT_PLANKEY key;
+    int precision;
+    void *inarray;
+    void *outarray;
 
-        fftw_plan_dft_1d(size, ind, outd, FFTW_FORWARD, plan_mode);
-        fftw_plan_dft_1d(size, ind, outd, FFTW_BACKWARD, plan_mode);
-        fftw_plan_dft_r2c_1d(size, rind, outd, plan_mode);
+    IDin = image_ID(in_name);
+    naxis = data.image[IDin].md[0].naxis;
+    datatype = data.image[IDin].md[0].datatype;
 
-        fftw_free(ind);
-        fftw_free(rind);
-        fftw_free(outd);
+    if((axis < 0) || (axis >= naxis) || (naxis > 3)
+            || ((datatype != _DATATYPE_COMPLEX_FLOAT) && (datatype != _DATATYPE_COMPLEX_DOUBLE)))
+    {
+        PRINT_ERROR("image %s not appropriate for FFT along axis %d", in_name, axis);
+        return -1;
+    }
 
+    if(strcmp(in_name, out_name) == 0)
+    {
+        IDout = IDin;
+    }
+    else
+    {
+        IDout = create_image_ID(out_name, naxis, data.image[IDin].md[0].size, datatype,
+                                data.SHARED_DFT, data.NBKEWORD_DFT);
+    }
 
-        size *= 2;
-        if(mode == 0)
-        {
-            export_wisdom();
-        }
+    if(datatype == _DATATYPE_COMPLEX_FLOAT)
+    {
+        precision = FFT_PRECISION_SINGLE;
+        inarray = (void *) data.image[IDin].array.CF;
+        outarray = (void *) data.image[IDout].array.CF;
+    }
+    else
+    {
+        precision = FFT_PRECISION_DOUBLE;
+        inarray = (void *) data.image[IDin].array.CD;
+        outarray = (void *) data.image[IDout].array.CD;
     }
 
+    fft_plankey_init(&key, precision, FFT_KIND_C2C, dir);
+    fft_image_plankey(&key, IDin, 1 << axis);
 
-    export_wisdom();
+    fft_batch_execute(&key, inarray, outarray);
 
-    return RETURN_SUCCESS;
+    return IDout;
 }
 
 
+long do1dfft_axis(const char *in_name, const char *out_name, int axis)
+{
+    return FFT_do1dfft_axis(in_name, out_name, axis, -1);
+}
 
 
-errno_t init_fftw_plans0()
+long do1dffti_axis(const char *in_name, const char *out_name, int axis)
 {
-    init_fftw_plans(0);
-
-    return RETURN_SUCCESS;
+    return FFT_do1dfft_axis(in_name, out_name, axis, 1);
 }
 
 
 
 
-int permut(const char *ID_name)
+/* 1d real -> complex fft along axis */
+// output size along axis is size/2+1
+imageID do1drfft_axis(
+    const char *in_name,
+    const char *out_name,
+    int         axis
+)
 {
-    long naxes0, naxes1, naxes2;
-    imageID ID;
-    long xhalf, yhalf;
-    long ii, jj, kk;
     long naxis;
+    uint32_t naxesout[3];
+    imageID IDin;
+    imageID IDout;
     uint8_t datatype;
-    int OK = 0;
+    FFT_PLANKEY key;
 
-    //  printf("permut image %s ...", ID_name);
-    // fflush(stdout);
+    IDin = image_ID(in_name);
+    naxis = data.image[IDin].md[0].naxis;
+    datatype = data.image[IDin].md[0].datatype;
 
-    ID = image_ID(ID_name);
-    naxis = data.image[ID].md[0].naxis;
+    if((axis < 0) || (axis >= naxis) || (naxis > 3)
+            || ((datatype != _DATATYPE_FLOAT) && (datatype != _DATATYPE_DOUBLE)))
+    {
+        PRINT_ERROR("image %s not appropriate for real FFT along axis %d", in_name, axis);
+        return -1;
+    }
 
-    naxes0 = data.image[ID].md[0].size[0];
-    if(naxis > 1)
+    for(int i = 0; i < naxis; i++)
     {
-        naxes1 = data.image[ID].md[0].size[1];
+        naxesout[i] = data.image[IDin].md[0].size[i];
     }
-    if(naxis > 2)
+    naxesout[axis] = naxesout[axis] / 2 + 1;
+
+    if(datatype == _DATATYPE_FLOAT)
     {
-        naxes2 = data.image[ID].md[0].size[2];
+        IDout = create_image_ID(out_name, naxis, naxesout, _DATATYPE_COMPLEX_FLOAT,
+                                data.SHARED_DFT, data.NBKEWORD_DFT);
+        fft_plankey_init(&key, FFT_PRECISION_SINGLE, FFT_KIND_R2C, FFTW_FORWARD);
+    }
+    else
+    {
+        IDout = create_image_ID(out_name, naxis, naxesout, _DATATYPE_COMPLEX_DOUBLE,
+                                data.SHARED_DFT, data.NBKEWORD_DFT);
+        fft_plankey_init(&key, FFT_PRECISION_DOUBLE, FFT_KIND_R2C, FFTW_FORWARD);
+    }
+    fft_image_plankey(&key, IDin, 1 << axis);
+
+    if(datatype == _DATATYPE_FLOAT)
+    {
+        fft_batch_execute(&key, data.image[IDin].array.F, data.image[IDout].array.CF);
     }
     else
     {
-        naxes2 = 1;
+        fft_batch_execute(&key, data.image[IDin].array.D, data.image[IDout].array.CD);
     }
 
-    //  printf(" [%ld %ld %ld] ", naxes0, naxes1, naxes2);
+    return IDout;
+}
 
 
-    datatype = data.image[ID].md[0].datatype;
 
-    if(datatype == _DATATYPE_FLOAT)
+
+
+/* N-dimensional fft over the axes of axismask */
+// supports single and double precisions, naxis 1 to 3
+// bit a of axismask selects axis a, other axes are batched: all in one guru plan
+// complex input: complex -> complex in direction dir, in place if out_name is in_name
+// real input: real -> complex (dir ignored), fastest selected axis of
+//             output holds size/2+1 elements
+// e.g. axismask = 7: 3D transform of a cube, 4: temporal transform of each pixel
+imageID FFT_dondfft(
+    const char *in_name,
+    const char *out_name,
+    long        axismask,
+    int         dir
+)
+{
+    long naxis;
+    uint32_t naxesout[3];
+    imageID IDin;
+    imageID IDout;
+    uint8_t datatype;
+    FFT_PLANKEY key;
+    int kind;
+    int precision;
+    void *inarray;
+    void *outarray;
+
+    IDin = image_ID(in_name);
+    naxis = data.image[IDin].md[0].naxis;
+    datatype = data.image[IDin].md[0].datatype;
+
+    switch(datatype)
     {
-        if(naxis == 1)
-        {
-            OK = 1;
-            xhalf = (long)(naxes0 / 2);
-            for(ii = 0; ii < xhalf; ii++)
-            {
-                SWAPf(data.image[ID].array.F[ii], data.image[ID].array.F[ii + xhalf]);
-            }
-        }
-        if(naxis == 2)
-        {
-            OK = 1;
-            xhalf = (long)(naxes0 / 2);
-            yhalf = (long)(naxes1 / 2);
-            for(jj = 0; jj < yhalf; jj++)
-                for(ii = 0; ii < xhalf; ii++)
-                {
-                    SWAPf(data.image[ID].array.F[jj * naxes0 + ii],
-                          data.image[ID].array.F[(jj + yhalf)*naxes0 + (ii + xhalf)]);
-                }
-            for(jj = yhalf; jj < naxes1; jj++)
-                for(ii = 0; ii < xhalf; ii++)
-                {
-                    SWAPf(data.image[ID].array.F[jj * naxes0 + ii],
-                          data.image[ID].array.F[(jj - yhalf)*naxes0 + (ii + xhalf)]);
-                }
-        }
-        if(naxis == 3)
-        {
-            OK = 1;
-            xhalf = (long)(naxes0 / 2);
-            yhalf = (long)(naxes1 / 2);
-            for(jj = 0; jj < yhalf; jj++)
-                for(ii = 0; ii < xhalf; ii++)
-                {
-                    for(kk = 0; kk < naxes2; kk++)
-                    {
-                        SWAPf(data.image[ID].array.F[kk * naxes0 * naxes1 + jj * naxes0 + ii],
-                              data.image[ID].array.F[kk * naxes0 * naxes1 + (jj + yhalf)*naxes0 +
-                                                     (ii + xhalf)]);
-                    }
-                }
-            for(jj = yhalf; jj < naxes1; jj++)
-                for(ii = 0; ii < xhalf; ii++)
-                {
-                    for(kk = 0; kk < naxes2; kk++)
-                    {
-                        SWAPf(data.image[ID].array.F[kk * naxes0 * naxes1 + jj * naxes0 + ii],
-                              data.image[ID].array.F[kk * naxes0 * naxes1 + (jj - yhalf)*naxes0 +
-                                                     (ii + xhalf)]);
-                    }
-                }
-        }
+        case _DATATYPE_FLOAT:
+        case _DATATYPE_DOUBLE:
+            kind = FFT_KIND_R2C;
+            dir = FFTW_FORWARD;
+            break;
+
+        case _DATATYPE_COMPLEX_FLOAT:
+        case _DATATYPE_COMPLEX_DOUBLE:
+            kind = FFT_KIND_C2C;
+            break;
+
+        default:
+            PRINT_ERROR("image %s datatype not supported by FFT", in_name);
+            return -1;
     }
+    precision = ((datatype == _DATATYPE_FLOAT) || (datatype == _DATATYPE_COMPLEX_FLOAT)) ?
+                FFT_PRECISION_SINGLE : FFT_PRECISION_DOUBLE;
 
-    if(datatype == _DATATYPE_DOUBLE)
+    fft_plankey_init(&key, precision, kind, dir);
+    if((naxis > 3) || (fft_image_plankey(&key, IDin, axismask) != RETURN_SUCCESS))
     {
-        if(naxis == 1)
-        {
-            OK = 1;
-            xhalf = (long)(naxes0 / 2);
-            for(ii = 0; ii < xhalf; ii++)
-            {
-                SWAPd(data.image[ID].array.D[ii], data.image[ID].array.D[ii + xhalf]);
-            }
-        }
-        if(naxis == 2)
-        {
-            OK = 1;
-            xhalf = (long)(naxes0 / 2);
-            yhalf = (long)(naxes1 / 2);
-            for(jj = 0; jj < yhalf; jj++)
-                for(ii = 0; ii < xhalf; ii++)
-                {
-                    SWAPd(data.image[ID].array.D[jj * naxes0 + ii],
-                          data.image[ID].array.D[(jj + yhalf)*naxes0 + (ii + xhalf)]);
-                }
-            for(jj = yhalf; jj < naxes1; jj++)
-                for(ii = 0; ii < xhalf; ii++)
-                {
-                    SWAPd(data.image[ID].array.D[jj * naxes0 + ii],
-                          data.image[ID].array.D[(jj - yhalf)*naxes0 + (ii + xhalf)]);
-                }
-        }
-        if(naxis == 3)
-        {
-            OK = 1;
-            xhalf = (long)(naxes0 / 2);
-            yhalf = (long)(naxes1 / 2);
-            for(jj = 0; jj < yhalf; jj++)
-                for(ii = 0; ii < xhalf; ii++)
-                {
-                    for(kk = 0; kk < naxes2; kk++)
-                    {
-                        SWAPd(data.image[ID].array.D[kk * naxes0 * naxes1 + jj * naxes0 + ii],
-                              data.image[ID].array.D[kk * naxes0 * naxes1 + (jj + yhalf)*naxes0 +
-                                                     (ii + xhalf)]);
-                    }
-                }
-            for(jj = yhalf; jj < naxes1; jj++)
-                for(ii = 0; ii < xhalf; ii++)
-                {
-                    for(kk = 0; kk < naxes2; kk++)
-                    {
-                        SWAPd(data.image[ID].array.D[kk * naxes0 * naxes1 + jj * naxes0 + ii],
-                              data.image[ID].array.D[kk * naxes0 * naxes1 + (jj - yhalf)*naxes0 +
-                                                     (ii + xhalf)]);
-                    }
-                }
-        }
+        PRINT_ERROR("image %s not appropriate for FFT over axis mask %ld", in_name, axismask);
+        return -1;
     }
 
-    if(datatype == _DATATYPE_COMPLEX_FLOAT)
+    for(int i = 0; i < naxis; i++)
+    {
+        naxesout[i] = data.image[IDin].md[0].size[i];
+    }
+
+    if(kind == FFT_KIND_R2C)
     {
-        if(naxis == 1)
+        int axishalf = 0;
+
+        while(((axismask >> axishalf) & 1) == 0)
         {
-            OK = 1;
-            xhalf = (long)(naxes0 / 2);
-            for(ii = 0; ii < xhalf; ii++)
-            {
-                CSWAPcf(data.image[ID].array.CF[ii], data.image[ID].array.CF[ii + xhalf]);
-            }
+            axishalf++;
         }
-        if(naxis == 2)
+        naxesout[axishalf] = naxesout[axishalf] / 2 + 1;
+
+        if(precision == FFT_PRECISION_SINGLE)
         {
-            OK = 1;
-            xhalf = (long)(naxes0 / 2);
-            yhalf = (long)(naxes1 / 2);
-            for(jj = 0; jj < yhalf; jj++)
-                for(ii = 0; ii < xhalf; ii++)
-                {
-                    CSWAPcf(data.image[ID].array.CF[jj * naxes0 + ii],
-                            data.image[ID].array.CF[(jj + yhalf)*naxes0 + (ii + xhalf)]);
-                }
-            for(jj = yhalf; jj < naxes1; jj++)
-                for(ii = 0; ii < xhalf; ii++)
-                {
-                    CSWAPcf(data.image[ID].array.CF[jj * naxes0 + ii],
-                            data.image[ID].array.CF[(jj - yhalf)*naxes0 + (ii + xhalf)]);
-                }
+            IDout = create_image_ID(out_name, naxis, naxesout, _DATATYPE_COMPLEX_FLOAT,
+                                    data.SHARED_DFT, data.NBKEWORD_DFT);
+            inarray = (void *) data.image[IDin].array.F;
+            outarray = (void *) data.image[IDout].array.CF;
         }
-        if(naxis == 3)
+        else
         {
-            OK = 1;
-            xhalf = (long)(naxes0 / 2);
-            yhalf = (long)(naxes1 / 2);
-            for(kk = 0; kk < naxes2; kk++)
-                for(jj = 0; jj < yhalf; jj++)
-                    for(ii = 0; ii < xhalf; ii++)
-                    {
-                        CSWAPcf(data.image[ID].array.CF[kk * naxes0 * naxes1 + jj * naxes0 + ii],
-                                data.image[ID].array.CF[kk * naxes0 * naxes1 + (jj + yhalf)*naxes0 +
-                                                        (ii + xhalf)]);
-                    }
-            printf(" - ");
-            fflush(stdout);
-
-            for(kk = 0; kk < naxes2; kk++)
-                for(jj = yhalf; jj < naxes1; jj++)
-                    for(ii = 0; ii < xhalf; ii++)
-                    {
-                        CSWAPcf(data.image[ID].array.CF[kk * naxes0 * naxes1 + jj * naxes0 + ii],
-                                data.image[ID].array.CF[kk * naxes0 * naxes1 + (jj - yhalf)*naxes0 +
-                                                        (ii + xhalf)]);
-                    }
+            IDout = create_image_ID(out_name, naxis, naxesout, _DATATYPE_COMPLEX_DOUBLE,
+                                    data.SHARED_DFT, data.NBKEWORD_DFT);
+            inarray = (void *) data.image[IDin].array.D;
+            outarray = (void *) data.image[IDout].array.CD;
         }
     }
-
-    if(datatype == _DATATYPE_COMPLEX_DOUBLE)
+    else
     {
-        if(naxis == 1)
+        if(strcmp(in_name, out_name) == 0)
         {
-            OK = 1;
-            xhalf = (long)(naxes0 / 2);
-            for(ii = 0; ii < xhalf; ii++)
-            {
-                CSWAPcd(data.image[ID].array.CD[ii], data.image[ID].array.CD[ii + xhalf]);
-            }
+            IDout = IDin;
         }
-        if(naxis == 2)
+        else
         {
-            OK = 1;
-            xhalf = (long)(naxes0 / 2);
-            yhalf = (long)(naxes1 / 2);
-            for(jj = 0; jj < yhalf; jj++)
-                for(ii = 0; ii < xhalf; ii++)
-                {
-                    CSWAPcd(data.image[ID].array.CD[jj * naxes0 + ii],
-                            data.image[ID].array.CD[(jj + yhalf)*naxes0 + (ii + xhalf)]);
-                }
-            for(jj = yhalf; jj < naxes1; jj++)
-                for(ii = 0; ii < xhalf; ii++)
-                {
-                    CSWAPcd(data.image[ID].array.CD[jj * naxes0 + ii],
-                            data.image[ID].array.CD[(jj - yhalf)*naxes0 + (ii + xhalf)]);
-                }
+            IDout = create_image_ID(out_name, naxis, naxesout, datatype,
+                                    data.SHARED_DFT, data.NBKEWORD_DFT);
         }
-        if(naxis == 3)
-        {
-            OK = 1;
-            xhalf = (long)(naxes0 / 2);
-            yhalf = (long)(naxes1 / 2);
-            for(kk = 0; kk < naxes2; kk++)
-                for(jj = 0; jj < yhalf; jj++)
-                    for(ii = 0; ii < xhalf; ii++)
-                    {
-                        CSWAPcd(data.image[ID].array.CD[kk * naxes0 * naxes1 + jj * naxes0 + ii],
-                                data.image[ID].array.CD[kk * naxes0 * naxes1 + (jj + yhalf)*naxes0 +
-                                                        (ii + xhalf)]);
-                    }
-            printf(" - ");
-            fflush(stdout);
 
-            for(kk = 0; kk < naxes2; kk++)
-                for(jj = yhalf; jj < naxes1; jj++)
-                    for(ii = 0; ii < xhalf; ii++)
-                    {
-                        CSWAPcd(data.image[ID].array.CD[kk * naxes0 * naxes1 + jj * naxes0 + ii],
-                                data.image[ID].array.CD[kk * naxes0 * naxes1 + (jj - yhalf)*naxes0 +
-                                                        (ii + xhalf)]);
-                    }
+        if(precision == FFT_PRECISION_SINGLE)
+        {
+            inarray = (void *) data.image[IDin].array.CF;
+            outarray = (void *) data.image[IDout].array.CF;
+        }
+        else
+        {
+            inarray = (void *) data.image[IDin].array.CD;
+            outarray = (void *) data.image[IDout].array.CD;
         }
     }
 
+    fft_batch_execute(&key, inarray, outarray);
 
+    return IDout;
+}
 
-    if(OK == 0)
-    {
-        printf("Error : data format not supported by permut\n");
-    }
 
 
-    //  printf(" done\n");
-    // fflush(stdout);
 
+/* N-dimensional complex -> real inverse fft over the axes of axismask */
+// input: half spectrum along the fastest selected axis, as produced by FFT_dondfft
+// naxes = real output size along that axis, 0 for even size 2 * (input size - 1)
+// FFTW c2r destroys its input, the input image is copied first
+imageID FFT_dondrffti(
+    const char *in_name,
+    const char *out_name,
+    long        axismask,
+    long        naxes
+)
+{
+    long naxis;
+    long size[3];
+    uint32_t naxesout[3];
+    int axishalf = 0;
+    imageID IDin;
+    imageID IDout;
+    uint8_t datatype;
+    FFT_PLANKEY key;
+    int precision;
+    size_t realsize;
+    void *inbuff;
 
-    return(0);
-}
+    IDin = image_ID(in_name);
+    naxis = data.image[IDin].md[0].naxis;
+    datatype = data.image[IDin].md[0].datatype;
 
+    if((naxis > 3) || (axismask <= 0) || (axismask >= (1 << naxis))
+            || ((datatype != _DATATYPE_COMPLEX_FLOAT) && (datatype != _DATATYPE_COMPLEX_DOUBLE)))
+    {
+        PRINT_ERROR("image %s not appropriate for c2r FFT over axis mask %ld", in_name,
+                    axismask);
+        return -1;
+    }
 
+    while(((axismask >> axishalf) & 1) == 0)
+    {
+        axishalf++;
+    }
+    for(int i = 0; i < naxis; i++)
+    {
+        size[i] = data.image[IDin].md[0].size[i];
+        naxesout[i] = data.image[IDin].md[0].size[i];
+    }
+    if(naxes == 0)
+    {
+        naxes = 2 * (size[axishalf] - 1);
+    }
+    if(naxes / 2 + 1 != size[axishalf])
+    {
+        PRINT_ERROR("c2r output size %ld does not match input size %ld", naxes,
+                    size[axishalf]);
+        return -1;
+    }
+    size[axishalf] = naxes;
+    naxesout[axishalf] = naxes;
 
-int array_index(long size)
-{
-    int i;
+    if(datatype == _DATATYPE_COMPLEX_FLOAT)
+    {
+        precision = FFT_PRECISION_SINGLE;
+        realsize = sizeof(float);
+        IDout = create_image_ID(out_name, naxis, naxesout, _DATATYPE_FLOAT,
+                                data.SHARED_DFT, data.NBKEWORD_DFT);
+    }
+    else
+    {
+        precision = FFT_PRECISION_DOUBLE;
+        realsize = sizeof(double);
+        IDout = create_image_ID(out_name, naxis, naxesout, _DATATYPE_DOUBLE,
+                                data.SHARED_DFT, data.NBKEWORD_DFT);
+    }
 
-    switch(size)
+    fft_plankey_init(&key, precision, FFT_KIND_C2R, FFTW_BACKWARD);
+    fft_plankey_addaxes(&key, naxis, size, (int) axismask);
+
+    inbuff = fftw_malloc(2 * realsize * data.image[IDin].md[0].nelement);
+    if(inbuff == NULL)
     {
-        case 1:
-            i = 0;
-            break;
-        case 2:
-            i = 1;
-            break;
-        case 4:
-            i = 2;
-            break;
-        case 8:
-            i = 3;
-            break;
-        case 16:
-            i = 4;
-            break;
-        case 32:
-            i = 5;
-            break;
-        case 64:
-            i = 6;
-            break;
-        case 128:
-            i = 7;
-            break;
-        case 256:
-            i = 8;
-            break;
-        case 512:
-            i = 9;
-            break;
-        case 1024:
-            i = 10;
-            break;
-        case 2048:
-            i = 11;
-            break;
-        case 4096:
-            i = 12;
-            break;
-        case 8192:
-            i = 13;
-            break;
-        case 16384:
-            i = 14;
-            break;
-        default:
-            i = 100;
+        PRINT_ERROR("malloc error");
+        abort();
     }
 
-    return(i);
+    if(precision == FFT_PRECISION_SINGLE)
+    {
+        memcpy(inbuff, data.image[IDin].array.CF, 2 * realsize * data.image[IDin].md[0].nelement);
+        fft_batch_execute(&key, inbuff, data.image[IDout].array.F);
+    }
+    else
+    {
+        memcpy(inbuff, data.image[IDin].array.CD, 2 * realsize * data.image[IDin].md[0].nelement);
+        fft_batch_execute(&key, inbuff, data.image[IDout].array.D);
+    }
+
+    fftw_free(inbuff);
+
+    return IDout;
 }
 
 
 
 
 
-/* 1d complex -> complex fft */
-// supports single and double precisions
-//
-long FFT_do1dfft(const char *in_name, const char *out_name, int dir)
+/* N-dimensional split-complex fft over the axes of axismask */
+// real and imaginary parts in separate float or double images, no
+// interleaved copy: e.g. re/im streams of a pipeline
+// output images are created unless they exist with the input size and type,
+// in place if output names are input names
+// plans are created from wisdom or in FFTW_ESTIMATE mode (see fft_plancache.c)
+imageID FFT_dondfft_split(
+    const char *re_name,
+    const char *im_name,
+    const char *reout_name,
+    const char *imout_name,
+    long        axismask,
+    int         dir
+)
 {
-    int *naxes;
-    uint32_t *naxesl;
     long naxis;
-    long IDin, IDout;
-    long i;
-    int OK = 0;
-    fftwf_plan plan;
-    fftw_plan plan_double;
-    long jj;
-    fftwf_complex *inptr, *outptr;
-    fftw_complex *inptr_double, *outptr_double;
+    imageID IDre;
+    imageID IDim;
+    imageID IDreout;
+    imageID IDimout;
     uint8_t datatype;
+    FFT_PLANKEY key;
+    int precision;
 
-    IDin = image_ID(in_name);
-    naxis = data.image[IDin].md[0].naxis;
-    naxes = (int *) malloc(naxis * sizeof(int));
-    naxesl = (uint32_t *) malloc(naxis * sizeof(uint32_t));
-    for(i = 0; i < naxis; i++)
+    IDre = image_ID(re_name);
+    IDim = image_ID(im_name);
+    naxis = data.image[IDre].md[0].naxis;
+    datatype = data.image[IDre].md[0].datatype;
+
+    if((naxis > 3) || (data.image[IDim].md[0].datatype != datatype)
+            || (data.image[IDim].md[0].nelement != data.image[IDre].md[0].nelement)
+            || ((datatype != _DATATYPE_FLOAT) && (datatype != _DATATYPE_DOUBLE)))
     {
-        naxesl[i] = data.image[IDin].md[0].size[i];
-        naxes[i] = (int) data.image[IDin].md[0].size[i];
+        PRINT_ERROR("images %s %s not appropriate for split FFT", re_name, im_name);
+        return -1;
+    }
+
+    precision = (datatype == _DATATYPE_FLOAT) ? FFT_PRECISION_SINGLE :
+                FFT_PRECISION_DOUBLE;
+    fft_plankey_init(&key, precision, FFT_KIND_C2C_SPLIT, dir);
+    if(fft_image_plankey(&key, IDre, axismask) != RETURN_SUCCESS)
+    {
+        PRINT_ERROR("image %s not appropriate for FFT over axis mask %ld", re_name,
+                    axismask);
+        return -1;
     }
-    datatype = data.image[IDin].md[0].datatype;
-    IDout = create_image_ID(out_name, naxis, naxesl, datatype, data.SHARED_DFT,
-                            data.NBKEWORD_DFT);
 
-    if(naxis == 1)
+    IDreout = image_ID(reout_name);
+    if((IDreout == -1) || (data.image[IDreout].md[0].datatype != datatype)
+            || (data.image[IDreout].md[0].nelement != data.image[IDre].md[0].nelement))
     {
-        if(array_index(naxes[0]) != 100)
+        if(IDreout != -1)
         {
-            OK = 1;
-            if(datatype == _DATATYPE_COMPLEX_FLOAT)
-            {
-                plan = fftwf_plan_dft_1d(naxes[0], (fftwf_complex *) data.image[IDin].array.CF,
-                                         (fftwf_complex *) data.image[IDout].array.CF, dir, FFTWOPTMODE);
-                fftwf_execute(plan);
-                fftwf_destroy_plan(plan);
-            }
-            else
-            {
-                plan_double = fftw_plan_dft_1d(naxes[0],
-                                               (fftw_complex *) data.image[IDin].array.CD,
-                                               (fftw_complex *) data.image[IDout].array.CD, dir, FFTWOPTMODE);
-                fftw_execute(plan_double);
-                fftw_destroy_plan(plan_double);
-            }
+            delete_image_ID(reout_name);
         }
-        else
+        IDreout = create_image_ID(reout_name, naxis, data.image[IDre].md[0].size,
+                                  datatype, data.SHARED_DFT, data.NBKEWORD_DFT);
+    }
+    IDimout = image_ID(imout_name);
+    if((IDimout == -1) || (data.image[IDimout].md[0].datatype != datatype)
+            || (data.image[IDimout].md[0].nelement != data.image[IDre].md[0].nelement))
+    {
+        if(IDimout != -1)
         {
-            OK = 1;
-            if(datatype == _DATATYPE_COMPLEX_FLOAT)
-            {
-                plan = fftwf_plan_dft_1d(naxes[0], (fftwf_complex *) data.image[IDin].array.CF,
-                                         (fftwf_complex *) data.image[IDout].array.CF, dir, FFTWOPTMODE);
-                fftwf_execute(plan);
-                fftwf_destroy_plan(plan);
-            }
-            else
-            {
-                plan_double =  fftw_plan_dft_1d(naxes[0],
-                                                (fftw_complex *) data.image[IDin].array.CD,
-                                                (fftw_complex *) data.image[IDout].array.CD, dir, FFTWOPTMODE);
-                fftw_execute(plan_double);
-                fftw_destroy_plan(plan_double);
-            }
+            delete_image_ID(imout_name);
         }
+        IDimout = create_image_ID(imout_name, naxis, data.image[IDre].md[0].size,
+                                  datatype, data.SHARED_DFT, data.NBKEWORD_DFT);
     }
 
-    if(naxis == 2)
+    if(precision == FFT_PRECISION_SINGLE)
     {
-        if((naxes[1] == 1) && (array_index(naxes[0]) != 100))
-        {
-            OK = 1;
-            if(datatype == _DATATYPE_COMPLEX_FLOAT)
-            {
-                inptr = (fftwf_complex *) data.image[IDin].array.CF;
-                outptr = (fftwf_complex *) data.image[IDout].array.CF;
-                plan = fftwf_plan_dft_1d(naxes[0], inptr, outptr, dir, FFTWOPTMODE);
-                fftwf_execute(plan);
-                fftwf_destroy_plan(plan);
-            }
-            else
-            {
-                inptr_double = (fftw_complex *) data.image[IDin].array.CD;
-                outptr_double = (fftw_complex *) data.image[IDout].array.CD;
-                plan_double = fftw_plan_dft_1d(naxes[0], inptr_double, outptr_double, dir,
-                                               FFTWOPTMODE);
-                fftw_execute(plan_double);
-                fftw_destroy_plan(plan_double);
-            }
-        }
-        else
-        {
-            OK = 1;
-            if(datatype == _DATATYPE_COMPLEX_FLOAT)
-            {
-                inptr = (fftwf_complex *) malloc(sizeof(fftwf_complex) * naxes[0]);
-                outptr = (fftwf_complex *) malloc(sizeof(fftwf_complex) * naxes[0]);
-                plan = fftwf_plan_dft_1d(naxes[0], inptr, outptr, dir, FFTWOPTMODE);
+        fft_batch_execute_split(&key,
+                                data.image[IDre].array.F, data.image[IDim].array.F,
+                                data.image[IDreout].array.F, data.image[IDimout].array.F);
+    }
+    else
+    {
+        fft_batch_execute_split(&key,
+                                data.image[IDre].array.D, data.image[IDim].array.D,
+                                data.image[IDreout].array.D, data.image[IDimout].array.D);
+    }
 
-                for(jj = 0; jj < naxes[1]; jj++)
-                {
-                    memcpy((char *) inptr, (char *) data.image[IDin].array.CF + sizeof(
-                               fftwf_complex)*jj * naxes[0], sizeof(fftwf_complex)*naxes[0]);
-                    fftwf_execute(plan);
-                    memcpy((char *) data.image[IDout].array.CF + sizeof(complex_float)*jj *
-                           naxes[0], outptr, sizeof(fftwf_complex)*naxes[0]);
-                }
-                fftwf_destroy_plan(plan);
-                free(inptr);
-                free(outptr);
-            }
-            else
-            {
-                inptr_double = (fftw_complex *) malloc(sizeof(fftw_complex) * naxes[0]);
-                outptr_double = (fftw_complex *) malloc(sizeof(fftw_complex) * naxes[0]);
-                plan_double = fftw_plan_dft_1d(naxes[0], inptr_double, outptr_double, dir,
-                                               FFTWOPTMODE);
+    return IDreout;
+}
+
+
+imageID do2dfft_split(
+    const char *re_name,
+    const char *im_name,
+    const char *reout_name,
+    const char *imout_name
+)
+{
+    return FFT_dondfft_split(re_name, im_name, reout_name, imout_name, 3, -1);
+}
 
-                for(jj = 0; jj < naxes[1]; jj++)
-                {
-                    memcpy((char *) inptr_double,
-                           (char *) data.image[IDin].array.CD + sizeof(fftw_complex)*jj * naxes[0],
-                           sizeof(fftw_complex)*naxes[0]);
-                    fftw_execute(plan_double);
-                    memcpy((char *) data.image[IDout].array.CD + sizeof(complex_double)*jj *
-                           naxes[0], outptr_double, sizeof(fftw_complex)*naxes[0]);
-                }
-                fftw_destroy_plan(plan_double);
-                free(inptr_double);
-                free(outptr_double);
-            }
-        }
-    }
 
-    if(OK == 0)
+imageID do2dffti_split(
+    const char *re_name,
+    const char *im_name,
+    const char *reout_name,
+    const char *imout_name
+)
+{
+    return FFT_dondfft_split(re_name, im_name, reout_name, imout_name, 3, 1);
+}
+
+
+
+
+
+/* FFTW real-to-real kind from name */
+// REDFT00 ... RODFT11, or DCT1 ... DCT4 / DST1 ... DST4 aliases
+// returns -1 if name is not recognized
+int fft_r2rkind(const char *kindname)
+{
+    const char *fftwname[] = {"REDFT00", "REDFT01", "REDFT10", "REDFT11",
+                              "RODFT00", "RODFT01", "RODFT10", "RODFT11"
+                             };
+    const char *aliasname[] = {"DCT1", "DCT3", "DCT2", "DCT4",
+                               "DST1", "DST3", "DST2", "DST4"
+                              };
+    const int kind[] = {FFTW_REDFT00, FFTW_REDFT01, FFTW_REDFT10, FFTW_REDFT11,
+                        FFTW_RODFT00, FFTW_RODFT01, FFTW_RODFT10, FFTW_RODFT11
+                       };
+
+    for(int k = 0; k < 8; k++)
     {
-        printf("Error : image dimension not appropriate for FFT\n");
+        if((strcmp(kindname, fftwname[k]) == 0) || (strcmp(kindname, aliasname[k]) == 0))
+        {
+            return kind[k];
+        }
     }
-    free(naxes);
-    free(naxesl);
 
-    return(IDout);
+    return -1;
 }
 
 
 
 
-/* 1d real -> complex fft */
-// supports single and double precision
-imageID do1drfft(
+/* real -> real (DCT/DST) transform over the axes of axismask */
+// r2rkind[a]: FFTW kind along image axis a
+// unnormalized as FFTW: a forward/inverse pair scales by 2(n-1) for REDFT00,
+// 2(n+1) for RODFT00, 2n for other kinds, along each axis
+// supports single and double precisions, in place if out_name is in_name
+static imageID FFT_dor2r(
     const char *in_name,
-    const char *out_name
+    const char *out_name,
+    long        axismask,
+    const int  *r2rkind
 )
 {
-    int *naxes;
-    uint32_t *naxesl;
-    uint32_t *naxesout;
     long naxis;
     imageID IDin;
     imageID IDout;
-    long i;
-    int OK = 0;
-    long jj;
-    fftwf_plan plan;
-    fftw_plan plan_double;
-    fftwf_complex *outptr;
-    fftw_complex *outptr_double;
-    float *inptr;
-    double *inptr_double;
     uint8_t datatype;
-
+    FFT_PLANKEY key;
+    int precision;
+    int dim = 0;
+    void *inarray;
+    void *outarray;
 
     IDin = image_ID(in_name);
     naxis = data.image[IDin].md[0].naxis;
-    naxes = (int *) malloc(naxis * sizeof(int));
-    naxesl = (uint32_t *) malloc(naxis * sizeof(uint32_t));
-    naxesout = (uint32_t *) malloc(naxis * sizeof(uint32_t));
-
     datatype = data.image[IDin].md[0].datatype;
 
-    for(i = 0; i < naxis; i++)
+    if((naxis > 3) || (axismask >= (1 << naxis))
+            || ((datatype != _DATATYPE_FLOAT) && (datatype != _DATATYPE_DOUBLE)))
     {
-        naxesl[i] = data.image[IDin].md[0].size[i];
-        naxes[i] = (int) data.image[IDin].md[0].size[i];
-        naxesout[i] = data.image[IDin].md[0].size[i];
-        if(i == 0)
-        {
-            naxesout[i] = data.image[IDin].md[0].size[i] / 2 + 1;
-        }
+        PRINT_ERROR("image %s not appropriate for r2r FFT over axis mask %ld", in_name,
+                    axismask);
+        return -1;
     }
 
-    if(datatype == _DATATYPE_FLOAT)
-    {
-        IDout = create_image_ID(out_name, naxis, naxesout, _DATATYPE_COMPLEX_FLOAT,
-                                data.SHARED_DFT, data.NBKEWORD_DFT);
-    }
-    else
+    precision = (datatype == _DATATYPE_FLOAT) ? FFT_PRECISION_SINGLE :
+                FFT_PRECISION_DOUBLE;
+    fft_plankey_init(&key, precision, FFT_KIND_R2R, 0);
+    if(fft_image_plankey(&key, IDin, axismask) != RETURN_SUCCESS)
     {
-        IDout = create_image_ID(out_name, naxis, naxesout, _DATATYPE_COMPLEX_DOUBLE,
-                                data.SHARED_DFT, data.NBKEWORD_DFT);
+        return -1;
     }
 
-    if(naxis == 2)
+    // key dims are slowest first
+    for(int a = naxis - 1; a >= 0; a--)
     {
-        if((naxes[1] == 1) && (array_index(naxes[0]) != 100))
+        if((axismask >> a) & 1)
         {
-            OK = 1;
-            if(datatype == _DATATYPE_FLOAT)
+            if(fft_plankey_setr2rkind(&key, dim, r2rkind[a]) != RETURN_SUCCESS)
             {
-                plan = fftwf_plan_dft_r2c_1d(naxes[0], data.image[IDin].array.F,
-                                             (fftwf_complex *) data.image[IDout].array.CF, FFTWOPTMODE);
-                fftwf_execute(plan);
-                fftwf_destroy_plan(plan);
-            }
-            else
-            {
-                plan_double = fftw_plan_dft_r2c_1d(naxes[0], data.image[IDin].array.D,
-                                                   (fftw_complex *) data.image[IDout].array.CD, FFTWOPTMODE);
-                fftw_execute(plan_double);
-                fftw_destroy_plan(plan_double);
+                return -1;
             }
+            dim++;
         }
-        else
-        {
-            OK = 1;
-            if(datatype == _DATATYPE_FLOAT)
-            {
-                inptr = (float *) malloc(sizeof(float) * naxes[0]);
-                outptr = (fftwf_complex *) malloc(sizeof(fftwf_complex) * naxes[0]);
-                plan = fftwf_plan_dft_r2c_1d(naxes[0], inptr, outptr, FFTWOPTMODE);
-
-                for(jj = 0; jj < naxes[1]; jj++)
-                {
-                    memcpy((char *) inptr, (char *) data.image[IDin].array.F + sizeof(
-                               float)*jj * naxes[0], sizeof(float)*naxes[0]);
-                    fftwf_execute(plan);
-                    memcpy((char *) data.image[IDout].array.CF + sizeof(complex_float)*jj *
-                           naxesout[0], outptr, sizeof(fftwf_complex)*naxesout[0]);
-                }
-                fftwf_destroy_plan(plan);
-                free(inptr);
-                free(outptr);
-            }
-            else
-            {
-                inptr_double = (double *) malloc(sizeof(double) * naxes[0]);
-                outptr_double = (fftw_complex *) malloc(sizeof(fftw_complex) * naxes[0]);
-                plan_double = fftw_plan_dft_r2c_1d(naxes[0], inptr_double, outptr_double,
-                                                   FFTWOPTMODE);
+    }
 
-                for(jj = 0; jj < naxes[1]; jj++)
-                {
-                    memcpy((char *) inptr_double,
-                           (char *) data.image[IDin].array.D + sizeof(double)*jj * naxes[0],
-                           sizeof(double)*naxes[0]);
-                    fftw_execute(plan_double);
-                    memcpy((char *) data.image[IDout].array.CD + sizeof(complex_double)*jj *
-                           naxesout[0], outptr_double, sizeof(fftw_complex)*naxesout[0]);
-                }
-                fftw_destroy_plan(plan_double);
-                free(inptr_double);
-                free(outptr_double);
-            }
-        }
+    if(strcmp(in_name, out_name) == 0)
+    {
+        IDout = IDin;
+    }
+    else
+    {
+        IDout = create_image_ID(out_name, naxis, data.image[IDin].md[0].size, datatype,
+                                data.SHARED_DFT, data.NBKEWORD_DFT);
     }
 
-    if(OK == 0)
+    if(precision == FFT_PRECISION_SINGLE)
     {
-        printf("Error : image dimension not appropriate for FFT\n");
+        inarray = (void *) data.image[IDin].array.F;
+        outarray = (void *) data.image[IDout].array.F;
+    }
+    else
+    {
+        inarray = (void *) data.image[IDin].array.D;
+        outarray = (void *) data.image[IDout].array.D;
     }
-    free(naxes);
-    free(naxesl);
-    free(naxesout);
 
-    return(IDout);
+    fft_batch_execute(&key, inarray, outarray);
+
+    return IDout;
 }
 
 
 
 
-long do1dfft(const char *in_name, const char *out_name)
+/* 1d real -> real fft along axis 0, batched over rows and slices */
+imageID do1dr2r(
+    const char *in_name,
+    const char *out_name,
+    int         kind
+)
 {
-    long IDout;
+    int r2rkind[3] = {kind, 0, 0};
+
+    return FFT_dor2r(in_name, out_name, 1, r2rkind);
+}
+
+
+
+
+/* 2d real -> real fft, batched over slices of a cube */
+// kind0 along axis 0 (x), kind1 along axis 1 (y)
+// e.g. Poisson solver with Neumann boundaries: REDFT10 forward, REDFT01 inverse
+imageID do2dr2r(
+    const char *in_name,
+    const char *out_name,
+    int         kind0,
+    int         kind1
+)
+{
+    int r2rkind[3] = {kind0, kind1, 0};
+
+    return FFT_dor2r(in_name, out_name, 3, r2rkind);
+}
+
+
 
-    IDout = FFT_do1dfft(in_name, out_name, -1);
 
-    return(IDout);
-}
 
 
-long do1dffti(const char *in_name, const char *out_name)
+/**
+ * @brief Complex 2D transform of each slice of an array
+ *
+ * inarray and outarray hold naxes0 x naxes1 x nbslice complex elements of
+ * the precision, inarray is not modified. dir = FFTW_FORWARD (-1) or
+ * FFTW_BACKWARD (1), unnormalized. centered = 1: zero frequency at
+ * (naxes0/2, naxes1/2) in input and output.
+ */
+errno_t FFT_do2dfft_array(
+    int         precision,
+    long        naxes0,
+    long        naxes1,
+    long        nbslice,
+    const void *inarray,
+    void       *outarray,
+    int         dir,
+    int         centered
+)
 {
-    long IDout;
-
-    IDout = FFT_do1dfft(in_name, out_name, 1);
+    FFT_PLANKEY key;
+    size_t eltsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(complex_float) :
+                     sizeof(complex_double);
+
+    // fftw dimensions are row-major: slowest axis first
+    fft_plankey_init(&key, precision, FFT_KIND_C2C, dir);
+    fft_plankey_adddim(&key, naxes1, naxes0, naxes0);
+    fft_plankey_adddim(&key, naxes0, 1, 1);
+    if(nbslice > 1)
+    {
+        // one 2D transform per slice
+        fft_plankey_addhowmany(&key, nbslice, naxes0 * naxes1, naxes0 * naxes1);
+    }
 
-    return(IDout);
-}
+    if(centered == 0)
+    {
+        fft_batch_execute(&key, (void *) inarray, outarray);
+    }
+    else if((naxes0 % 2 == 0) && (naxes1 % 2 == 0))
+    {
+        // input shift folded into the output as a (-1)^(ii+jj) modulation
+        fft_batch_execute(&key, (void *) inarray, outarray);
+        fft_shift_centerspectrum(outarray, precision, naxes0, naxes1, nbslice);
+    }
+    else
+    {
+        long size[3] = {naxes0, naxes1, nbslice};
 
+        // odd sizes: ifftshift into output, in-place transform, fftshift
+        fft_shift_quadrantcopy(inarray, outarray, eltsize, naxes0, naxes1, nbslice);
+        fft_batch_execute(&key, outarray, outarray);
+        fft_shift_axes(outarray, eltsize, 3, size, 3, 0);
+    }
 
+    return RETURN_SUCCESS;
+}
 
 
 
 
 /* 2d complex fft */
 // supports single and double precisions
-long FFT_do2dfft(const char *in_name, const char *out_name, int dir)
+// centered = 1: input and output have the zero frequency at (naxes0/2, naxes1/2),
+// same as permut before and after the transform but without the passes over the input
+long FFT_do2dfft(
+    const char *in_name,
+    const char *out_name,
+    int dir,
+    int centered
+)
 {
-    int *naxes;
-    uint32_t *naxesl;
     long naxis;
     long IDin, IDout;
-    long i;
-    int OK = 0;
-    fftwf_plan plan;
-    fftw_plan plan_double;
-    long tmp1;
-
-    char ffttmpcpyname[SBUFFERSIZE];
-    int n;
     uint8_t datatype;
-
+    int precision;
+    void *inarray;
+    void *outarray;
 
 
     IDin = image_ID(in_name);
     naxis = data.image[IDin].md[0].naxis;
-    naxes = (int *) malloc(naxis * sizeof(int));
-    naxesl = (uint32_t *) malloc(naxis * sizeof(uint32_t));
-
-    for(i = 0; i < naxis; i++)
-    {
-        naxesl[i] = (long) data.image[IDin].md[0].size[i];
-        naxes[i] = (int) data.image[IDin].md[0].size[i];
-    }
-
-
 
     datatype = data.image[IDin].md[0].datatype;
-    IDout = create_image_ID(out_name, naxis, naxesl, datatype, data.SHARED_DFT,
-                            data.NBKEWORD_DFT);
-
-
+    IDout = create_image_ID(out_name, naxis, data.image[IDin].md[0].size, datatype,
+                            data.SHARED_DFT, data.NBKEWORD_DFT);
 
-    // need to swap first 2 axis for fftw
-    if(naxis > 1)
+    if(datatype == _DATATYPE_COMPLEX_FLOAT)
     {
-        tmp1 = naxes[0];
-        naxes[0] = naxes[1];
-        naxes[1] = tmp1;
+        precision = FFT_PRECISION_SINGLE;
+        inarray = (void *) data.image[IDin].array.CF;
+        outarray = (void *) data.image[IDout].array.CF;
     }
-
-
-
-    if(naxis == 2)
+    else
     {
-        OK = 1;
-
-        if(datatype == _DATATYPE_COMPLEX_FLOAT)
-        {
-            plan = fftwf_plan_dft_2d(naxes[0], naxes[1],
-                                     (fftwf_complex *) data.image[IDin].array.CF,
-                                     (fftwf_complex *) data.image[IDout].array.CF, dir, FFTWOPTMODE);
-            if(plan == NULL)
-            {
-                //	  if ( Debug > 2)
-                fprintf(stdout, "New FFT size [do2dfft %d x %d]: optimizing ...", naxes[1],
-                        naxes[0]);
-                fflush(stdout);
-
-                n = snprintf(ffttmpcpyname, SBUFFERSIZE, "_ffttmpcpyname_%d", (int) getpid());
-                if(n >= SBUFFERSIZE)
-                {
-                    PRINT_ERROR("Attempted to write string buffer with too many characters");
-                }
-                copy_image_ID(in_name, ffttmpcpyname, 0);
-
-                plan = fftwf_plan_dft_2d(naxes[0], naxes[1],
-                                         (fftwf_complex *) data.image[IDin].array.CF,
-                                         (fftwf_complex *) data.image[IDout].array.CF, dir, FFTWOPTMODE);
-                copy_image_ID(ffttmpcpyname, in_name, 0);
-                delete_image_ID(ffttmpcpyname);
-                export_wisdom();
-                fprintf(stdout, "\n");
-            }
-            fftwf_execute(plan);
-            fftwf_destroy_plan(plan);
-        }
-        else
-        {
-            plan_double = fftw_plan_dft_2d(naxes[0], naxes[1],
-                                           (fftw_complex *) data.image[IDin].array.CD,
-                                           (fftw_complex *) data.image[IDout].array.CD, dir, FFTWOPTMODE);
-            if(plan_double == NULL)
-            {
-                //	  if ( Debug > 2)
-                fprintf(stdout, "New FFT size [do2dfft %d x %d]: optimizing ...", naxes[1],
-                        naxes[0]);
-                fflush(stdout);
-
-                n = snprintf(ffttmpcpyname, SBUFFERSIZE, "_ffttmpcpyname_%d", (int) getpid());
-                if(n >= SBUFFERSIZE)
-                {
-                    PRINT_ERROR("Attempted to write string buffer with too many characters");
-                }
-                copy_image_ID(in_name, ffttmpcpyname, 0);
-
-                plan_double = fftw_plan_dft_2d(naxes[0], naxes[1],
-                                               (fftw_complex *) data.image[IDin].array.CD,
-                                               (fftw_complex *) data.image[IDout].array.CD, dir, FFTWOPTMODE);
-                copy_image_ID(ffttmpcpyname, in_name, 0);
-                delete_image_ID(ffttmpcpyname);
-                export_wisdom();
-                fprintf(stdout, "\n");
-            }
-            fftw_execute(plan_double);
-            fftw_destroy_plan(plan_double);
-        }
+        precision = FFT_PRECISION_DOUBLE;
+        inarray = (void *) data.image[IDin].array.CD;
+        outarray = (void *) data.image[IDout].array.CD;
     }
 
 
-
-    if(naxis == 3)
+    if((naxis == 2) || (naxis == 3))
     {
-        OK = 1;
-        if(datatype == _DATATYPE_COMPLEX_FLOAT)
-        {
-            plan = fftwf_plan_many_dft(2, naxes, naxes[2],
-                                       (fftwf_complex *) data.image[IDin].array.CF, NULL, 1, naxes[0] * naxes[1],
-                                       (fftwf_complex *) data.image[IDout].array.CF, NULL, 1, naxes[0] * naxes[1], dir,
-                                       FFTWOPTMODE);
-            if(plan == NULL)
-            {
-                //if ( Debug > 2)
-                fprintf(stdout, "New FFT size [do2dfft %d x %d x %d]: optimizing ...", naxes[1],
-                        naxes[0], naxes[2]);
-                fflush(stdout);
-
-                n = snprintf(ffttmpcpyname, SBUFFERSIZE, "_ffttmpcpyname_%d", (int) getpid());
-                if(n >= SBUFFERSIZE)
-                {
-                    PRINT_ERROR("Attempted to write string buffer with too many characters");
-                }
-                copy_image_ID(in_name, ffttmpcpyname, 0);
-
-                plan = fftwf_plan_many_dft(2, naxes, naxes[2],
-                                           (fftwf_complex *) data.image[IDin].array.CF, NULL, 1, naxes[0] * naxes[1],
-                                           (fftwf_complex *) data.image[IDout].array.CF, NULL, 1, naxes[0] * naxes[1], dir,
-                                           FFTWOPTMODE);
-                copy_image_ID(ffttmpcpyname, in_name, 0);
-                delete_image_ID(ffttmpcpyname);
-                export_wisdom();
-                fprintf(stdout, "\n");
-            }
-            fftwf_execute(plan);
-            fftwf_destroy_plan(plan);
-        }
-        else
-        {
-            plan_double = fftw_plan_many_dft(2, naxes, naxes[2],
-                                             (fftw_complex *) data.image[IDin].array.CD, NULL, 1, naxes[0] * naxes[1],
-                                             (fftw_complex *) data.image[IDout].array.CD, NULL, 1, naxes[0] * naxes[1], dir,
-                                             FFTWOPTMODE);
-            if(plan_double == NULL)
-            {
-                //if ( Debug > 2)
-                fprintf(stdout, "New FFT size [do2dfft %d x %d x %d]: optimizing ...", naxes[1],
-                        naxes[0], naxes[2]);
-                fflush(stdout);
-
-                n = snprintf(ffttmpcpyname, SBUFFERSIZE, "_ffttmpcpyname_%d", (int) getpid());
-                if(n >= SBUFFERSIZE)
-                {
-                    PRINT_ERROR("Attempted to write string buffer with too many characters");
-                }
-                copy_image_ID(in_name, ffttmpcpyname, 0);
-
-                plan_double = fftw_plan_many_dft(2, naxes, naxes[2],
-                                                 (fftw_complex *) data.image[IDin].array.CD, NULL, 1, naxes[0] * naxes[1],
-                                                 (fftw_complex *) data.image[IDout].array.CD, NULL, 1, naxes[0] * naxes[1], dir,
-                                                 FFTWOPTMODE);
-                copy_image_ID(ffttmpcpyname, in_name, 0);
-                delete_image_ID(ffttmpcpyname);
-                export_wisdom();
-                fprintf(stdout, "\n");
-            }
-            fftw_execute(plan_double);
-            fftw_destroy_plan(plan_double);
-        }
+        FFT_do2dfft_array(precision, data.image[IDin].md[0].size[0],
+                          data.image[IDin].md[0].size[1],
+                          (naxis == 3) ? data.image[IDin].md[0].size[2] : 1,
+                          inarray, outarray, dir, centered);
     }
-
-
-    if(OK == 0)
+    else
     {
         printf("Error : image dimension not appropriate for FFT\n");
     }
 
-    free(naxes);
-
 
     return(IDout);
 }
@@ -1592,7 +2503,7 @@ long do2dfft(const char *in_name, const char *out_name)
 {
     long IDout;
 
-    IDout = FFT_do2dfft(in_name, out_name, -1);
+    IDout = FFT_do2dfft(in_name, out_name, -1, 0);
 
     return(IDout);
 }
@@ -1602,7 +2513,27 @@ long do2dffti(const char *in_name, const char *out_name)
 {
     long IDout;
 
-    IDout = FFT_do2dfft(in_name, out_name, 1);
+    IDout = FFT_do2dfft(in_name, out_name, 1, 0);
+
+    return(IDout);
+}
+
+
+long do2dfft_centered(const char *in_name, const char *out_name)
+{
+    long IDout;
+
+    IDout = FFT_do2dfft(in_name, out_name, -1, 1);
+
+    return(IDout);
+}
+
+
+long do2dffti_centered(const char *in_name, const char *out_name)
+{
+    long IDout;
+
+    IDout = FFT_do2dfft(in_name, out_name, 1, 1);
 
     return(IDout);
 }
@@ -1666,8 +2597,6 @@ int pupfft(const char *ID_name_ampl, const char *ID_name_pha,
         mk_complex_from_reim(ID_name_ampl, ID_name_pha, Ctmpname, 0);
     }
 
-    permut(Ctmpname);
-
     n = snprintf(C1tmpname, SBUFFERSIZE, "_C1tmp_%d", (int) getpid());
     if(n >= SBUFFERSIZE)
     {
@@ -1675,11 +2604,11 @@ int pupfft(const char *ID_name_ampl, const char *ID_name_pha,
     }
     if(inv == 0)
     {
-        do2dfft(Ctmpname, C1tmpname);    /* equ. fft2d(..,1) */
+        do2dfft_centered(Ctmpname, C1tmpname);    /* equ. fft2d(..,1) */
     }
     else
     {
-        do2dffti(Ctmpname, C1tmpname);    /* equ. fft2d(..,0) */
+        do2dffti_centered(Ctmpname, C1tmpname);    /* equ. fft2d(..,0) */
     }
 
     delete_image_ID(Ctmpname);
@@ -1697,9 +2626,6 @@ int pupfft(const char *ID_name_ampl, const char *ID_name_pha,
 
     delete_image_ID(C1tmpname);
 
-    permut(ID_name_ampl_out);
-    permut(ID_name_pha_out);
-
     return(0);
 }
 
@@ -1707,308 +2633,437 @@ int pupfft(const char *ID_name_ampl, const char *ID_name_pha,
 
 
 
+// expansion of the r2c half spectrum to the full spectrum, one row per job index
+typedef struct
+{
+    int   precision;
+    void *tmp;          // naxestmp0 x naxes1 per slice
+    void *out;          // naxes0 x naxes1 per slice
+    long  naxes0;
+    long  naxes1;
+    long  naxestmp0;
+    int   centered;     // output row/column shifted by naxes/2
+    int   modulate;     // output multiplied by (-1)^(ii+jj): centered input
+} FFT_RFFT_EXPAND;
+
+
+// out[ii + off] for ii in [i0, i1): row[ii] for ii <= n0/2, conj(rowm[n0 - ii]) above,
+// times (-1)^ii if sflip, negated if sneg; RTYPE is the real type of TYPE
+// straight loops without index wrap or datatype test so they vectorize
+#define FFT_RFFT_EXPANDSEG(NAME, TYPE, RTYPE)                           \
+static void NAME(const TYPE *row, const TYPE *rowm, TYPE *out, long n0, \
+                 long i0, long i1, long off, int sflip, int sneg)       \
+{                                                                       \
+    long imid = n0 / 2 + 1;                                             \
+    long ia = (i1 < imid) ? i1 : imid;                                  \
+    RTYPE s0 = sneg ? -1.0 : 1.0;                                       \
+    RTYPE s1 = sflip ? -s0 : s0;                                        \
+                                                                        \
+    for(long ii = i0; ii < ia; ii++)                                    \
+    {                                                                   \
+        RTYPE sgn = (ii & 1) ? s1 : s0;                                 \
+        out[ii + off].re = sgn * row[ii].re;                            \
+        out[ii + off].im = sgn * row[ii].im;                            \
+    }                                                                   \
+    for(long ii = (i0 > imid) ? i0 : imid; ii < i1; ii++)               \
+    {                                                                   \
+        RTYPE sgn = (ii & 1) ? s1 : s0;                                 \
+        out[ii + off].re = sgn * rowm[n0 - ii].re;                      \
+        out[ii + off].im = -sgn * rowm[n0 - ii].im;                     \
+    }                                                                   \
+}
+
+FFT_RFFT_EXPANDSEG(fft_rfft_expandsegf, complex_float, float)
+FFT_RFFT_EXPANDSEG(fft_rfft_expandsegd, complex_double, double)
+
+
+static void fft_rfft_expandrows(
+    void *ptr,
+    long  r0,
+    long  r1
+)
+{
+    FFT_RFFT_EXPAND *job = (FFT_RFFT_EXPAND *) ptr;
+    long n0 = job->naxes0;
+    long n1 = job->naxes1;
+    long h0 = job->centered ? n0 / 2 : 0;
+    long h1 = job->centered ? n1 / 2 : 0;
+
+    for(long r = r0; r < r1; r++)
+    {
+        long kk = r / n1;
+        long jj = r % n1;
+        long jjm = (n1 - jj) % n1;     // mirrored row for the conjugate half
+        long jjout = (jj + h1) % n1;
+        long tmprow = (kk * n1 + jj) * job->naxestmp0;
+        long tmprowm = (kk * n1 + jjm) * job->naxestmp0;
+        long outrow = (kk * n1 + jjout) * n0;
+        int sneg = job->modulate && (jj & 1);
+
+        // output column ii + h0 wraps at ii = n0 - h0: two straight segments
+        if(job->precision == FFT_PRECISION_SINGLE)
+        {
+            complex_float *tmparray = (complex_float *) job->tmp;
+            complex_float *outarray = (complex_float *) job->out + outrow;
+
+            fft_rfft_expandsegf(tmparray + tmprow, tmparray + tmprowm, outarray, n0,
+                                0, n0 - h0, h0, job->modulate, sneg);
+            fft_rfft_expandsegf(tmparray + tmprow, tmparray + tmprowm, outarray, n0,
+                                n0 - h0, n0, h0 - n0, job->modulate, sneg);
+        }
+        else
+        {
+            complex_double *tmparray = (complex_double *) job->tmp;
+            complex_double *outarray = (complex_double *) job->out + outrow;
+
+            fft_rfft_expandsegd(tmparray + tmprow, tmparray + tmprowm, outarray, n0,
+                                0, n0 - h0, h0, job->modulate, sneg);
+            fft_rfft_expandsegd(tmparray + tmprow, tmparray + tmprowm, outarray, n0,
+                                n0 - h0, n0, h0 - n0, job->modulate, sneg);
+        }
+    }
+}
+
+
+
+
+/**
+ * @brief Real-to-complex 2D transform of each slice of an array
+ *
+ * inarray holds naxes0 x naxes1 x nbslice real elements and is not
+ * modified. outarray holds (naxes0/2+1) x naxes1 complex elements per slice
+ * with half, naxes0 x naxes1 otherwise. centered requires the full spectrum.
+ */
+errno_t FFT_do2drfft_array(
+    int         precision,
+    long        naxes0,
+    long        naxes1,
+    long        nbslice,
+    const void *inarray,
+    void       *outarray,
+    int         half,
+    int         centered
+)
+{
+    long naxestmp0 = naxes0 / 2 + 1;
+    FFT_PLANKEY key;
+    size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                          double);
+    void *inshift = NULL;
+    FFT_RFFT_EXPAND expjob;
+
+    if(half && centered)
+    {
+        PRINT_ERROR("centered r2c transform requires full spectrum output");
+        return RETURN_FAILURE;
+    }
+
+    // fftw dimensions are row-major: slowest axis first
+    // input strides in real elements, output strides in complex elements
+    fft_plankey_init(&key, precision, FFT_KIND_R2C, FFTW_FORWARD);
+    fft_plankey_adddim(&key, naxes1, naxes0, naxestmp0);
+    fft_plankey_adddim(&key, naxes0, 1, 1);
+    if(nbslice > 1)
+    {
+        fft_plankey_addhowmany(&key, nbslice, naxes0 * naxes1, naxestmp0 * naxes1);
+    }
+
+    if(half)
+    {
+        fft_batch_execute(&key, (void *) inarray, outarray);
+        return RETURN_SUCCESS;
+    }
+
+    expjob.precision = precision;
+    expjob.out = outarray;
+    expjob.tmp = fftw_malloc(2 * realsize * naxestmp0 * naxes1 * nbslice);
+    if(expjob.tmp == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+    expjob.naxes0 = naxes0;
+    expjob.naxes1 = naxes1;
+    expjob.naxestmp0 = naxestmp0;
+    expjob.centered = centered;
+    expjob.modulate = centered;
+
+    if((centered == 1) && ((naxes0 % 2 != 0) || (naxes1 % 2 != 0)))
+    {
+        // odd sizes: the input shift is not a sign modulation, shift a copy
+        inshift = malloc(realsize * naxes0 * naxes1 * nbslice);
+        if(inshift == NULL)
+        {
+            PRINT_ERROR("malloc error");
+            abort();
+        }
+        fft_shift_quadrantcopy(inarray, inshift, realsize, naxes0, naxes1, nbslice);
+        inarray = inshift;
+        expjob.modulate = 0;
+    }
+
+    fft_batch_execute(&key, (void *) inarray, expjob.tmp);
+    free(inshift);
+
+    fft_workerpool_parallelfor(fft_rfft_expandrows, &expjob, nbslice * naxes1);
+
+    fftw_free(expjob.tmp);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
 /* real fft : real to complex */
 // supports single and double precisions
+// half = 1: output is the (naxes0/2+1) x naxes1 half spectrum computed by FFTW,
+//           written directly into the output image
+// half = 0: output is the full naxes0 x naxes1 spectrum, expanded by Hermitian
+//           symmetry from a scratch half spectrum
+// centered = 1 (full spectrum only): as FFT_do2dfft, zero frequency at
+//           (naxes0/2, naxes1/2) in input and output
 imageID FFT_do2drfft(
     const char *in_name,
     const char *out_name,
-    int dir
+    int half,
+    int centered
+)
+{
+    long naxis;
+    uint32_t naxesout[3];
+    imageID IDin;
+    imageID IDout;
+    uint8_t datatype;
+    int precision;
+    void *inarray;
+    void *outarray;
+
+
+    IDin = image_ID(in_name);
+
+    datatype = data.image[IDin].md[0].datatype;
+    naxis = data.image[IDin].md[0].naxis;
+
+    if((naxis != 2) && (naxis != 3))
+    {
+        printf("Error : image dimension not appropriate for FFT\n");
+        return -1;
+    }
+    if(half && centered)
+    {
+        PRINT_ERROR("centered r2c transform requires full spectrum output");
+        return -1;
+    }
+
+    for(int i = 0; i < naxis; i++)
+    {
+        naxesout[i] = data.image[IDin].md[0].size[i];
+    }
+    if(half)
+    {
+        naxesout[0] = naxesout[0] / 2 + 1;
+    }
+
+    if(datatype == _DATATYPE_FLOAT)
+    {
+        precision = FFT_PRECISION_SINGLE;
+        inarray = (void *) data.image[IDin].array.F;
+        IDout = create_image_ID(out_name, naxis, naxesout, _DATATYPE_COMPLEX_FLOAT,
+                                data.SHARED_DFT, data.NBKEWORD_DFT);
+        outarray = (void *) data.image[IDout].array.CF;
+    }
+    else
+    {
+        precision = FFT_PRECISION_DOUBLE;
+        inarray = (void *) data.image[IDin].array.D;
+        IDout = create_image_ID(out_name, naxis, naxesout, _DATATYPE_COMPLEX_DOUBLE,
+                                data.SHARED_DFT, data.NBKEWORD_DFT);
+        outarray = (void *) data.image[IDout].array.CD;
+    }
+
+    FFT_do2drfft_array(precision, data.image[IDin].md[0].size[0],
+                       data.image[IDin].md[0].size[1],
+                       (naxis == 3) ? data.image[IDin].md[0].size[2] : 1,
+                       inarray, outarray, half, centered);
+
+    return IDout;
+}
+
+
+
+
+imageID do2drfft(
+    const char *in_name,
+    const char *out_name
+)
+{
+    imageID IDout;
+
+    IDout = FFT_do2drfft(in_name, out_name, 0, 0);
+
+    return IDout;
+}
+
+
+
+imageID do2drfft_centered(
+    const char *in_name,
+    const char *out_name
+)
+{
+    imageID IDout;
+
+    IDout = FFT_do2drfft(in_name, out_name, 0, 1);
+
+    return IDout;
+}
+
+
+
+imageID do2drfft_half(
+    const char *in_name,
+    const char *out_name
+)
+{
+    imageID IDout;
+
+    IDout = FFT_do2drfft(in_name, out_name, 1, 0);
+
+    return IDout;
+}
+
+
+
+// complex to real transform of half spectrum inarray (overwritten) into outarray
+// rank 1: one transform per row, rank 2: one per slice
+// naxes0 is the real row size, input rows hold naxes0/2+1 complex elements
+static void fft_c2r_execute(
+    int   precision,
+    int   rank,
+    long  naxes0,
+    long  naxes1,
+    long  nbslice,
+    void *inarray,
+    void *outarray
+)
+{
+    FFT_PLANKEY key;
+    int n0h = naxes0 / 2 + 1;
+
+    fft_plankey_init(&key, precision, FFT_KIND_C2R, FFTW_BACKWARD);
+    if(rank == 1)
+    {
+        fft_plankey_adddim(&key, naxes0, 1, 1);
+        if(naxes1 * nbslice > 1)
+        {
+            fft_plankey_addhowmany(&key, naxes1 * nbslice, n0h, naxes0);
+        }
+    }
+    else
+    {
+        fft_plankey_adddim(&key, naxes1, n0h, naxes0);
+        fft_plankey_adddim(&key, naxes0, 1, 1);
+        if(nbslice > 1)
+        {
+            fft_plankey_addhowmany(&key, nbslice, n0h * naxes1, naxes0 * naxes1);
+        }
+    }
+
+    fft_batch_execute(&key, inarray, outarray);
+}
+
+
+
+
+/* complex to real inverse fft */
+// input: half spectrum as produced by r2c, naxes0/2+1 complex elements per row
+// output: real image with rows of naxes0 elements, same other axes
+// naxes0 = 0: even row size 2 * (input size - 1)
+// rank 1: transform along axis 0 of each row (naxis 1 to 3)
+// rank 2: 2D transform of each slice (naxis 2 or 3)
+// FFTW c2r destroys its input, the input image is copied first
+static imageID FFT_dorffti(
+    const char *in_name,
+    const char *out_name,
+    int         rank,
+    long        naxes0
 )
 {
-    int *naxes;  // int format for fftw
-    uint32_t *naxesl;
-    uint32_t *naxestmp;
-
-    long naxis;
     imageID IDin;
     imageID IDout;
-    imageID IDtmp;
-
-    int OK = 0;
-    fftwf_plan plan;
-    fftw_plan plan_double;
-    long tmp1;
-
-
+    long naxis;
+    uint32_t naxesout[3];
     uint8_t datatype;
-    uint8_t datatypeout;
-
+    int precision;
+    size_t realsize;
+    long nbslice = 1;
+    void *inbuff;
 
     IDin = image_ID(in_name);
-
-    datatype = data.image[IDin].md[0].datatype;
     naxis = data.image[IDin].md[0].naxis;
-    naxes = (int *) malloc(naxis * sizeof(uint32_t));
-    naxesl = (uint32_t *) malloc(naxis * sizeof(uint32_t));
-    naxestmp = (uint32_t *) malloc(naxis * sizeof(uint32_t));
-
+    datatype = data.image[IDin].md[0].datatype;
 
+    if(naxes0 == 0)
+    {
+        naxes0 = 2 * ((long) data.image[IDin].md[0].size[0] - 1);
+    }
 
+    if((naxis < rank) || (naxis > 3)
+            || ((datatype != _DATATYPE_COMPLEX_FLOAT) && (datatype != _DATATYPE_COMPLEX_DOUBLE))
+            || (naxes0 / 2 + 1 != (long) data.image[IDin].md[0].size[0]))
+    {
+        PRINT_ERROR("image %s not appropriate for c2r FFT of size %ld", in_name, naxes0);
+        return -1;
+    }
 
     for(int i = 0; i < naxis; i++)
     {
-        naxes[i] = (int) data.image[IDin].md[0].size[i];
-        naxesl[i] = (uint32_t) data.image[IDin].md[0].size[i];
-        naxestmp[i] = data.image[IDin].md[0].size[i];
-        if(i == 0)
-        {
-            naxestmp[i] = data.image[IDin].md[0].size[i] / 2 + 1;
-        }
+        naxesout[i] = data.image[IDin].md[0].size[i];
+    }
+    naxesout[0] = naxes0;
+    for(int i = rank; i < naxis; i++)
+    {
+        nbslice *= naxesout[i];
     }
 
-    char ffttmpname[STRINGMAXLEN_IMGNAME];
-    WRITE_IMAGENAME(ffttmpname, "_ffttmp_%d", (int) getpid());
-
-    if(datatype == _DATATYPE_FLOAT)
+    if(datatype == _DATATYPE_COMPLEX_FLOAT)
     {
-        datatypeout = _DATATYPE_COMPLEX_FLOAT;
+        precision = FFT_PRECISION_SINGLE;
+        realsize = sizeof(float);
+        IDout = create_image_ID(out_name, naxis, naxesout, _DATATYPE_FLOAT,
+                                data.SHARED_DFT, data.NBKEWORD_DFT);
     }
     else
     {
-        datatypeout = _DATATYPE_COMPLEX_DOUBLE;
+        precision = FFT_PRECISION_DOUBLE;
+        realsize = sizeof(double);
+        IDout = create_image_ID(out_name, naxis, naxesout, _DATATYPE_DOUBLE,
+                                data.SHARED_DFT, data.NBKEWORD_DFT);
     }
 
-    IDtmp = create_image_ID(ffttmpname, naxis, naxestmp, datatypeout,
-                            data.SHARED_DFT, data.NBKEWORD_DFT);
-
-    IDout = create_image_ID(out_name, naxis, naxesl, datatypeout, data.SHARED_DFT,
-                            data.NBKEWORD_DFT);
-
-    if(naxis == 2)
+    inbuff = fftw_malloc(2 * realsize * data.image[IDin].md[0].nelement);
+    if(inbuff == NULL)
     {
-        OK = 1;
-
-        if(datatype == _DATATYPE_FLOAT)
-        {
-            plan = fftwf_plan_dft_r2c_2d((int) naxes[1], (int) naxes[0],
-                                         data.image[IDin].array.F, (fftwf_complex *) data.image[IDtmp].array.CF,
-                                         FFTWOPTMODE);
-            if(plan == NULL)
-            {
-                // if ( Debug > 2)
-                fprintf(stdout, "New FFT size [do2drfft %d x %d]: optimizing ...", naxes[1],
-                        naxes[0]);
-                fflush(stdout);
-
-                char ffttmpcpyname[STRINGMAXLEN_IMGNAME];
-                WRITE_IMAGENAME(ffttmpcpyname, "_ffttmpcpy_%d", (int) getpid());
-
-                copy_image_ID(in_name, ffttmpcpyname, 0);
-
-                plan = fftwf_plan_dft_r2c_2d(naxes[1], naxes[0], data.image[IDin].array.F,
-                                             (fftwf_complex *) data.image[IDtmp].array.CF, FFTWOPTMODE);
-                copy_image_ID(ffttmpcpyname, in_name, 0);
-                delete_image_ID(ffttmpcpyname);
-                export_wisdom();
-                fprintf(stdout, "\n");
-            }
-            fftwf_execute(plan);
-            fftwf_destroy_plan(plan);
-
-            if(dir == -1)
-            {
-                for(uint32_t ii = 0; ii < (uint32_t) (naxes[0] / 2 + 1); ii++)
-                    for(uint32_t jj = 0; jj < (uint32_t) naxes[1]; jj++)
-                    {
-                        data.image[IDout].array.CF[jj * naxes[0] + ii] = data.image[IDtmp].array.CF[jj *
-                                naxestmp[0] + ii];
-                    }
-
-                for(uint32_t ii = 1; ii < (uint32_t) (naxes[0] / 2 + 1); ii++)
-                {
-                    uint32_t jj = 0;
-                    data.image[IDout].array.CF[jj * naxes[0] + (naxes[0] - ii)].re =
-                        data.image[IDtmp].array.CF[jj * naxestmp[0] + ii].re;
-                    data.image[IDout].array.CF[jj * naxes[0] + (naxes[0] - ii)].im =
-                        -data.image[IDtmp].array.CF[jj * naxestmp[0] + ii].im;
-                    for(uint32_t jj = 1; jj < (uint32_t) naxes[1]; jj++)
-                    {
-                        data.image[IDout].array.CF[jj * naxes[0] + (naxes[0] - ii)].re =
-                            data.image[IDtmp].array.CF[(naxes[1] - jj) * naxestmp[0] + ii].re;
-                        data.image[IDout].array.CF[jj * naxes[0] + (naxes[0] - ii)].im =
-                            -data.image[IDtmp].array.CF[(naxes[1] - jj) * naxestmp[0] + ii].im;
-                    }
-                }
-            }
-        }
-        else
-        {
-            plan_double = fftw_plan_dft_r2c_2d(naxes[1], naxes[0], data.image[IDin].array.D,
-                                               (fftw_complex *) data.image[IDtmp].array.CD, FFTWOPTMODE);
-            if(plan_double == NULL)
-            {
-                // if ( Debug > 2)
-                fprintf(stdout, "New FFT size [do2drfft %d x %d]: optimizing ...", naxes[1],
-                        naxes[0]);
-                fflush(stdout);
-
-                char ffttmpcpyname[STRINGMAXLEN_IMGNAME];
-                WRITE_IMAGENAME(ffttmpcpyname, "_ffttmpcpy_%d", (int) getpid());
-
-                copy_image_ID(in_name, ffttmpcpyname, 0);
-
-                plan_double = fftw_plan_dft_r2c_2d(naxes[1], naxes[0], data.image[IDin].array.D,
-                                                   (fftw_complex *) data.image[IDtmp].array.CD, FFTWOPTMODE);
-                copy_image_ID(ffttmpcpyname, in_name, 0);
-                delete_image_ID(ffttmpcpyname);
-                export_wisdom();
-                fprintf(stdout, "\n");
-            }
-            fftw_execute(plan_double);
-            fftw_destroy_plan(plan_double);
-
-            if(dir == -1)
-            {
-                for(uint32_t ii = 0; ii < (uint32_t) (naxes[0] / 2 + 1); ii++)
-                    for(uint32_t jj = 0; jj < (uint32_t) naxes[1]; jj++)
-                    {
-                        data.image[IDout].array.CD[jj * naxes[0] + ii] = data.image[IDtmp].array.CD[jj *
-                                naxestmp[0] + ii];
-                    }
-
-                for(uint32_t ii = 1; ii < (uint32_t) (naxes[0] / 2 + 1); ii++)
-                {
-                    uint32_t jj = 0;
-                    data.image[IDout].array.CD[jj * naxes[0] + (naxes[0] - ii)].re =
-                        data.image[IDtmp].array.CD[jj * naxestmp[0] + ii].re;
-                    data.image[IDout].array.CD[jj * naxes[0] + (naxes[0] - ii)].im =
-                        -data.image[IDtmp].array.CD[jj * naxestmp[0] + ii].im;
-                    for(uint32_t jj = 1; jj < (uint32_t) naxes[1]; jj++)
-                    {
-                        data.image[IDout].array.CD[jj * naxes[0] + (naxes[0] - ii)].re =
-                            data.image[IDtmp].array.CD[(naxes[1] - jj) * naxestmp[0] + ii].re;
-                        data.image[IDout].array.CD[jj * naxes[0] + (naxes[0] - ii)].im =
-                            -data.image[IDtmp].array.CD[(naxes[1] - jj) * naxestmp[0] + ii].im;
-                    }
-                }
-            }
-        }
+        PRINT_ERROR("malloc error");
+        abort();
     }
-    if(naxis == 3)
-    {
-        OK = 1;
-        //idist = naxes[0]*naxes[1];
-
-        // swapping first 2 axis
-        tmp1 = naxes[0];
-        naxes[0] = naxes[1];
-        naxes[1] = tmp1;
-
-        if(datatype == _DATATYPE_FLOAT)
-        {
-            plan = fftwf_plan_many_dft_r2c(2, naxes, naxes[2], data.image[IDin].array.F,
-                                           NULL, 1, naxes[0] * naxes[1], (fftwf_complex *) data.image[IDout].array.CF,
-                                           NULL, 1, naxes[0] * naxes[1], FFTWOPTMODE);
-            if(plan == NULL)
-            {
-                //	  if ( Debug > 2) fprintf(stdout,"New FFT size [do2drfft %d x %d x %d]: optimizing ...",naxes[1],naxes[0],naxes[2]);
-                fflush(stdout);
-
-                char ffttmpcpyname[STRINGMAXLEN_IMGNAME];
-                WRITE_IMAGENAME(ffttmpcpyname, "_ffttmpcpy_%d", (int) getpid());
-                copy_image_ID(in_name, ffttmpcpyname, 0);
-
-                plan = fftwf_plan_many_dft_r2c(2, naxes, naxes[2], data.image[IDin].array.F,
-                                               NULL, 1, naxes[0] * naxes[1], (fftwf_complex *) data.image[IDout].array.CF,
-                                               NULL, 1, naxes[0] * naxes[1], FFTWOPTMODE);
-
-                copy_image_ID(ffttmpcpyname, in_name, 0);
-                delete_image_ID(ffttmpcpyname);
-                export_wisdom();
-                fprintf(stdout, "\n");
-            }
-
-            fftwf_execute(plan);
-            fftwf_destroy_plan(plan);
-
-            if(dir == -1)
-            {
-                // unswapping first 2 axis
-                tmp1 = naxes[0];
-                naxes[0] = naxes[1];
-                naxes[1] = tmp1;
-
-                for(uint32_t ii = 0; ii < (uint32_t) (naxes[0] / 2 + 1); ii++)
-                    for(uint32_t jj = 0; jj < (uint32_t) naxes[1]; jj++)
-                        for(uint32_t kk = 0; kk < (uint32_t) naxes[2]; kk++)
-                        {
-                            data.image[IDout].array.CF[naxes[0]*naxes[1]*kk + jj * naxes[0] + ii] =
-                                data.image[IDtmp].array.CF[naxestmp[0] * naxestmp[1] * kk + jj * naxestmp[0] +
-                                                           ii];
-                            if(ii != 0)
-                            {
-                                data.image[IDout].array.CF[naxes[0]*naxes[1]*kk + jj * naxes[0] +
-                                                           (naxes[0] - ii)] = data.image[IDtmp].array.CF[naxestmp[0] * naxestmp[1] * kk +
-                                                                   jj * naxestmp[0] + ii];
-                            }
-                        }
-            }
-        }
-        else
-        {
-            plan_double = fftw_plan_many_dft_r2c(2, naxes, naxes[2],
-                                                 data.image[IDin].array.D, NULL, 1, naxes[0] * naxes[1],
-                                                 (fftw_complex *) data.image[IDout].array.CD, NULL, 1, naxes[0] * naxes[1],
-                                                 FFTWOPTMODE);
-            if(plan == NULL)
-            {
-                //	  if ( Debug > 2) fprintf(stdout,"New FFT size [do2drfft %d x %d x %d]: optimizing ...",naxes[1],naxes[0],naxes[2]);
-                //				fflush(stdout);
-
-                char ffttmpcpyname[STRINGMAXLEN_IMGNAME];
-                WRITE_IMAGENAME(ffttmpcpyname, "_ffttmpcpy_%d", (int) getpid());
-
-                copy_image_ID(in_name, ffttmpcpyname, 0);
-
-                plan_double = fftw_plan_many_dft_r2c(2, naxes, naxes[2],
-                                                     data.image[IDin].array.D, NULL, 1, naxes[0] * naxes[1],
-                                                     (fftw_complex *) data.image[IDout].array.CD, NULL, 1, naxes[0] * naxes[1],
-                                                     FFTWOPTMODE);
-
-                copy_image_ID(ffttmpcpyname, in_name, 0);
-                delete_image_ID(ffttmpcpyname);
-                export_wisdom();
-                fprintf(stdout, "\n");
-            }
 
-            fftw_execute(plan_double);
-            fftw_destroy_plan(plan_double);
-
-            if(dir == -1)
-            {
-                // unswapping first 2 axis
-                tmp1 = naxes[0];
-                naxes[0] = naxes[1];
-                naxes[1] = tmp1;
-
-                for(uint32_t ii = 0; ii < (uint32_t) (naxes[0] / 2 + 1); ii++)
-                    for(uint32_t jj = 0; jj < (uint32_t) naxes[1]; jj++)
-                        for(uint32_t kk = 0; kk < (uint32_t) naxes[2]; kk++)
-                        {
-                            data.image[IDout].array.CD[naxes[0]*naxes[1]*kk + jj * naxes[0] + ii] =
-                                data.image[IDtmp].array.CD[naxestmp[0] * naxestmp[1] * kk + jj * naxestmp[0] +
-                                                           ii];
-                            if(ii != 0)
-                            {
-                                data.image[IDout].array.CD[naxes[0]*naxes[1]*kk + jj * naxes[0] +
-                                                           (naxes[0] - ii)] = data.image[IDtmp].array.CD[naxestmp[0] * naxestmp[1] * kk +
-                                                                   jj * naxestmp[0] + ii];
-                            }
-                        }
-            }
-        }
+    // rank 1: rows of all slices are batched together, naxes1 = 1
+    if(precision == FFT_PRECISION_SINGLE)
+    {
+        memcpy(inbuff, data.image[IDin].array.CF, 2 * realsize * data.image[IDin].md[0].nelement);
+        fft_c2r_execute(precision, rank, naxes0, (rank == 1) ? 1 : naxesout[1], nbslice,
+                        inbuff, data.image[IDout].array.F);
     }
-
-    if(OK == 0)
+    else
     {
-        printf("Error : image dimension not appropriate for FFT\n");
+        memcpy(inbuff, data.image[IDin].array.CD, 2 * realsize * data.image[IDin].md[0].nelement);
+        fft_c2r_execute(precision, rank, naxes0, (rank == 1) ? 1 : naxesout[1], nbslice,
+                        inbuff, data.image[IDout].array.D);
     }
 
-    delete_image_ID(ffttmpname);
-
-    free(naxestmp);
-    free(naxesl);
-    free(naxes);
+    fftw_free(inbuff);
 
     return IDout;
 }
@@ -2016,120 +3071,279 @@ imageID FFT_do2drfft(
 
 
 
-imageID do2drfft(
+imageID FFT_do1drffti(
     const char *in_name,
-    const char *out_name
+    const char *out_name,
+    long        naxes0
 )
 {
-    imageID IDout;
+    return FFT_dorffti(in_name, out_name, 1, naxes0);
+}
 
-    IDout = FFT_do2drfft(in_name, out_name, -1);
 
-    return IDout;
+imageID do1drffti(
+    const char *in_name,
+    const char *out_name
+)
+{
+    return FFT_dorffti(in_name, out_name, 1, 0);
 }
 
 
+imageID FFT_do2drffti(
+    const char *in_name,
+    const char *out_name,
+    long        naxes0
+)
+{
+    return FFT_dorffti(in_name, out_name, 2, naxes0);
+}
+
 
 imageID do2drffti(
     const char *in_name,
     const char *out_name
 )
 {
-    imageID IDout;
-
-    IDout = FFT_do2drfft(in_name, out_name, 1);
-
-    return IDout;
+    return FFT_dorffti(in_name, out_name, 2, 0);
 }
 
 
 
 
+// Hermitian part of a full complex spectrum on its naxes0/2+1 first columns,
+// one row per job index: the c2r transform of the result is the real part
+// of the complex inverse transform of the full spectrum
+typedef struct
+{
+    int   precision;
+    void *in;           // naxes0 x naxes1 per slice
+    void *out;          // (naxes0/2+1) x naxes1 per slice
+    long  naxes0;
+    long  naxes1;
+    int   centered;     // input zero frequency at (naxes0/2, naxes1/2)
+    int   modulate;     // multiply by (-1)^(ii+jj): centered output
+} FFT_HERMITIAN_HALF;
+
+
+// out[ii] for ii in [i0, i1) = (rowin[ii + a] + conj(rowmin[b - ii])) / 2,
+// times (-1)^ii if sflip, negated if sneg; RTYPE is the real type of TYPE
+// straight loop without index wrap or datatype test so it vectorizes
+#define FFT_HERMITIAN_HALFSEG(NAME, TYPE, RTYPE)                        \
+static void NAME(const TYPE *rowin, const TYPE *rowmin, TYPE *out,      \
+                 long i0, long i1, long a, long b, int sflip, int sneg) \
+{                                                                       \
+    RTYPE s0 = sneg ? -0.5 : 0.5;                                       \
+    RTYPE s1 = sflip ? -s0 : s0;                                        \
+                                                                        \
+    for(long ii = i0; ii < i1; ii++)                                    \
+    {                                                                   \
+        RTYPE sgn = (ii & 1) ? s1 : s0;                                 \
+        out[ii].re = sgn * (rowin[ii + a].re + rowmin[b - ii].re);      \
+        out[ii].im = sgn * (rowin[ii + a].im - rowmin[b - ii].im);      \
+    }                                                                   \
+}
 
+FFT_HERMITIAN_HALFSEG(fft_hermitian_halfsegf, complex_float, float)
+FFT_HERMITIAN_HALFSEG(fft_hermitian_halfsegd, complex_double, double)
 
 
+static void fft_hermitian_halfrows(
+    void *ptr,
+    long  r0,
+    long  r1
+)
+{
+    FFT_HERMITIAN_HALF *job = (FFT_HERMITIAN_HALF *) ptr;
+    long n0 = job->naxes0;
+    long n1 = job->naxes1;
+    long n0h = n0 / 2 + 1;
+    long h0 = job->centered ? n0 / 2 : 0;
+    long h1 = job->centered ? n1 / 2 : 0;
+    long cut[4];
+
+    // input column (ii + h0) % n0 wraps at ii = n0 - h0, mirrored column
+    // (h0 - ii) % n0 at ii = h0 + 1: up to three straight segments
+    cut[0] = 0;
+    cut[1] = (h0 + 1 < n0 - h0) ? h0 + 1 : n0 - h0;
+    cut[2] = (h0 + 1 < n0 - h0) ? n0 - h0 : h0 + 1;
+    cut[3] = n0h;
+    for(int c = 1; c < 3; c++)
+    {
+        if(cut[c] > n0h)
+        {
+            cut[c] = n0h;
+        }
+    }
 
+    for(long r = r0; r < r1; r++)
+    {
+        long kk = r / n1;
+        long jj = r % n1;
+        long jjin = (jj + h1) % n1;
+        long jjmin = (n1 - jj + h1) % n1;     // mirrored row
+        long inrow = (kk * n1 + jjin) * n0;
+        long inrowm = (kk * n1 + jjmin) * n0;
+        long outrow = (kk * n1 + jj) * n0h;
+        int sneg = job->modulate && (jj & 1);
+
+        for(int c = 0; c < 3; c++)
+        {
+            long i0 = cut[c];
+            long i1 = cut[c + 1];
+            long a = (i0 + h0 < n0) ? h0 : h0 - n0;
+            long b = (i0 <= h0) ? h0 : n0 + h0;
 
+            if(i1 <= i0)
+            {
+                continue;
+            }
+            if(job->precision == FFT_PRECISION_SINGLE)
+            {
+                complex_float *inarray = (complex_float *) job->in;
 
-imageID fft_correlation(
-    const char *ID_name1,
-    const char *ID_name2,
-    const char *ID_nameout
-)
-{
-    imageID ID1;
-    imageID IDout;
-    long nelement;
+                fft_hermitian_halfsegf(inarray + inrow, inarray + inrowm,
+                                       (complex_float *) job->out + outrow,
+                                       i0, i1, a, b, job->modulate, sneg);
+            }
+            else
+            {
+                complex_double *inarray = (complex_double *) job->in;
 
-    char ft1name[STRINGMAXLEN_IMGNAME];
-    char ft2name[STRINGMAXLEN_IMGNAME];
-    char fta1name[STRINGMAXLEN_IMGNAME];
-    char fta2name[STRINGMAXLEN_IMGNAME];
-    char ftp1name[STRINGMAXLEN_IMGNAME];
-    char ftp2name[STRINGMAXLEN_IMGNAME];
-    char fta12name[STRINGMAXLEN_IMGNAME];
-    char ftp12name[STRINGMAXLEN_IMGNAME];
-    char fftname[STRINGMAXLEN_IMGNAME];
-    char fft1name[STRINGMAXLEN_IMGNAME];
-    char fft1pname[STRINGMAXLEN_IMGNAME];
+                fft_hermitian_halfsegd(inarray + inrow, inarray + inrowm,
+                                       (complex_double *) job->out + outrow,
+                                       i0, i1, a, b, job->modulate, sneg);
+            }
+        }
+    }
+}
 
-    ID1 = image_ID(ID_name1);
-    nelement = data.image[ID1].md[0].nelement;
 
 
-	WRITE_IMAGENAME(ft1name, "_ft1_%d", (int) getpid());
-    do2drfft(ID_name1, ft1name);
 
-    WRITE_IMAGENAME(ft2name, "_ft2_%d", (int) getpid());
-    do2drfft(ID_name2, ft2name);
+/**
+ * @brief Real part of the complex 2D inverse transform of each slice
+ *
+ * inarray holds naxes0 x naxes1 x nbslice complex elements and is not
+ * modified, outarray as many real elements. The Hermitian part of each
+ * slice is built in a scratch half spectrum for the c2r transform.
+ */
+errno_t FFT_do2dffti_real_array(
+    int         precision,
+    long        naxes0,
+    long        naxes1,
+    long        nbslice,
+    const void *inarray,
+    void       *outarray,
+    int         centered
+)
+{
+    long size[3] = {naxes0, naxes1, nbslice};
+    size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                          double);
+    FFT_HERMITIAN_HALF job;
+
+    job.precision = precision;
+    job.in = (void *) inarray;
+    job.out = fftw_malloc(2 * realsize * (naxes0 / 2 + 1) * naxes1 * nbslice);
+    if(job.out == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+    job.naxes0 = naxes0;
+    job.naxes1 = naxes1;
+    job.centered = centered;
+    // odd sizes: output centering is not a sign modulation, shifted afterwards
+    job.modulate = centered && (naxes0 % 2 == 0) && (naxes1 % 2 == 0);
 
-    WRITE_IMAGENAME(fta1name, "_%s_a_%d", ft1name, (int) getpid());
-    WRITE_IMAGENAME(ftp1name, "_%s_p_%d", ft1name, (int) getpid());
-    WRITE_IMAGENAME(fta2name, "_%s_a_%d", ft2name, (int) getpid());
-    WRITE_IMAGENAME(ftp2name, "_%s_p_%d", ft2name, (int) getpid());
-    WRITE_IMAGENAME(fta12name, "_%s_12a_%d", ft1name, (int) getpid());
-    WRITE_IMAGENAME(ftp12name, "_%s_12p_%d", ft1name, (int) getpid());
+    fft_workerpool_parallelfor(fft_hermitian_halfrows, &job, naxes1 * nbslice);
 
-    mk_amph_from_complex(ft1name, fta1name, ftp1name, 0);
-    mk_amph_from_complex(ft2name, fta2name, ftp2name, 0);
+    fft_c2r_execute(precision, 2, naxes0, naxes1, nbslice, job.out, outarray);
+    if(centered && !job.modulate)
+    {
+        fft_shift_axes(outarray, realsize, 3, size, 3, 0);
+    }
 
+    fftw_free(job.out);
 
-    delete_image_ID(ft1name);
-    delete_image_ID(ft2name);
+    return RETURN_SUCCESS;
+}
 
-    arith_image_mult(fta1name, fta2name, fta12name);
-    arith_image_sub(ftp1name, ftp2name, ftp12name);
-    delete_image_ID(fta1name);
-    delete_image_ID(fta2name);
-    delete_image_ID(ftp1name);
-    delete_image_ID(ftp2name);
 
-    arith_image_cstmult_inplace(fta12name, 1.0 / sqrt(nelement) / (1.0 * nelement));
 
-    WRITE_IMAGENAME(fftname, "_fft_%d", (int) getpid());
 
-    mk_complex_from_amph(fta12name, ftp12name, fftname, 0);
-    delete_image_ID(fta12name);
-    delete_image_ID(ftp12name);
+/* real part of the 2d complex inverse fft */
+// same result as do2dffti followed by mk_reim_from_complex, with a c2r
+// transform on the Hermitian part of the input: half the transform work
+// and no imaginary part image
+// centered = 1: as FFT_do2dfft
+imageID FFT_do2dffti_real(
+    const char *in_name,
+    const char *out_name,
+    int         centered
+)
+{
+    imageID IDin;
+    imageID IDout;
+    long naxis;
+    uint8_t datatype;
+    int precision;
+    void *inarray;
+    void *outarray;
 
-    WRITE_IMAGENAME(fft1name, "_fft1_%d", (int) getpid());
+    IDin = image_ID(in_name);
+    naxis = data.image[IDin].md[0].naxis;
+    datatype = data.image[IDin].md[0].datatype;
 
-    do2dfft(fftname, fft1name);
-    delete_image_ID(fftname);
+    if((naxis < 2) || (naxis > 3)
+            || ((datatype != _DATATYPE_COMPLEX_FLOAT) && (datatype != _DATATYPE_COMPLEX_DOUBLE)))
+    {
+        printf("Error : image dimension not appropriate for FFT\n");
+        return -1;
+    }
 
-    WRITE_IMAGENAME(fft1pname, "_fft1p_%d", (int) getpid());
+    if(datatype == _DATATYPE_COMPLEX_FLOAT)
+    {
+        precision = FFT_PRECISION_SINGLE;
+        inarray = (void *) data.image[IDin].array.CF;
+        IDout = create_image_ID(out_name, naxis, data.image[IDin].md[0].size,
+                                _DATATYPE_FLOAT, data.SHARED_DFT, data.NBKEWORD_DFT);
+        outarray = (void *) data.image[IDout].array.F;
+    }
+    else
+    {
+        precision = FFT_PRECISION_DOUBLE;
+        inarray = (void *) data.image[IDin].array.CD;
+        IDout = create_image_ID(out_name, naxis, data.image[IDin].md[0].size,
+                                _DATATYPE_DOUBLE, data.SHARED_DFT, data.NBKEWORD_DFT);
+        outarray = (void *) data.image[IDout].array.D;
+    }
 
+    FFT_do2dffti_real_array(precision, data.image[IDin].md[0].size[0],
+                            data.image[IDin].md[0].size[1],
+                            (naxis == 3) ? data.image[IDin].md[0].size[2] : 1,
+                            inarray, outarray, centered);
 
-    mk_amph_from_complex(fft1name, ID_nameout, fft1pname, 0);
-    permut(ID_nameout);
+    return IDout;
+}
 
-    delete_image_ID(fft1name);
-    delete_image_ID(fft1pname);
 
-    IDout = image_ID(ID_nameout);
+imageID do2dffti_real(
+    const char *in_name,
+    const char *out_name
+)
+{
+    return FFT_do2dffti_real(in_name, out_name, 0);
+}
 
 
-    return IDout;
+imageID do2dffti_real_centered(
+    const char *in_name,
+    const char *out_name
+)
+{
+    return FFT_do2dffti_real(in_name, out_name, 1);
 }
 
 
@@ -2156,18 +3370,13 @@ int fftczoom(
     naxes[1] = data.image[ID].md[0].size[1];
 
     coeff = 1.0 / (factor * factor * naxes[0] * naxes[1]);
-    permut(ID_name);
 
     WRITE_IMAGENAME(tmpzname, "_tmpz_%d", (int) getpid());
-    do2dfft(ID_name, tmpzname);
-
+    WRITE_IMAGENAME(tmpz1name, "_tmpz1_%d", (int) getpid());
 
-    permut(ID_name);
-    permut(tmpzname);
+    do2dfft_centered(ID_name, tmpzname);
     ID = image_ID(tmpzname);
 
-    WRITE_IMAGENAME(tmpz1name, "_tmpz1_%d", (int) getpid());
-
     ID1 = create_2DCimage_ID(tmpz1name, factor * naxes[0], factor * naxes[1]);
 
     for(uint32_t ii = 0; ii < naxes[0]; ii++)
@@ -2182,9 +3391,7 @@ int fftczoom(
         }
     delete_image_ID(tmpzname);
 
-    permut(tmpz1name);
-    do2dffti(tmpz1name, IDout_name);
-    permut(IDout_name);
+    do2dffti_centered(tmpz1name, IDout_name);
     delete_image_ID(tmpz1name);
 
     return(0);
@@ -2211,18 +3418,13 @@ int fftzoom(
     naxes[1] = data.image[ID].md[0].size[1];
 
     coeff = 1.0 / (factor * factor * naxes[0] * naxes[1]);
-    permut(ID_name);
 
     CREATE_IMAGENAME(tmpzname, "_tmpz_%d", (int) getpid());
+    CREATE_IMAGENAME(tmpz1name, "_tmpz1_%d", (int) getpid());
 
-    do2drfft(ID_name, tmpzname);
-
-    permut(ID_name);
-    permut(tmpzname);
+    do2drfft_centered(ID_name, tmpzname);
     ID = image_ID(tmpzname);
 
-    CREATE_IMAGENAME(tmpz1name, "_tmpz1_%d", (int) getpid());
-
     ID1 = create_2DCimage_ID(tmpz1name, factor * naxes[0], factor * naxes[1]);
 
     for(uint32_t ii = 0; ii < naxes[0]; ii++)
@@ -2237,22 +3439,9 @@ int fftzoom(
         }
     delete_image_ID(tmpzname);
 
-    permut(tmpz1name);
-
-    CREATE_IMAGENAME(tmpz2name, "_tmpz2_%d", (int) getpid());
-
-    do2dffti(tmpz1name, tmpz2name);
-
-    permut(tmpz2name);
+    do2dffti_real_centered(tmpz1name, IDout_name);
     delete_image_ID(tmpz1name);
 
-    CREATE_IMAGENAME(tbename, "_tbe_%d", (int) getpid());
-
-    mk_reim_from_complex(tmpz2name, IDout_name, tbename, 0);
-
-    delete_image_ID(tbename);
-    delete_image_ID(tmpz2name);
-
     return(0);
 }
 
@@ -2275,10 +3464,10 @@ int test_fftspeed(int nmax)
     struct timespec tS1;
     struct timespec tS2;
     double ti0, ti1, ti2;
-    double dt1;
+    double dt1 = 1.0;
     //struct timeval tv;
-    //int nb_threads=1;
-    //int nb_threads_max = 8;
+    int nb_threads;
+    int nb_threads_max = (int) sysconf(_SC_NPROCESSORS_ONLN);
 
     /*  printf("%ld ticks per second\n",CLOCKS_PER_SEC);*/
     nbiter = 10000;
@@ -2287,12 +3476,10 @@ int test_fftspeed(int nmax)
     printf("Testing complex FFT, nxn pix\n");
 
     printf("size(pix)");
-# ifdef FFTWMT
-    for(nb_threads = 1; nb_threads < nb_threads_max; nb_threads++)
+    for(nb_threads = 1; nb_threads <= nb_threads_max; nb_threads *= 2)
     {
         printf("%13d", nb_threads);
     }
-# endif
     printf("\n");
 
 
@@ -2300,11 +3487,9 @@ int test_fftspeed(int nmax)
     for(n = 0; n < nmax; n++)
     {
         printf("%9ld", size);
-# ifdef FFTWMT
-        for(nb_threads = 1; nb_threads < nb_threads_max; nb_threads++)
+        for(nb_threads = 1; nb_threads <= nb_threads_max; nb_threads *= 2)
         {
-            fft_setNthreads(nb_threads);
-# endif
+            fft_planpolicy_setcallnthreads(nb_threads);
 
 #if _POSIX_TIMERS > 0
             clock_gettime(CLOCK_REALTIME, &tS0);
@@ -2360,9 +3545,7 @@ int test_fftspeed(int nmax)
             printf("%10.3f ms", dt1 * 1000.0);
             //printf("Complex FFT %ldx%ld [%d threads] : %f ms  [%ld]\n",size,size,nb_threads,dt1*1000.0,nbiter);
             fflush(stdout);
-# ifdef FFTWMT
         }
-# endif
         printf("\n");
         nbiter = 0.1 / dt1;
         if(nbiter < 2)
@@ -2371,6 +3554,7 @@ int test_fftspeed(int nmax)
         }
         size = size * 2;
     }
+    fft_planpolicy_setcallnthreads(0);
 
     return(0);
 }
@@ -2382,6 +3566,114 @@ int test_fftspeed(int nmax)
 
 /* ----------------- CUSTOM DFT ------------- */
 
+
+// 1D phase table cos/sin(2 pi dir Xin Xout) over active pixels
+typedef struct
+{
+    const uint_fast16_t *inactive;
+    const uint_fast16_t *outactive;
+    const float         *Xin;
+    const float         *Xout;
+    long                 NBin;
+    int                  dir;
+    long                 size;
+    float               *cosarray;
+    float               *sinarray;
+} FFT_DFT_PHATABLE;
+
+
+static void fft_DFT_phatable(
+    void *ptr,
+    long  pixout0,
+    long  pixout1
+)
+{
+    FFT_DFT_PHATABLE *tab = (FFT_DFT_PHATABLE *) ptr;
+
+    for(long pixout = pixout0; pixout < pixout1; pixout++)
+    {
+        uint_fast16_t iiout = tab->outactive[pixout];
+        for(long pixin = 0; pixin < tab->NBin; pixin++)
+        {
+            uint_fast16_t iiin = tab->inactive[pixin];
+            float pha = 2.0 * tab->dir * M_PI * (tab->Xin[pixin] * tab->Xout[pixout]);
+
+            tab->cosarray[iiout * tab->size + iiin] = cosf(pha);
+            tab->sinarray[iiout * tab->size + iiin] = sinf(pha);
+        }
+    }
+}
+
+
+
+// DFT sum over input points, for a range of output points
+typedef struct
+{
+    const uint_fast16_t *iiinarray;
+    const uint_fast16_t *jjinarray;
+    const double        *valinamp;
+    const float         *cosvalinpha;
+    const float         *sinvalinpha;
+    uint32_t             NBptsin;
+
+    const uint_fast16_t *iioutarray;
+    const uint_fast16_t *jjoutarray;
+
+    const float         *cosXXarray;
+    const float         *sinXXarray;
+    const float         *cosYYarray;
+    const float         *sinYYarray;
+    uint32_t             xsize;
+    uint32_t             ysize;
+
+    double               Zfactor;
+    complex_float       *outarray;
+} FFT_DFT_SUM;
+
+
+static void fft_DFT_sum(
+    void *ptr,
+    long  kout0,
+    long  kout1
+)
+{
+    FFT_DFT_SUM *dft = (FFT_DFT_SUM *) ptr;
+    uint32_t xsize = dft->xsize;
+    uint32_t ysize = dft->ysize;
+
+    for(long kout = kout0; kout < kout1; kout++)
+    {
+        uint_fast16_t iiout = dft->iioutarray[kout];
+        uint_fast16_t jjout = dft->jjoutarray[kout];
+        double re = 0.0;
+        double im = 0.0;
+
+        for(uint32_t k = 0; k < dft->NBptsin; k++)
+        {
+            uint_fast16_t iiin = dft->iiinarray[k];
+            uint_fast16_t jjin = dft->jjinarray[k];
+
+            float cosXX = dft->cosXXarray[iiout * xsize + iiin];
+            float cosYY = dft->cosYYarray[jjout * ysize + jjin];
+
+            float sinXX = dft->sinXXarray[iiout * xsize + iiin];
+            float sinYY = dft->sinYYarray[jjout * ysize + jjin];
+
+            float cosXY = cosXX * cosYY - sinXX * sinYY;
+            float sinXY = sinXX * cosYY + cosXX * sinYY;
+
+            float cospha = dft->cosvalinpha[k] * cosXY - dft->sinvalinpha[k] * sinXY;
+            float sinpha = dft->sinvalinpha[k] * cosXY + dft->cosvalinpha[k] * sinXY;
+
+
+            re += dft->valinamp[k] * cospha;
+            im += dft->valinamp[k] * sinpha;
+        }
+        dft->outarray[jjout * xsize + iiout].re = re / dft->Zfactor;
+        dft->outarray[jjout * xsize + iiout].im = im / dft->Zfactor;
+    }
+}
+
 //
 // Zfactor is zoom factor
 // dir = -1 for FT, 1 for inverse FT
@@ -2409,7 +3701,6 @@ imageID fft_DFT(
     uint32_t ii, jj, k, kout;
     double val;
     double re, im;
-    float pha;
 
     uint_fast16_t *iiinarray;
     uint_fast16_t *jjinarray;
@@ -2425,8 +3716,6 @@ imageID fft_DFT(
     double *xoutarray;
     double *youtarray;
 
-    float cospha, sinpha;
-
     long IDcosXX, IDcosYY, IDsinXX, IDsinYY;
 
     // list of active coordinates
@@ -2446,7 +3735,8 @@ imageID fft_DFT(
     float *YoutarrayActive;
     uint_fast16_t iiin, jjin, iiout, jjout;
 
-    float cosXX, sinXX, cosYY, sinYY, cosXY, sinXY;
+    FFT_DFT_PHATABLE tab;
+    FFT_DFT_SUM dft;
 
 
 
@@ -2652,36 +3942,19 @@ imageID fft_DFT(
 
 
 
-    printf(" <");
+    printf(" [%d thread(s)] <", fft_workerpool_nthreads());
     fflush(stdout);
 
-    //#ifdef _OPENMP
-#ifdef HAVE_LIBGOMP
-    printf("HAVE_LIBGOMP");
-    #pragma omp parallel default(shared) private(pixiiout, pixiiin, iiout, iiin, pha, cospha, sinpha)
-    {
-        #pragma omp for
-#endif
-
-        for(pixiiout = 0; pixiiout < NBpixact_iiout; pixiiout++)
-        {
-            iiout = iioutarrayActive[pixiiout];
-            for(pixiiin = 0; pixiiin < NBpixact_iiin; pixiiin++)
-            {
-                iiin = iiinarrayActive[pixiiin];
-                pha = 2.0 * dir * M_PI * (XinarrayActive[pixiiin] * XoutarrayActive[pixiiout]);
-                cospha = cosf(pha);
-                sinpha = sinf(pha);
-
-                data.image[IDcosXX].array.F[iiout * xsize + iiin] = cospha;
-                data.image[IDsinXX].array.F[iiout * xsize + iiin] = sinpha;
-
-            }
-        }
-# ifdef HAVE_LIBGOMP
-        // # ifdef _OPENMP
-    }
-# endif
+    tab.inactive = iiinarrayActive;
+    tab.outactive = iioutarrayActive;
+    tab.Xin = XinarrayActive;
+    tab.Xout = XoutarrayActive;
+    tab.NBin = NBpixact_iiin;
+    tab.dir = dir;
+    tab.size = xsize;
+    tab.cosarray = data.image[IDcosXX].array.F;
+    tab.sinarray = data.image[IDsinXX].array.F;
+    fft_workerpool_parallelfor(fft_DFT_phatable, &tab, NBpixact_iiout);
 
     printf("> ");
     fflush(stdout);
@@ -2692,31 +3965,16 @@ imageID fft_DFT(
     printf(" <");
     fflush(stdout);
 
-    //# ifdef _OPENMP
-# ifdef HAVE_LIBGOMP
-    #pragma omp parallel default(shared) private(pixjjout, pixjjin, jjout, jjin, pha, cospha, sinpha)
-    {
-        #pragma omp for
-# endif
-        for(pixjjout = 0; pixjjout < NBpixact_jjout; pixjjout++)
-        {
-            jjout = jjoutarrayActive[pixjjout];
-            for(pixjjin = 0; pixjjin < NBpixact_jjin; pixjjin++)
-            {
-                jjin = jjinarrayActive[pixjjin];
-                pha = 2.0 * dir * M_PI * (YinarrayActive[pixjjin] * YoutarrayActive[pixjjout]);
-                cospha = cosf(pha);
-                sinpha = sinf(pha);
-
-                data.image[IDcosYY].array.F[jjout * ysize + jjin] = cospha;
-                data.image[IDsinYY].array.F[jjout * ysize + jjin] = sinpha;
+    tab.inactive = jjinarrayActive;
+    tab.outactive = jjoutarrayActive;
+    tab.Xin = YinarrayActive;
+    tab.Xout = YoutarrayActive;
+    tab.NBin = NBpixact_jjin;
+    tab.size = ysize;
+    tab.cosarray = data.image[IDcosYY].array.F;
+    tab.sinarray = data.image[IDsinYY].array.F;
+    fft_workerpool_parallelfor(fft_DFT_phatable, &tab, NBpixact_jjout);
 
-            }
-        }
-# ifdef HAVE_LIBGOMP
-        // # ifdef _OPENMP
-    }
-# endif
     printf("> ");
     fflush(stdout);
 
@@ -2726,57 +3984,25 @@ imageID fft_DFT(
 
     printf(" <");
     fflush(stdout);
-#ifdef HAVE_LIBGOMP
-    printf(" -omp- %d ", omp_get_max_threads());
-    fflush(stdout);
-    #pragma omp parallel default(shared) private(kout, k, pha, re, im, cospha, sinpha, iiin, jjin, iiout, jjout, cosXX, cosYY, sinXX, sinYY, cosXY, sinXY)
-    {
-        #pragma omp master
-        {
-            printf(" [%d thread(s)] ", omp_get_num_threads());
-            fflush(stdout);
-        }
-
-        #pragma omp for
-#endif
-
-        for(kout = 0; kout < NBptsout; kout++)
-        {
-            iiout = iioutarray[kout];
-            jjout = jjoutarray[kout];
-
-            re = 0.0;
-            im = 0.0;
-            for(k = 0; k < NBptsin; k++)
-            {
-                iiin = iiinarray[k];
-                jjin = jjinarray[k];
-
-                cosXX = data.image[IDcosXX].array.F[iiout * xsize + iiin];
-                cosYY = data.image[IDcosYY].array.F[jjout * ysize + jjin];
 
-                sinXX = data.image[IDsinXX].array.F[iiout * xsize + iiin];
-                sinYY = data.image[IDsinYY].array.F[jjout * ysize + jjin];
+    dft.iiinarray = iiinarray;
+    dft.jjinarray = jjinarray;
+    dft.valinamp = valinamp;
+    dft.cosvalinpha = cosvalinpha;
+    dft.sinvalinpha = sinvalinpha;
+    dft.NBptsin = NBptsin;
+    dft.iioutarray = iioutarray;
+    dft.jjoutarray = jjoutarray;
+    dft.cosXXarray = data.image[IDcosXX].array.F;
+    dft.sinXXarray = data.image[IDsinXX].array.F;
+    dft.cosYYarray = data.image[IDcosYY].array.F;
+    dft.sinYYarray = data.image[IDsinYY].array.F;
+    dft.xsize = xsize;
+    dft.ysize = ysize;
+    dft.Zfactor = Zfactor;
+    dft.outarray = data.image[IDout].array.CF;
+    fft_workerpool_parallelfor(fft_DFT_sum, &dft, NBptsout);
 
-                cosXY = cosXX * cosYY - sinXX * sinYY;
-                sinXY = sinXX * cosYY + cosXX * sinYY;
-
-                cospha = cosvalinpha[k] * cosXY - sinvalinpha[k] * sinXY;
-                sinpha = sinvalinpha[k] * cosXY + cosvalinpha[k] * sinXY;
-
-
-                re += valinamp[k] * cospha;
-                im += valinamp[k] * sinpha;
-            }
-            data.image[IDout].array.CF[jjoutarray[kout]*xsize + iioutarray[kout]].re = re /
-                    Zfactor;
-            data.image[IDout].array.CF[jjoutarray[kout]*xsize + iioutarray[kout]].im = im /
-                    Zfactor;
-        }
-
-#ifdef HAVE_LIBGOMP
-    }
-#endif
     printf("> ");
     fflush(stdout);
 
@@ -3273,13 +4499,10 @@ int fft_image_translate(const char *ID_name, const char *ID_out, double xtransl,
     mk_complex_from_amph("amptmp", "phatmp1", "ffttmp2", 0);
     delete_image_ID("amptmp");
     delete_image_ID("phatmp1");
-    do2dffti("ffttmp2", "ffttmp3");
+    do2dffti_real("ffttmp2", "retmp");
     delete_image_ID("ffttmp2");
-    mk_reim_from_complex("ffttmp3", "retmp", "imtmp", 0);
     arith_image_cstmult("retmp", 1.0 / naxes[0] / naxes[1], ID_out);
-    delete_image_ID("ffttmp3");
     delete_image_ID("retmp");
-    delete_image_ID("imtmp");
     // }
     // else
     //{
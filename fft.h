@@ -18,6 +18,12 @@ errno_t export_wisdom();
 
 int permut(const char *ID_name);
 
+imageID permut_copy(const char *ID_name, const char *IDout_name);
+
+imageID fftshift(const char *ID_name, long axismask);
+
+imageID ifftshift(const char *ID_name, long axismask);
+
 //void permutfliphv(const char *ID_name);
 
 imageID do1dfft(const char *in_name, const char *out_name);
@@ -26,17 +32,79 @@ imageID do1drfft(const char *in_name, const char *out_name);
 
 imageID do1dffti(const char *in_name, const char *out_name);
 
+imageID FFT_do1dfft_axis(const char *in_name, const char *out_name, int axis,
+                         int dir);
+
+imageID do1dfft_axis(const char *in_name, const char *out_name, int axis);
+
+imageID do1dffti_axis(const char *in_name, const char *out_name, int axis);
+
+imageID do1drfft_axis(const char *in_name, const char *out_name, int axis);
+
+imageID FFT_dondfft(const char *in_name, const char *out_name, long axismask,
+                    int dir);
+
+imageID FFT_dondrffti(const char *in_name, const char *out_name, long axismask,
+                      long naxes);
+
+imageID FFT_dondfft_split(const char *re_name, const char *im_name,
+                          const char *reout_name, const char *imout_name,
+                          long axismask, int dir);
+
+imageID do2dfft_split(const char *re_name, const char *im_name,
+                      const char *reout_name, const char *imout_name);
+
+imageID do2dffti_split(const char *re_name, const char *im_name,
+                       const char *reout_name, const char *imout_name);
+
+int fft_r2rkind(const char *kindname);
+
+imageID do1dr2r(const char *in_name, const char *out_name, int kind);
+
+imageID do2dr2r(const char *in_name, const char *out_name, int kind0,
+                int kind1);
+
+errno_t FFT_do2dfft_array(int precision, long naxes0, long naxes1, long nbslice,
+                          const void *inarray, void *outarray, int dir, int centered);
+
 imageID do2dfft(const char *in_name, const char *out_name);
 
 imageID do2dffti(const char *in_name, const char *out_name);
 
+imageID do2dfft_centered(const char *in_name, const char *out_name);
+
+imageID do2dffti_centered(const char *in_name, const char *out_name);
+
 int pupfft(const char *ID_name_ampl, const char *ID_name_pha,
            const char *ID_name_ampl_out, const char *ID_name_pha_out, const char *options);
 
+errno_t FFT_do2drfft_array(int precision, long naxes0, long naxes1, long nbslice,
+                           const void *inarray, void *outarray, int half, int centered);
+
 imageID do2drfft(const char *in_name, const char *out_name);
 
+imageID do2drfft_centered(const char *in_name, const char *out_name);
+
+imageID do2drfft_half(const char *in_name, const char *out_name);
+
 imageID do2drffti(const char *in_name, const char *out_name);
 
+imageID FFT_do2drffti(const char *in_name, const char *out_name, long naxes0);
+
+imageID do1drffti(const char *in_name, const char *out_name);
+
+imageID FFT_do1drffti(const char *in_name, const char *out_name, long naxes0);
+
+errno_t FFT_do2dffti_real_array(int precision, long naxes0, long naxes1,
+                                long nbslice, const void *inarray, void *outarray, int centered);
+
+imageID FFT_do2dffti_real(const char *in_name, const char *out_name,
+                          int centered);
+
+imageID do2dffti_real(const char *in_name, const char *out_name);
+
+imageID do2dffti_real_centered(const char *in_name, const char *out_name);
+
 imageID fft_correlation(const char *ID_name1, const char *ID_name2,
                      const char *ID_nameout);
 
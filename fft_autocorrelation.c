@@ -2,67 +2,220 @@
  * @file    fft_autocorrelation.c
  * @brief   Compute autocorrelation using FFT
  *
+ * r2c transform, |X|^2 scaled in a single pass on the half spectrum, c2r
+ * transform back. Each slice of a cube is processed independently.
+ *
+ * out(m) = sum_n in(n) in(n + m) / sqrt(N), N pixels per input slice,
+ * zero lag at (0, 0). With zeropad, each slice is padded with zeros to
+ * twice its size along both axes: the output (2 naxes0 x 2 naxes1) is then
+ * the linear autocorrelation, instead of the circular one.
+ *
+ * For 2D images the normalization is that of the original autocorrelation.
+ * Cube outputs are rescaled: the original normalized by the element count
+ * of the whole cube, each slice is now normalized by its own pixel count,
+ * so that a slice gives the same result as the 2D image.
  *
  */
 
 #include <math.h>
+#include <string.h>
+
+#include <fftw3.h>
 
 #include "CommandLineInterface/CLIcore.h"
 #include "COREMOD_memory/COREMOD_memory.h"
-#include "COREMOD_arith/COREMOD_arith.h"
-#include "fft.h"
 
+#include "fft_plancache.h"
+#include "fft_workerpool.h"
+#include "fft_correlation.h"
+#include "fft_autocorrelation.h"
 
-imageID autocorrelation(
-    const char *IDin_name,
-    const char *IDout_name
-)
+
+// |X|^2 of half spectrum elements, scaled
+typedef struct
 {
-    imageID IDin;
-    imageID IDout;
-    uint64_t nelement;
+    int     precision;
+    void   *spec;
+    double  scale;
+} FFT_AUTOCORRELATION_POWER;
+
+
+// spec[ii] = scale * |spec[ii]|^2 for ii in [i0, i1)
+// straight loop without datatype test so it vectorizes
+#define FFT_AUTOCORRELATION_POWSEG(NAME, TYPE)                  \
+static void NAME(TYPE *spec, long i0, long i1, TYPE scale)      \
+{                                                               \
+    for(long ii = i0; ii < i1; ii++)                            \
+    {                                                           \
+        TYPE re = spec[2 * ii];                                 \
+        TYPE im = spec[2 * ii + 1];                             \
+        spec[2 * ii] = scale * (re * re + im * im);             \
+        spec[2 * ii + 1] = 0;                                   \
+    }                                                           \
+}
 
+FFT_AUTOCORRELATION_POWSEG(fft_autocorrelation_powsegf, float)
+FFT_AUTOCORRELATION_POWSEG(fft_autocorrelation_powsegd, double)
 
-    IDin = image_ID(IDin_name);
-    nelement = data.image[IDin].md[0].nelement;
+
+static void fft_autocorrelation_powrange(
+    void *ptr,
+    long  i0,
+    long  i1
+)
+{
+    FFT_AUTOCORRELATION_POWER *job = (FFT_AUTOCORRELATION_POWER *) ptr;
+
+    if(job->precision == FFT_PRECISION_SINGLE)
+    {
+        fft_autocorrelation_powsegf((float *) job->spec, i0, i1, (float) job->scale);
+    }
+    else
+    {
+        fft_autocorrelation_powsegd((double *) job->spec, i0, i1, job->scale);
+    }
+}
 
 
-	char atmp1name[STRINGMAXLEN_IMGNAME];
-    WRITE_IMAGENAME(atmp1name, "_atmp1_%d", (int) getpid());
 
-    do2drfft(IDin_name, atmp1name);
 
-	char aampname[STRINGMAXLEN_IMGNAME];
-    WRITE_IMAGENAME(aampname, "_aamp_%d", (int) getpid());
+/**
+ * @brief Autocorrelation of the slices of a real array
+ *
+ * outarray holds m0 x m1 elements per slice, with m0 = naxes0, m1 = naxes1,
+ * or twice these with zeropad. inarray is not modified.
+ */
+errno_t fft_autocorrelation_array(
+    int         precision,
+    long        naxes0,
+    long        naxes1,
+    long        nbslice,
+    const void *inarray,
+    void       *outarray,
+    int         zeropad
+)
+{
+    long m0 = zeropad ? 2 * naxes0 : naxes0;
+    long m1 = zeropad ? 2 * naxes1 : naxes1;
+    size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                          double);
+    void *padarray = NULL;
+    void *spec;
+    FFT_AUTOCORRELATION_POWER job;
+
+    if(zeropad)
+    {
+        padarray = fftw_malloc(realsize * m0 * m1 * nbslice);
+        if(padarray == NULL)
+        {
+            PRINT_ERROR("malloc error");
+            abort();
+        }
+        memset(padarray, 0, realsize * m0 * m1 * nbslice);
+        for(long r = 0; r < naxes1 * nbslice; r++)
+        {
+            long kk = r / naxes1;
+            long jj = r % naxes1;
+
+            memcpy((char *) padarray + realsize * ((kk * m1 + jj) * m0),
+                   (const char *) inarray + realsize * r * naxes0, realsize * naxes0);
+        }
+        inarray = padarray;
+    }
+
+    spec = fftw_malloc(2 * realsize * (m0 / 2 + 1) * m1 * nbslice);
+    if(spec == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    fft_correlation_rfft(precision, m0, m1, nbslice, inarray, spec);
+    fftw_free(padarray);
+
+    // c2r multiplies by m0 m1
+    job.precision = precision;
+    job.spec = spec;
+    job.scale = 1.0 / (1.0 * m0 * m1 * sqrt(1.0 * naxes0 * naxes1));
+    fft_workerpool_parallelfor(fft_autocorrelation_powrange, &job,
+                               (m0 / 2 + 1) * m1 * nbslice);
+
+    fft_correlation_c2r(precision, m0, m1, nbslice, spec, outarray, 0);
+    fftw_free(spec);
+
+    return RETURN_SUCCESS;
+}
+
 
-	char aphaname[STRINGMAXLEN_IMGNAME];
-    WRITE_IMAGENAME(aphaname, "_apha_%d", (int) getpid());
 
-    mk_amph_from_complex(atmp1name, aampname, aphaname, 0);
 
-	char sqaampname[STRINGMAXLEN_IMGNAME];
-    WRITE_IMAGENAME(sqaampname, "_sqaamp_%d", (int) getpid());
+/* autocorrelation of a real image, or of each slice of a cube */
+// single and double precisions
+// zeropad = 1: linear autocorrelation on a 2 naxes0 x 2 naxes1 output
+// cube slices normalized by their own pixel count (see file header)
+imageID fft_autocorrelation(
+    const char *IDin_name,
+    const char *IDout_name,
+    int         zeropad
+)
+{
+    imageID IDin;
+    imageID IDout;
+    uint8_t datatype;
+    uint32_t naxes[3];
+    long naxis;
+    long n0, n1, nbslice;
+    int precision;
+    void *inarray;
+    void *outarray;
 
-    arith_image_mult(aampname, aampname, sqaampname);
-    delete_image_ID(aampname);
-    delete_image_ID(aphaname);
-    delete_image_ID(atmp1name);
+    IDin = image_ID(IDin_name);
+    datatype = data.image[IDin].md[0].datatype;
+    naxis = data.image[IDin].md[0].naxis;
+
+    if((naxis < 2) || (naxis > 3)
+            || ((datatype != _DATATYPE_FLOAT) && (datatype != _DATATYPE_DOUBLE)))
+    {
+        PRINT_ERROR("image %s not appropriate for autocorrelation", IDin_name);
+        return -1;
+    }
+
+    n0 = data.image[IDin].md[0].size[0];
+    n1 = data.image[IDin].md[0].size[1];
+    nbslice = (naxis == 3) ? data.image[IDin].md[0].size[2] : 1;
+
+    if(datatype == _DATATYPE_FLOAT)
+    {
+        precision = FFT_PRECISION_SINGLE;
+        inarray = (void *) data.image[IDin].array.F;
+    }
+    else
+    {
+        precision = FFT_PRECISION_DOUBLE;
+        inarray = (void *) data.image[IDin].array.D;
+    }
+
+    naxes[0] = zeropad ? 2 * n0 : n0;
+    naxes[1] = zeropad ? 2 * n1 : n1;
+    naxes[2] = nbslice;
+    IDout = create_image_ID(IDout_name, naxis, naxes, datatype, data.SHARED_DFT,
+                            data.NBKEWORD_DFT);
+    outarray = (datatype == _DATATYPE_FLOAT) ? (void *) data.image[IDout].array.F :
+               (void *) data.image[IDout].array.D;
+
+    fft_autocorrelation_array(precision, n0, n1, nbslice, inarray, outarray,
+                              zeropad);
+
+    return IDout;
+}
 
-	char sqaamp1name[STRINGMAXLEN_IMGNAME];
-    WRITE_IMAGENAME(sqaamp1name, "_sqaamp1_%d", (int) getpid());
-    
-    arith_image_cstmult(sqaampname, 1.0 / sqrt(nelement) / (1.0 * nelement),
-                        sqaamp1name);
-    delete_image_ID(sqaampname);
 
-    do2drfft(sqaamp1name, atmp1name);
-    mk_reim_from_complex(atmp1name, IDout_name, aphaname, 0);
-    delete_image_ID(sqaamp1name);
-    delete_image_ID(atmp1name);
-    delete_image_ID(aphaname);
 
-	IDout = image_ID("IDout_name");
 
-    return(IDout);
+imageID autocorrelation(
+    const char *IDin_name,
+    const char *IDout_name
+)
+{
+    return fft_autocorrelation(IDin_name, IDout_name, 0);
 }
-
@@ -3,6 +3,22 @@
  *
  */
 
+errno_t fft_autocorrelation_array(
+    int         precision,
+    long        naxes0,
+    long        naxes1,
+    long        nbslice,
+    const void *inarray,
+    void       *outarray,
+    int         zeropad
+);
+
+imageID fft_autocorrelation(
+    const char *IDin_name,
+    const char *IDout_name,
+    int         zeropad
+);
+
 imageID autocorrelation(
     const char *IDin_name,
     const char *IDout_name
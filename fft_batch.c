@@ -0,0 +1,510 @@
+/**
+ * @file    fft_batch.c
+ * @brief   Slice-parallel execution of batched transforms
+ *
+ * A batch of transforms (first howmany dimension of the key, e.g. the
+ * slices of a cube in do2dfft) can run as :
+ * - one plan over all slices, parallelized by FFTW threads (transform)
+ * - groups of contiguous slices on parallel threads, each group with its
+ *   own single-threaded plan (slice)
+ * - groups of slices, each plan with several FFTW threads (both)
+ *
+ * The thread count given by fft_planpolicy_nthreads is split between
+ * slice threads and FFTW threads according to the mode (fftslicemode).
+ * Both run on the fft worker pool (fft_workerpool.c) :
+ *
+ *     auto      : from cube shape: each slice gets one FFTW thread per
+ *                 FFT_PLANPOLICY_AUTOMINELEM elements, remaining threads
+ *                 process slices in parallel (default)
+ *     transform : FFTW threads only
+ *     slice     : slice threads only
+ *     measure   : splits are timed on scratch arrays on first use of each
+ *                 geometry, fastest is kept
+ *
+ * When the first howmany dimension has unit stride (transforms along a
+ * slow axis, one per column, as in do1dfft_axis), each group is further
+ * executed in blocks of adjacent columns holding about
+ * FFT_BATCH_BLOCKBYTES, so that the strided transforms of a block stay
+ * in cache.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft_plancache.h"
+#include "fft_planpolicy.h"
+#include "fft_batch.h"
+#include "fft_workerpool.h"
+
+
+// group of slices run by one job
+typedef struct
+{
+    const FFT_PLANKEY *key;
+    void              *in;
+    void              *out;
+    int                nslicethreads;
+    int                nfftthreads;
+    int                NBerr;
+} FFT_BATCH_JOB;
+
+
+typedef struct
+{
+    FFT_PLANKEY key;
+    int         nslicethreads;
+    int         nfftthreads;
+    double      time;          // execution time [sec]
+} FFT_BATCH_MEASURE;
+
+
+static int batch_mode = FFT_BATCH_MODE_AUTO;
+
+static FFT_BATCH_MEASURE batch_measure[FFT_BATCH_MAXNB];
+static int batch_NBmeasure = 0;
+static int batch_measurenext = 0;
+
+static pthread_mutex_t batch_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *batch_modename[] = {"auto", "transform", "slice", "measure"};
+
+
+
+
+errno_t fft_batch_setmode(
+    const char *modestr
+)
+{
+    for(int mode = FFT_BATCH_MODE_AUTO; mode <= FFT_BATCH_MODE_MEASURE; mode++)
+    {
+        if(strcmp(modestr, batch_modename[mode]) == 0)
+        {
+            pthread_mutex_lock(&batch_mutex);
+            batch_mode = mode;
+            pthread_mutex_unlock(&batch_mutex);
+            return RETURN_SUCCESS;
+        }
+    }
+
+    PRINT_ERROR("Unknown slice mode \"%s\" (auto, transform, slice, measure)",
+                modestr);
+
+    return RETURN_FAILURE;
+}
+
+
+
+
+// element size of input (output = 0) or output (output = 1) array
+static size_t fft_batch_eltsize(
+    const FFT_PLANKEY *key,
+    int                output
+)
+{
+    size_t realsize = (key->precision == FFT_PRECISION_SINGLE) ? sizeof(
+                          float) : sizeof(double);
+
+    if((key->kind == FFT_KIND_R2R) || (key->kind == FFT_KIND_C2C_SPLIT)
+            || ((key->kind == FFT_KIND_R2C) && (output == 0))
+            || ((key->kind == FFT_KIND_C2R) && (output == 1)))
+    {
+        return realsize;
+    }
+
+    return 2 * realsize;
+}
+
+
+
+
+// execute slices k0 to k1-1 of key, in column blocks for unit-stride batches
+static errno_t fft_batch_execrange(
+    const FFT_PLANKEY *key,
+    void              *in,
+    void              *out,
+    long               k0,
+    long               k1,
+    int                nfftthreads
+)
+{
+    size_t ineltsize = fft_batch_eltsize(key, 0);
+    size_t outeltsize = fft_batch_eltsize(key, 1);
+    size_t instep = ineltsize * key->howmany_dims[0].is;
+    size_t outstep = outeltsize * key->howmany_dims[0].os;
+    long nblock = k1 - k0;
+    errno_t ret = RETURN_SUCCESS;
+    FFT_PLANKEY subkey = *key;
+
+    if((key->howmany_dims[0].is == 1) && (key->howmany_dims[0].os == 1))
+    {
+        size_t transformsize = ineltsize;
+
+        for(int k = 0; k < key->rank; k++)
+        {
+            transformsize *= key->dims[k].n;
+        }
+        nblock = (long)(FFT_BATCH_BLOCKBYTES / transformsize) & ~7L;
+        if(nblock < 8)
+        {
+            nblock = 8;
+        }
+    }
+
+    subkey.nthreads = nfftthreads;
+    for(long k = k0; k < k1; k += nblock)
+    {
+        long n = (k1 - k < nblock) ? k1 - k : nblock;
+
+        subkey.howmany_dims[0].n = (int) n;
+        if(fft_plancache_execute(&subkey, (char *) in + k * instep,
+                                 (char *) out + k * outstep) != RETURN_SUCCESS)
+        {
+            ret = RETURN_FAILURE;
+        }
+    }
+
+    return ret;
+}
+
+
+
+
+static void fft_batch_job(
+    void *ptr,
+    int   ijob
+)
+{
+    FFT_BATCH_JOB *job = (FFT_BATCH_JOB *) ptr;
+    long nslice = job->key->howmany_dims[0].n;
+    long k0 = nslice * ijob / job->nslicethreads;
+    long k1 = nslice * (ijob + 1) / job->nslicethreads;
+
+    if(fft_batch_execrange(job->key, job->in, job->out, k0, k1,
+                           job->nfftthreads) != RETURN_SUCCESS)
+    {
+        __sync_fetch_and_add(&job->NBerr, 1);
+    }
+}
+
+
+
+
+// run batch as nslicethreads groups of slices, nfftthreads FFTW threads each
+static errno_t fft_batch_run(
+    const FFT_PLANKEY *key,
+    void              *in,
+    void              *out,
+    int                nslicethreads,
+    int                nfftthreads
+)
+{
+    FFT_BATCH_JOB job;
+
+    if(key->howmany_rank < 1)
+    {
+        FFT_PLANKEY subkey = *key;
+
+        subkey.nthreads = nfftthreads;
+        return fft_plancache_execute(&subkey, in, out);
+    }
+
+    if(nslicethreads < 2)
+    {
+        return fft_batch_execrange(key, in, out, 0, key->howmany_dims[0].n, nfftthreads);
+    }
+
+    job.key = key;
+    job.in = in;
+    job.out = out;
+    job.nslicethreads = nslicethreads;
+    job.nfftthreads = nfftthreads;
+    job.NBerr = 0;
+    fft_workerpool_run(fft_batch_job, &job, nslicethreads);
+
+    return (job.NBerr == 0) ? RETURN_SUCCESS : RETURN_FAILURE;
+}
+
+
+
+
+// caller must hold batch_mutex
+static FFT_BATCH_MEASURE *fft_batch_lookup(
+    const FFT_PLANKEY *key
+)
+{
+    for(int i = 0; i < batch_NBmeasure; i++)
+    {
+        if(memcmp(&batch_measure[i].key, key, sizeof(FFT_PLANKEY)) == 0)
+        {
+            return &batch_measure[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+
+
+// time candidate splits of nthreads on scratch arrays
+static void fft_batch_measure(
+    const FFT_PLANKEY *key,
+    int                nthreads,
+    int               *nslicethreads,
+    int               *nfftthreads
+)
+{
+    long nslice = key->howmany_dims[0].n;
+    void *inbase, *outbase;
+    void *in, *out;
+    double besttime = -1.0;
+
+    *nslicethreads = 1;
+    *nfftthreads = nthreads;
+
+    if(fft_plankey_scratch(key, &inbase, &outbase, &in, &out) != RETURN_SUCCESS)
+    {
+        PRINT_ERROR("Cannot allocate FFT benchmark arrays");
+        return;
+    }
+
+    for(int nst = 1; (nst <= nthreads) && (nst <= nslice); nst *= 2)
+    {
+        int nft = nthreads / nst;
+        double dt = -1.0;
+
+        // first run creates plans
+        fft_batch_run(key, in, out, nst, nft);
+        for(int iter = 0; iter < 3; iter++)
+        {
+            struct timespec t0, t1;
+
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            fft_batch_run(key, in, out, nst, nft);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            double t = 1.0 * (t1.tv_sec - t0.tv_sec) + 1.0e-9 * (t1.tv_nsec - t0.tv_nsec);
+            if((dt < 0.0) || (t < dt))
+            {
+                dt = t;
+            }
+        }
+        if((besttime < 0.0) || (dt < besttime))
+        {
+            besttime = dt;
+            *nslicethreads = nst;
+            *nfftthreads = nft;
+        }
+    }
+
+    fftw_free(inbase);
+    fftw_free(outbase);
+
+    pthread_mutex_lock(&batch_mutex);
+    if(fft_batch_lookup(key) == NULL)
+    {
+        FFT_BATCH_MEASURE *meas = &batch_measure[batch_measurenext];
+
+        meas->key = *key;
+        meas->nslicethreads = *nslicethreads;
+        meas->nfftthreads = *nfftthreads;
+        meas->time = besttime;
+        batch_measurenext = (batch_measurenext + 1) % FFT_BATCH_MAXNB;
+        if(batch_NBmeasure < FFT_BATCH_MAXNB)
+        {
+            batch_NBmeasure++;
+        }
+    }
+    pthread_mutex_unlock(&batch_mutex);
+}
+
+
+
+
+/**
+ * @brief Split threads of batched transform key between slices and FFTW
+ *
+ * key in-place flag, alignment and total number of threads are set from
+ * in and out.
+ */
+errno_t fft_batch_split(
+    FFT_PLANKEY *key,
+    void        *in,
+    void        *out,
+    int         *nslicethreads,
+    int         *nfftthreads
+)
+{
+    int  mode;
+    int  nthreads;
+    long nslice;
+
+    fft_plankey_setarrays(key, in, out);
+    nthreads = key->nthreads;
+
+    *nslicethreads = 1;
+    *nfftthreads = nthreads;
+
+    if((key->howmany_rank < 1) || (nthreads < 2))
+    {
+        return RETURN_SUCCESS;
+    }
+    nslice = key->howmany_dims[0].n;
+
+    pthread_mutex_lock(&batch_mutex);
+    mode = batch_mode;
+    if((mode == FFT_BATCH_MODE_MEASURE) && (key->kind == FFT_KIND_C2C_SPLIT))
+    {
+        // split arrays cannot be timed on scratch arrays
+        mode = FFT_BATCH_MODE_AUTO;
+    }
+    if(mode == FFT_BATCH_MODE_MEASURE)
+    {
+        FFT_BATCH_MEASURE *meas = fft_batch_lookup(key);
+        if(meas != NULL)
+        {
+            *nslicethreads = meas->nslicethreads;
+            *nfftthreads = meas->nfftthreads;
+            pthread_mutex_unlock(&batch_mutex);
+            return RETURN_SUCCESS;
+        }
+    }
+    pthread_mutex_unlock(&batch_mutex);
+
+    switch(mode)
+    {
+        case FFT_BATCH_MODE_TRANSFORM:
+            break;
+
+        case FFT_BATCH_MODE_SLICE:
+            *nslicethreads = (nthreads < nslice) ? nthreads : (int) nslice;
+            *nfftthreads = 1;
+            break;
+
+        case FFT_BATCH_MODE_MEASURE:
+            fft_batch_measure(key, nthreads, nslicethreads, nfftthreads);
+            break;
+
+        default:
+        {
+            double slicenelem = 1.0;
+
+            for(int k = 0; k < key->rank; k++)
+            {
+                slicenelem *= key->dims[k].n;
+            }
+            *nfftthreads = (int)(slicenelem / FFT_PLANPOLICY_AUTOMINELEM);
+            if(*nfftthreads < 1)
+            {
+                *nfftthreads = 1;
+            }
+            if(*nfftthreads > nthreads)
+            {
+                *nfftthreads = nthreads;
+            }
+            *nslicethreads = nthreads / *nfftthreads;
+            if(*nslicethreads > nslice)
+            {
+                *nslicethreads = (int) nslice;
+            }
+        }
+        break;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Execute batched transform key, slices spread over threads
+ *
+ * Same as fft_plancache_execute for keys without howmany dimension.
+ */
+errno_t fft_batch_execute(
+    FFT_PLANKEY *key,
+    void        *in,
+    void        *out
+)
+{
+    int nslicethreads;
+    int nfftthreads;
+
+    fft_batch_split(key, in, out, &nslicethreads, &nfftthreads);
+
+    return fft_batch_run(key, in, out, nslicethreads, nfftthreads);
+}
+
+
+
+
+
+/**
+ * @brief Execute batched split-complex transform key
+ *
+ * Real and imaginary parts in separate arrays (ri, ii) -> (ro, io), as
+ * float or double depending on key precision. key strides are the same for
+ * both parts. Backward transforms swap real and imaginary parts of input
+ * and output (FFTW split arrays have no sign).
+ */
+errno_t fft_batch_execute_split(
+    FFT_PLANKEY *key,
+    void        *ri,
+    void        *ii,
+    void        *ro,
+    void        *io
+)
+{
+    size_t realsize = (key->precision == FFT_PRECISION_SINGLE) ? sizeof(
+                          float) : sizeof(double);
+
+    if(key->sign == FFTW_BACKWARD)
+    {
+        void *tmp = ri;
+        ri = ii;
+        ii = tmp;
+        tmp = ro;
+        ro = io;
+        io = tmp;
+    }
+
+    key->kind = FFT_KIND_C2C_SPLIT;
+    key->splitoffset_in = ((char *) ii - (char *) ri) / (ptrdiff_t) realsize;
+    key->splitoffset_out = ((char *) io - (char *) ro) / (ptrdiff_t) realsize;
+
+    return fft_batch_execute(key, ri, ro);
+}
+
+
+
+errno_t fft_batch_list()
+{
+    pthread_mutex_lock(&batch_mutex);
+
+    printf("slice mode : %s\n", batch_modename[batch_mode]);
+    for(int i = 0; i < batch_NBmeasure; i++)
+    {
+        const FFT_PLANKEY *key = &batch_measure[i].key;
+
+        printf("    %c %d", (key->precision == FFT_PRECISION_SINGLE) ? 'F' : 'D',
+               key->dims[key->rank - 1].n);
+        for(int k = key->rank - 2; k >= 0; k--)
+        {
+            printf(" x %d", key->dims[k].n);
+        }
+        printf(" x %d slices : %2d slice thread(s) x %2d FFTW thread(s)  %10.3f ms\n",
+               key->howmany_dims[0].n, batch_measure[i].nslicethreads,
+               batch_measure[i].nfftthreads, batch_measure[i].time * 1000.0);
+    }
+
+    pthread_mutex_unlock(&batch_mutex);
+
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file    fft_batch.h
+ *
+ */
+
+#ifndef _FFT_BATCH_H
+#define _FFT_BATCH_H
+
+#include "fft_plancache.h"
+
+
+#define FFT_BATCH_MODE_AUTO      0
+#define FFT_BATCH_MODE_TRANSFORM 1
+#define FFT_BATCH_MODE_SLICE     2
+#define FFT_BATCH_MODE_MEASURE   3
+
+#define FFT_BATCH_MAXNB          64
+
+// column block size for unit-stride batches [byte]
+#define FFT_BATCH_BLOCKBYTES     (256 * 1024)
+
+
+errno_t fft_batch_setmode(
+    const char *modestr
+);
+
+errno_t fft_batch_split(
+    FFT_PLANKEY *key,
+    void        *in,
+    void        *out,
+    int         *nslicethreads,
+    int         *nfftthreads
+);
+
+errno_t fft_batch_execute(
+    FFT_PLANKEY *key,
+    void        *in,
+    void        *out
+);
+
+errno_t fft_batch_execute_split(
+    FFT_PLANKEY *key,
+    void        *ri,
+    void        *ii,
+    void        *ro,
+    void        *io
+);
+
+errno_t fft_batch_list();
+
+#endif
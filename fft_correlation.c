@@ -0,0 +1,806 @@
+/**
+ * @file    fft_correlation.c
+ * @brief   Cross-correlation of real images using FFT
+ *
+ * Fused correlation engine: r2c transform of both inputs, conjugate
+ * multiply on the half spectra, c2r transform back. No amplitude/phase
+ * conversion and no intermediate image.
+ *
+ * out(m) = sum_n in1(n) in2(n + m) / sqrt(N), N pixels per slice,
+ * with zero lag at (naxes0/2, naxes1/2). For even sizes, the output
+ * centering is a (-1)^(ii+jj) modulation of the cross spectrum, folded
+ * into the multiply; odd sizes are shifted after the c2r transform.
+ *
+ * Reference contexts (fft_correlation_ref) keep the half spectrum of a
+ * fixed reference image, conjugated unless convolving, optionally
+ * normalized to unit modulus (phase correlation). Each call then costs one
+ * r2c and one c2r transform. The spectrum is recomputed when the reference
+ * write counter (cnt0) changes, or when the image is reallocated.
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+#include "COREMOD_memory/COREMOD_memory.h"
+
+#include "fft_plancache.h"
+#include "fft_batch.h"
+#include "fft_shift.h"
+#include "fft_workerpool.h"
+#include "fft_correlation.h"
+
+
+// conjugate multiply of half spectra, one row per job index
+typedef struct
+{
+    int         precision;
+    size_t      realsize;
+    const void *spec1;
+    long        nbslice1;     // 1: same spectrum for all slices
+    const void *spec2;
+    long        nbslice2;
+    void       *specout;
+    long        naxes0h;
+    long        naxes1;
+    double      scale;
+    int         conjugate;    // conj(spec1) * spec2, otherwise spec1 * spec2
+    int         modulate;     // multiply by (-1)^(ii+jj): centered output
+} FFT_CORRELATION_MULT;
+
+
+// reference spectrum context
+typedef struct
+{
+    int       used;
+    char      refname[STRINGMAXLEN_IMGNAME];
+    int       flags;
+
+    // reference image state when spectrum was computed
+    void     *refarray;
+    uint8_t   datatype;
+    long      naxes0;
+    long      naxes1;
+    uint64_t  cnt0;
+
+    void     *spec;       // (naxes0/2+1) x naxes1 complex
+    uint64_t  nrefresh;
+    uint64_t  nexec;
+    uint64_t  lastuse;
+} FFT_CORRELATION_CTX;
+
+
+static FFT_CORRELATION_CTX corrctx[FFT_CORRELATION_MAXCTX];
+static uint64_t corrctx_tick = 0;
+
+// context table lock: correlations hold it for reading, refresh for writing
+static pthread_rwlock_t corrctx_rwlock = PTHREAD_RWLOCK_INITIALIZER;
+
+
+
+
+// out[ii] = scale * conj(a[ii]) * b[ii] (CS = -1) or scale * a[ii] * b[ii]
+// (CS = 1), times (-1)^ii if modulate
+// out may be a or b; straight loop without datatype test so it vectorizes
+#define FFT_CORRELATION_MULTROW(NAME, TYPE, CS)                        \
+static void NAME(const TYPE *a, const TYPE *b, TYPE *out, long n,      \
+                 TYPE scale, int modulate)                             \
+{                                                                      \
+    for(long ii = 0; ii < n; ii++)                                     \
+    {                                                                  \
+        TYPE s = (modulate && (ii & 1)) ? -scale : scale;              \
+        TYPE ai = CS * a[2 * ii + 1];                                  \
+        TYPE re = a[2 * ii] * b[2 * ii] - ai * b[2 * ii + 1];          \
+        TYPE im = a[2 * ii] * b[2 * ii + 1] + ai * b[2 * ii];          \
+        out[2 * ii] = s * re;                                          \
+        out[2 * ii + 1] = s * im;                                      \
+    }                                                                  \
+}
+
+FFT_CORRELATION_MULTROW(fft_correlation_cmultrowf, float, -1)
+FFT_CORRELATION_MULTROW(fft_correlation_cmultrowd, double, -1)
+FFT_CORRELATION_MULTROW(fft_correlation_multrowf, float, 1)
+FFT_CORRELATION_MULTROW(fft_correlation_multrowd, double, 1)
+
+
+
+
+static void fft_correlation_multrows(
+    void *ptr,
+    long  r0,
+    long  r1
+)
+{
+    FFT_CORRELATION_MULT *job = (FFT_CORRELATION_MULT *) ptr;
+    long n0h = job->naxes0h;
+    long n1 = job->naxes1;
+
+    for(long r = r0; r < r1; r++)
+    {
+        long jj = r % n1;
+        long row1 = ((job->nbslice1 == 1) ? jj : r) * n0h;
+        long row2 = ((job->nbslice2 == 1) ? jj : r) * n0h;
+        double scale = (job->modulate && (jj & 1)) ? -job->scale : job->scale;
+
+        const void *a = (const char *) job->spec1 + 2 * row1 * job->realsize;
+        const void *b = (const char *) job->spec2 + 2 * row2 * job->realsize;
+        void *out = (char *) job->specout + 2 * r * n0h * job->realsize;
+
+        if(job->precision == FFT_PRECISION_SINGLE)
+        {
+            if(job->conjugate)
+            {
+                fft_correlation_cmultrowf(a, b, out, n0h, (float) scale, job->modulate);
+            }
+            else
+            {
+                fft_correlation_multrowf(a, b, out, n0h, (float) scale, job->modulate);
+            }
+        }
+        else
+        {
+            if(job->conjugate)
+            {
+                fft_correlation_cmultrowd(a, b, out, n0h, scale, job->modulate);
+            }
+            else
+            {
+                fft_correlation_multrowd(a, b, out, n0h, scale, job->modulate);
+            }
+        }
+    }
+}
+
+
+
+
+// output centering folded into the cross spectrum
+static int fft_correlation_modulate(
+    long naxes0,
+    long naxes1
+)
+{
+    return (naxes0 % 2 == 0) && (naxes1 % 2 == 0);
+}
+
+
+
+
+// 2D guru key over the slices of a naxes0 x naxes1 x nbslice array
+static void fft_correlation_plankey(
+    FFT_PLANKEY *key,
+    int          precision,
+    int          kind,
+    long         naxes0,
+    long         naxes1,
+    long         nbslice
+)
+{
+    long size[3] = {naxes0, naxes1, nbslice};
+
+    fft_plankey_init(key, precision, kind,
+                     (kind == FFT_KIND_R2C) ? FFTW_FORWARD : FFTW_BACKWARD);
+    fft_plankey_addaxes(key, (nbslice > 1) ? 3 : 2, size, 3);
+}
+
+
+
+
+/**
+ * @brief Half spectra of the slices of a real array
+ *
+ * spec holds (naxes0/2+1) x naxes1 complex elements per slice.
+ * inarray is not modified.
+ */
+errno_t fft_correlation_rfft(
+    int         precision,
+    long        naxes0,
+    long        naxes1,
+    long        nbslice,
+    const void *inarray,
+    void       *spec
+)
+{
+    FFT_PLANKEY key;
+
+    fft_correlation_plankey(&key, precision, FFT_KIND_R2C, naxes0, naxes1, nbslice);
+
+    return fft_batch_execute(&key, (void *) inarray, spec);
+}
+
+
+
+
+/**
+ * @brief Cross spectrum conj(spec1) * spec2 of nbslice slices
+ *
+ * conjugate = 0: spec1 * spec2, for a spec1 stored conjugated.
+ * nbslice1, nbslice2: 1 (same spectrum for every slice) or nbslice.
+ * specout may be spec1 or spec2. Includes the 1/(N sqrt(N)) scaling of
+ * fft_correlation and, if centered, the output centering for even sizes.
+ */
+errno_t fft_correlation_crossmult(
+    int         precision,
+    long        naxes0,
+    long        naxes1,
+    long        nbslice,
+    const void *spec1,
+    long        nbslice1,
+    const void *spec2,
+    long        nbslice2,
+    void       *specout,
+    int         conjugate,
+    int         centered
+)
+{
+    FFT_CORRELATION_MULT job;
+    double N = 1.0 * naxes0 * naxes1;
+
+    job.precision = precision;
+    job.realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                       double);
+    job.spec1 = spec1;
+    job.nbslice1 = nbslice1;
+    job.spec2 = spec2;
+    job.nbslice2 = nbslice2;
+    job.specout = specout;
+    job.naxes0h = naxes0 / 2 + 1;
+    job.naxes1 = naxes1;
+    job.scale = 1.0 / (N * sqrt(N));
+    job.conjugate = conjugate;
+    job.modulate = centered && fft_correlation_modulate(naxes0, naxes1);
+
+    return fft_workerpool_parallelfor(fft_correlation_multrows, &job,
+                                      nbslice * naxes1);
+}
+
+
+
+
+/**
+ * @brief Real correlation from cross spectrum
+ *
+ * spec is overwritten (c2r transform). centered must be the value given
+ * to fft_correlation_crossmult.
+ */
+errno_t fft_correlation_c2r(
+    int   precision,
+    long  naxes0,
+    long  naxes1,
+    long  nbslice,
+    void *spec,
+    void *outarray,
+    int   centered
+)
+{
+    FFT_PLANKEY key;
+
+    fft_correlation_plankey(&key, precision, FFT_KIND_C2R, naxes0, naxes1, nbslice);
+    if(fft_batch_execute(&key, spec, outarray) != RETURN_SUCCESS)
+    {
+        return RETURN_FAILURE;
+    }
+
+    if(centered && !fft_correlation_modulate(naxes0, naxes1))
+    {
+        // odd sizes: exact fftshift, zero lag at (naxes0/2, naxes1/2)
+        size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(
+                              float) : sizeof(double);
+        long size[3] = {naxes0, naxes1, nbslice};
+
+        fft_shift_axes(outarray, realsize, (nbslice > 1) ? 3 : 2, size, 3, 0);
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/* cross-correlation of two real images, zero lag at the center */
+// either image can be a cube: each slice is correlated with the other
+// image (reference), or with the same slice if both are cubes
+// single and double precisions, both inputs of the same type
+imageID fft_correlation(
+    const char *ID_name1,
+    const char *ID_name2,
+    const char *ID_nameout
+)
+{
+    imageID ID1;
+    imageID ID2;
+    imageID IDout;
+    uint8_t datatype;
+    uint32_t naxes[3];
+    long nbslice1;
+    long nbslice2;
+    long nbslice;
+    int precision;
+    size_t realsize;
+    void *spec1;
+    void *spec2;
+    void *specout;
+    void *array1;
+    void *array2;
+    void *outarray;
+
+    ID1 = image_ID(ID_name1);
+    ID2 = image_ID(ID_name2);
+    if((ID1 == -1) || (ID2 == -1))
+    {
+        PRINT_ERROR("image %s or %s not found", ID_name1, ID_name2);
+        return -1;
+    }
+    datatype = data.image[ID1].md[0].datatype;
+
+    nbslice1 = (data.image[ID1].md[0].naxis == 3) ? data.image[ID1].md[0].size[2] : 1;
+    nbslice2 = (data.image[ID2].md[0].naxis == 3) ? data.image[ID2].md[0].size[2] : 1;
+    nbslice = (nbslice1 > nbslice2) ? nbslice1 : nbslice2;
+
+    if((data.image[ID1].md[0].naxis < 2) || (data.image[ID2].md[0].naxis < 2)
+            || (data.image[ID2].md[0].datatype != datatype)
+            || ((datatype != _DATATYPE_FLOAT) && (datatype != _DATATYPE_DOUBLE))
+            || (data.image[ID1].md[0].size[0] != data.image[ID2].md[0].size[0])
+            || (data.image[ID1].md[0].size[1] != data.image[ID2].md[0].size[1])
+            || ((nbslice1 != 1) && (nbslice1 != nbslice))
+            || ((nbslice2 != 1) && (nbslice2 != nbslice)))
+    {
+        PRINT_ERROR("images %s %s not appropriate for correlation", ID_name1, ID_name2);
+        return -1;
+    }
+
+    naxes[0] = data.image[ID1].md[0].size[0];
+    naxes[1] = data.image[ID1].md[0].size[1];
+    naxes[2] = nbslice;
+
+    if(datatype == _DATATYPE_FLOAT)
+    {
+        precision = FFT_PRECISION_SINGLE;
+        realsize = sizeof(float);
+        array1 = (void *) data.image[ID1].array.F;
+        array2 = (void *) data.image[ID2].array.F;
+    }
+    else
+    {
+        precision = FFT_PRECISION_DOUBLE;
+        realsize = sizeof(double);
+        array1 = (void *) data.image[ID1].array.D;
+        array2 = (void *) data.image[ID2].array.D;
+    }
+
+    IDout = create_image_ID(ID_nameout, (nbslice > 1) ? 3 : 2, naxes, datatype,
+                            data.SHARED_DFT, data.NBKEWORD_DFT);
+    outarray = (datatype == _DATATYPE_FLOAT) ? (void *) data.image[IDout].array.F :
+               (void *) data.image[IDout].array.D;
+
+    size_t specsize = 2 * realsize * (naxes[0] / 2 + 1) * naxes[1];
+    spec1 = fftw_malloc(specsize * nbslice1);
+    spec2 = fftw_malloc(specsize * nbslice2);
+    if((spec1 == NULL) || (spec2 == NULL))
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    fft_correlation_rfft(precision, naxes[0], naxes[1], nbslice1, array1, spec1);
+    fft_correlation_rfft(precision, naxes[0], naxes[1], nbslice2, array2, spec2);
+
+    specout = (nbslice1 == nbslice) ? spec1 : spec2;
+    fft_correlation_crossmult(precision, naxes[0], naxes[1], nbslice,
+                              spec1, nbslice1, spec2, nbslice2, specout, 1, 1);
+    fft_correlation_c2r(precision, naxes[0], naxes[1], nbslice, specout, outarray, 1);
+
+    fftw_free(spec1);
+    fftw_free(spec2);
+
+    return IDout;
+}
+
+
+
+
+// caller must hold corrctx_rwlock
+static FFT_CORRELATION_CTX *fft_correlation_ctxlookup(
+    const char *IDref_name,
+    int         flags
+)
+{
+    for(int i = 0; i < FFT_CORRELATION_MAXCTX; i++)
+    {
+        if((corrctx[i].used == 1) && (corrctx[i].flags == flags)
+                && (strcmp(corrctx[i].refname, IDref_name) == 0))
+        {
+            return &corrctx[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+
+
+// caller must hold corrctx_rwlock
+static int fft_correlation_ctxvalid(
+    const FFT_CORRELATION_CTX *ctx,
+    imageID                    IDref
+)
+{
+    void *refarray = (data.image[IDref].md[0].datatype == _DATATYPE_FLOAT) ?
+                     (void *) data.image[IDref].array.F : (void *) data.image[IDref].array.D;
+
+    return (ctx->refarray == refarray)
+           && (ctx->datatype == data.image[IDref].md[0].datatype)
+           && (ctx->naxes0 == data.image[IDref].md[0].size[0])
+           && (ctx->naxes1 == data.image[IDref].md[0].size[1])
+           && (ctx->cnt0 == data.image[IDref].md[0].cnt0);
+}
+
+
+
+
+// conjugate and/or normalize to unit modulus the n complex elements of spec
+#define FFT_CORRELATION_REFSPEC(NAME, TYPE)                             \
+static void NAME(TYPE *spec, long n, int conjugate, int normalize)      \
+{                                                                       \
+    for(long ii = 0; ii < n; ii++)                                      \
+    {                                                                   \
+        TYPE re = spec[2 * ii];                                         \
+        TYPE im = conjugate ? -spec[2 * ii + 1] : spec[2 * ii + 1];     \
+        TYPE a2 = re * re + im * im;                                    \
+        TYPE s = (normalize == 0) ? 1 : ((a2 > 0) ? 1 / sqrt(a2) : 0);  \
+        spec[2 * ii] = s * re;                                          \
+        spec[2 * ii + 1] = s * im;                                      \
+    }                                                                   \
+}
+
+FFT_CORRELATION_REFSPEC(fft_correlation_refspecf, float)
+FFT_CORRELATION_REFSPEC(fft_correlation_refspecd, double)
+
+
+
+
+// compute reference spectrum into a new buffer, without holding corrctx_rwlock
+// state of reference image (refarray, datatype, naxes, cnt0) set in *state
+// returns NULL if reference is not appropriate
+static void *fft_correlation_refspectrum(
+    imageID              IDref,
+    int                  flags,
+    FFT_CORRELATION_CTX *state
+)
+{
+    uint8_t datatype = data.image[IDref].md[0].datatype;
+    long n0 = data.image[IDref].md[0].size[0];
+    long n1 = data.image[IDref].md[0].size[1];
+    int precision;
+    size_t realsize;
+    void *spec;
+
+    if((data.image[IDref].md[0].naxis != 2)
+            || ((datatype != _DATATYPE_FLOAT) && (datatype != _DATATYPE_DOUBLE)))
+    {
+        PRINT_ERROR("image %s not appropriate as correlation reference",
+                    data.image[IDref].md[0].name);
+        return NULL;
+    }
+    precision = (datatype == _DATATYPE_FLOAT) ? FFT_PRECISION_SINGLE :
+                FFT_PRECISION_DOUBLE;
+    realsize = (datatype == _DATATYPE_FLOAT) ? sizeof(float) : sizeof(double);
+
+    spec = fftw_malloc(2 * realsize * (n0 / 2 + 1) * n1);
+    if(spec == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    // counter read first: a write during the transform triggers a new refresh
+    state->datatype = datatype;
+    state->naxes0 = n0;
+    state->naxes1 = n1;
+    state->cnt0 = data.image[IDref].md[0].cnt0;
+    if(precision == FFT_PRECISION_SINGLE)
+    {
+        state->refarray = (void *) data.image[IDref].array.F;
+        fft_correlation_rfft(precision, n0, n1, 1, state->refarray, spec);
+        fft_correlation_refspecf((float *) spec, (n0 / 2 + 1) * n1,
+                                 !(flags & FFT_CORRELATION_CONVOLVE),
+                                 flags & FFT_CORRELATION_PHASE);
+    }
+    else
+    {
+        state->refarray = (void *) data.image[IDref].array.D;
+        fft_correlation_rfft(precision, n0, n1, 1, state->refarray, spec);
+        fft_correlation_refspecd((double *) spec, (n0 / 2 + 1) * n1,
+                                 !(flags & FFT_CORRELATION_CONVOLVE),
+                                 flags & FFT_CORRELATION_PHASE);
+    }
+
+    return spec;
+}
+
+
+
+
+// caller must hold corrctx_rwlock for writing
+// returns free context, evicting least recently used one if table is full
+static FFT_CORRELATION_CTX *fft_correlation_ctxfreeslot()
+{
+    int islot = 0;
+
+    for(int i = 0; i < FFT_CORRELATION_MAXCTX; i++)
+    {
+        if(corrctx[i].used == 0)
+        {
+            return &corrctx[i];
+        }
+        if(__atomic_load_n(&corrctx[i].lastuse, __ATOMIC_RELAXED)
+                < __atomic_load_n(&corrctx[islot].lastuse, __ATOMIC_RELAXED))
+        {
+            islot = i;
+        }
+    }
+
+    fftw_free(corrctx[islot].spec);
+    memset(&corrctx[islot], 0, sizeof(FFT_CORRELATION_CTX));
+
+    return &corrctx[islot];
+}
+
+
+
+
+/**
+ * @brief Reference spectrum of context (IDref_name, flags)
+ *
+ * Context is created or refreshed if needed. The new spectrum is computed
+ * without holding the table lock, and swapped into the context under the
+ * write lock, so correlations on other contexts are not blocked meanwhile.
+ * The table is read-locked until fft_correlation_refrelease: the spectrum
+ * stays valid meanwhile.
+ * Returns NULL (not locked) if reference is not appropriate.
+ */
+const void *fft_correlation_refacquire(
+    const char *IDref_name,
+    int         flags
+)
+{
+    FFT_CORRELATION_CTX *ctx;
+    imageID IDref = image_ID(IDref_name);
+
+    if(IDref == -1)
+    {
+        PRINT_ERROR("image %s not found", IDref_name);
+        return NULL;
+    }
+
+    pthread_rwlock_rdlock(&corrctx_rwlock);
+    ctx = fft_correlation_ctxlookup(IDref_name, flags);
+    while((ctx == NULL) || (fft_correlation_ctxvalid(ctx, IDref) == 0))
+    {
+        FFT_CORRELATION_CTX state;
+        void *spec;
+        void *oldspec;
+
+        pthread_rwlock_unlock(&corrctx_rwlock);
+
+        spec = fft_correlation_refspectrum(IDref, flags, &state);
+        if(spec == NULL)
+        {
+            return NULL;
+        }
+
+        pthread_rwlock_wrlock(&corrctx_rwlock);
+        ctx = fft_correlation_ctxlookup(IDref_name, flags);
+        if(ctx == NULL)
+        {
+            ctx = fft_correlation_ctxfreeslot();
+            strncpy(ctx->refname, IDref_name, STRINGMAXLEN_IMGNAME - 1);
+            ctx->flags = flags;
+            ctx->used = 1;
+        }
+        // no reader can hold the previous spectrum: we hold the write lock
+        oldspec = ctx->spec;
+        ctx->spec = spec;
+        ctx->refarray = state.refarray;
+        ctx->datatype = state.datatype;
+        ctx->naxes0 = state.naxes0;
+        ctx->naxes1 = state.naxes1;
+        ctx->cnt0 = state.cnt0;
+        ctx->nrefresh++;
+        pthread_rwlock_unlock(&corrctx_rwlock);
+
+        fftw_free(oldspec);
+
+        // context may have been evicted in between: look it up again
+        pthread_rwlock_rdlock(&corrctx_rwlock);
+        ctx = fft_correlation_ctxlookup(IDref_name, flags);
+    }
+
+    __sync_fetch_and_add(&ctx->nexec, 1);
+    __atomic_store_n(&ctx->lastuse, __sync_add_and_fetch(&corrctx_tick, 1),
+                     __ATOMIC_RELAXED);
+
+    return ctx->spec;
+}
+
+
+
+
+void fft_correlation_refrelease()
+{
+    pthread_rwlock_unlock(&corrctx_rwlock);
+}
+
+
+
+
+/**
+ * @brief Correlate image (or each slice of a cube) with a fixed reference
+ *
+ * Same result as fft_correlation(IDref_name, ID_name, ID_nameout), with the
+ * reference spectrum kept in a context between calls.
+ * flags: FFT_CORRELATION_CONVOLVE (convolution instead of correlation),
+ *        FFT_CORRELATION_PHASE (unit-modulus reference spectrum)
+ * An existing output image of the right size and type is reused, and its
+ * cnt0 incremented, so the call can run in a loop on streams.
+ */
+imageID fft_correlation_ref(
+    const char *IDref_name,
+    const char *ID_name,
+    const char *ID_nameout,
+    int         flags
+)
+{
+    const void *refspec;
+    imageID IDref;
+    imageID ID;
+    imageID IDout;
+    uint8_t datatype;
+    uint32_t naxes[3];
+    long nbslice;
+    int precision;
+    size_t realsize;
+    void *inarray;
+    void *outarray;
+    void *spec;
+
+    IDref = image_ID(IDref_name);
+    ID = image_ID(ID_name);
+    if((IDref == -1) || (ID == -1))
+    {
+        PRINT_ERROR("image %s or %s not found", IDref_name, ID_name);
+        return -1;
+    }
+    datatype = data.image[ID].md[0].datatype;
+    nbslice = (data.image[ID].md[0].naxis == 3) ? data.image[ID].md[0].size[2] : 1;
+
+    if((data.image[ID].md[0].naxis < 2) || (data.image[ID].md[0].naxis > 3)
+            || (data.image[IDref].md[0].naxis != 2)
+            || ((datatype != _DATATYPE_FLOAT) && (datatype != _DATATYPE_DOUBLE))
+            || (data.image[IDref].md[0].datatype != datatype)
+            || (data.image[ID].md[0].size[0] != data.image[IDref].md[0].size[0])
+            || (data.image[ID].md[0].size[1] != data.image[IDref].md[0].size[1]))
+    {
+        PRINT_ERROR("image %s not appropriate for correlation with %s", ID_name,
+                    IDref_name);
+        return -1;
+    }
+
+    naxes[0] = data.image[ID].md[0].size[0];
+    naxes[1] = data.image[ID].md[0].size[1];
+    naxes[2] = nbslice;
+    precision = (datatype == _DATATYPE_FLOAT) ? FFT_PRECISION_SINGLE :
+                FFT_PRECISION_DOUBLE;
+    realsize = (datatype == _DATATYPE_FLOAT) ? sizeof(float) : sizeof(double);
+
+    IDout = image_ID(ID_nameout);
+    if((IDout == -1) || (data.image[IDout].md[0].datatype != datatype)
+            || (data.image[IDout].md[0].nelement != data.image[ID].md[0].nelement))
+    {
+        if(IDout != -1)
+        {
+            delete_image_ID(ID_nameout);
+        }
+        IDout = create_image_ID(ID_nameout, (nbslice > 1) ? 3 : 2, naxes, datatype,
+                                data.SHARED_DFT, data.NBKEWORD_DFT);
+    }
+
+    if(precision == FFT_PRECISION_SINGLE)
+    {
+        inarray = (void *) data.image[ID].array.F;
+        outarray = (void *) data.image[IDout].array.F;
+    }
+    else
+    {
+        inarray = (void *) data.image[ID].array.D;
+        outarray = (void *) data.image[IDout].array.D;
+    }
+
+    spec = fftw_malloc(2 * realsize * (naxes[0] / 2 + 1) * naxes[1] * nbslice);
+    if(spec == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+    fft_correlation_rfft(precision, naxes[0], naxes[1], nbslice, inarray, spec);
+
+    refspec = fft_correlation_refacquire(IDref_name, flags);
+    if(refspec == NULL)
+    {
+        fftw_free(spec);
+        return -1;
+    }
+    fft_correlation_crossmult(precision, naxes[0], naxes[1], nbslice,
+                              refspec, 1, spec, nbslice, spec, 0, 1);
+    fft_correlation_refrelease();
+
+    fft_correlation_c2r(precision, naxes[0], naxes[1], nbslice, spec, outarray, 1);
+    fftw_free(spec);
+
+    data.image[IDout].md[0].cnt0++;
+
+    return IDout;
+}
+
+
+
+
+errno_t fft_correlation_reflist()
+{
+    long NBctx = 0;
+
+    pthread_rwlock_rdlock(&corrctx_rwlock);
+
+    printf("%4s  %-32s %5s %c %-12s %10s %10s\n",
+           "slot", "reference", "flags", 'P', "size", "nrefresh", "nexec");
+
+    for(int i = 0; i < FFT_CORRELATION_MAXCTX; i++)
+    {
+        if(corrctx[i].used == 1)
+        {
+            char sizestr[STRINGMAXLEN_DEFAULT];
+
+            snprintf(sizestr, STRINGMAXLEN_DEFAULT, "%ldx%ld", corrctx[i].naxes0,
+                     corrctx[i].naxes1);
+            printf("%4d  %-32s %5d %c %-12s %10lu %10lu\n",
+                   i, corrctx[i].refname, corrctx[i].flags,
+                   (corrctx[i].datatype == _DATATYPE_FLOAT) ? 'F' : 'D',
+                   sizestr,
+                   (unsigned long) corrctx[i].nrefresh,
+                   (unsigned long) corrctx[i].nexec);
+            NBctx++;
+        }
+    }
+
+    pthread_rwlock_unlock(&corrctx_rwlock);
+
+    printf("%ld reference context(s)\n", NBctx);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+errno_t fft_correlation_refflush()
+{
+    pthread_rwlock_wrlock(&corrctx_rwlock);
+
+    for(int i = 0; i < FFT_CORRELATION_MAXCTX; i++)
+    {
+        if(corrctx[i].used == 1)
+        {
+            fftw_free(corrctx[i].spec);
+        }
+    }
+    memset(corrctx, 0, sizeof(corrctx));
+
+    pthread_rwlock_unlock(&corrctx_rwlock);
+
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file    fft_correlation.h
+ *
+ */
+
+#ifndef _FFT_CORRELATION_H
+#define _FFT_CORRELATION_H
+
+
+#define FFT_CORRELATION_MAXCTX   16
+
+// fft_correlation_ref flags
+#define FFT_CORRELATION_CONVOLVE 1   // reference spectrum not conjugated
+#define FFT_CORRELATION_PHASE    2   // unit-modulus reference spectrum
+
+
+errno_t fft_correlation_rfft(
+    int         precision,
+    long        naxes0,
+    long        naxes1,
+    long        nbslice,
+    const void *inarray,
+    void       *spec
+);
+
+errno_t fft_correlation_crossmult(
+    int         precision,
+    long        naxes0,
+    long        naxes1,
+    long        nbslice,
+    const void *spec1,
+    long        nbslice1,
+    const void *spec2,
+    long        nbslice2,
+    void       *specout,
+    int         conjugate,
+    int         centered
+);
+
+errno_t fft_correlation_c2r(
+    int   precision,
+    long  naxes0,
+    long  naxes1,
+    long  nbslice,
+    void *spec,
+    void *outarray,
+    int   centered
+);
+
+const void *fft_correlation_refacquire(
+    const char *IDref_name,
+    int         flags
+);
+
+void fft_correlation_refrelease();
+
+imageID fft_correlation_ref(
+    const char *IDref_name,
+    const char *ID_name,
+    const char *ID_nameout,
+    int         flags
+);
+
+errno_t fft_correlation_reflist();
+
+errno_t fft_correlation_refflush();
+
+#endif
@@ -0,0 +1,1474 @@
+/**
+ * @file    fft_plancache.c
+ * @brief   Process-wide cache of FFTW plans
+ *
+ * Plans are created once per transform geometry and kept alive.
+ * Each call re-runs the cached plan on the caller's arrays with the
+ * FFTW new-array execute functions.
+ *
+ * The key holds the guru description of the transform (rank, dims,
+ * howmany dims), precision, kind, direction, in/out-of-place and
+ * array alignment, as required for new-array execution.
+ *
+ * In background planning mode, a new geometry is first served by a
+ * FFTW_ESTIMATE plan, while a planner thread optimizes it on scratch
+ * arrays. The optimized plan then replaces the estimate plan in cache.
+ * The planner thread plans in time slices, releasing the FFTW planner in
+ * between, so that new geometries planned by other threads do not wait for
+ * a full optimization. FFTW keeps the wisdom of the subproblems solved in
+ * each slice, so the next slice resumes where the previous one stopped.
+ *
+ * Plans are never destroyed while holding the cache table lock: evicted or
+ * replaced plans are unlinked from the table, and destroyed after the lock
+ * is released.
+ *
+ * Split-complex transforms (separate real and imaginary arrays) are keyed
+ * by the offset between real and imaginary parts, as FFTW requires it to be
+ * unchanged for new-array execution. They cannot be planned on scratch
+ * arrays: plans come from wisdom, or are created with FFTW_ESTIMATE.
+ *
+ * FFTW threads are initialized for both precisions on first plan creation,
+ * and run on the fft worker pool if FFTW supports it (FFTW >= 3.3.9).
+ * The number of threads is part of the key (see fft_planpolicy_nthreads).
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft/fft.h"
+
+#include "fft_plancache.h"
+#include "fft_planpolicy.h"
+#include "fft_wisdom.h"
+#include "fft_workerpool.h"
+
+
+typedef struct
+{
+    int         used;
+    FFT_PLANKEY key;
+    void       *plan;     // fftw_plan or fftwf_plan, depending on key.precision
+    unsigned    flags;    // planner flags used to create plan
+
+    uint64_t    nexec;
+    uint64_t    lastuse;
+    double      plantime; // planning time [sec]
+} FFT_PLANCACHE_ENTRY;
+
+
+static FFT_PLANCACHE_ENTRY plancache[FFT_PLANCACHE_MAXNB];
+static uint64_t plancache_tick = 0;
+
+// cache table lock: transforms hold it for reading, insert/flush for writing
+static pthread_rwlock_t plancache_rwlock = PTHREAD_RWLOCK_INITIALIZER;
+
+// FFTW planner is not thread-safe
+static pthread_mutex_t planner_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// FFTW threads initialized, protected by planner_mutex
+static int fftwthreads_init = 0;
+
+
+// background planner queue
+static FFT_PLANKEY bgqueue[FFT_PLANCACHE_MAXNB];
+static int bgqueue_first = 0;
+static int bgqueue_NB = 0;
+static int bgthread_running = 0;
+static int bgthread_stop = 0;
+static pthread_t bgthread;
+static pthread_mutex_t bgqueue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bgqueue_cond = PTHREAD_COND_INITIALIZER;
+
+// background planning slices [sec]: first slice, doubled up to max
+#define FFT_PLANCACHE_BGSLICE0    0.02
+#define FFT_PLANCACHE_BGSLICEMAX  0.5
+// total background planning time if planning policy sets no time limit [sec]
+#define FFT_PLANCACHE_BGMAXTIME   300.0
+
+
+
+
+void fft_plankey_init(
+    FFT_PLANKEY *key,
+    int          precision,
+    int          kind,
+    int          sign
+)
+{
+    memset(key, 0, sizeof(FFT_PLANKEY));
+    key->precision = precision;
+    key->kind = kind;
+    key->sign = sign;
+}
+
+
+
+errno_t fft_plankey_adddim(
+    FFT_PLANKEY *key,
+    int          n,
+    int          is,
+    int          os
+)
+{
+    if(key->rank >= FFT_PLANCACHE_MAXRANK)
+    {
+        PRINT_ERROR("transform rank exceeds %d", FFT_PLANCACHE_MAXRANK);
+        return RETURN_FAILURE;
+    }
+    key->dims[key->rank].n = n;
+    key->dims[key->rank].is = is;
+    key->dims[key->rank].os = os;
+    key->rank++;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+errno_t fft_plankey_addhowmany(
+    FFT_PLANKEY *key,
+    int          n,
+    int          is,
+    int          os
+)
+{
+    if(key->howmany_rank >= FFT_PLANCACHE_MAXRANK)
+    {
+        PRINT_ERROR("howmany rank exceeds %d", FFT_PLANCACHE_MAXRANK);
+        return RETURN_FAILURE;
+    }
+    key->howmany_dims[key->howmany_rank].n = n;
+    key->howmany_dims[key->howmany_rank].is = is;
+    key->howmany_dims[key->howmany_rank].os = os;
+    key->howmany_rank++;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+
+/**
+ * @brief Add dims and howmany dims of a transform over the axes in axismask
+ *
+ * Array of naxis axes with logical (real) sizes size[], size[0] fastest,
+ * contiguous in memory. Bit a of axismask selects axis a for the transform,
+ * other axes are batched, adjacent contiguous ones merged into one howmany
+ * dimension. For R2C / C2R keys, the fastest selected axis holds size/2+1
+ * complex elements on the complex side.
+ *
+ * First howmany dimension is the one fft_batch splits across threads:
+ * columns below the transform if axis 0 is not transformed, slowest batch
+ * axis otherwise.
+ */
+errno_t fft_plankey_addaxes(
+    FFT_PLANKEY *key,
+    int          naxis,
+    const long  *size,
+    int          axismask
+)
+{
+    long istride[FFT_PLANCACHE_MAXRANK];
+    long ostride[FFT_PLANCACHE_MAXRANK];
+    long is = 1;
+    long os = 1;
+    int  axishalf = -1;
+    int  NBgroup = 0;
+    long groupn[FFT_PLANCACHE_MAXRANK];
+    long groupis[FFT_PLANCACHE_MAXRANK];
+    long groupos[FFT_PLANCACHE_MAXRANK];
+
+    if((naxis < 1) || (naxis > FFT_PLANCACHE_MAXRANK) || (axismask <= 0)
+            || (axismask >= (1 << naxis)))
+    {
+        PRINT_ERROR("invalid axis mask %d for %d axes", axismask, naxis);
+        return RETURN_FAILURE;
+    }
+
+    if((key->kind == FFT_KIND_R2C) || (key->kind == FFT_KIND_C2R))
+    {
+        for(axishalf = 0; ((axismask >> axishalf) & 1) == 0; axishalf++) {}
+    }
+
+    for(int a = 0; a < naxis; a++)
+    {
+        long nc = (a == axishalf) ? size[a] / 2 + 1 : size[a];
+
+        istride[a] = is;
+        ostride[a] = os;
+        is *= (key->kind == FFT_KIND_C2R) ? nc : size[a];
+        os *= (key->kind == FFT_KIND_R2C) ? nc : size[a];
+    }
+
+    // transform dims, slowest first
+    for(int a = naxis - 1; a >= 0; a--)
+    {
+        if((axismask >> a) & 1)
+        {
+            if(fft_plankey_adddim(key, size[a], istride[a], ostride[a]) != RETURN_SUCCESS)
+            {
+                return RETURN_FAILURE;
+            }
+        }
+    }
+
+    // batch axes, fastest first, contiguous neighbours merged
+    for(int a = 0; a < naxis; a++)
+    {
+        if((axismask >> a) & 1)
+        {
+            continue;
+        }
+        if((NBgroup > 0)
+                && (((axismask >> (a - 1)) & 1) == 0)
+                && (istride[a] == groupn[NBgroup - 1] * groupis[NBgroup - 1])
+                && (ostride[a] == groupn[NBgroup - 1] * groupos[NBgroup - 1]))
+        {
+            groupn[NBgroup - 1] *= size[a];
+            continue;
+        }
+        groupn[NBgroup] = size[a];
+        groupis[NBgroup] = istride[a];
+        groupos[NBgroup] = ostride[a];
+        NBgroup++;
+    }
+
+    if((axismask & 1) == 0)
+    {
+        fft_plankey_addhowmany(key, groupn[0], groupis[0], groupos[0]);
+        for(int g = NBgroup - 1; g > 0; g--)
+        {
+            fft_plankey_addhowmany(key, groupn[g], groupis[g], groupos[g]);
+        }
+    }
+    else
+    {
+        for(int g = NBgroup - 1; g >= 0; g--)
+        {
+            fft_plankey_addhowmany(key, groupn[g], groupis[g], groupos[g]);
+        }
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// caller must hold planner_mutex
+static void fft_plancache_initthreads()
+{
+    if(fftwthreads_init == 1)
+    {
+        return;
+    }
+    if((fftw_init_threads() == 0) || (fftwf_init_threads() == 0))
+    {
+        PRINT_ERROR("FFTW threads initialization failed");
+    }
+#ifdef HAVE_FFTW_THREADS_CALLBACK
+    // FFTW threads run on the fft worker pool
+    fftw_threads_set_callback(fft_workerpool_fftwloop, NULL);
+    fftwf_threads_set_callback(fft_workerpool_fftwloop, NULL);
+#endif
+    fftwthreads_init = 1;
+}
+
+
+
+
+/**
+ * @brief Lock FFTW planner
+ *
+ * Any call to the FFTW planner or wisdom functions outside this file
+ * must be done while holding the lock.
+ * FFTW threads are initialized on first lock, as they must be before
+ * wisdom is imported.
+ */
+void fft_plancache_plannerlock()
+{
+    pthread_mutex_lock(&planner_mutex);
+    fft_plancache_initthreads();
+}
+
+void fft_plancache_plannerunlock()
+{
+    pthread_mutex_unlock(&planner_mutex);
+}
+
+
+
+
+static int fft_plankey_equal(
+    const FFT_PLANKEY *k1,
+    const FFT_PLANKEY *k2
+)
+{
+    if((k1->precision != k2->precision)
+            || (k1->kind != k2->kind)
+            || (k1->sign != k2->sign)
+            || (k1->rank != k2->rank)
+            || (k1->howmany_rank != k2->howmany_rank)
+            || (k1->nthreads != k2->nthreads)
+            || (k1->inplace != k2->inplace)
+            || (k1->align_in != k2->align_in)
+            || (k1->align_out != k2->align_out))
+    {
+        return 0;
+    }
+
+    for(int i = 0; i < k1->rank; i++)
+    {
+        if((k1->dims[i].n != k2->dims[i].n)
+                || (k1->dims[i].is != k2->dims[i].is)
+                || (k1->dims[i].os != k2->dims[i].os)
+                || (k1->r2rkind[i] != k2->r2rkind[i]))
+        {
+            return 0;
+        }
+    }
+
+    for(int i = 0; i < k1->howmany_rank; i++)
+    {
+        if((k1->howmany_dims[i].n != k2->howmany_dims[i].n)
+                || (k1->howmany_dims[i].is != k2->howmany_dims[i].is)
+                || (k1->howmany_dims[i].os != k2->howmany_dims[i].os))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+
+
+/**
+ * @brief Set FFTW r2r kind (FFTW_REDFT10, FFTW_RODFT00 ...) of transform dim
+ *
+ * dim is the index in key dims (slowest first)
+ */
+errno_t fft_plankey_setr2rkind(
+    FFT_PLANKEY *key,
+    int          dim,
+    int          r2rkind
+)
+{
+    if((dim < 0) || (dim >= key->rank)
+            || (r2rkind < FFTW_R2HC) || (r2rkind > FFTW_RODFT11))
+    {
+        PRINT_ERROR("invalid r2r kind %d for dim %d", r2rkind, dim);
+        return RETURN_FAILURE;
+    }
+    key->r2rkind[dim] = r2rkind;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Set in-place flag, alignment and number of threads of key
+ */
+void fft_plankey_setarrays(
+    FFT_PLANKEY *key,
+    void        *in,
+    void        *out
+)
+{
+    key->inplace = (in == out) ? 1 : 0;
+
+    if(key->nthreads < 1)
+    {
+        key->nthreads = fft_planpolicy_nthreads(key);
+    }
+
+    if(key->precision == FFT_PRECISION_SINGLE)
+    {
+        key->align_in = fftwf_alignment_of((float *) in);
+        key->align_out = fftwf_alignment_of((float *) out);
+    }
+    else
+    {
+        key->align_in = fftw_alignment_of((double *) in);
+        key->align_out = fftw_alignment_of((double *) out);
+    }
+}
+
+
+
+
+// caller must hold plancache_rwlock
+static FFT_PLANCACHE_ENTRY *fft_plancache_lookup(
+    const FFT_PLANKEY *key
+)
+{
+    for(int i = 0; i < FFT_PLANCACHE_MAXNB; i++)
+    {
+        if(plancache[i].used == 1)
+        {
+            if(fft_plankey_equal(&plancache[i].key, key) == 1)
+            {
+                return &plancache[i];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+
+
+/**
+ * @brief Release FFTW threads, worker pool, plans and wisdom
+ *
+ * Threads do not survive fork(): must be called before forking processes
+ * that run FFTs.
+ * Threads and wisdom are initialized again on next plan request, and the
+ * worker pool is started again on next use, in parent and child.
+ */
+errno_t fft_plancache_cleanupthreads()
+{
+    fft_plancache_bgstop();
+    fft_plancache_flush();
+
+    pthread_mutex_lock(&planner_mutex);
+    if(fftwthreads_init == 1)
+    {
+        fftw_cleanup_threads();
+        fftwf_cleanup_threads();
+        fftwthreads_init = 0;
+    }
+    pthread_mutex_unlock(&planner_mutex);
+
+    // a child would inherit a running pool without workers
+    fft_workerpool_stop();
+
+    fft_wisdom_unload(FFT_PRECISION_SINGLE);
+    fft_wisdom_unload(FFT_PRECISION_DOUBLE);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+static void *fft_plancache_create(
+    const FFT_PLANKEY *key,
+    void              *in,
+    void              *out,
+    unsigned           flags,
+    double             timelimit
+)
+{
+    void *plan = NULL;
+
+    int   nthreads = (key->nthreads > 0) ? key->nthreads : 1;
+
+    fftw_r2r_kind r2rkind[FFT_PLANCACHE_MAXRANK];
+    for(int i = 0; i < key->rank; i++)
+    {
+        r2rkind[i] = (fftw_r2r_kind) key->r2rkind[i];
+    }
+
+    // first plan request for this precision: import wisdom
+    fft_wisdom_load(key->precision);
+
+    pthread_mutex_lock(&planner_mutex);
+
+    fft_plancache_initthreads();
+
+    if(key->precision == FFT_PRECISION_SINGLE)
+    {
+        fftwf_set_timelimit(timelimit);
+        fftwf_plan_with_nthreads(nthreads);
+    }
+    else
+    {
+        fftw_set_timelimit(timelimit);
+        fftw_plan_with_nthreads(nthreads);
+    }
+
+    if(key->precision == FFT_PRECISION_SINGLE)
+    {
+        switch(key->kind)
+        {
+            case FFT_KIND_C2C:
+                plan = fftwf_plan_guru_dft(key->rank, key->dims,
+                                           key->howmany_rank, key->howmany_dims,
+                                           (fftwf_complex *) in, (fftwf_complex *) out,
+                                           key->sign, flags);
+                break;
+
+            case FFT_KIND_R2C:
+                plan = fftwf_plan_guru_dft_r2c(key->rank, key->dims,
+                                               key->howmany_rank, key->howmany_dims,
+                                               (float *) in, (fftwf_complex *) out,
+                                               flags);
+                break;
+
+            case FFT_KIND_C2R:
+                plan = fftwf_plan_guru_dft_c2r(key->rank, key->dims,
+                                               key->howmany_rank, key->howmany_dims,
+                                               (fftwf_complex *) in, (float *) out,
+                                               flags);
+                break;
+
+            case FFT_KIND_R2R:
+                plan = fftwf_plan_guru_r2r(key->rank, key->dims,
+                                           key->howmany_rank, key->howmany_dims,
+                                           (float *) in, (float *) out,
+                                           r2rkind, flags);
+                break;
+
+            case FFT_KIND_C2C_SPLIT:
+                plan = fftwf_plan_guru_split_dft(key->rank, key->dims,
+                                                 key->howmany_rank, key->howmany_dims,
+                                                 (float *) in, (float *) in + key->splitoffset_in,
+                                                 (float *) out, (float *) out + key->splitoffset_out,
+                                                 flags);
+                break;
+        }
+    }
+    else
+    {
+        switch(key->kind)
+        {
+            case FFT_KIND_C2C:
+                plan = fftw_plan_guru_dft(key->rank, key->dims,
+                                          key->howmany_rank, key->howmany_dims,
+                                          (fftw_complex *) in, (fftw_complex *) out,
+                                          key->sign, flags);
+                break;
+
+            case FFT_KIND_R2C:
+                plan = fftw_plan_guru_dft_r2c(key->rank, key->dims,
+                                              key->howmany_rank, key->howmany_dims,
+                                              (double *) in, (fftw_complex *) out,
+                                              flags);
+                break;
+
+            case FFT_KIND_C2R:
+                plan = fftw_plan_guru_dft_c2r(key->rank, key->dims,
+                                              key->howmany_rank, key->howmany_dims,
+                                              (fftw_complex *) in, (double *) out,
+                                              flags);
+                break;
+
+            case FFT_KIND_R2R:
+                plan = fftw_plan_guru_r2r(key->rank, key->dims,
+                                          key->howmany_rank, key->howmany_dims,
+                                          (double *) in, (double *) out,
+                                          r2rkind, flags);
+                break;
+
+            case FFT_KIND_C2C_SPLIT:
+                plan = fftw_plan_guru_split_dft(key->rank, key->dims,
+                                                key->howmany_rank, key->howmany_dims,
+                                                (double *) in, (double *) in + key->splitoffset_in,
+                                                (double *) out, (double *) out + key->splitoffset_out,
+                                                flags);
+                break;
+        }
+    }
+
+    pthread_mutex_unlock(&planner_mutex);
+
+    return plan;
+}
+
+
+
+
+void fft_plancache_destroyplan(
+    int   precision,
+    void *plan
+)
+{
+    pthread_mutex_lock(&planner_mutex);
+    if(precision == FFT_PRECISION_SINGLE)
+    {
+        fftwf_destroy_plan((fftwf_plan) plan);
+    }
+    else
+    {
+        fftw_destroy_plan((fftw_plan) plan);
+    }
+    pthread_mutex_unlock(&planner_mutex);
+}
+
+
+
+
+static void fft_plancache_run(
+    const FFT_PLANKEY *key,
+    void              *plan,
+    void              *in,
+    void              *out
+)
+{
+    if(key->precision == FFT_PRECISION_SINGLE)
+    {
+        switch(key->kind)
+        {
+            case FFT_KIND_C2C:
+                fftwf_execute_dft((fftwf_plan) plan,
+                                  (fftwf_complex *) in, (fftwf_complex *) out);
+                break;
+
+            case FFT_KIND_R2C:
+                fftwf_execute_dft_r2c((fftwf_plan) plan,
+                                      (float *) in, (fftwf_complex *) out);
+                break;
+
+            case FFT_KIND_C2R:
+                fftwf_execute_dft_c2r((fftwf_plan) plan,
+                                      (fftwf_complex *) in, (float *) out);
+                break;
+
+            case FFT_KIND_R2R:
+                fftwf_execute_r2r((fftwf_plan) plan, (float *) in, (float *) out);
+                break;
+
+            case FFT_KIND_C2C_SPLIT:
+                fftwf_execute_split_dft((fftwf_plan) plan,
+                                        (float *) in, (float *) in + key->splitoffset_in,
+                                        (float *) out, (float *) out + key->splitoffset_out);
+                break;
+        }
+    }
+    else
+    {
+        switch(key->kind)
+        {
+            case FFT_KIND_C2C:
+                fftw_execute_dft((fftw_plan) plan,
+                                 (fftw_complex *) in, (fftw_complex *) out);
+                break;
+
+            case FFT_KIND_R2C:
+                fftw_execute_dft_r2c((fftw_plan) plan,
+                                     (double *) in, (fftw_complex *) out);
+                break;
+
+            case FFT_KIND_C2R:
+                fftw_execute_dft_c2r((fftw_plan) plan,
+                                     (fftw_complex *) in, (double *) out);
+                break;
+
+            case FFT_KIND_R2R:
+                fftw_execute_r2r((fftw_plan) plan, (double *) in, (double *) out);
+                break;
+
+            case FFT_KIND_C2C_SPLIT:
+                fftw_execute_split_dft((fftw_plan) plan,
+                                       (double *) in, (double *) in + key->splitoffset_in,
+                                       (double *) out, (double *) out + key->splitoffset_out);
+                break;
+        }
+    }
+}
+
+
+
+
+// number of elements spanned by guru dims
+// ncomplexlast = 1 if last dimension holds n/2+1 complex elements
+static size_t fft_plankey_extent(
+    const FFT_PLANKEY *key,
+    int                output,
+    int                ncomplexlast
+)
+{
+    size_t extent = 1;
+
+    for(int i = 0; i < key->rank; i++)
+    {
+        long n = key->dims[i].n;
+        long stride = (output == 1) ? key->dims[i].os : key->dims[i].is;
+
+        if((ncomplexlast == 1) && (i == key->rank - 1))
+        {
+            n = n / 2 + 1;
+        }
+        extent += (n - 1) * labs(stride);
+    }
+    for(int i = 0; i < key->howmany_rank; i++)
+    {
+        long stride = (output == 1) ? key->howmany_dims[i].os :
+                      key->howmany_dims[i].is;
+
+        extent += (key->howmany_dims[i].n - 1) * labs(stride);
+    }
+
+    return extent;
+}
+
+
+
+
+/**
+ * @brief Allocate scratch arrays for planning transform key
+ *
+ * Arrays have the same alignment and in-place layout as the arrays the
+ * plan will be executed on. Free *inbase and *outbase with fftw_free.
+ * For in-place transforms, *outbase is NULL.
+ */
+errno_t fft_plankey_scratch(
+    const FFT_PLANKEY *key,
+    void             **inbase,
+    void             **outbase,
+    void             **in,
+    void             **out
+)
+{
+    size_t realsize = (key->precision == FFT_PRECISION_SINGLE) ? sizeof(
+                          float) : sizeof(double);
+    size_t insize;
+    size_t outsize;
+
+    if(key->kind == FFT_KIND_C2C_SPLIT)
+    {
+        // real/imaginary offset of caller arrays cannot be reproduced
+        return RETURN_FAILURE;
+    }
+
+    switch(key->kind)
+    {
+        case FFT_KIND_R2C:
+            insize = realsize * fft_plankey_extent(key, 0, 0);
+            outsize = 2 * realsize * fft_plankey_extent(key, 1, 1);
+            break;
+
+        case FFT_KIND_C2R:
+            insize = 2 * realsize * fft_plankey_extent(key, 0, 1);
+            outsize = realsize * fft_plankey_extent(key, 1, 0);
+            break;
+
+        case FFT_KIND_R2R:
+            insize = realsize * fft_plankey_extent(key, 0, 0);
+            outsize = realsize * fft_plankey_extent(key, 1, 0);
+            break;
+
+        default:
+            insize = 2 * realsize * fft_plankey_extent(key, 0, 0);
+            outsize = 2 * realsize * fft_plankey_extent(key, 1, 0);
+            break;
+    }
+
+    *outbase = NULL;
+    if(key->inplace == 1)
+    {
+        if(outsize > insize)
+        {
+            insize = outsize;
+        }
+    }
+    else
+    {
+        *outbase = fftw_malloc(outsize + 64);
+        if(*outbase == NULL)
+        {
+            return RETURN_FAILURE;
+        }
+    }
+
+    *inbase = fftw_malloc(insize + 64);
+    if(*inbase == NULL)
+    {
+        fftw_free(*outbase);
+        return RETURN_FAILURE;
+    }
+    memset(*inbase, 0, insize + 64);
+
+    *in = (char *) *inbase + key->align_in;
+    if(key->inplace == 1)
+    {
+        *out = *in;
+    }
+    else
+    {
+        memset(*outbase, 0, outsize + 64);
+        *out = (char *) *outbase + key->align_out;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// caller must hold plancache_rwlock for writing
+// returns free slot, evicting least recently used entry if table is full
+// evicted plan is returned in *oldplan (NULL if none), for the caller to
+// destroy after releasing the lock
+static FFT_PLANCACHE_ENTRY *fft_plancache_freeslot(
+    void **oldplan,
+    int   *oldprecision
+)
+{
+    int islot = 0;
+
+    *oldplan = NULL;
+    for(int i = 0; i < FFT_PLANCACHE_MAXNB; i++)
+    {
+        if(plancache[i].used == 0)
+        {
+            return &plancache[i];
+        }
+        if(__atomic_load_n(&plancache[i].lastuse, __ATOMIC_RELAXED)
+                < __atomic_load_n(&plancache[islot].lastuse, __ATOMIC_RELAXED))
+        {
+            islot = i;
+        }
+    }
+
+    *oldplan = plancache[islot].plan;
+    *oldprecision = plancache[islot].key.precision;
+    plancache[islot].plan = NULL;
+    plancache[islot].used = 0;
+
+    return &plancache[islot];
+}
+
+
+
+
+// create plan and insert it in cache, unless already there
+static errno_t fft_plancache_insertplan(
+    FFT_PLANKEY *key,
+    void        *in,
+    void        *out,
+    unsigned     flags,
+    double       timelimit
+)
+{
+    FFT_PLANCACHE_ENTRY *entry;
+    void *oldplan;
+    int   oldprecision = key->precision;
+
+    pthread_rwlock_rdlock(&plancache_rwlock);
+    entry = fft_plancache_lookup(key);
+    pthread_rwlock_unlock(&plancache_rwlock);
+    if(entry != NULL)
+    {
+        return RETURN_SUCCESS;
+    }
+
+
+    // new geometry: plan outside of table lock
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    void *plan = fft_plancache_create(key, in, out, flags, timelimit);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if(plan == NULL)
+    {
+        return RETURN_FAILURE;
+    }
+
+
+    pthread_rwlock_wrlock(&plancache_rwlock);
+    entry = fft_plancache_lookup(key);
+    if(entry == NULL)
+    {
+        // not inserted by another thread in the meantime
+        entry = fft_plancache_freeslot(&oldplan, &oldprecision);
+        entry->key = *key;
+        entry->plan = plan;
+        entry->flags = flags;
+        entry->nexec = 0;
+        entry->lastuse = __sync_add_and_fetch(&plancache_tick, 1);
+        entry->plantime = 1.0 * (t1.tv_sec - t0.tv_sec) + 1.0e-9 * (t1.tv_nsec -
+                          t0.tv_nsec);
+        entry->used = 1;
+    }
+    else
+    {
+        oldplan = plan;
+    }
+    pthread_rwlock_unlock(&plancache_rwlock);
+
+    if(oldplan != NULL)
+    {
+        fft_plancache_destroyplan(oldprecision, oldplan);
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Create plan for key on private scratch arrays
+ *
+ * Plan is not inserted in cache. Caller arrays are never touched,
+ * whatever the planning mode.
+ */
+void *fft_plancache_scratchplan(
+    const FFT_PLANKEY *key,
+    unsigned           flags,
+    double             timelimit,
+    double            *plantime
+)
+{
+    void *inbase, *outbase;
+    void *in, *out;
+
+    if(fft_plankey_scratch(key, &inbase, &outbase, &in, &out) != RETURN_SUCCESS)
+    {
+        PRINT_ERROR("Cannot allocate FFTW planning arrays");
+        return NULL;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    void *plan = fft_plancache_create(key, in, out, flags, timelimit);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    *plantime = 1.0 * (t1.tv_sec - t0.tv_sec) + 1.0e-9 * (t1.tv_nsec - t0.tv_nsec);
+
+    fftw_free(inbase);
+    fftw_free(outbase);
+
+    return plan;
+}
+
+
+
+
+// store plan in cache, replacing the existing plan for key if any
+static void fft_plancache_store(
+    const FFT_PLANKEY *key,
+    void              *plan,
+    unsigned           flags,
+    double             plantime
+)
+{
+    FFT_PLANCACHE_ENTRY *entry;
+    void *oldplan;
+    int   oldprecision = key->precision;
+
+    pthread_rwlock_wrlock(&plancache_rwlock);
+    entry = fft_plancache_lookup(key);
+    if(entry == NULL)
+    {
+        entry = fft_plancache_freeslot(&oldplan, &oldprecision);
+        entry->key = *key;
+        entry->nexec = 0;
+        entry->lastuse = __sync_add_and_fetch(&plancache_tick, 1);
+        entry->used = 1;
+    }
+    else
+    {
+        // no transform can be running on the old plan once unlinked
+        oldplan = entry->plan;
+    }
+    entry->plan = plan;
+    entry->flags = flags;
+    entry->plantime = plantime;
+    pthread_rwlock_unlock(&plancache_rwlock);
+
+    if(oldplan != NULL)
+    {
+        fft_plancache_destroyplan(oldprecision, oldplan);
+    }
+}
+
+
+
+
+// background planning stop requested, bgqueue_mutex not held
+static int fft_plancache_bgstopping()
+{
+    int stop;
+
+    pthread_mutex_lock(&bgqueue_mutex);
+    stop = bgthread_stop;
+    pthread_mutex_unlock(&bgqueue_mutex);
+
+    return stop;
+}
+
+
+
+
+/**
+ * @brief Optimize plan on scratch arrays and swap it into cache
+ *
+ * Planning is done in slices of increasing time limit, the FFTW planner
+ * being released between slices. Optimization is complete when the plan
+ * can be created from wisdom alone. It stops when the planning policy time
+ * limit is spent: the plan of the last slice is then used.
+ * Returns 1 if a plan was stored (new wisdom to export), 0 otherwise.
+ */
+static int fft_plancache_upgrade(
+    FFT_PLANKEY *key
+)
+{
+    FFT_PLANCACHE_ENTRY *entry;
+    unsigned flags;
+    double   timelimit;
+    double   plantime = 0.0;
+    double   slice = FFT_PLANCACHE_BGSLICE0;
+    void    *plan = NULL;
+
+    fft_planpolicy_get(key, &flags, &timelimit);
+    if(timelimit <= 0.0)
+    {
+        timelimit = FFT_PLANCACHE_BGMAXTIME;
+    }
+
+    pthread_rwlock_rdlock(&plancache_rwlock);
+    entry = fft_plancache_lookup(key);
+    if((entry != NULL) && (entry->flags == flags))
+    {
+        // already upgraded
+        pthread_rwlock_unlock(&plancache_rwlock);
+        return 0;
+    }
+    pthread_rwlock_unlock(&plancache_rwlock);
+
+    while(1)
+    {
+        double slicetime;
+
+        plan = fft_plancache_scratchplan(key, flags | FFTW_WISDOM_ONLY,
+                                         FFTW_NO_TIMELIMIT, &slicetime);
+        plantime += slicetime;
+        if(plan != NULL)
+        {
+            break;
+        }
+
+        if(slice > timelimit - plantime)
+        {
+            // FFTW: zero time limit plans at once, negative is no limit
+            slice = (timelimit > plantime) ? timelimit - plantime : 0.0;
+        }
+        plan = fft_plancache_scratchplan(key, flags, slice, &slicetime);
+        plantime += slicetime;
+        if(plan == NULL)
+        {
+            return 0;
+        }
+        if((plantime >= timelimit) || (fft_plancache_bgstopping() == 1))
+        {
+            break;
+        }
+        fft_plancache_destroyplan(key->precision, plan);
+        plan = NULL;
+
+        slice *= 2.0;
+        if(slice > FFT_PLANCACHE_BGSLICEMAX)
+        {
+            slice = FFT_PLANCACHE_BGSLICEMAX;
+        }
+    }
+
+    fft_plancache_store(key, plan, flags, plantime);
+
+    return 1;
+}
+
+
+
+
+static void *fft_plancache_bgthread(
+    __attribute__((unused)) void *arg
+)
+{
+    FFT_PLANKEY key;
+    int newwisdom = 0;
+
+    while(1)
+    {
+        pthread_mutex_lock(&bgqueue_mutex);
+        if((bgqueue_NB == 0) && (newwisdom == 1))
+        {
+            // queue drained: export once for all plans optimized
+            pthread_mutex_unlock(&bgqueue_mutex);
+            export_wisdom();
+            newwisdom = 0;
+            continue;
+        }
+        while((bgqueue_NB == 0) && (bgthread_stop == 0))
+        {
+            pthread_cond_wait(&bgqueue_cond, &bgqueue_mutex);
+        }
+        if(bgthread_stop == 1)
+        {
+            pthread_mutex_unlock(&bgqueue_mutex);
+            if(newwisdom == 1)
+            {
+                export_wisdom();
+            }
+            break;
+        }
+        key = bgqueue[bgqueue_first];
+        bgqueue_first = (bgqueue_first + 1) % FFT_PLANCACHE_MAXNB;
+        bgqueue_NB--;
+        pthread_mutex_unlock(&bgqueue_mutex);
+
+        if(fft_plancache_upgrade(&key) == 1)
+        {
+            newwisdom = 1;
+        }
+    }
+
+    return NULL;
+}
+
+
+
+
+// queue key for background optimization, start planner thread if needed
+static errno_t fft_plancache_bgqueue(
+    const FFT_PLANKEY *key
+)
+{
+    pthread_mutex_lock(&bgqueue_mutex);
+
+    if(bgthread_running == 0)
+    {
+        bgthread_stop = 0;
+        if(pthread_create(&bgthread, NULL, fft_plancache_bgthread, NULL) != 0)
+        {
+            pthread_mutex_unlock(&bgqueue_mutex);
+            PRINT_ERROR("Cannot start FFTW background planner thread");
+            return RETURN_FAILURE;
+        }
+        bgthread_running = 1;
+    }
+
+    if(bgqueue_NB == FFT_PLANCACHE_MAXNB)
+    {
+        // queue full: key will be queued again on its next new insertion
+        pthread_mutex_unlock(&bgqueue_mutex);
+        return RETURN_FAILURE;
+    }
+    bgqueue[(bgqueue_first + bgqueue_NB) % FFT_PLANCACHE_MAXNB] = *key;
+    bgqueue_NB++;
+
+    pthread_cond_signal(&bgqueue_cond);
+    pthread_mutex_unlock(&bgqueue_mutex);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Stop background planner thread
+ *
+ * Waits for the current planning slice to complete: the best plan found so
+ * far is stored. Pending requests are dropped.
+ */
+errno_t fft_plancache_bgstop()
+{
+    pthread_mutex_lock(&bgqueue_mutex);
+    if(bgthread_running == 0)
+    {
+        pthread_mutex_unlock(&bgqueue_mutex);
+        return RETURN_SUCCESS;
+    }
+    bgthread_stop = 1;
+    bgqueue_NB = 0;
+    pthread_cond_signal(&bgqueue_cond);
+    pthread_mutex_unlock(&bgqueue_mutex);
+
+    pthread_join(bgthread, NULL);
+
+    pthread_mutex_lock(&bgqueue_mutex);
+    bgthread_running = 0;
+    pthread_mutex_unlock(&bgqueue_mutex);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Make sure a plan exists in cache for key, without touching arrays
+ *
+ * Planning mode is set by fft_planpolicy. If it is not FFTW_ESTIMATE,
+ * the plan can only be created from wisdom, as measuring would overwrite
+ * arrays in and out.
+ * In background planning mode, a FFTW_ESTIMATE plan is used meanwhile,
+ * and optimization is queued to the planner thread.
+ * Returns RETURN_FAILURE if no plan could be created : fft_plancache_optimize
+ * must then be called.
+ */
+errno_t fft_plancache_plan(
+    FFT_PLANKEY *key,
+    void        *in,
+    void        *out
+)
+{
+    unsigned flags;
+    double   timelimit;
+
+    fft_plankey_setarrays(key, in, out);
+    fft_planpolicy_get(key, &flags, &timelimit);
+
+    if(flags & FFTW_ESTIMATE)
+    {
+        return fft_plancache_insertplan(key, in, out, flags, timelimit);
+    }
+
+    if(fft_plancache_insertplan(key, in, out, flags | FFTW_WISDOM_ONLY,
+                                timelimit) == RETURN_SUCCESS)
+    {
+        return RETURN_SUCCESS;
+    }
+
+    if(key->kind == FFT_KIND_C2C_SPLIT)
+    {
+        // no scratch planning: see fft_plankey_scratch
+        return fft_plancache_insertplan(key, in, out, FFTW_ESTIMATE, timelimit);
+    }
+
+    if(fft_planpolicy_background() == 1)
+    {
+        if(fft_plancache_insertplan(key, in, out, FFTW_ESTIMATE,
+                                    timelimit) != RETURN_SUCCESS)
+        {
+            return RETURN_FAILURE;
+        }
+        fft_plancache_bgqueue(key);
+        return RETURN_SUCCESS;
+    }
+
+    return RETURN_FAILURE;
+}
+
+
+
+
+/**
+ * @brief Create plan for key with the full planning mode
+ *
+ * Planning is done on private scratch arrays with the same alignment as
+ * in and out, which are only used to set the key.
+ * New wisdom is exported.
+ */
+errno_t fft_plancache_optimize(
+    FFT_PLANKEY *key,
+    void        *in,
+    void        *out
+)
+{
+    FFT_PLANCACHE_ENTRY *entry;
+    unsigned flags;
+    double   timelimit;
+    double   plantime;
+
+    fft_plankey_setarrays(key, in, out);
+    fft_planpolicy_get(key, &flags, &timelimit);
+
+    pthread_rwlock_rdlock(&plancache_rwlock);
+    entry = fft_plancache_lookup(key);
+    pthread_rwlock_unlock(&plancache_rwlock);
+    if(entry != NULL)
+    {
+        return RETURN_SUCCESS;
+    }
+
+    printf("New FFT size [");
+    for(int i = key->rank - 1; i >= 0; i--)
+    {
+        printf("%d%s", key->dims[i].n, (i == 0) ? "" : " x ");
+    }
+    printf("]: optimizing ...");
+    fflush(stdout);
+
+    void *plan = fft_plancache_scratchplan(key, flags, timelimit, &plantime);
+    printf("\n");
+    if(plan == NULL)
+    {
+        return RETURN_FAILURE;
+    }
+    fft_plancache_store(key, plan, flags, plantime);
+
+    export_wisdom();
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Execute transform described by key on arrays in and out
+ *
+ * Plan is taken from cache, or created and inserted on first use.
+ * Arrays in and out are not touched by planning.
+ * Returns RETURN_FAILURE if no plan could be created.
+ */
+errno_t fft_plancache_execute(
+    FFT_PLANKEY *key,
+    void        *in,
+    void        *out
+)
+{
+    FFT_PLANCACHE_ENTRY *entry;
+
+    fft_plankey_setarrays(key, in, out);
+
+    pthread_rwlock_rdlock(&plancache_rwlock);
+    entry = fft_plancache_lookup(key);
+    while(entry == NULL)
+    {
+        pthread_rwlock_unlock(&plancache_rwlock);
+        if(fft_plancache_plan(key, in, out) != RETURN_SUCCESS)
+        {
+            if(fft_plancache_optimize(key, in, out) != RETURN_SUCCESS)
+            {
+                PRINT_ERROR("Cannot create FFTW plan");
+                return RETURN_FAILURE;
+            }
+        }
+        // entry may have been evicted in between: look it up again
+        pthread_rwlock_rdlock(&plancache_rwlock);
+        entry = fft_plancache_lookup(key);
+    }
+
+    fft_plancache_run(key, entry->plan, in, out);
+    __sync_fetch_and_add(&entry->nexec, 1);
+    // concurrent transforms hold the read lock only
+    __atomic_store_n(&entry->lastuse, __sync_add_and_fetch(&plancache_tick, 1),
+                     __ATOMIC_RELAXED);
+    pthread_rwlock_unlock(&plancache_rwlock);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Whether a plan for key on arrays in and out is in cache
+ *
+ * Does not plan, and does not count as a use of the cached plan.
+ */
+int fft_plancache_cached(
+    FFT_PLANKEY *key,
+    void        *in,
+    void        *out
+)
+{
+    int cached;
+
+    fft_plankey_setarrays(key, in, out);
+
+    pthread_rwlock_rdlock(&plancache_rwlock);
+    cached = (fft_plancache_lookup(key) != NULL) ? 1 : 0;
+    pthread_rwlock_unlock(&plancache_rwlock);
+
+    return cached;
+}
+
+
+
+
+errno_t fft_plancache_list()
+{
+    const char *kindstr[] = {"C2C", "R2C", "C2R", "R2R", "C2CS"};
+    long NBentry = 0;
+
+    pthread_rwlock_rdlock(&plancache_rwlock);
+
+    printf("%4s  %c  %-4s %4s  %-24s %-16s %3s %5s %3s %-10s %10s %10s\n",
+           "slot", 'P', "kind", "dir", "dims", "howmany", "ip", "align", "thr", "mode",
+           "nexec", "plan[ms]");
+
+    for(int i = 0; i < FFT_PLANCACHE_MAXNB; i++)
+    {
+        if(plancache[i].used == 1)
+        {
+            FFT_PLANKEY *key = &plancache[i].key;
+            char dimstr[STRINGMAXLEN_DEFAULT];
+            char howmanystr[STRINGMAXLEN_DEFAULT];
+            int  n = 0;
+
+            dimstr[0] = '\0';
+            for(int k = 0; k < key->rank; k++)
+            {
+                n += snprintf(dimstr + n, STRINGMAXLEN_DEFAULT - n, "%s%d",
+                              (k == 0) ? "" : "x", key->dims[k].n);
+            }
+            n = 0;
+            howmanystr[0] = '\0';
+            for(int k = 0; k < key->howmany_rank; k++)
+            {
+                n += snprintf(howmanystr + n, STRINGMAXLEN_DEFAULT - n, "%s%d",
+                              (k == 0) ? "" : "x", key->howmany_dims[k].n);
+            }
+
+            printf("%4d  %c  %-4s %4d  %-24s %-16s %3d %2d/%2d %3d %-10s %10lu %10.3f\n",
+                   i,
+                   (key->precision == FFT_PRECISION_SINGLE) ? 'F' : 'D',
+                   kindstr[key->kind],
+                   key->sign,
+                   dimstr,
+                   howmanystr,
+                   key->inplace,
+                   key->align_in, key->align_out,
+                   key->nthreads,
+                   fft_planpolicy_modename(plancache[i].flags),
+                   (unsigned long) plancache[i].nexec,
+                   plancache[i].plantime * 1000.0);
+            NBentry++;
+        }
+    }
+
+    pthread_rwlock_unlock(&plancache_rwlock);
+
+    printf("%ld plan(s) in cache\n", NBentry);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+errno_t fft_plancache_flush()
+{
+    void *oldplan[FFT_PLANCACHE_MAXNB];
+    int   oldprecision[FFT_PLANCACHE_MAXNB];
+    int   NBold = 0;
+
+    pthread_rwlock_wrlock(&plancache_rwlock);
+    for(int i = 0; i < FFT_PLANCACHE_MAXNB; i++)
+    {
+        if(plancache[i].used == 1)
+        {
+            oldplan[NBold] = plancache[i].plan;
+            oldprecision[NBold] = plancache[i].key.precision;
+            NBold++;
+            plancache[i].plan = NULL;
+            plancache[i].used = 0;
+        }
+    }
+    pthread_rwlock_unlock(&plancache_rwlock);
+
+    // unlinked plans: destroyed outside of table lock
+    for(int i = 0; i < NBold; i++)
+    {
+        fft_plancache_destroyplan(oldprecision[i], oldplan[i]);
+    }
+
+    return RETURN_SUCCESS;
+}
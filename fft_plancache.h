@@ -0,0 +1,156 @@
+/**
+ * @file    fft_plancache.h
+ *
+ */
+
+#ifndef _FFT_PLANCACHE_H
+#define _FFT_PLANCACHE_H
+
+#include <fftw3.h>
+
+
+#define FFT_PLANCACHE_MAXRANK 4
+#define FFT_PLANCACHE_MAXNB   256
+
+#define FFT_PRECISION_SINGLE  0
+#define FFT_PRECISION_DOUBLE  1
+
+#define FFT_KIND_C2C          0
+#define FFT_KIND_R2C          1
+#define FFT_KIND_C2R          2
+#define FFT_KIND_R2R          3
+#define FFT_KIND_C2C_SPLIT    4
+
+
+// Plan key
+// Transform described as FFTW guru dimensions (row-major: slowest first)
+// Strides are in units of the array element (real or complex)
+//
+typedef struct
+{
+    int        precision;
+    int        kind;
+    int        sign;
+
+    int        rank;
+    fftw_iodim dims[FFT_PLANCACHE_MAXRANK];
+
+    int        howmany_rank;
+    fftw_iodim howmany_dims[FFT_PLANCACHE_MAXRANK];
+
+    // FFTW r2r kind of each transform dim (FFT_KIND_R2R only)
+    int        r2rkind[FFT_PLANCACHE_MAXRANK];
+
+    // FFT_KIND_C2C_SPLIT only: imaginary - real array offsets, in elements
+    // in and out arrays of the key are the real parts
+    long       splitoffset_in;
+    long       splitoffset_out;
+
+    // number of FFTW threads, 0: set from fft_planpolicy on execution
+    int        nthreads;
+
+    // set by fft_plancache_execute from array pointers
+    int        inplace;
+    int        align_in;
+    int        align_out;
+} FFT_PLANKEY;
+
+
+
+void fft_plankey_init(
+    FFT_PLANKEY *key,
+    int          precision,
+    int          kind,
+    int          sign
+);
+
+errno_t fft_plankey_adddim(
+    FFT_PLANKEY *key,
+    int          n,
+    int          is,
+    int          os
+);
+
+errno_t fft_plankey_addhowmany(
+    FFT_PLANKEY *key,
+    int          n,
+    int          is,
+    int          os
+);
+
+errno_t fft_plankey_addaxes(
+    FFT_PLANKEY *key,
+    int          naxis,
+    const long  *size,
+    int          axismask
+);
+
+errno_t fft_plankey_setr2rkind(
+    FFT_PLANKEY *key,
+    int          dim,
+    int          r2rkind
+);
+
+void fft_plankey_setarrays(
+    FFT_PLANKEY *key,
+    void        *in,
+    void        *out
+);
+
+errno_t fft_plankey_scratch(
+    const FFT_PLANKEY *key,
+    void             **inbase,
+    void             **outbase,
+    void             **in,
+    void             **out
+);
+
+void fft_plancache_plannerlock();
+
+void fft_plancache_plannerunlock();
+
+errno_t fft_plancache_bgstop();
+
+errno_t fft_plancache_cleanupthreads();
+
+void *fft_plancache_scratchplan(
+    const FFT_PLANKEY *key,
+    unsigned           flags,
+    double             timelimit,
+    double            *plantime
+);
+
+void fft_plancache_destroyplan(
+    int   precision,
+    void *plan
+);
+
+errno_t fft_plancache_plan(
+    FFT_PLANKEY *key,
+    void        *in,
+    void        *out
+);
+
+errno_t fft_plancache_optimize(
+    FFT_PLANKEY *key,
+    void        *in,
+    void        *out
+);
+
+errno_t fft_plancache_execute(
+    FFT_PLANKEY *key,
+    void        *in,
+    void        *out
+);
+
+int fft_plancache_cached(
+    FFT_PLANKEY *key,
+    void        *in,
+    void        *out
+);
+
+errno_t fft_plancache_list();
+
+errno_t fft_plancache_flush();
+
+#endif
@@ -0,0 +1,702 @@
+/**
+ * @file    fft_planpolicy.c
+ * @brief   Runtime FFTW planning rigor
+ *
+ * Selects FFTW planner flags (ESTIMATE / MEASURE / PATIENT / EXHAUSTIVE),
+ * planning time limit and number of FFTW threads at runtime.
+ * A global default is applied to all transforms, unless a per-size
+ * override matches the transform dimensions.
+ *
+ * Settings are read at module load from FFTCONFIGDIR/fftplanmode.conf :
+ *
+ *     # comment
+ *     default    measure
+ *     timelimit  5.0
+ *     nthreads   0
+ *     size       120 120 patient
+ *     size       2048 2048 measure 8
+ *     size       4096 exhaustive
+ *     background 1
+ *     slicemode  auto
+ *     pool       8 4-11 80 1 256
+ *
+ * and can be changed from the CLI (fftplanmode, fftplanmodesize, fftplanbg,
+ * fftnthreads, fftnthreadssize, fftslicemode, fftpool).
+ *
+ * Number of threads, by priority :
+ * - per-call value set by the calling thread (fft_planpolicy_setcallnthreads)
+ * - per-size override
+ * - default, if > 0
+ * - automatic: one thread per FFT_PLANPOLICY_AUTOMINELEM elements,
+ *   up to the number of online CPUs
+ *
+ * With background = 1, sizes not found in wisdom run with a FFTW_ESTIMATE
+ * plan until the planner thread has optimized them (see fft_plancache.c).
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft_plancache.h"
+#include "fft_planpolicy.h"
+#include "fft_batch.h"
+#include "fft_workerpool.h"
+
+
+
+// override flags value: use default planning mode
+#define FFT_PLANPOLICY_DEFAULTFLAGS (~0U)
+
+
+typedef struct
+{
+    int      rank;
+    int      size[FFT_PLANCACHE_MAXRANK];  // image axis order: fastest first
+    unsigned flags;
+    int      nthreads;                     // 0: default
+} FFT_PLANPOLICY_OVERRIDE;
+
+
+static unsigned planpolicy_flags = FFTW_ESTIMATE;
+static double   planpolicy_timelimit = FFTW_NO_TIMELIMIT;
+static int      planpolicy_background = 0;
+static int      planpolicy_nthreads = 0;   // 0: automatic, atomic
+
+static __thread int planpolicy_callnthreads = 0;
+
+static FFT_PLANPOLICY_OVERRIDE planpolicy_override[FFT_PLANPOLICY_MAXOVERRIDE];
+static int planpolicy_NBoverride = 0;
+// number of overrides with nthreads > 0, atomic
+// 0: fft_planpolicy_nthreads does not take planpolicy_mutex
+static int planpolicy_NBnthreadsoverride = 0;
+
+static pthread_mutex_t planpolicy_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// online CPUs, read once per process
+static long planpolicy_NBcpu = 1;
+static pthread_once_t planpolicy_NBcpu_once = PTHREAD_ONCE_INIT;
+
+
+
+
+static void fft_planpolicy_NBcpu_init()
+{
+    planpolicy_NBcpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if(planpolicy_NBcpu < 1)
+    {
+        planpolicy_NBcpu = 1;
+    }
+}
+
+
+
+
+errno_t fft_planpolicy_parsemode(
+    const char *modestr,
+    unsigned   *flags
+)
+{
+    if(strcmp(modestr, "estimate") == 0)
+    {
+        *flags = FFTW_ESTIMATE;
+    }
+    else if(strcmp(modestr, "measure") == 0)
+    {
+        *flags = FFTW_MEASURE;
+    }
+    else if(strcmp(modestr, "patient") == 0)
+    {
+        *flags = FFTW_PATIENT;
+    }
+    else if(strcmp(modestr, "exhaustive") == 0)
+    {
+        *flags = FFTW_EXHAUSTIVE;
+    }
+    else
+    {
+        PRINT_ERROR("Unknown FFTW planning mode \"%s\" (estimate, measure, patient, exhaustive)",
+                    modestr);
+        return RETURN_FAILURE;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+const char *fft_planpolicy_modename(
+    unsigned flags
+)
+{
+    if(flags & FFTW_ESTIMATE)
+    {
+        return "estimate";
+    }
+    if(flags & FFTW_EXHAUSTIVE)
+    {
+        return "exhaustive";
+    }
+    if(flags & FFTW_PATIENT)
+    {
+        return "patient";
+    }
+
+    return "measure";
+}
+
+
+
+
+/**
+ * @brief Set default planning mode and time limit
+ *
+ * timelimit in second, negative for no limit.
+ * Cached plans are flushed so that new plans use the new mode.
+ */
+errno_t fft_planpolicy_set(
+    const char *modestr,
+    double      timelimit
+)
+{
+    unsigned flags;
+
+    if(fft_planpolicy_parsemode(modestr, &flags) != RETURN_SUCCESS)
+    {
+        return RETURN_FAILURE;
+    }
+
+    pthread_mutex_lock(&planpolicy_mutex);
+    planpolicy_flags = flags;
+    if(timelimit > 0.0)
+    {
+        planpolicy_timelimit = timelimit;
+    }
+    else
+    {
+        planpolicy_timelimit = FFTW_NO_TIMELIMIT;
+    }
+    pthread_mutex_unlock(&planpolicy_mutex);
+
+    fft_plancache_flush();
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// override entry for size0 x size1, created if needed
+// caller must hold planpolicy_mutex
+static FFT_PLANPOLICY_OVERRIDE *fft_planpolicy_override(
+    long size0,
+    long size1
+)
+{
+    FFT_PLANPOLICY_OVERRIDE ovr;
+    int i;
+
+    memset(&ovr, 0, sizeof(FFT_PLANPOLICY_OVERRIDE));
+    ovr.flags = FFT_PLANPOLICY_DEFAULTFLAGS;
+    ovr.size[0] = (int) size0;
+    ovr.rank = 1;
+    if(size1 > 0)
+    {
+        ovr.size[1] = (int) size1;
+        ovr.rank = 2;
+    }
+
+    for(i = 0; i < planpolicy_NBoverride; i++)
+    {
+        if((planpolicy_override[i].rank == ovr.rank)
+                && (memcmp(planpolicy_override[i].size, ovr.size, sizeof(ovr.size)) == 0))
+        {
+            return &planpolicy_override[i];
+        }
+    }
+    if(i == FFT_PLANPOLICY_MAXOVERRIDE)
+    {
+        PRINT_ERROR("Too many FFTW planning overrides (max %d)",
+                    FFT_PLANPOLICY_MAXOVERRIDE);
+        return NULL;
+    }
+    planpolicy_override[i] = ovr;
+    planpolicy_NBoverride++;
+
+    return &planpolicy_override[i];
+}
+
+
+
+
+/**
+ * @brief Set planning mode for transforms of size size0 x size1
+ *
+ * size1 = 0 for 1D transforms.
+ */
+errno_t fft_planpolicy_setsize(
+    const char *modestr,
+    long        size0,
+    long        size1
+)
+{
+    FFT_PLANPOLICY_OVERRIDE *ovr;
+    unsigned flags;
+
+    if(fft_planpolicy_parsemode(modestr, &flags) != RETURN_SUCCESS)
+    {
+        return RETURN_FAILURE;
+    }
+
+    pthread_mutex_lock(&planpolicy_mutex);
+    ovr = fft_planpolicy_override(size0, size1);
+    if(ovr != NULL)
+    {
+        ovr->flags = flags;
+    }
+    pthread_mutex_unlock(&planpolicy_mutex);
+
+    if(ovr == NULL)
+    {
+        return RETURN_FAILURE;
+    }
+
+    fft_plancache_flush();
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Set number of FFTW threads for transforms of size size0 x size1
+ *
+ * size1 = 0 for 1D transforms. nthreads = 0 to use the default.
+ * Plans are keyed by number of threads: cache is not flushed.
+ */
+errno_t fft_planpolicy_setsizenthreads(
+    long size0,
+    long size1,
+    long nthreads
+)
+{
+    FFT_PLANPOLICY_OVERRIDE *ovr;
+
+    pthread_mutex_lock(&planpolicy_mutex);
+    ovr = fft_planpolicy_override(size0, size1);
+    if(ovr != NULL)
+    {
+        int NBnthreadsoverride = 0;
+
+        ovr->nthreads = (nthreads > 0) ? (int) nthreads : 0;
+        for(int i = 0; i < planpolicy_NBoverride; i++)
+        {
+            if(planpolicy_override[i].nthreads > 0)
+            {
+                NBnthreadsoverride++;
+            }
+        }
+        __atomic_store_n(&planpolicy_NBnthreadsoverride, NBnthreadsoverride,
+                         __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&planpolicy_mutex);
+
+    if(ovr == NULL)
+    {
+        return RETURN_FAILURE;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Set default number of FFTW threads
+ *
+ * nthreads = 0 for automatic choice from transform size.
+ */
+errno_t fft_planpolicy_setnthreads(
+    long nthreads
+)
+{
+    __atomic_store_n(&planpolicy_nthreads, (nthreads > 0) ? (int) nthreads : 0,
+                     __ATOMIC_RELAXED);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Set number of FFTW threads for transforms run by calling thread
+ *
+ * Overrides all other settings until reset with nthreads = 0.
+ */
+errno_t fft_planpolicy_setcallnthreads(
+    int nthreads
+)
+{
+    planpolicy_callnthreads = (nthreads > 0) ? nthreads : 0;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// per-size override matching key, or NULL
+// caller must hold planpolicy_mutex
+static FFT_PLANPOLICY_OVERRIDE *fft_planpolicy_match(
+    const FFT_PLANKEY *key
+)
+{
+    for(int i = 0; i < planpolicy_NBoverride; i++)
+    {
+        int match = 1;
+
+        if(planpolicy_override[i].rank != key->rank)
+        {
+            continue;
+        }
+        // key dims are row-major: last dim is image axis 0
+        for(int k = 0; k < key->rank; k++)
+        {
+            if(planpolicy_override[i].size[k] != key->dims[key->rank - 1 - k].n)
+            {
+                match = 0;
+            }
+        }
+        if(match == 1)
+        {
+            return &planpolicy_override[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+
+
+/**
+ * @brief Planner flags and time limit for transform key
+ */
+errno_t fft_planpolicy_get(
+    const FFT_PLANKEY *key,
+    unsigned          *flags,
+    double            *timelimit
+)
+{
+    FFT_PLANPOLICY_OVERRIDE *ovr;
+
+    pthread_mutex_lock(&planpolicy_mutex);
+
+    *flags = planpolicy_flags;
+    *timelimit = planpolicy_timelimit;
+
+    ovr = fft_planpolicy_match(key);
+    if((ovr != NULL) && (ovr->flags != FFT_PLANPOLICY_DEFAULTFLAGS))
+    {
+        *flags = ovr->flags;
+    }
+
+    pthread_mutex_unlock(&planpolicy_mutex);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Number of FFTW threads for transform key
+ *
+ * Called for every transform: without per-size thread override, no lock
+ * and no system call.
+ */
+int fft_planpolicy_nthreads(
+    const FFT_PLANKEY *key
+)
+{
+    int nthreads;
+
+    if(planpolicy_callnthreads > 0)
+    {
+        return planpolicy_callnthreads;
+    }
+
+    nthreads = __atomic_load_n(&planpolicy_nthreads, __ATOMIC_RELAXED);
+    if(__atomic_load_n(&planpolicy_NBnthreadsoverride, __ATOMIC_ACQUIRE) > 0)
+    {
+        FFT_PLANPOLICY_OVERRIDE *ovr;
+
+        pthread_mutex_lock(&planpolicy_mutex);
+        ovr = fft_planpolicy_match(key);
+        if((ovr != NULL) && (ovr->nthreads > 0))
+        {
+            nthreads = ovr->nthreads;
+        }
+        pthread_mutex_unlock(&planpolicy_mutex);
+    }
+
+    if(nthreads == 0)
+    {
+        // automatic: small transforms single-threaded
+        double nelem = 1.0;
+        long   NBcpu;
+
+        pthread_once(&planpolicy_NBcpu_once, fft_planpolicy_NBcpu_init);
+        NBcpu = planpolicy_NBcpu;
+
+        for(int k = 0; k < key->rank; k++)
+        {
+            nelem *= key->dims[k].n;
+        }
+        for(int k = 0; k < key->howmany_rank; k++)
+        {
+            nelem *= key->howmany_dims[k].n;
+        }
+
+        nthreads = (int) (nelem / FFT_PLANPOLICY_AUTOMINELEM);
+        if(nthreads > NBcpu)
+        {
+            nthreads = (int) NBcpu;
+        }
+        if(nthreads < 1)
+        {
+            nthreads = 1;
+        }
+    }
+
+    return nthreads;
+}
+
+
+
+
+errno_t fft_planpolicy_setbackground(
+    long mode
+)
+{
+    pthread_mutex_lock(&planpolicy_mutex);
+    planpolicy_background = (mode > 0) ? 1 : 0;
+    pthread_mutex_unlock(&planpolicy_mutex);
+
+    if(mode == 0)
+    {
+        fft_plancache_bgstop();
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+int fft_planpolicy_background()
+{
+    int mode;
+
+    pthread_mutex_lock(&planpolicy_mutex);
+    mode = planpolicy_background;
+    pthread_mutex_unlock(&planpolicy_mutex);
+
+    return mode;
+}
+
+
+
+
+errno_t fft_planpolicy_loadconf()
+{
+    FILE *fp;
+    char fname[STRINGMAXLEN_FULLFILENAME];
+    char line[STRINGMAXLEN_DEFAULT];
+    long lineno = 0;
+
+    WRITE_FULLFILENAME(fname, "%s/fftplanmode.conf", FFTCONFIGDIR);
+
+    if((fp = fopen(fname, "r")) == NULL)
+    {
+        // no configuration file: keep defaults
+        return RETURN_SUCCESS;
+    }
+
+    while(fgets(line, STRINGMAXLEN_DEFAULT, fp) != NULL)
+    {
+        char keyword[100];
+        char modestr[100];
+        double timelimit;
+        long size0, size1;
+
+        lineno++;
+        if((line[0] == '#') || (sscanf(line, "%99s", keyword) != 1))
+        {
+            continue;
+        }
+
+        if(strcmp(keyword, "default") == 0)
+        {
+            if(sscanf(line, "%*s %99s", modestr) == 1)
+            {
+                pthread_mutex_lock(&planpolicy_mutex);
+                fft_planpolicy_parsemode(modestr, &planpolicy_flags);
+                pthread_mutex_unlock(&planpolicy_mutex);
+                continue;
+            }
+        }
+        else if(strcmp(keyword, "timelimit") == 0)
+        {
+            if(sscanf(line, "%*s %lf", &timelimit) == 1)
+            {
+                pthread_mutex_lock(&planpolicy_mutex);
+                planpolicy_timelimit = (timelimit > 0.0) ? timelimit : FFTW_NO_TIMELIMIT;
+                pthread_mutex_unlock(&planpolicy_mutex);
+                continue;
+            }
+        }
+        else if(strcmp(keyword, "nthreads") == 0)
+        {
+            long nthreads;
+            if(sscanf(line, "%*s %ld", &nthreads) == 1)
+            {
+                fft_planpolicy_setnthreads(nthreads);
+                continue;
+            }
+        }
+        else if(strcmp(keyword, "slicemode") == 0)
+        {
+            if((sscanf(line, "%*s %99s", modestr) == 1)
+                    && (fft_batch_setmode(modestr) == RETURN_SUCCESS))
+            {
+                continue;
+            }
+        }
+        else if(strcmp(keyword, "pool") == 0)
+        {
+            long nthreads, rtprio, mlockstack;
+            long stackKiB = 0;
+            char cpulist[100];
+            // stack size optional
+            if((sscanf(line, "%*s %ld %99s %ld %ld %ld", &nthreads, cpulist, &rtprio,
+                       &mlockstack, &stackKiB) >= 4)
+                    && (fft_workerpool_set(nthreads, cpulist, rtprio, mlockstack,
+                                           stackKiB) == RETURN_SUCCESS))
+            {
+                continue;
+            }
+        }
+        else if(strcmp(keyword, "background") == 0)
+        {
+            long mode;
+            if(sscanf(line, "%*s %ld", &mode) == 1)
+            {
+                fft_planpolicy_setbackground(mode);
+                continue;
+            }
+        }
+        else if(strcmp(keyword, "size") == 0)
+        {
+            // size size0 [size1] mode [nthreads]
+            long nthreads;
+            int  NBarg;
+
+            if((NBarg = sscanf(line, "%*s %ld %ld %99s %ld", &size0, &size1, modestr,
+                               &nthreads)) >= 3)
+            {
+                fft_planpolicy_setsize(modestr, size0, size1);
+                if(NBarg == 4)
+                {
+                    fft_planpolicy_setsizenthreads(size0, size1, nthreads);
+                }
+                continue;
+            }
+            if((NBarg = sscanf(line, "%*s %ld %99s %ld", &size0, modestr, &nthreads)) >= 2)
+            {
+                fft_planpolicy_setsize(modestr, size0, 0);
+                if(NBarg == 3)
+                {
+                    fft_planpolicy_setsizenthreads(size0, 0, nthreads);
+                }
+                continue;
+            }
+        }
+
+        PRINT_WARNING("%s line %ld ignored: %s", fname, lineno, line);
+    }
+
+    fclose(fp);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+errno_t fft_planpolicy_list()
+{
+    int nthreads;
+
+    pthread_mutex_lock(&planpolicy_mutex);
+
+    printf("default planning mode : %s\n", fft_planpolicy_modename(planpolicy_flags));
+    if(planpolicy_timelimit > 0.0)
+    {
+        printf("planning time limit   : %.3f sec\n", planpolicy_timelimit);
+    }
+    else
+    {
+        printf("planning time limit   : none\n");
+    }
+    printf("background planning   : %s\n", (planpolicy_background == 1) ? "on" : "off");
+    pthread_once(&planpolicy_NBcpu_once, fft_planpolicy_NBcpu_init);
+    nthreads = __atomic_load_n(&planpolicy_nthreads, __ATOMIC_RELAXED);
+    if(nthreads > 0)
+    {
+        printf("FFTW threads          : %d\n", nthreads);
+    }
+    else
+    {
+        printf("FFTW threads          : auto (1 per %d elements, max %ld)\n",
+               FFT_PLANPOLICY_AUTOMINELEM, planpolicy_NBcpu);
+    }
+
+    for(int i = 0; i < planpolicy_NBoverride; i++)
+    {
+        FFT_PLANPOLICY_OVERRIDE *ovr = &planpolicy_override[i];
+        char nthreadstr[20] = "";
+
+        if(ovr->nthreads > 0)
+        {
+            snprintf(nthreadstr, 20, ", %d thread(s)", ovr->nthreads);
+        }
+        if(ovr->rank == 1)
+        {
+            printf("    size %6d         : %s%s\n", ovr->size[0],
+                   (ovr->flags == FFT_PLANPOLICY_DEFAULTFLAGS) ? "default" :
+                   fft_planpolicy_modename(ovr->flags), nthreadstr);
+        }
+        else
+        {
+            printf("    size %6d x %6d : %s%s\n", ovr->size[0], ovr->size[1],
+                   (ovr->flags == FFT_PLANPOLICY_DEFAULTFLAGS) ? "default" :
+                   fft_planpolicy_modename(ovr->flags), nthreadstr);
+        }
+    }
+
+    pthread_mutex_unlock(&planpolicy_mutex);
+
+    fft_batch_list();
+    fft_workerpool_list();
+
+    return RETURN_SUCCESS;
+}
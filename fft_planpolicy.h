@@ -0,0 +1,72 @@
+/**
+ * @file    fft_planpolicy.h
+ *
+ */
+
+#ifndef _FFT_PLANPOLICY_H
+#define _FFT_PLANPOLICY_H
+
+#include "fft_plancache.h"
+
+
+#define FFT_PLANPOLICY_MAXOVERRIDE 64
+
+// automatic thread count: one FFTW thread per this many elements
+#define FFT_PLANPOLICY_AUTOMINELEM 262144
+
+
+errno_t fft_planpolicy_parsemode(
+    const char *modestr,
+    unsigned   *flags
+);
+
+const char *fft_planpolicy_modename(
+    unsigned flags
+);
+
+errno_t fft_planpolicy_set(
+    const char *modestr,
+    double      timelimit
+);
+
+errno_t fft_planpolicy_setsize(
+    const char *modestr,
+    long        size0,
+    long        size1
+);
+
+errno_t fft_planpolicy_setsizenthreads(
+    long size0,
+    long size1,
+    long nthreads
+);
+
+errno_t fft_planpolicy_setnthreads(
+    long nthreads
+);
+
+errno_t fft_planpolicy_setcallnthreads(
+    int nthreads
+);
+
+errno_t fft_planpolicy_get(
+    const FFT_PLANKEY *key,
+    unsigned          *flags,
+    double            *timelimit
+);
+
+int fft_planpolicy_nthreads(
+    const FFT_PLANKEY *key
+);
+
+errno_t fft_planpolicy_setbackground(
+    long mode
+);
+
+int fft_planpolicy_background();
+
+errno_t fft_planpolicy_loadconf();
+
+errno_t fft_planpolicy_list();
+
+#endif
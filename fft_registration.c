@@ -0,0 +1,468 @@
+/**
+ * @file    fft_registration.c
+ * @brief   Subpixel image registration
+ *
+ * Shift of an image, or of each slice of a cube, with respect to a
+ * reference, following Guizar-Sicairos et al. (2008) :
+ * - coarse correlation by r2c, conjugate multiply and c2r transforms,
+ *   the reference spectrum being kept in a correlation context
+ *   (fft_correlation_ref)
+ * - integer peak of the coarse correlation
+ * - matrix DFT of the cross spectrum on a 1.5 x 1.5 pixel region around
+ *   the peak, upsampled by factor upsample, for the subpixel peak
+ *
+ * The matrix DFT works on the half spectrum: it is the real part of the
+ * Hermitian-weighted sum, separable along each axis.
+ * Slices are processed in parallel on the fft worker pool.
+ * fft_registration_spectrum does all steps after the cross spectrum, on
+ * arrays.
+ *
+ * Results go to a small 3 x nbslice output stream (dx, dy, peak per
+ * slice), reused between calls, with cnt0 incremented on each update.
+ *
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+#include "COREMOD_memory/COREMOD_memory.h"
+
+#include "fft_plancache.h"
+#include "fft_workerpool.h"
+#include "fft_correlation.h"
+#include "fft_registration.h"
+
+
+typedef struct
+{
+    int         precision;
+    long        naxes0;
+    long        naxes1;
+    long        upsample;
+    const void *spec;       // cross spectra, (naxes0/2+1) x naxes1 per slice
+    const void *corr;       // coarse correlation, naxes0 x naxes1 per slice
+    double      scale;      // correlation value / transform value
+    double     *result;     // dx, dy, peak per slice
+} FFT_REGISTRATION_JOB;
+
+
+
+
+// normalize complex elements to unit modulus, one row per job index
+typedef struct
+{
+    int   precision;
+    void *spec;
+    long  rowsize;
+} FFT_REGISTRATION_PHASE_JOB;
+
+
+#define FFT_REGISTRATION_PHASEROW(NAME, TYPE)                           \
+static void NAME(TYPE *spec, long n)                                    \
+{                                                                       \
+    for(long ii = 0; ii < n; ii++)                                      \
+    {                                                                   \
+        TYPE a2 = spec[2 * ii] * spec[2 * ii] + spec[2 * ii + 1] * spec[2 * ii + 1]; \
+        TYPE s = (a2 > 0) ? 1 / sqrt(a2) : 0;                           \
+        spec[2 * ii] *= s;                                              \
+        spec[2 * ii + 1] *= s;                                          \
+    }                                                                   \
+}
+
+FFT_REGISTRATION_PHASEROW(fft_registration_phaserowf, float)
+FFT_REGISTRATION_PHASEROW(fft_registration_phaserowd, double)
+
+
+static void fft_registration_phaserows(
+    void *ptr,
+    long  r0,
+    long  r1
+)
+{
+    FFT_REGISTRATION_PHASE_JOB *job = (FFT_REGISTRATION_PHASE_JOB *) ptr;
+
+    for(long r = r0; r < r1; r++)
+    {
+        if(job->precision == FFT_PRECISION_SINGLE)
+        {
+            fft_registration_phaserowf((float *) job->spec + 2 * r * job->rowsize,
+                                       job->rowsize);
+        }
+        else
+        {
+            fft_registration_phaserowd((double *) job->spec + 2 * r * job->rowsize,
+                                       job->rowsize);
+        }
+    }
+}
+
+
+
+
+// upsampled correlation on M x M points around (p0, p1), spacing 1/upsample
+// returns the peak in *dx, *dy, *peak (transform units)
+static void fft_registration_upsample(
+    const FFT_REGISTRATION_JOB *job,
+    const void                 *spec,
+    long                        p0,
+    long                        p1,
+    double                     *dx,
+    double                     *dy,
+    double                     *peak
+)
+{
+    long n0 = job->naxes0;
+    long n1 = job->naxes1;
+    long n0h = n0 / 2 + 1;
+    long M = (long) ceil(1.5 * job->upsample);
+    long off = M / 2;
+    double *cs0;     // [a][k0] cos, sin of 2 pi k0 x_a / n0, times weight
+    double *cs1;     // [b][k1] cos, sin of 2 pi f1 y_b / n1
+    double *T;       // [a][k1] complex, transform along axis 0
+    double *Z;       // cross spectrum as double
+
+    cs0 = (double *) malloc(sizeof(double) * 2 * M * n0h);
+    cs1 = (double *) malloc(sizeof(double) * 2 * M * n1);
+    T = (double *) malloc(sizeof(double) * 2 * M * n1);
+    Z = (double *) malloc(sizeof(double) * 2 * n0h * n1);
+    if((cs0 == NULL) || (cs1 == NULL) || (T == NULL) || (Z == NULL))
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    for(long i = 0; i < 2 * n0h * n1; i++)
+    {
+        Z[i] = (job->precision == FFT_PRECISION_SINGLE) ? ((const float *) spec)[i] :
+               ((const double *) spec)[i];
+    }
+
+    for(long a = 0; a < M; a++)
+    {
+        double x = p0 + 1.0 * (a - off) / job->upsample;
+
+        for(long k0 = 0; k0 < n0h; k0++)
+        {
+            // Hermitian weight: k0 and n0 - k0 both stand for this column
+            double w = ((k0 == 0) || (2 * k0 == n0)) ? 1.0 : 2.0;
+            double ph = 2.0 * M_PI * k0 * x / n0;
+
+            cs0[2 * (a * n0h + k0)] = w * cos(ph);
+            cs0[2 * (a * n0h + k0) + 1] = w * sin(ph);
+        }
+    }
+    for(long b = 0; b < M; b++)
+    {
+        double y = p1 + 1.0 * (b - off) / job->upsample;
+
+        for(long k1 = 0; k1 < n1; k1++)
+        {
+            long f1 = (2 * k1 < n1) ? k1 : k1 - n1;
+            double ph = 2.0 * M_PI * f1 * y / n1;
+
+            cs1[2 * (b * n1 + k1)] = cos(ph);
+            cs1[2 * (b * n1 + k1) + 1] = sin(ph);
+        }
+    }
+
+    for(long k1 = 0; k1 < n1; k1++)
+    {
+        for(long a = 0; a < M; a++)
+        {
+            const double *e = cs0 + 2 * a * n0h;
+            const double *z = Z + 2 * k1 * n0h;
+            double tre = 0.0;
+            double tim = 0.0;
+
+            for(long k0 = 0; k0 < n0h; k0++)
+            {
+                tre += z[2 * k0] * e[2 * k0] - z[2 * k0 + 1] * e[2 * k0 + 1];
+                tim += z[2 * k0] * e[2 * k0 + 1] + z[2 * k0 + 1] * e[2 * k0];
+            }
+            T[2 * (a * n1 + k1)] = tre;
+            T[2 * (a * n1 + k1) + 1] = tim;
+        }
+    }
+
+    *peak = -HUGE_VAL;
+    for(long b = 0; b < M; b++)
+    {
+        const double *e = cs1 + 2 * b * n1;
+
+        for(long a = 0; a < M; a++)
+        {
+            const double *t = T + 2 * a * n1;
+            double v = 0.0;
+
+            // real part only
+            for(long k1 = 0; k1 < n1; k1++)
+            {
+                v += t[2 * k1] * e[2 * k1] - t[2 * k1 + 1] * e[2 * k1 + 1];
+            }
+            if(v > *peak)
+            {
+                *peak = v;
+                *dx = p0 + 1.0 * (a - off) / job->upsample;
+                *dy = p1 + 1.0 * (b - off) / job->upsample;
+            }
+        }
+    }
+
+    free(cs0);
+    free(cs1);
+    free(T);
+    free(Z);
+}
+
+
+
+
+static void fft_registration_slices(
+    void *ptr,
+    long  k0,
+    long  k1
+)
+{
+    FFT_REGISTRATION_JOB *job = (FFT_REGISTRATION_JOB *) ptr;
+    long n0 = job->naxes0;
+    long n1 = job->naxes1;
+    long npix = n0 * n1;
+    size_t realsize = (job->precision == FFT_PRECISION_SINGLE) ? sizeof(
+                          float) : sizeof(double);
+
+    for(long k = k0; k < k1; k++)
+    {
+        const void *spec = (const char *) job->spec + 2 * realsize * (n0 / 2 + 1) * n1 * k;
+        long imax = 0;
+        double vmax = -HUGE_VAL;
+        double dx, dy, peak;
+
+        // coarse peak
+        for(long i = 0; i < npix; i++)
+        {
+            double v = (job->precision == FFT_PRECISION_SINGLE) ?
+                       ((const float *) job->corr)[k * npix + i] :
+                       ((const double *) job->corr)[k * npix + i];
+            if(v > vmax)
+            {
+                vmax = v;
+                imax = i;
+            }
+        }
+        dx = imax % n0;
+        dy = imax / n0;
+        if(2 * dx > n0)
+        {
+            dx -= n0;
+        }
+        if(2 * dy > n1)
+        {
+            dy -= n1;
+        }
+        peak = vmax;
+
+        if(job->upsample > 1)
+        {
+            fft_registration_upsample(job, spec, (long) dx, (long) dy, &dx, &dy, &peak);
+        }
+
+        job->result[3 * k] = dx;
+        job->result[3 * k + 1] = dy;
+        job->result[3 * k + 2] = peak * job->scale;
+    }
+}
+
+
+
+
+/**
+ * @brief Shift of each slice from its cross spectrum with the reference
+ *
+ * spec holds nbslice cross spectra (naxes0/2+1) x naxes1, as computed by
+ * fft_correlation_crossmult from the conjugated reference spectrum,
+ * uncentered. spec is modified with FFT_REGISTRATION_PHASE.
+ * result: dx, dy, peak per slice (see fft_registration).
+ */
+errno_t fft_registration_spectrum(
+    int     precision,
+    long    naxes0,
+    long    naxes1,
+    long    nbslice,
+    void   *spec,
+    long    upsample,
+    int     flags,
+    double *result
+)
+{
+    FFT_REGISTRATION_JOB job;
+    size_t realsize;
+    size_t specsize;
+    void *spec1;
+    void *corr;
+
+    job.precision = precision;
+    job.naxes0 = naxes0;
+    job.naxes1 = naxes1;
+    job.upsample = upsample;
+    job.result = result;
+    realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(double);
+
+    specsize = 2 * realsize * (naxes0 / 2 + 1) * naxes1 * nbslice;
+    spec1 = fftw_malloc(specsize);
+    corr = fftw_malloc(realsize * naxes0 * naxes1 * nbslice);
+    if((spec1 == NULL) || (corr == NULL))
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    if(flags & FFT_REGISTRATION_PHASE)
+    {
+        FFT_REGISTRATION_PHASE_JOB phasejob;
+
+        phasejob.precision = precision;
+        phasejob.spec = spec;
+        phasejob.rowsize = naxes0 / 2 + 1;
+        fft_workerpool_parallelfor(fft_registration_phaserows, &phasejob,
+                                   naxes1 * nbslice);
+        job.scale = 1.0 / (naxes0 * naxes1);
+    }
+    else
+    {
+        // fft_correlation normalization: 1 / sqrt(N)
+        job.scale = sqrt(1.0 * naxes0 * naxes1);
+    }
+
+    // coarse correlation, c2r destroys its input
+    memcpy(spec1, spec, specsize);
+    fft_correlation_c2r(precision, naxes0, naxes1, nbslice, spec1, corr, 0);
+    fftw_free(spec1);
+
+    job.spec = spec;
+    job.corr = corr;
+    fft_workerpool_parallelfor(fft_registration_slices, &job, nbslice);
+
+    fftw_free(corr);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/* subpixel shift of image (each slice of a cube) with respect to reference */
+// output: 3 x nbslice stream of (dx, dy, peak), in(n) ~ ref(n - (dx, dy))
+// upsample: subpixel resolution 1/upsample, 1 for integer shifts
+// peak: correlation sum_n ref(n) in(n + shift), or in [0, 1] with
+//       FFT_REGISTRATION_PHASE
+imageID fft_registration(
+    const char *IDref_name,
+    const char *ID_name,
+    const char *IDout_name,
+    long        upsample,
+    int         flags
+)
+{
+    imageID IDref;
+    imageID ID;
+    imageID IDout;
+    uint8_t datatype;
+    uint32_t naxesout[2];
+    long n0, n1, nbslice;
+    int precision;
+    size_t realsize;
+    const void *refspec;
+    void *inarray;
+    void *spec;
+    double *result;
+
+    IDref = image_ID(IDref_name);
+    ID = image_ID(ID_name);
+    if((IDref == -1) || (ID == -1))
+    {
+        PRINT_ERROR("image %s or %s not found", IDref_name, ID_name);
+        return -1;
+    }
+    datatype = data.image[ID].md[0].datatype;
+    n0 = data.image[ID].md[0].size[0];
+    n1 = data.image[ID].md[0].size[1];
+    nbslice = (data.image[ID].md[0].naxis == 3) ? data.image[ID].md[0].size[2] : 1;
+
+    if((data.image[ID].md[0].naxis < 2) || (upsample < 1)
+            || ((datatype != _DATATYPE_FLOAT) && (datatype != _DATATYPE_DOUBLE))
+            || (data.image[IDref].md[0].datatype != datatype)
+            || (data.image[IDref].md[0].size[0] != n0)
+            || (data.image[IDref].md[0].size[1] != n1))
+    {
+        PRINT_ERROR("image %s not appropriate for registration on %s", ID_name,
+                    IDref_name);
+        return -1;
+    }
+
+    precision = (datatype == _DATATYPE_FLOAT) ? FFT_PRECISION_SINGLE :
+                FFT_PRECISION_DOUBLE;
+    realsize = (datatype == _DATATYPE_FLOAT) ? sizeof(float) : sizeof(double);
+    inarray = (datatype == _DATATYPE_FLOAT) ? (void *) data.image[ID].array.F :
+              (void *) data.image[ID].array.D;
+
+    spec = fftw_malloc(2 * realsize * (n0 / 2 + 1) * n1 * nbslice);
+    result = (double *) malloc(sizeof(double) * 3 * nbslice);
+    if((spec == NULL) || (result == NULL))
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    // cross spectra, uncentered
+    fft_correlation_rfft(precision, n0, n1, nbslice, inarray, spec);
+    refspec = fft_correlation_refacquire(IDref_name, 0);
+    if(refspec == NULL)
+    {
+        fftw_free(spec);
+        free(result);
+        return -1;
+    }
+    fft_correlation_crossmult(precision, n0, n1, nbslice, refspec, 1, spec,
+                              nbslice, spec, 0, 0);
+    fft_correlation_refrelease();
+
+    fft_registration_spectrum(precision, n0, n1, nbslice, spec, upsample, flags,
+                              result);
+    fftw_free(spec);
+
+
+    IDout = image_ID(IDout_name);
+    if((IDout == -1) || (data.image[IDout].md[0].datatype != datatype)
+            || (data.image[IDout].md[0].nelement != (uint64_t)(3 * nbslice)))
+    {
+        if(IDout != -1)
+        {
+            delete_image_ID(IDout_name);
+        }
+        naxesout[0] = 3;
+        naxesout[1] = nbslice;
+        IDout = create_image_ID(IDout_name, 2, naxesout, datatype, data.SHARED_DFT,
+                                data.NBKEWORD_DFT);
+    }
+
+    for(long i = 0; i < 3 * nbslice; i++)
+    {
+        if(datatype == _DATATYPE_FLOAT)
+        {
+            data.image[IDout].array.F[i] = result[i];
+        }
+        else
+        {
+            data.image[IDout].array.D[i] = result[i];
+        }
+    }
+    data.image[IDout].md[0].cnt0++;
+
+    free(result);
+
+    return IDout;
+}
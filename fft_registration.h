@@ -0,0 +1,33 @@
+/**
+ * @file    fft_registration.h
+ *
+ */
+
+#ifndef _FFT_REGISTRATION_H
+#define _FFT_REGISTRATION_H
+
+
+// fft_registration flags
+#define FFT_REGISTRATION_PHASE 1   // phase correlation: unit-modulus cross spectrum
+
+
+errno_t fft_registration_spectrum(
+    int     precision,
+    long    naxes0,
+    long    naxes1,
+    long    nbslice,
+    void   *spec,
+    long    upsample,
+    int     flags,
+    double *result
+);
+
+imageID fft_registration(
+    const char *IDref_name,
+    const char *ID_name,
+    const char *IDout_name,
+    long        upsample,
+    int         flags
+);
+
+#endif
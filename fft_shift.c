@@ -0,0 +1,524 @@
+/**
+ * @file    fft_shift.c
+ * @brief   Quadrant shift of images and cubes
+ *
+ * Engine behind permut: swaps the image halves along axes 0 and 1 of
+ * each slice. Data is processed as blocks of contiguous rows spread over
+ * the fft worker pool, each row half moved with fixed-size block copies
+ * that the compiler turns into vector loads and stores. Works on any
+ * element size (float, double, complex float, complex double).
+ *
+ * In place, odd sizes give the same result as the original permut.
+ * Out of place, output(ii, jj) = input((ii + naxes0/2) % naxes0,
+ * (jj + naxes1/2) % naxes1): ifftshift along axes 0 and 1, which is the
+ * in-place result for even sizes only. permut_copy therefore uses it for
+ * even sizes only.
+ *
+ * fft_shift_centerspectrum turns the transform of an array into the
+ * transform of its permut, permuted: quadrant swap and (-1)^(ii+jj)
+ * modulation in a single pass, for even sizes.
+ *
+ * fft_shift_axes is the exact fftshift / ifftshift, valid for odd sizes,
+ * on any subset of axes of a 1D to 4D array. Each selected axis is rotated
+ * in place by cycle-following, so no second buffer is needed.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft_plancache.h"
+#include "fft_shift.h"
+#include "fft_workerpool.h"
+
+
+// vector block size [byte]
+#define FFT_SHIFT_BLOCK 64
+
+// largest piece of a line moved at once by fft_shift_axes [byte]
+#define FFT_SHIFT_CHUNK 4096
+
+
+typedef struct
+{
+    const char *in;
+    char       *out;
+    size_t      eltsize;
+    long        naxes0;
+    long        naxes1;
+    long        xhalf;
+    long        yhalf;
+    int         pass;    // in place: 0 for rows jj < yhalf, 1 for rows jj >= yhalf
+} FFT_SHIFT_JOB;
+
+
+// rotation of one axis, array seen as [nouter][n][ninner]
+typedef struct
+{
+    char  *array;
+    size_t eltsize;
+    long   n;
+    long   ninner;
+    long   nchunk;  // pieces of ninner, each up to FFT_SHIFT_CHUNK bytes
+    long   chunkelem;
+    long   shift;   // left rotation: out[i] = in[(i + shift) % n]
+} FFT_SHIFT_AXISJOB;
+
+
+
+
+// exchange nbytes between non-overlapping a and b
+static void fft_shift_swapbytes(
+    char *__restrict a,
+    char *__restrict b,
+    size_t nbytes
+)
+{
+    char ta[FFT_SHIFT_BLOCK];
+    char tb[FFT_SHIFT_BLOCK];
+
+    while(nbytes >= FFT_SHIFT_BLOCK)
+    {
+        memcpy(ta, a, FFT_SHIFT_BLOCK);
+        memcpy(tb, b, FFT_SHIFT_BLOCK);
+        memcpy(a, tb, FFT_SHIFT_BLOCK);
+        memcpy(b, ta, FFT_SHIFT_BLOCK);
+        a += FFT_SHIFT_BLOCK;
+        b += FFT_SHIFT_BLOCK;
+        nbytes -= FFT_SHIFT_BLOCK;
+    }
+    if(nbytes > 0)
+    {
+        memcpy(ta, a, nbytes);
+        memcpy(a, b, nbytes);
+        memcpy(b, ta, nbytes);
+    }
+}
+
+
+
+
+// in place, rows r0 to r1-1 of current pass, all slices
+static void fft_shift_swaprows(
+    void *ptr,
+    long  r0,
+    long  r1
+)
+{
+    FFT_SHIFT_JOB *job = (FFT_SHIFT_JOB *) ptr;
+    long nrow = (job->pass == 0) ? job->yhalf : job->naxes1 - job->yhalf;
+    size_t rowsize = job->eltsize * job->naxes0;
+
+    for(long r = r0; r < r1; r++)
+    {
+        long kk = r / nrow;
+        long jj = r % nrow;
+        long jj1;
+
+        if(job->pass == 0)
+        {
+            jj1 = jj + job->yhalf;
+        }
+        else
+        {
+            jj += job->yhalf;
+            jj1 = jj - job->yhalf;
+        }
+
+        char *slice = job->out + kk * job->naxes1 * rowsize;
+        fft_shift_swapbytes(slice + jj * rowsize,
+                            slice + jj1 * rowsize + job->xhalf * job->eltsize,
+                            job->xhalf * job->eltsize);
+    }
+}
+
+
+
+
+// out of place, output rows r0 to r1-1, all slices
+static void fft_shift_copyrows(
+    void *ptr,
+    long  r0,
+    long  r1
+)
+{
+    FFT_SHIFT_JOB *job = (FFT_SHIFT_JOB *) ptr;
+    size_t rowsize = job->eltsize * job->naxes0;
+    size_t rightsize = job->eltsize * (job->naxes0 - job->xhalf);
+    size_t leftsize = job->eltsize * job->xhalf;
+
+    for(long r = r0; r < r1; r++)
+    {
+        long kk = r / job->naxes1;
+        long jj = r % job->naxes1;
+        long jjin = (jj + job->yhalf) % job->naxes1;
+        const char *rowin = job->in + (kk * job->naxes1 + jjin) * rowsize;
+        char *rowout = job->out + r * rowsize;
+
+        memcpy(rowout, rowin + leftsize, rightsize);
+        memcpy(rowout + rightsize, rowin, leftsize);
+    }
+}
+
+
+
+
+static void fft_shift_rows(
+    void (*rangefunc)(void *arg, long i0, long i1),
+    FFT_SHIFT_JOB *job,
+    long           nrow
+)
+{
+    if(job->eltsize * job->naxes0 * nrow < FFT_SHIFT_MINPARBYTES)
+    {
+        if(nrow > 0)
+        {
+            rangefunc(job, 0, nrow);
+        }
+    }
+    else
+    {
+        fft_workerpool_parallelfor(rangefunc, job, nrow);
+    }
+}
+
+
+
+
+// complex rows as re/im pairs:
+// a[ii] <-> b[ii + xhalf] with sign (-1)^(ii + pa) on a, (-1)^(ii + pb) on b
+// and, if a != b, a[ii + xhalf] <-> b[ii] with signs (-1)^(ii + pc) and (-1)^(ii + pd)
+#define FFT_SHIFT_SIGNSWAPC(NAME, TYPE)                                 \
+static void NAME(TYPE *a, TYPE *b, long xhalf, int pa, int pb, int pc, int pd) \
+{                                                                       \
+    for(long ii = 0; ii < xhalf; ii++)                                  \
+    {                                                                   \
+        TYPE sa = ((ii + pa) & 1) ? -1 : 1;                             \
+        TYPE sb = ((ii + pb) & 1) ? -1 : 1;                             \
+        TYPE re0 = a[2 * ii];                                           \
+        TYPE im0 = a[2 * ii + 1];                                       \
+        a[2 * ii] = sa * b[2 * (ii + xhalf)];                           \
+        a[2 * ii + 1] = sa * b[2 * (ii + xhalf) + 1];                   \
+        b[2 * (ii + xhalf)] = sb * re0;                                 \
+        b[2 * (ii + xhalf) + 1] = sb * im0;                             \
+    }                                                                   \
+    if(a != b)                                                          \
+    {                                                                   \
+        for(long ii = 0; ii < xhalf; ii++)                              \
+        {                                                               \
+            TYPE sc = ((ii + pc) & 1) ? -1 : 1;                         \
+            TYPE sd = ((ii + pd) & 1) ? -1 : 1;                         \
+            TYPE re0 = a[2 * (ii + xhalf)];                             \
+            TYPE im0 = a[2 * (ii + xhalf) + 1];                         \
+            a[2 * (ii + xhalf)] = sc * b[2 * ii];                       \
+            a[2 * (ii + xhalf) + 1] = sc * b[2 * ii + 1];               \
+            b[2 * ii] = sd * re0;                                       \
+            b[2 * ii + 1] = sd * im0;                                   \
+        }                                                               \
+    }                                                                   \
+}
+
+FFT_SHIFT_SIGNSWAPC(fft_shift_signswapcf, float)
+FFT_SHIFT_SIGNSWAPC(fft_shift_signswapcd, double)
+
+
+
+
+// row pairs (jj, jj + yhalf) r0 to r1-1 of all slices, one row if yhalf = 0
+static void fft_shift_signswaprows(
+    void *ptr,
+    long  r0,
+    long  r1
+)
+{
+    FFT_SHIFT_JOB *job = (FFT_SHIFT_JOB *) ptr;
+    long npair = (job->yhalf > 0) ? job->yhalf : 1;
+    size_t rowsize = job->eltsize * job->naxes0;
+
+    for(long r = r0; r < r1; r++)
+    {
+        long kk = r / npair;
+        long jj = r % npair;
+        char *rowa = job->out + (kk * job->naxes1 + jj) * rowsize;
+        char *rowb = rowa + job->yhalf * rowsize;
+
+        // sign at destination (ii, jj) is (-1)^(ii + jj + xhalf + yhalf)
+        int pa = (int) ((jj + job->xhalf + job->yhalf) & 1);
+        int pb = (int) (jj & 1);
+        int pc = (int) ((jj + job->yhalf) & 1);
+        int pd = (int) ((jj + job->xhalf) & 1);
+
+        if(job->eltsize == sizeof(complex_float))
+        {
+            fft_shift_signswapcf((float *) rowa, (float *) rowb, job->xhalf,
+                                 pa, pb, pc, pd);
+        }
+        else
+        {
+            fft_shift_signswapcd((double *) rowa, (double *) rowb, job->xhalf,
+                                 pa, pb, pc, pd);
+        }
+    }
+}
+
+
+
+
+/**
+ * @brief Swap quadrants of naxes2 slices of naxes0 x naxes1 elements in place
+ *
+ * naxes1 = 1 for 1D arrays.
+ */
+errno_t fft_shift_quadrant(
+    void  *array,
+    size_t eltsize,
+    long   naxes0,
+    long   naxes1,
+    long   naxes2
+)
+{
+    FFT_SHIFT_JOB job;
+
+    job.in = array;
+    job.out = array;
+    job.eltsize = eltsize;
+    job.naxes0 = naxes0;
+    job.naxes1 = naxes1;
+    job.xhalf = naxes0 / 2;
+    job.yhalf = naxes1 / 2;
+
+    // for odd naxes1, row yhalf is swapped in both passes: passes run in order
+    job.pass = 0;
+    fft_shift_rows(fft_shift_swaprows, &job, naxes2 * job.yhalf);
+    job.pass = 1;
+    fft_shift_rows(fft_shift_swaprows, &job, naxes2 * (naxes1 - job.yhalf));
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Quadrant shift from in to out (non-overlapping)
+ */
+errno_t fft_shift_quadrantcopy(
+    const void *in,
+    void       *out,
+    size_t      eltsize,
+    long        naxes0,
+    long        naxes1,
+    long        naxes2
+)
+{
+    FFT_SHIFT_JOB job;
+
+    job.in = in;
+    job.out = out;
+    job.eltsize = eltsize;
+    job.naxes0 = naxes0;
+    job.naxes1 = naxes1;
+    job.xhalf = naxes0 / 2;
+    job.yhalf = naxes1 / 2;
+    job.pass = 0;
+
+    fft_shift_rows(fft_shift_copyrows, &job, naxes2 * naxes1);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+static long fft_shift_gcd(
+    long a,
+    long b
+)
+{
+    while(b != 0)
+    {
+        long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+
+
+
+// rotate pieces j0 to j1-1 (outer index x chunk index) along the axis
+static void fft_shift_rotatechunks(
+    void *ptr,
+    long  j0,
+    long  j1
+)
+{
+    FFT_SHIFT_AXISJOB *job = (FFT_SHIFT_AXISJOB *) ptr;
+    char tmp[FFT_SHIFT_CHUNK];
+    size_t stride = job->eltsize * job->ninner;
+    long ncycle = fft_shift_gcd(job->n, job->shift);
+
+    for(long j = j0; j < j1; j++)
+    {
+        long outer = j / job->nchunk;
+        long chunk = j % job->nchunk;
+        long i0 = chunk * job->chunkelem;
+        long nelem = job->ninner - i0;
+        if(nelem > job->chunkelem)
+        {
+            nelem = job->chunkelem;
+        }
+        size_t nbytes = nelem * job->eltsize;
+        char *line = job->array + outer * job->n * stride + i0 * job->eltsize;
+
+        // each cycle visits n / ncycle positions
+        for(long c = 0; c < ncycle; c++)
+        {
+            long k = c;
+
+            memcpy(tmp, line + c * stride, nbytes);
+            for(;;)
+            {
+                long knext = k + job->shift;
+                if(knext >= job->n)
+                {
+                    knext -= job->n;
+                }
+                if(knext == c)
+                {
+                    break;
+                }
+                memcpy(line + k * stride, line + knext * stride, nbytes);
+                k = knext;
+            }
+            memcpy(line + k * stride, tmp, nbytes);
+        }
+    }
+}
+
+
+
+
+/**
+ * @brief Center a complex spectrum computed from an uncentered input
+ *
+ * For even naxes0 and naxes1 (or naxes1 = 1), with X = FFT(x) in array,
+ * array becomes permut(FFT(permut(x))), i.e. the transform of the
+ * centered input, centered. Done as one quadrant swap pass with the
+ * (-1)^(ii+jj) modulation folded in. Same for forward and inverse
+ * transforms.
+ */
+errno_t fft_shift_centerspectrum(
+    void *array,
+    int   precision,
+    long  naxes0,
+    long  naxes1,
+    long  naxes2
+)
+{
+    FFT_SHIFT_JOB job;
+
+    if((naxes0 % 2 != 0) || ((naxes1 > 1) && (naxes1 % 2 != 0)))
+    {
+        PRINT_ERROR("centered spectrum requires even sizes: %ld x %ld", naxes0, naxes1);
+        return RETURN_FAILURE;
+    }
+
+    job.in = array;
+    job.out = array;
+    job.eltsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(complex_float) :
+                  sizeof(complex_double);
+    job.naxes0 = naxes0;
+    job.naxes1 = naxes1;
+    job.xhalf = naxes0 / 2;
+    job.yhalf = naxes1 / 2;
+    job.pass = 0;
+
+    fft_shift_rows(fft_shift_signswaprows, &job,
+                   naxes2 * ((job.yhalf > 0) ? job.yhalf : 1));
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief fftshift (inverse = 0) or ifftshift (inverse = 1), in place
+ *
+ * size[0] is the fastest axis. Bit a of axismask selects axis a,
+ * axismask = 0 shifts all axes.
+ *
+ * fftshift moves element 0 to index n/2, ifftshift undoes it.
+ * Both are the same for even n.
+ */
+errno_t fft_shift_axes(
+    void       *array,
+    size_t      eltsize,
+    int         naxis,
+    const long *size,
+    int         axismask,
+    int         inverse
+)
+{
+    long nelem = 1;
+
+    if((naxis < 1) || (naxis > FFT_SHIFT_MAXAXIS) || (eltsize > FFT_SHIFT_CHUNK))
+    {
+        PRINT_ERROR("unsupported array for fft_shift_axes: naxis = %d, eltsize = %ld",
+                    naxis, (long) eltsize);
+        return RETURN_FAILURE;
+    }
+
+    if(axismask == 0)
+    {
+        axismask = (1 << naxis) - 1;
+    }
+
+    for(int axis = 0; axis < naxis; axis++)
+    {
+        nelem *= size[axis];
+    }
+
+    // rotations along different axes commute: one axis at a time
+    for(int axis = 0; axis < naxis; axis++)
+    {
+        FFT_SHIFT_AXISJOB job;
+        long n = size[axis];
+        long ninner = 1;
+
+        if(((axismask >> axis) & 1) == 0 || (n < 2))
+        {
+            continue;
+        }
+
+        for(int a = 0; a < axis; a++)
+        {
+            ninner *= size[a];
+        }
+
+        job.array = (char *) array;
+        job.eltsize = eltsize;
+        job.n = n;
+        job.ninner = ninner;
+        job.chunkelem = FFT_SHIFT_CHUNK / eltsize;
+        job.nchunk = (ninner + job.chunkelem - 1) / job.chunkelem;
+        job.shift = inverse ? n / 2 : n - n / 2;
+
+        long npiece = (nelem / (n * ninner)) * job.nchunk;
+
+        if(eltsize * nelem < FFT_SHIFT_MINPARBYTES)
+        {
+            fft_shift_rotatechunks(&job, 0, npiece);
+        }
+        else
+        {
+            fft_workerpool_parallelfor(fft_shift_rotatechunks, &job, npiece);
+        }
+    }
+
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file    fft_shift.h
+ *
+ */
+
+#ifndef _FFT_SHIFT_H
+#define _FFT_SHIFT_H
+
+
+// arrays smaller than this are shifted by the calling thread only
+#define FFT_SHIFT_MINPARBYTES (256 * 1024)
+
+#define FFT_SHIFT_MAXAXIS     4
+
+
+
+errno_t fft_shift_quadrant(
+    void  *array,
+    size_t eltsize,
+    long   naxes0,
+    long   naxes1,
+    long   naxes2
+);
+
+errno_t fft_shift_quadrantcopy(
+    const void *in,
+    void       *out,
+    size_t      eltsize,
+    long        naxes0,
+    long        naxes1,
+    long        naxes2
+);
+
+errno_t fft_shift_centerspectrum(
+    void *array,
+    int   precision,
+    long  naxes0,
+    long  naxes1,
+    long  naxes2
+);
+
+errno_t fft_shift_axes(
+    void       *array,
+    size_t      eltsize,
+    int         naxis,
+    const long *size,
+    int         axismask,
+    int         inverse
+);
+
+#endif
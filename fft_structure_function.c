@@ -2,51 +2,376 @@
  * @file    fft_structure_function.c
  * @brief   Compute structure function using FFT
  *
+ * D(r) = < (in(n + r) - in(n))^2 > = 2 (C(0) - C(r)), with C the circular
+ * autocorrelation per pixel, averaged over the slices of a cube.
+ *
+ * Slices are transformed r2c in groups of FFT_STRUCTURE_FUNCTION_NBSLICE,
+ * and |X|^2 accumulated over all slices in the spectral domain, so a
+ * single c2r transform gives the ensemble averaged C. D is then computed
+ * in one vectorized pass, and optionally reduced to a radial profile.
  *
  */
 
 #include <math.h>
+#include <string.h>
+
+#include <fftw3.h>
 
 #include "CommandLineInterface/CLIcore.h"
 #include "COREMOD_memory/COREMOD_memory.h"
 
-#include "fft_autocorrelation.h"
+#include "fft_plancache.h"
+#include "fft_workerpool.h"
+#include "fft_correlation.h"
+#include "fft_structure_function.h"
 
 
-imageID fft_structure_function(
+// accumulate |X|^2 of nbslice half spectra
+typedef struct
+{
+    int         precision;
+    const void *spec;
+    long        nbslice;
+    long        nelem;      // complex elements per slice
+    double     *acc;        // nelem
+} FFT_STRUCTURE_FUNCTION_ACC;
+
+
+// acc[ii] += |spec[k][ii]|^2 over k, for ii in [i0, i1)
+// straight loops without datatype test so they vectorize
+#define FFT_STRUCTURE_FUNCTION_ACCSEG(NAME, TYPE)                       \
+static void NAME(const TYPE *spec, double *acc, long nbslice, long nelem, \
+                 long i0, long i1)                                      \
+{                                                                       \
+    for(long k = 0; k < nbslice; k++)                                   \
+    {                                                                   \
+        const TYPE *s = spec + 2 * k * nelem;                           \
+        for(long ii = i0; ii < i1; ii++)                                \
+        {                                                               \
+            acc[ii] += (double) s[2 * ii] * s[2 * ii]                   \
+                       + (double) s[2 * ii + 1] * s[2 * ii + 1];        \
+        }                                                               \
+    }                                                                   \
+}
+
+FFT_STRUCTURE_FUNCTION_ACCSEG(fft_structure_function_accsegf, float)
+FFT_STRUCTURE_FUNCTION_ACCSEG(fft_structure_function_accsegd, double)
+
+
+static void fft_structure_function_accrange(
+    void *ptr,
+    long  i0,
+    long  i1
+)
+{
+    FFT_STRUCTURE_FUNCTION_ACC *job = (FFT_STRUCTURE_FUNCTION_ACC *) ptr;
+
+    if(job->precision == FFT_PRECISION_SINGLE)
+    {
+        fft_structure_function_accsegf((const float *) job->spec, job->acc,
+                                       job->nbslice, job->nelem, i0, i1);
+    }
+    else
+    {
+        fft_structure_function_accsegd((const double *) job->spec, job->acc,
+                                       job->nbslice, job->nelem, i0, i1);
+    }
+}
+
+
+
+
+// complex half spectrum of scaled accumulated power, for the c2r
+typedef struct
+{
+    int           precision;
+    const double *acc;
+    void         *spec;
+    double        scale;
+} FFT_STRUCTURE_FUNCTION_PACK;
+
+
+// spec[ii] = scale * acc[ii] + 0 i for ii in [i0, i1)
+#define FFT_STRUCTURE_FUNCTION_PACKSEG(NAME, TYPE)                      \
+static void NAME(const double *acc, TYPE *spec, long i0, long i1,       \
+                 double scale)                                          \
+{                                                                       \
+    for(long ii = i0; ii < i1; ii++)                                    \
+    {                                                                   \
+        spec[2 * ii] = (TYPE)(scale * acc[ii]);                         \
+        spec[2 * ii + 1] = 0;                                           \
+    }                                                                   \
+}
+
+FFT_STRUCTURE_FUNCTION_PACKSEG(fft_structure_function_packsegf, float)
+FFT_STRUCTURE_FUNCTION_PACKSEG(fft_structure_function_packsegd, double)
+
+
+static void fft_structure_function_packrange(
+    void *ptr,
+    long  i0,
+    long  i1
+)
+{
+    FFT_STRUCTURE_FUNCTION_PACK *job = (FFT_STRUCTURE_FUNCTION_PACK *) ptr;
+
+    if(job->precision == FFT_PRECISION_SINGLE)
+    {
+        fft_structure_function_packsegf(job->acc, (float *) job->spec, i0, i1,
+                                        job->scale);
+    }
+    else
+    {
+        fft_structure_function_packsegd(job->acc, (double *) job->spec, i0, i1,
+                                        job->scale);
+    }
+}
+
+
+
+
+// out[ii] = 2 (c0 - out[ii])
+#define FFT_STRUCTURE_FUNCTION_DSEG(NAME, TYPE)                 \
+static void NAME(TYPE *out, long n)                             \
+{                                                               \
+    TYPE c0 = out[0];                                           \
+    for(long ii = 0; ii < n; ii++)                              \
+    {                                                           \
+        out[ii] = 2 * (c0 - out[ii]);                           \
+    }                                                           \
+}
+
+FFT_STRUCTURE_FUNCTION_DSEG(fft_structure_function_dsegf, float)
+FFT_STRUCTURE_FUNCTION_DSEG(fft_structure_function_dsegd, double)
+
+
+
+
+// average of D over annuli of unit width around zero lag (0,0), lags wrapped
+// profile and count zeroed by caller
+#define FFT_STRUCTURE_FUNCTION_RADIAL(NAME, TYPE)                       \
+static void NAME(const TYPE *D, long naxes0, long naxes1,               \
+                 double *profile, long *count, long nbbin)              \
+{                                                                       \
+    for(long jj = 0; jj < naxes1; jj++)                                 \
+    {                                                                   \
+        double y = (2 * jj < naxes1) ? jj : jj - naxes1;                \
+        for(long ii = 0; ii < naxes0; ii++)                             \
+        {                                                               \
+            double x = (2 * ii < naxes0) ? ii : ii - naxes0;            \
+            long bin = (long)(sqrt(x * x + y * y) + 0.5);               \
+                                                                        \
+            if(bin < nbbin)                                             \
+            {                                                           \
+                profile[bin] += D[jj * naxes0 + ii];                    \
+                count[bin]++;                                           \
+            }                                                           \
+        }                                                               \
+    }                                                                   \
+    for(long bin = 0; bin < nbbin; bin++)                               \
+    {                                                                   \
+        if(count[bin] > 0)                                              \
+        {                                                               \
+            profile[bin] /= count[bin];                                 \
+        }                                                               \
+    }                                                                   \
+}
+
+FFT_STRUCTURE_FUNCTION_RADIAL(fft_structure_function_radialf, float)
+FFT_STRUCTURE_FUNCTION_RADIAL(fft_structure_function_radiald, double)
+
+
+
+
+/**
+ * @brief Structure function of the slices of a real array, ensemble averaged
+ *
+ * outarray: D(r), naxes0 x naxes1, zero lag at (0,0), or if radial = 1
+ * its radial profile of FFT_STRUCTURE_FUNCTION_NBBIN(naxes0, naxes1)
+ * elements (radius 0 to max(naxes0, naxes1)/2 pixels).
+ */
+errno_t fft_structure_function_array(
+    int         precision,
+    long        naxes0,
+    long        naxes1,
+    long        nbslice,
+    const void *inarray,
+    void       *outarray,
+    int         radial
+)
+{
+    long n0 = naxes0;
+    long n1 = naxes1;
+    long n0h = n0 / 2 + 1;
+    size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                          double);
+    void *spec;
+    void *corr;
+    double *acc;
+    FFT_STRUCTURE_FUNCTION_ACC job;
+    FFT_STRUCTURE_FUNCTION_PACK pack;
+
+    long chunk = (nbslice < FFT_STRUCTURE_FUNCTION_NBSLICE) ? nbslice :
+                 FFT_STRUCTURE_FUNCTION_NBSLICE;
+    spec = fftw_malloc(2 * realsize * n0h * n1 * chunk);
+    acc = (double *) calloc(n0h * n1, sizeof(double));
+    // D written to output directly, unless reduced to radial profile
+    corr = radial ? fftw_malloc(realsize * n0 * n1) : outarray;
+    if((spec == NULL) || (acc == NULL) || (corr == NULL))
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+
+    job.precision = precision;
+    job.spec = spec;
+    job.nelem = n0h * n1;
+    job.acc = acc;
+    for(long k = 0; k < nbslice; k += chunk)
+    {
+        job.nbslice = (nbslice - k < chunk) ? nbslice - k : chunk;
+        fft_correlation_rfft(precision, n0, n1, job.nbslice,
+                             (const char *) inarray + realsize * n0 * n1 * k, spec);
+        fft_workerpool_parallelfor(fft_structure_function_accrange, &job, job.nelem);
+    }
+
+    // mean C(r) per pixel after c2r (which multiplies by N)
+    pack.precision = precision;
+    pack.acc = acc;
+    pack.spec = spec;
+    pack.scale = 1.0 / (1.0 * nbslice * n0 * n1 * n0 * n1);
+    fft_workerpool_parallelfor(fft_structure_function_packrange, &pack, job.nelem);
+
+    fft_correlation_c2r(precision, n0, n1, 1, spec, corr, 0);
+    fftw_free(spec);
+    free(acc);
+
+    if(precision == FFT_PRECISION_SINGLE)
+    {
+        fft_structure_function_dsegf((float *) corr, n0 * n1);
+    }
+    else
+    {
+        fft_structure_function_dsegd((double *) corr, n0 * n1);
+    }
+
+    if(radial)
+    {
+        long nbbin = FFT_STRUCTURE_FUNCTION_NBBIN(n0, n1);
+        double *profile = (double *) calloc(nbbin, sizeof(double));
+        long *count = (long *) calloc(nbbin, sizeof(long));
+
+        if((profile == NULL) || (count == NULL))
+        {
+            PRINT_ERROR("malloc error");
+            abort();
+        }
+
+        if(precision == FFT_PRECISION_SINGLE)
+        {
+            fft_structure_function_radialf((const float *) corr, n0, n1, profile,
+                                           count, nbbin);
+        }
+        else
+        {
+            fft_structure_function_radiald((const double *) corr, n0, n1, profile,
+                                           count, nbbin);
+        }
+        for(long bin = 0; bin < nbbin; bin++)
+        {
+            if(precision == FFT_PRECISION_SINGLE)
+            {
+                ((float *) outarray)[bin] = profile[bin];
+            }
+            else
+            {
+                ((double *) outarray)[bin] = profile[bin];
+            }
+        }
+        free(profile);
+        free(count);
+        fftw_free(corr);
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/* structure function of an image, ensemble averaged over cube slices */
+// output: D(r), zero lag at (0,0), or its radial profile if radial = 1
+// (1D, radius 0 to max(naxes0, naxes1)/2 pixels)
+// single and double precisions
+imageID fft_structure_function_ensemble(
     const char *ID_in,
-    const char *ID_out
+    const char *ID_out,
+    int         radial
 )
 {
-    imageID  IDout;
-    double   value;
-    uint64_t nelement;
-    uint8_t  datatype;
+    imageID IDin;
+    imageID IDout;
+    uint8_t datatype;
+    long naxis;
+    long n0, n1, nbslice;
+    int precision;
+    void *inarray;
+    uint32_t naxes[2];
+
+    IDin = image_ID(ID_in);
+    datatype = data.image[IDin].md[0].datatype;
+    naxis = data.image[IDin].md[0].naxis;
+
+    if((naxis < 2) || (naxis > 3)
+            || ((datatype != _DATATYPE_FLOAT) && (datatype != _DATATYPE_DOUBLE)))
+    {
+        PRINT_ERROR("image %s not appropriate for structure function", ID_in);
+        return -1;
+    }
 
-    autocorrelation(ID_in, ID_out);
-    IDout = image_ID(ID_out);
-    nelement = data.image[IDout].md[0].nelement;
+    n0 = data.image[IDin].md[0].size[0];
+    n1 = data.image[IDin].md[0].size[1];
+    nbslice = (naxis == 3) ? data.image[IDin].md[0].size[2] : 1;
 
-    datatype = data.image[IDout].md[0].datatype;
-    
     if(datatype == _DATATYPE_FLOAT)
     {
-        value = -data.image[IDout].array.F[0];
-        for(uint64_t ii=0; ii<nelement; ii++)
-        {
-			data.image[IDout].array.F[ii] += value;
-			data.image[IDout].array.F[ii] *= -2.0/sqrt(nelement);
-		}
+        precision = FFT_PRECISION_SINGLE;
+        inarray = (void *) data.image[IDin].array.F;
     }
-    if(datatype == _DATATYPE_DOUBLE)
+    else
     {
-        value = -data.image[IDout].array.D[0];
-        for(uint64_t ii=0; ii<nelement; ii++)
-        {
-			data.image[IDout].array.D[ii] += value;
-			data.image[IDout].array.D[ii] *= -2.0/sqrt(nelement);
-		}
+        precision = FFT_PRECISION_DOUBLE;
+        inarray = (void *) data.image[IDin].array.D;
     }
 
+    if(radial == 0)
+    {
+        naxes[0] = n0;
+        naxes[1] = n1;
+        IDout = create_image_ID(ID_out, 2, naxes, datatype, data.SHARED_DFT,
+                                data.NBKEWORD_DFT);
+    }
+    else
+    {
+        naxes[0] = FFT_STRUCTURE_FUNCTION_NBBIN(n0, n1);
+        IDout = create_image_ID(ID_out, 1, naxes, datatype, data.SHARED_DFT,
+                                data.NBKEWORD_DFT);
+    }
+
+    fft_structure_function_array(precision, n0, n1, nbslice, inarray,
+                                 (datatype == _DATATYPE_FLOAT) ? (void *) data.image[IDout].array.F :
+                                 (void *) data.image[IDout].array.D, radial);
+
     return IDout;
 }
+
+
+
+
+imageID fft_structure_function(
+    const char *ID_in,
+    const char *ID_out
+)
+{
+    return fft_structure_function_ensemble(ID_in, ID_out, 0);
+}
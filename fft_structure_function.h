@@ -3,9 +3,37 @@
  *
  */
 
+#ifndef _FFT_STRUCTURE_FUNCTION_H
+#define _FFT_STRUCTURE_FUNCTION_H
+
+
+// slices transformed per batch when accumulating over a cube
+#define FFT_STRUCTURE_FUNCTION_NBSLICE 16
+
+// number of radial profile bins: radius 0 to max(naxes0, naxes1)/2
+#define FFT_STRUCTURE_FUNCTION_NBBIN(naxes0, naxes1) \
+    ((((naxes0) > (naxes1)) ? (naxes0) : (naxes1)) / 2 + 1)
+
+
+errno_t fft_structure_function_array(
+    int         precision,
+    long        naxes0,
+    long        naxes1,
+    long        nbslice,
+    const void *inarray,
+    void       *outarray,
+    int         radial
+);
+
+imageID fft_structure_function_ensemble(
+    const char *ID_in,
+    const char *ID_out,
+    int         radial
+);
+
 imageID fft_structure_function(
     const char *ID_in,
     const char *ID_out
 );
 
-
+#endif
@@ -0,0 +1,504 @@
+/**
+ * @file    fft_wisdom.c
+ * @brief   FFTW wisdom files
+ *
+ * Wisdom is only valid on the machine and FFTW build that produced it.
+ * Wisdom files are keyed by CPU model, instruction set, FFTW version and
+ * thread mode :
+ *
+ *     FFTCONFIGDIR/fftwf_wisdom_<hostkey>.dat   single precision
+ *     FFTCONFIGDIR/fftw_wisdom_<hostkey>.dat    double precision
+ *
+ * Several processes may export wisdom to the same file. Writers hold an
+ * exclusive lock on <file>.lock, merge the file content into their own
+ * wisdom, write a temporary file and rename it over the wisdom file.
+ * Readers therefore always see a complete file, and no writer discards
+ * wisdom accumulated by another.
+ *
+ * Wisdom is imported lazily, on the first plan request for each precision
+ * (fft_wisdom_load), so that processes not running FFTs do not pay for
+ * parsing wisdom files at startup.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <errno.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft/fft.h"
+#include "fft_plancache.h"
+#include "fft_wisdom.h"
+
+
+#define FFT_WISDOM_HOSTKEYLEN 200
+
+
+static char wisdom_hostkey[FFT_WISDOM_HOSTKEYLEN];
+static pthread_once_t wisdom_hostkey_once = PTHREAD_ONCE_INIT;
+
+// per precision: wisdom file imported, file found, import time [sec]
+static int    wisdom_loaded[2] = {0, 0};
+static int    wisdom_found[2] = {0, 0};
+static double wisdom_loadtime[2] = {0.0, 0.0};
+static pthread_mutex_t wisdom_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// FFTCONFIGDIR created, once per process
+static errno_t wisdom_dirstatus = RETURN_FAILURE;
+static pthread_once_t wisdom_dir_once = PTHREAD_ONCE_INIT;
+
+
+
+
+// most capable x86 vector extension used by FFTW codelets
+static const char *fft_wisdom_isa()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f"))
+    {
+        return "avx512";
+    }
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return "avx2";
+    }
+    if(__builtin_cpu_supports("avx"))
+    {
+        return "avx";
+    }
+    if(__builtin_cpu_supports("sse2"))
+    {
+        return "sse2";
+    }
+    return "x86";
+#elif defined(__aarch64__)
+    return "aarch64";
+#else
+    return "generic";
+#endif
+}
+
+
+
+
+static void fft_wisdom_cpumodel(
+    char  *model,
+    size_t len
+)
+{
+    FILE *fp;
+    char line[STRINGMAXLEN_DEFAULT];
+
+    strncpy(model, "unknowncpu", len - 1);
+    model[len - 1] = '\0';
+
+    if((fp = fopen("/proc/cpuinfo", "r")) == NULL)
+    {
+        return;
+    }
+
+    while(fgets(line, STRINGMAXLEN_DEFAULT, fp) != NULL)
+    {
+        // x86: "model name", arm: "CPU part"
+        if((strncmp(line, "model name", 10) == 0)
+                || (strncmp(line, "CPU part", 8) == 0))
+        {
+            char *pch = strchr(line, ':');
+            if(pch != NULL)
+            {
+                pch++;
+                while(*pch == ' ')
+                {
+                    pch++;
+                }
+                strncpy(model, pch, len - 1);
+                model[len - 1] = '\0';
+                break;
+            }
+        }
+    }
+    fclose(fp);
+}
+
+
+
+
+static void fft_wisdom_hostkey_init()
+{
+    char model[STRINGMAXLEN_DEFAULT];
+    // FFTW threads always initialized (fft_plancache.c)
+    const char *threadmode = "mt";
+
+    fft_wisdom_cpumodel(model, STRINGMAXLEN_DEFAULT);
+
+    snprintf(wisdom_hostkey, FFT_WISDOM_HOSTKEYLEN, "%s_%s_%s_%s",
+             model, fft_wisdom_isa(), fftw_version, threadmode);
+
+    // keep file name safe
+    for(char *pch = wisdom_hostkey; *pch != '\0'; pch++)
+    {
+        if((*pch == '\n') && (pch[1] == '\0'))
+        {
+            *pch = '\0';
+            break;
+        }
+        if(!(((*pch >= 'a') && (*pch <= 'z')) || ((*pch >= 'A') && (*pch <= 'Z'))
+                || ((*pch >= '0') && (*pch <= '9')) || (*pch == '.') || (*pch == '-')
+                || (*pch == '_')))
+        {
+            *pch = '-';
+        }
+    }
+}
+
+
+
+
+/**
+ * @brief Key identifying wisdom compatible with this host
+ *
+ * cpumodel_isa_fftwversion_threadmode, restricted to [A-Za-z0-9._-]
+ */
+const char *fft_wisdom_hostkey()
+{
+    pthread_once(&wisdom_hostkey_once, fft_wisdom_hostkey_init);
+    return wisdom_hostkey;
+}
+
+
+
+
+errno_t fft_wisdom_fname(
+    char *fname,
+    int   precision
+)
+{
+    WRITE_FULLFILENAME(fname, "%s/%s_wisdom_%s.dat", FFTCONFIGDIR,
+                       (precision == FFT_PRECISION_SINGLE) ? "fftwf" : "fftw",
+                       fft_wisdom_hostkey());
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+static int fft_wisdom_importfile(
+    int         precision,
+    const char *fname
+)
+{
+    int ret;
+
+    fft_plancache_plannerlock();
+    if(precision == FFT_PRECISION_SINGLE)
+    {
+        ret = fftwf_import_wisdom_from_filename(fname);
+    }
+    else
+    {
+        ret = fftw_import_wisdom_from_filename(fname);
+    }
+    fft_plancache_plannerunlock();
+
+    return ret;
+}
+
+
+
+
+static errno_t fft_wisdom_exportfile(
+    int precision
+)
+{
+    char fname[STRINGMAXLEN_FULLFILENAME];
+    char fnamelock[STRINGMAXLEN_FULLFILENAME];
+    char fnametmp[STRINGMAXLEN_FULLFILENAME];
+    int  fdlock;
+    int  ret;
+
+    fft_wisdom_fname(fname, precision);
+    WRITE_FULLFILENAME(fnamelock, "%s.lock", fname);
+    WRITE_FULLFILENAME(fnametmp, "%s.%d.tmp", fname, (int) getpid());
+
+    if((fdlock = open(fnamelock, O_RDWR | O_CREAT, 0644)) == -1)
+    {
+        PRINT_ERROR("Cannot open wisdom lock file \"%s\"", fnamelock);
+        return RETURN_FAILURE;
+    }
+    if(flock(fdlock, LOCK_EX) == -1)
+    {
+        PRINT_ERROR("Cannot lock wisdom file \"%s\"", fnamelock);
+        close(fdlock);
+        return RETURN_FAILURE;
+    }
+
+    // merge wisdom written by other processes since our last import
+    if(access(fname, R_OK) == 0)
+    {
+        if(fft_wisdom_importfile(precision, fname) == 0)
+        {
+            PRINT_WARNING("Cannot read wisdom file \"%s\", overwriting", fname);
+        }
+    }
+
+    fft_plancache_plannerlock();
+    if(precision == FFT_PRECISION_SINGLE)
+    {
+        ret = fftwf_export_wisdom_to_filename(fnametmp);
+    }
+    else
+    {
+        ret = fftw_export_wisdom_to_filename(fnametmp);
+    }
+    fft_plancache_plannerunlock();
+
+    if(ret == 0)
+    {
+        PRINT_ERROR("Error writing wisdom file \"%s\"", fnametmp);
+        unlink(fnametmp);
+        flock(fdlock, LOCK_UN);
+        close(fdlock);
+        return RETURN_FAILURE;
+    }
+
+    if(rename(fnametmp, fname) == -1)
+    {
+        PRINT_ERROR("Cannot rename \"%s\" to \"%s\"", fnametmp, fname);
+        unlink(fnametmp);
+        flock(fdlock, LOCK_UN);
+        close(fdlock);
+        return RETURN_FAILURE;
+    }
+
+    flock(fdlock, LOCK_UN);
+    close(fdlock);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// import wisdom file, wisdom_mutex held
+static errno_t fft_wisdom_loadfile(
+    int precision
+)
+{
+    char fname[STRINGMAXLEN_FULLFILENAME];
+    struct timespec t0, t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    fft_wisdom_fname(fname, precision);
+    wisdom_found[precision] = 0;
+    // file is replaced atomically by writers: no lock needed
+    if(access(fname, R_OK) == 0)
+    {
+        if(fft_wisdom_importfile(precision, fname) == 0)
+        {
+            PRINT_ERROR("Error reading wisdom file \"%s\"", fname);
+        }
+        else
+        {
+            wisdom_found[precision] = 1;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    wisdom_loadtime[precision] = 1.0 * (t1.tv_sec - t0.tv_sec) + 1.0e-9 *
+                                 (t1.tv_nsec - t0.tv_nsec);
+    wisdom_loaded[precision] = 1;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Import wisdom for precision, if not already done
+ *
+ * Called before any plan creation.
+ */
+errno_t fft_wisdom_load(
+    int precision
+)
+{
+    pthread_mutex_lock(&wisdom_mutex);
+    if(wisdom_loaded[precision] == 0)
+    {
+        fft_wisdom_loadfile(precision);
+    }
+    pthread_mutex_unlock(&wisdom_mutex);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Mark wisdom as not loaded, after FFTW forgot it
+ *
+ * Wisdom is imported again on next plan request.
+ */
+errno_t fft_wisdom_unload(
+    int precision
+)
+{
+    pthread_mutex_lock(&wisdom_mutex);
+    wisdom_loaded[precision] = 0;
+    pthread_mutex_unlock(&wisdom_mutex);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+errno_t fft_wisdom_info()
+{
+    printf("wisdom host key : %s\n", fft_wisdom_hostkey());
+
+    pthread_mutex_lock(&wisdom_mutex);
+    for(int precision = FFT_PRECISION_SINGLE; precision <= FFT_PRECISION_DOUBLE;
+            precision++)
+    {
+        char fname[STRINGMAXLEN_FULLFILENAME];
+
+        fft_wisdom_fname(fname, precision);
+        printf("%s precision : %s\n",
+               (precision == FFT_PRECISION_SINGLE) ? "single" : "double", fname);
+        if(wisdom_loaded[precision] == 0)
+        {
+            printf("    not loaded\n");
+        }
+        else
+        {
+            printf("    %s, import time %.3f ms\n",
+                   (wisdom_found[precision] == 1) ? "loaded" : "no file",
+                   wisdom_loadtime[precision] * 1000.0);
+        }
+    }
+    pthread_mutex_unlock(&wisdom_mutex);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Import wisdom files for both precisions
+ *
+ * Re-reads files even if already loaded, to pick up wisdom written by
+ * other processes.
+ */
+errno_t import_wisdom()
+{
+    int nowisdomWarning = 0;
+
+    pthread_mutex_lock(&wisdom_mutex);
+    for(int precision = FFT_PRECISION_SINGLE; precision <= FFT_PRECISION_DOUBLE;
+            precision++)
+    {
+        fft_wisdom_loadfile(precision);
+        if(wisdom_found[precision] == 0)
+        {
+            nowisdomWarning = 1;
+        }
+    }
+    pthread_mutex_unlock(&wisdom_mutex);
+
+    if(nowisdomWarning == 1)
+    {
+        printf("(no fftw wisdom file for host key %s, run initfft to create)\n",
+               fft_wisdom_hostkey());
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// mkdir -p FFTCONFIGDIR
+static void fft_wisdom_mkdirinit()
+{
+    char dirname[STRINGMAXLEN_FULLFILENAME];
+
+    strncpy(dirname, FFTCONFIGDIR, STRINGMAXLEN_FULLFILENAME - 1);
+    dirname[STRINGMAXLEN_FULLFILENAME - 1] = '\0';
+
+    wisdom_dirstatus = RETURN_SUCCESS;
+    for(char *pch = dirname + 1; ; pch++)
+    {
+        if(((*pch == '/') || (*pch == '\0')) && (pch[-1] != '/'))
+        {
+            char c = *pch;
+
+            *pch = '\0';
+            if((mkdir(dirname, 0755) == -1) && (errno != EEXIST))
+            {
+                PRINT_ERROR("Cannot create directory \"%s\"", dirname);
+                wisdom_dirstatus = RETURN_FAILURE;
+                return;
+            }
+            *pch = c;
+            if(c == '\0')
+            {
+                break;
+            }
+        }
+    }
+}
+
+
+
+
+/**
+ * @brief Create FFTCONFIGDIR if needed
+ *
+ * Done once per process, without spawning a shell.
+ */
+errno_t fft_wisdom_mkdir()
+{
+    pthread_once(&wisdom_dir_once, fft_wisdom_mkdirinit);
+
+    return wisdom_dirstatus;
+}
+
+
+
+
+errno_t export_wisdom()
+{
+    errno_t ret = RETURN_SUCCESS;
+
+    if(fft_wisdom_mkdir() != RETURN_SUCCESS)
+    {
+        return RETURN_FAILURE;
+    }
+
+    for(int precision = FFT_PRECISION_SINGLE; precision <= FFT_PRECISION_DOUBLE;
+            precision++)
+    {
+        if(fft_wisdom_exportfile(precision) != RETURN_SUCCESS)
+        {
+            ret = RETURN_FAILURE;
+        }
+    }
+
+    return ret;
+}
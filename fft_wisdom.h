@@ -0,0 +1,29 @@
+/**
+ * @file    fft_wisdom.h
+ *
+ */
+
+#ifndef _FFT_WISDOM_H
+#define _FFT_WISDOM_H
+
+
+const char *fft_wisdom_hostkey();
+
+errno_t fft_wisdom_fname(
+    char *fname,
+    int   precision
+);
+
+errno_t fft_wisdom_load(
+    int precision
+);
+
+errno_t fft_wisdom_unload(
+    int precision
+);
+
+errno_t fft_wisdom_info();
+
+errno_t fft_wisdom_mkdir();
+
+#endif
@@ -0,0 +1,589 @@
+/**
+ * @file    fft_wisdomgen.c
+ * @brief   Generate FFTW wisdom for a list of transforms
+ *
+ * Manifest file, one transform per line :
+ *
+ *     # kind     precision  size           [nthreads] [mode]
+ *     c2c        fd         120x120
+ *     c2c,r2c    f          384x384
+ *     c2r        d          256x256x100    1          patient
+ *     c2c        f          120x120        patient
+ *     all        f          4096
+ *     c2c,r2c    f          2048r500
+ *
+ * kind      : comma-separated list of c2c (both directions), r2c, c2r, or all
+ * precision : f (single), d (double) or fd (both)
+ * size      : size0[xsize1[xsize2]]
+ *             size2 is the number of slices of a cube, transformed as a
+ *             batch of 2D transforms as in do2dfft / do2drfft
+ *             or size0rnrow : 1D transforms of size0 on each of nrow rows,
+ *             as done by do1dfft / do1drfft on a size0 x nrow image
+ * nthreads  : number of FFTW threads, 0 for automatic as at runtime (default)
+ * mode      : estimate, measure, patient or exhaustive (default), may
+ *             follow size directly when nthreads is omitted
+ *
+ * Transforms already in wisdom are skipped, so an interrupted run can be
+ * resumed. Entries are spread across worker processes. Each worker saves
+ * its wisdom after every transform into a part file, and part files are
+ * merged into the wisdom files at the end of the run (or at the start of
+ * the next run, if interrupted).
+ *
+ * Workers compete for cores and caches while measuring: NBproc should not
+ * exceed the number of physical cores.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft/fft.h"
+
+#include "fft_plancache.h"
+#include "fft_planpolicy.h"
+#include "fft_wisdom.h"
+#include "fft_wisdomgen.h"
+
+
+
+#define FFT_WISDOMGEN_KIND_C2C  0x01
+#define FFT_WISDOMGEN_KIND_R2C  0x02
+#define FFT_WISDOMGEN_KIND_C2R  0x04
+
+#define FFT_WISDOMGEN_PREC_SINGLE  0x01
+#define FFT_WISDOMGEN_PREC_DOUBLE  0x02
+
+
+typedef struct
+{
+    int      kindmask;
+    int      precmask;
+    int      naxis;
+    int      size[3];
+    int      nthreads;
+    unsigned flags;
+} FFT_WISDOMGEN_ENTRY;
+
+
+
+
+static errno_t fft_wisdomgen_addentry(
+    FFT_WISDOMGEN_ENTRY **entries,
+    long                 *NBentry,
+    FFT_WISDOMGEN_ENTRY  *entry
+)
+{
+    FFT_WISDOMGEN_ENTRY *tmp;
+
+    tmp = (FFT_WISDOMGEN_ENTRY *) realloc(*entries,
+                                          sizeof(FFT_WISDOMGEN_ENTRY) * (*NBentry + 1));
+    if(tmp == NULL)
+    {
+        PRINT_ERROR("realloc error");
+        return RETURN_FAILURE;
+    }
+    *entries = tmp;
+    (*entries)[*NBentry] = *entry;
+    (*NBentry)++;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// 2^n x 2^n 2D and 2^n 1D transforms, as optimized by initfft in earlier versions
+static errno_t fft_wisdomgen_defaultlist(
+    FFT_WISDOMGEN_ENTRY **entries,
+    long                 *NBentry
+)
+{
+    FFT_WISDOMGEN_ENTRY entry;
+
+    memset(&entry, 0, sizeof(FFT_WISDOMGEN_ENTRY));
+    entry.kindmask = FFT_WISDOMGEN_KIND_C2C | FFT_WISDOMGEN_KIND_R2C;
+    entry.precmask = FFT_WISDOMGEN_PREC_SINGLE | FFT_WISDOMGEN_PREC_DOUBLE;
+    entry.nthreads = 0;
+    entry.flags = FFTW_EXHAUSTIVE;
+
+    entry.naxis = 2;
+    for(int n = 0; n < 14; n++)
+    {
+        entry.size[0] = 1 << n;
+        entry.size[1] = 1 << n;
+        fft_wisdomgen_addentry(entries, NBentry, &entry);
+    }
+
+    entry.naxis = 1;
+    entry.size[1] = 1;
+    for(int n = 0; n < 15; n++)
+    {
+        entry.size[0] = 1 << n;
+        fft_wisdomgen_addentry(entries, NBentry, &entry);
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+static errno_t fft_wisdomgen_readmanifest(
+    const char           *fname,
+    FFT_WISDOMGEN_ENTRY **entries,
+    long                 *NBentry
+)
+{
+    FILE *fp;
+    char line[STRINGMAXLEN_DEFAULT];
+    long lineno = 0;
+
+    if((fp = fopen(fname, "r")) == NULL)
+    {
+        PRINT_ERROR("Cannot open FFT size manifest \"%s\"", fname);
+        return RETURN_FAILURE;
+    }
+
+    while(fgets(line, STRINGMAXLEN_DEFAULT, fp) != NULL)
+    {
+        FFT_WISDOMGEN_ENTRY entry;
+        char kindstr[100];
+        char precstr[100];
+        char sizestr[100];
+        char nthreadsstr[100];
+        char modestr[100];
+        int  nthreads = 0;
+        int  NBarg;
+        int  OK = 1;
+
+        lineno++;
+        if(line[0] == '#')
+        {
+            continue;
+        }
+        NBarg = sscanf(line, "%99s %99s %99s %99s %99s", kindstr, precstr, sizestr,
+                       nthreadsstr, modestr);
+        if(NBarg < 1)
+        {
+            continue;
+        }
+        if(NBarg < 3)
+        {
+            OK = 0;
+        }
+        if(NBarg > 3)
+        {
+            char *endptr;
+            long  nthreadsl = strtol(nthreadsstr, &endptr, 10);
+
+            if((endptr != nthreadsstr) && (*endptr == '\0'))
+            {
+                nthreads = (int) nthreadsl;
+            }
+            else if(NBarg == 4)
+            {
+                // mode without nthreads
+                strcpy(modestr, nthreadsstr);
+                NBarg = 5;
+            }
+            else
+            {
+                OK = 0;
+            }
+        }
+
+        memset(&entry, 0, sizeof(FFT_WISDOMGEN_ENTRY));
+        entry.nthreads = nthreads;
+        entry.flags = FFTW_EXHAUSTIVE;
+        if((OK == 1) && (NBarg > 4))
+        {
+            if(fft_planpolicy_parsemode(modestr, &entry.flags) != RETURN_SUCCESS)
+            {
+                OK = 0;
+            }
+        }
+
+        if(OK == 1)
+        {
+            char *saveptr;
+            for(char *tok = strtok_r(kindstr, ",", &saveptr); tok != NULL;
+                    tok = strtok_r(NULL, ",", &saveptr))
+            {
+                if(strcmp(tok, "c2c") == 0)
+                {
+                    entry.kindmask |= FFT_WISDOMGEN_KIND_C2C;
+                }
+                else if(strcmp(tok, "r2c") == 0)
+                {
+                    entry.kindmask |= FFT_WISDOMGEN_KIND_R2C;
+                }
+                else if(strcmp(tok, "c2r") == 0)
+                {
+                    entry.kindmask |= FFT_WISDOMGEN_KIND_C2R;
+                }
+                else if(strcmp(tok, "all") == 0)
+                {
+                    entry.kindmask |= FFT_WISDOMGEN_KIND_C2C | FFT_WISDOMGEN_KIND_R2C |
+                                      FFT_WISDOMGEN_KIND_C2R;
+                }
+                else
+                {
+                    OK = 0;
+                }
+            }
+
+            if(strchr(precstr, 'f') != NULL)
+            {
+                entry.precmask |= FFT_WISDOMGEN_PREC_SINGLE;
+            }
+            if(strchr(precstr, 'd') != NULL)
+            {
+                entry.precmask |= FFT_WISDOMGEN_PREC_DOUBLE;
+            }
+
+            entry.size[1] = 1;
+            entry.size[2] = 1;
+            if(strchr(sizestr, 'r') != NULL)
+            {
+                // batched 1D: rows in size[1]
+                entry.naxis = (sscanf(sizestr, "%dr%d", &entry.size[0], &entry.size[1]) == 2) ?
+                              1 : 0;
+            }
+            else
+            {
+                entry.naxis = sscanf(sizestr, "%dx%dx%d", &entry.size[0], &entry.size[1],
+                                     &entry.size[2]);
+            }
+        }
+
+        if((OK == 0) || (entry.kindmask == 0) || (entry.precmask == 0)
+                || (entry.naxis < 1) || (entry.nthreads < 0))
+        {
+            PRINT_WARNING("%s line %ld ignored: %s", fname, lineno, line);
+            continue;
+        }
+
+        fft_wisdomgen_addentry(entries, NBentry, &entry);
+    }
+
+    fclose(fp);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// plan key matching the transforms done by do1dfft, do1drfft, do2dfft, do2drfft
+static void fft_wisdomgen_key(
+    FFT_PLANKEY               *key,
+    const FFT_WISDOMGEN_ENTRY *entry,
+    int                        precision,
+    int                        kind,
+    int                        sign
+)
+{
+    int n0 = entry->size[0];
+    int n1 = entry->size[1];
+    int n0h = n0 / 2 + 1;
+    int is0 = (kind == FFT_KIND_C2R) ? n0h : n0;
+    int os0 = (kind == FFT_KIND_R2C) ? n0h : n0;
+
+    fft_plankey_init(key, precision, kind, sign);
+
+    if(entry->naxis == 1)
+    {
+        fft_plankey_adddim(key, n0, 1, 1);
+        if(n1 > 1)
+        {
+            // one transform per row
+            fft_plankey_addhowmany(key, n1, is0, os0);
+        }
+    }
+    else
+    {
+        fft_plankey_adddim(key, n1, is0, os0);
+        fft_plankey_adddim(key, n0, 1, 1);
+        if(entry->naxis == 3)
+        {
+            fft_plankey_addhowmany(key, entry->size[2], is0 * n1, os0 * n1);
+        }
+    }
+
+    key->nthreads = (entry->nthreads > 0) ? entry->nthreads : fft_planpolicy_nthreads(key);
+}
+
+
+
+
+static void fft_wisdomgen_partfname(
+    char *fname,
+    int   precision,
+    int   iproc
+)
+{
+    WRITE_FULLFILENAME(fname, "%s/%s_wisdom_%s_part%02d.dat", FFTCONFIGDIR,
+                       (precision == FFT_PRECISION_SINGLE) ? "fftwf" : "fftw",
+                       fft_wisdom_hostkey(), iproc);
+}
+
+
+
+
+// import and remove part files left by workers
+static long fft_wisdomgen_mergeparts()
+{
+    long NBmerged = 0;
+
+    for(int iproc = 0; iproc < FFT_WISDOMGEN_MAXPROC; iproc++)
+    {
+        for(int precision = FFT_PRECISION_SINGLE; precision <= FFT_PRECISION_DOUBLE;
+                precision++)
+        {
+            char fname[STRINGMAXLEN_FULLFILENAME];
+            int  ret;
+
+            fft_wisdomgen_partfname(fname, precision, iproc);
+            if(access(fname, R_OK) != 0)
+            {
+                continue;
+            }
+
+            fft_plancache_plannerlock();
+            if(precision == FFT_PRECISION_SINGLE)
+            {
+                ret = fftwf_import_wisdom_from_filename(fname);
+            }
+            else
+            {
+                ret = fftw_import_wisdom_from_filename(fname);
+            }
+            fft_plancache_plannerunlock();
+
+            if(ret == 0)
+            {
+                PRINT_ERROR("Error reading wisdom part file %s", fname);
+            }
+            else
+            {
+                NBmerged++;
+            }
+            unlink(fname);
+        }
+    }
+
+    return NBmerged;
+}
+
+
+
+
+static void fft_wisdomgen_worker(
+    const FFT_WISDOMGEN_ENTRY *entries,
+    long                       NBentry,
+    int                        iproc,
+    int                        NBproc
+)
+{
+    const int kindlist[] = {FFT_KIND_C2C, FFT_KIND_C2C, FFT_KIND_R2C, FFT_KIND_C2R};
+    const int signlist[] = {FFTW_FORWARD, FFTW_BACKWARD, FFTW_FORWARD, FFTW_BACKWARD};
+    const int maskbit[] = {FFT_WISDOMGEN_KIND_C2C, FFT_WISDOMGEN_KIND_C2C, FFT_WISDOMGEN_KIND_R2C, FFT_WISDOMGEN_KIND_C2R};
+    const char *kindname[] = {"c2c fwd", "c2c bwd", "r2c", "c2r"};
+
+    for(long i = iproc; i < NBentry; i += NBproc)
+    {
+        const FFT_WISDOMGEN_ENTRY *entry = &entries[i];
+
+        for(int precision = FFT_PRECISION_SINGLE; precision <= FFT_PRECISION_DOUBLE;
+                precision++)
+        {
+            int newwisdom = 0;
+
+            if(!(entry->precmask & (1 << precision)))
+            {
+                continue;
+            }
+
+            for(int k = 0; k < 4; k++)
+            {
+                FFT_PLANKEY key;
+                void  *plan;
+                double plantime;
+
+                if(!(entry->kindmask & maskbit[k]))
+                {
+                    continue;
+                }
+
+                fft_wisdomgen_key(&key, entry, precision, kindlist[k], signlist[k]);
+
+                plan = fft_plancache_scratchplan(&key, entry->flags | FFTW_WISDOM_ONLY,
+                                                 FFTW_NO_TIMELIMIT, &plantime);
+                if(plan != NULL)
+                {
+                    // already in wisdom
+                    fft_plancache_destroyplan(precision, plan);
+                    continue;
+                }
+
+                printf("[%2d] optimizing %c %-7s %5d x %5d x %5d ...", iproc,
+                       (precision == FFT_PRECISION_SINGLE) ? 'F' : 'D',
+                       kindname[k], entry->size[0], entry->size[1], entry->size[2]);
+                fflush(stdout);
+
+                plan = fft_plancache_scratchplan(&key, entry->flags, FFTW_NO_TIMELIMIT,
+                                                 &plantime);
+                if(plan == NULL)
+                {
+                    printf(" FAILED\n");
+                    continue;
+                }
+                fft_plancache_destroyplan(precision, plan);
+                printf(" %.1f sec\n", plantime);
+                fflush(stdout);
+                newwisdom = 1;
+            }
+
+            if(newwisdom == 1)
+            {
+                char fname[STRINGMAXLEN_FULLFILENAME];
+
+                fft_wisdomgen_partfname(fname, precision, iproc);
+                fft_plancache_plannerlock();
+                if(precision == FFT_PRECISION_SINGLE)
+                {
+                    fftwf_export_wisdom_to_filename(fname);
+                }
+                else
+                {
+                    fftw_export_wisdom_to_filename(fname);
+                }
+                fft_plancache_plannerunlock();
+            }
+        }
+    }
+}
+
+
+
+
+/**
+ * @brief Optimize transforms listed in manifest file and save wisdom
+ *
+ * If manifest_fname is NULL or empty, FFTCONFIGDIR/fftsizes.txt is used if
+ * it exists, otherwise 2^n 1D and 2D sizes.
+ * NBproc worker processes share the list.
+ */
+errno_t fft_wisdomgen_run(
+    const char *manifest_fname,
+    long        NBproc
+)
+{
+    FFT_WISDOMGEN_ENTRY *entries = NULL;
+    long NBentry = 0;
+    char fname[STRINGMAXLEN_FULLFILENAME];
+    errno_t ret;
+
+    if((manifest_fname != NULL) && (manifest_fname[0] != '\0'))
+    {
+        ret = fft_wisdomgen_readmanifest(manifest_fname, &entries, &NBentry);
+    }
+    else
+    {
+        WRITE_FULLFILENAME(fname, "%s/fftsizes.txt", FFTCONFIGDIR);
+        if(access(fname, R_OK) == 0)
+        {
+            ret = fft_wisdomgen_readmanifest(fname, &entries, &NBentry);
+        }
+        else
+        {
+            ret = fft_wisdomgen_defaultlist(&entries, &NBentry);
+        }
+    }
+    if(ret != RETURN_SUCCESS)
+    {
+        free(entries);
+        return ret;
+    }
+
+    if(NBproc < 1)
+    {
+        NBproc = 1;
+    }
+    if(NBproc > FFT_WISDOMGEN_MAXPROC)
+    {
+        NBproc = FFT_WISDOMGEN_MAXPROC;
+    }
+    if(NBproc > NBentry)
+    {
+        NBproc = (NBentry > 0) ? NBentry : 1;
+    }
+
+    printf("Optimization of FFTW: %ld entries, %ld process(es)\n", NBentry, NBproc);
+    printf("You can kill the optimization anytime, and resume later where it previously stopped.\n");
+    fflush(stdout);
+
+    if(fft_wisdom_mkdir() != RETURN_SUCCESS)
+    {
+        free(entries);
+        return RETURN_FAILURE;
+    }
+
+    // planner thread must not hold the planner lock when forking, and
+    // FFTW and pool worker threads are not inherited by child processes:
+    // each child starts its own pool on its first multithreaded plan
+    fft_plancache_cleanupthreads();
+
+    // load wisdom once, before workers are forked
+    import_wisdom();
+
+    // resume: wisdom saved by an interrupted run
+    if(fft_wisdomgen_mergeparts() > 0)
+    {
+        export_wisdom();
+    }
+
+    if(NBproc == 1)
+    {
+        fft_wisdomgen_worker(entries, NBentry, 0, 1);
+    }
+    else
+    {
+        pid_t pid[FFT_WISDOMGEN_MAXPROC];
+
+        for(int iproc = 0; iproc < NBproc; iproc++)
+        {
+            pid[iproc] = fork();
+            if(pid[iproc] == 0)
+            {
+                fft_wisdomgen_worker(entries, NBentry, iproc, (int) NBproc);
+                fflush(stdout);
+                _exit(0);
+            }
+            if(pid[iproc] < 0)
+            {
+                PRINT_ERROR("fork error");
+            }
+        }
+        for(int iproc = 0; iproc < NBproc; iproc++)
+        {
+            if(pid[iproc] > 0)
+            {
+                waitpid(pid[iproc], NULL, 0);
+            }
+        }
+    }
+
+    fft_wisdomgen_mergeparts();
+    export_wisdom();
+
+    free(entries);
+
+    return RETURN_SUCCESS;
+}
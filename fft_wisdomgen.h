@@ -0,0 +1,18 @@
+/**
+ * @file    fft_wisdomgen.h
+ *
+ */
+
+#ifndef _FFT_WISDOMGEN_H
+#define _FFT_WISDOMGEN_H
+
+
+#define FFT_WISDOMGEN_MAXPROC 64
+
+
+errno_t fft_wisdomgen_run(
+    const char *manifest_fname,
+    long        NBproc
+);
+
+#endif
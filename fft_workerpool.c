@@ -0,0 +1,691 @@
+/**
+ * @file    fft_workerpool.c
+ * @brief   Persistent worker threads for FFT computations
+ *
+ * All multi-threaded work in the fft module runs on this pool: FFTW
+ * threads (through fftw_threads_set_callback), slices of cube transforms
+ * (fft_batch.c), fft_DFT and permut.
+ *
+ * The pool has nthreads - 1 worker threads: the calling thread executes
+ * jobs as well. Workers can be pinned to a CPU list (one CPU per worker,
+ * round robin), run with SCHED_FIFO priority, and run on mlock'ed stacks,
+ * so that FFTs in real-time loops do not migrate onto cores used by other
+ * real-time threads and do not page-fault.
+ *
+ * Several job batches can be active at the same time, and a job can
+ * submit a nested batch (e.g. a threaded FFTW plan within a slice job).
+ * Idle workers take jobs from any active batch.
+ *
+ * Settings are set with fftpool, or in FFTCONFIGDIR/fftplanmode.conf :
+ *
+ *     pool  <nthreads> <cpulist> <rtprio> <mlock> [<stack KiB>]
+ *     pool  8 4-11 80 1 256
+ *
+ * nthreads = 0 for the number of online CPUs, cpulist = "-" for no
+ * pinning, rtprio = 0 for normal scheduling. CPU ranges can be written
+ * 4-11 or 4:11. Worker stack size 0 (or omitted) for the default
+ * FFT_WORKERPOOL_STACKSIZE: FFT jobs need little stack, and locked stacks
+ * are charged to RLIMIT_MEMLOCK.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft_workerpool.h"
+
+
+typedef struct FFT_WORKERPOOL_BATCH
+{
+    void (*jobfunc)(void *arg, int ijob);
+    void *arg;
+    int   njobs;
+    int   next;   // next job to be claimed
+    int   done;   // number of jobs completed
+
+    struct FFT_WORKERPOOL_BATCH *nextbatch;
+} FFT_WORKERPOOL_BATCH;
+
+
+// settings
+static int pool_nthreads = 0;      // 0: number of online CPUs
+static int pool_size = 0;          // resolved nthreads, atomic: 0 until first use
+static pthread_once_t pool_size_once = PTHREAD_ONCE_INIT;
+static int pool_cpulist[FFT_WORKERPOOL_MAXNB];
+static int pool_NBcpu = 0;         // 0: no pinning
+static int pool_rtprio = 0;
+static int pool_mlock = 0;
+static size_t pool_stacksize = FFT_WORKERPOOL_STACKSIZE;
+
+// state
+static int pool_running = 0;
+static int pool_stopping = 0;      // workers being joined
+static int pool_stop = 0;
+static int pool_NBworker = 0;
+static pthread_t pool_worker[FFT_WORKERPOOL_MAXNB];
+static void *pool_stack[FFT_WORKERPOOL_MAXNB];
+static size_t pool_stackused;      // stack size of running workers
+
+static FFT_WORKERPOOL_BATCH *pool_batchlist = NULL;
+
+// protects batch list and jobs counters
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_workcond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_donecond = PTHREAD_COND_INITIALIZER;
+
+// protects settings, start and stop
+// never held while waiting for jobs or workers: jobs do not take it
+static pthread_mutex_t pool_setmutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_stopcond = PTHREAD_COND_INITIALIZER;
+
+
+
+
+// parse CPU list such as "2,4-7" (or "2,4:7")
+static errno_t fft_workerpool_parsecpulist(
+    const char *cpulist,
+    int        *cpu,
+    int        *NBcpu
+)
+{
+    const char *pch = cpulist;
+
+    *NBcpu = 0;
+    if((strcmp(cpulist, "-") == 0) || (cpulist[0] == '\0'))
+    {
+        return RETURN_SUCCESS;
+    }
+
+    while(*pch != '\0')
+    {
+        char *endptr;
+        long c0, c1;
+
+        c0 = strtol(pch, &endptr, 10);
+        if(endptr == pch)
+        {
+            PRINT_ERROR("Invalid CPU list \"%s\"", cpulist);
+            return RETURN_FAILURE;
+        }
+        c1 = c0;
+        pch = endptr;
+        if((*pch == '-') || (*pch == ':'))
+        {
+            pch++;
+            c1 = strtol(pch, &endptr, 10);
+            if(endptr == pch)
+            {
+                PRINT_ERROR("Invalid CPU list \"%s\"", cpulist);
+                return RETURN_FAILURE;
+            }
+            pch = endptr;
+        }
+        for(long c = c0; (c <= c1) && (*NBcpu < FFT_WORKERPOOL_MAXNB); c++)
+        {
+            cpu[(*NBcpu)++] = (int) c;
+        }
+        if(*pch == ',')
+        {
+            pch++;
+        }
+        else if(*pch != '\0')
+        {
+            PRINT_ERROR("Invalid CPU list \"%s\"", cpulist);
+            return RETURN_FAILURE;
+        }
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// number of threads for setting nthreads, 0: online CPUs
+static int fft_workerpool_resolvesize(
+    long nthreads
+)
+{
+    if(nthreads <= 0)
+    {
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if(nthreads > FFT_WORKERPOOL_MAXNB)
+    {
+        nthreads = FFT_WORKERPOOL_MAXNB;
+    }
+
+    return (nthreads > 0) ? (int) nthreads : 1;
+}
+
+
+
+
+// default pool size, once per process unless set first
+static void fft_workerpool_size_init()
+{
+    int expected = 0;
+
+    __atomic_compare_exchange_n(&pool_size, &expected,
+                                fft_workerpool_resolvesize(0), 0,
+                                __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+
+
+
+/**
+ * @brief Set worker pool configuration
+ *
+ * Running workers are stopped, and restarted with the new settings
+ * on next use.
+ */
+errno_t fft_workerpool_set(
+    long        nthreads,
+    const char *cpulist,
+    long        rtprio,
+    long        mlockstack,
+    long        stackKiB
+)
+{
+    int cpu[FFT_WORKERPOOL_MAXNB];
+    int NBcpu;
+    size_t stacksize = FFT_WORKERPOOL_STACKSIZE;
+
+    if(fft_workerpool_parsecpulist(cpulist, cpu, &NBcpu) != RETURN_SUCCESS)
+    {
+        return RETURN_FAILURE;
+    }
+    if((rtprio < 0) || (rtprio > sched_get_priority_max(SCHED_FIFO)))
+    {
+        PRINT_ERROR("Invalid SCHED_FIFO priority %ld", rtprio);
+        return RETURN_FAILURE;
+    }
+    if(stackKiB > 0)
+    {
+        long pagesize = sysconf(_SC_PAGESIZE);
+
+        stacksize = (size_t) stackKiB * 1024;
+        if(stacksize < (size_t) PTHREAD_STACK_MIN)
+        {
+            stacksize = (size_t) PTHREAD_STACK_MIN;
+        }
+        stacksize = (stacksize + pagesize - 1) / pagesize * pagesize;
+    }
+
+    fft_workerpool_stop();
+
+    if(nthreads > FFT_WORKERPOOL_MAXNB)
+    {
+        nthreads = FFT_WORKERPOOL_MAXNB;
+    }
+
+    pthread_once(&pool_size_once, fft_workerpool_size_init);
+
+    pthread_mutex_lock(&pool_setmutex);
+    __atomic_store_n(&pool_nthreads, (nthreads > 0) ? (int) nthreads : 0,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&pool_size, fft_workerpool_resolvesize(nthreads),
+                     __ATOMIC_RELAXED);
+    memcpy(pool_cpulist, cpu, sizeof(int) * NBcpu);
+    pool_NBcpu = NBcpu;
+    pool_rtprio = (int) rtprio;
+    pool_mlock = (mlockstack > 0) ? 1 : 0;
+    pool_stacksize = stacksize;
+    pthread_mutex_unlock(&pool_setmutex);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// read without lock: called from jobs
+// online CPUs are counted once, not on every dispatch
+static int fft_workerpool_size()
+{
+    int nthreads = __atomic_load_n(&pool_size, __ATOMIC_ACQUIRE);
+
+    if(nthreads == 0)
+    {
+        pthread_once(&pool_size_once, fft_workerpool_size_init);
+        nthreads = __atomic_load_n(&pool_size, __ATOMIC_ACQUIRE);
+    }
+
+    return nthreads;
+}
+
+
+
+
+/**
+ * @brief Number of threads executing jobs, including the caller
+ *
+ * Does not lock: may be called from jobs.
+ */
+int fft_workerpool_nthreads()
+{
+    return fft_workerpool_size();
+}
+
+
+
+
+// run jobs of any batch until stop
+static void *fft_workerpool_worker(
+    __attribute__((unused)) void *ptr
+)
+{
+    pthread_mutex_lock(&pool_mutex);
+    while(pool_stop == 0)
+    {
+        FFT_WORKERPOOL_BATCH *batch = pool_batchlist;
+
+        while((batch != NULL) && (batch->next >= batch->njobs))
+        {
+            batch = batch->nextbatch;
+        }
+        if(batch == NULL)
+        {
+            pthread_cond_wait(&pool_workcond, &pool_mutex);
+            continue;
+        }
+
+        int ijob = batch->next++;
+        pthread_mutex_unlock(&pool_mutex);
+
+        batch->jobfunc(batch->arg, ijob);
+
+        pthread_mutex_lock(&pool_mutex);
+        batch->done++;
+        if(batch->done == batch->njobs)
+        {
+            pthread_cond_broadcast(&pool_donecond);
+        }
+    }
+    pthread_mutex_unlock(&pool_mutex);
+
+    return NULL;
+}
+
+
+
+
+// caller must hold pool_setmutex
+static errno_t fft_workerpool_start()
+{
+    int NBworker = fft_workerpool_size() - 1;
+
+    pool_stop = 0;
+    pool_NBworker = 0;
+    pool_stackused = pool_stacksize;
+
+    for(int iw = 0; iw < NBworker; iw++)
+    {
+        pthread_attr_t attr;
+        int ret;
+
+        pthread_attr_init(&attr);
+        pool_stack[iw] = NULL;
+
+        if(pool_mlock == 1)
+        {
+            pool_stack[iw] = mmap(NULL, pool_stackused,
+                                  PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+            if(pool_stack[iw] == MAP_FAILED)
+            {
+                pool_stack[iw] = NULL;
+                PRINT_WARNING("Cannot allocate worker stack");
+            }
+            else
+            {
+                if(mlock(pool_stack[iw], pool_stackused) != 0)
+                {
+                    PRINT_WARNING("Cannot lock worker stack in memory (RLIMIT_MEMLOCK ?)");
+                }
+                pthread_attr_setstack(&attr, pool_stack[iw], pool_stackused);
+            }
+        }
+        else
+        {
+            pthread_attr_setstacksize(&attr, pool_stackused);
+        }
+
+        if(pool_NBcpu > 0)
+        {
+            cpu_set_t cpuset;
+
+            CPU_ZERO(&cpuset);
+            CPU_SET(pool_cpulist[iw % pool_NBcpu], &cpuset);
+            pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+        }
+
+        if(pool_rtprio > 0)
+        {
+            struct sched_param schedpar;
+
+            schedpar.sched_priority = pool_rtprio;
+            pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+            pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+            pthread_attr_setschedparam(&attr, &schedpar);
+        }
+
+        ret = pthread_create(&pool_worker[iw], &attr, fft_workerpool_worker, NULL);
+        if((ret == EINVAL) && (pool_NBcpu > 0))
+        {
+            cpu_set_t cpuset;
+
+            PRINT_WARNING("Cannot pin worker to CPU %d: worker not pinned",
+                          pool_cpulist[iw % pool_NBcpu]);
+            sched_getaffinity(0, sizeof(cpu_set_t), &cpuset);
+            pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+            ret = pthread_create(&pool_worker[iw], &attr, fft_workerpool_worker, NULL);
+        }
+        if((ret == EPERM) && (pool_rtprio > 0))
+        {
+            PRINT_WARNING("No permission for SCHED_FIFO: worker runs with normal scheduling");
+            pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+            ret = pthread_create(&pool_worker[iw], &attr, fft_workerpool_worker, NULL);
+        }
+        pthread_attr_destroy(&attr);
+
+        if(ret != 0)
+        {
+            PRINT_ERROR("Cannot create FFT worker thread");
+            if(pool_stack[iw] != NULL)
+            {
+                munmap(pool_stack[iw], pool_stackused);
+            }
+            break;
+        }
+        pool_NBworker++;
+    }
+
+    __atomic_store_n(&pool_running, 1, __ATOMIC_RELEASE);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Stop worker threads
+ *
+ * Pending jobs are completed by their callers. Workers are joined without
+ * holding pool_setmutex, as a job may query the pool meanwhile.
+ * Concurrent calls return once workers are stopped.
+ */
+errno_t fft_workerpool_stop()
+{
+    pthread_t worker[FFT_WORKERPOOL_MAXNB];
+    void     *stack[FFT_WORKERPOOL_MAXNB];
+    int       NBworker;
+
+    pthread_mutex_lock(&pool_setmutex);
+    while(pool_stopping == 1)
+    {
+        pthread_cond_wait(&pool_stopcond, &pool_setmutex);
+    }
+    if(pool_running == 0)
+    {
+        pthread_mutex_unlock(&pool_setmutex);
+        return RETURN_SUCCESS;
+    }
+    pool_stopping = 1;
+    NBworker = pool_NBworker;
+    memcpy(worker, pool_worker, sizeof(pthread_t) * NBworker);
+    memcpy(stack, pool_stack, sizeof(void *) * NBworker);
+    pthread_mutex_unlock(&pool_setmutex);
+
+    pthread_mutex_lock(&pool_mutex);
+    pool_stop = 1;
+    pthread_cond_broadcast(&pool_workcond);
+    pthread_mutex_unlock(&pool_mutex);
+
+    for(int iw = 0; iw < NBworker; iw++)
+    {
+        pthread_join(worker[iw], NULL);
+        if(stack[iw] != NULL)
+        {
+            munmap(stack[iw], pool_stackused);
+        }
+    }
+
+    pthread_mutex_lock(&pool_setmutex);
+    for(int iw = 0; iw < NBworker; iw++)
+    {
+        pool_stack[iw] = NULL;
+    }
+    pool_NBworker = 0;
+    pool_stopping = 0;
+    __atomic_store_n(&pool_running, 0, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&pool_stopcond);
+    pthread_mutex_unlock(&pool_setmutex);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Run jobfunc(arg, ijob) for ijob = 0 ... njobs-1 on the pool
+ *
+ * Returns when all jobs are completed. The calling thread executes jobs.
+ * May be called from a job.
+ */
+errno_t fft_workerpool_run(
+    void (*jobfunc)(void *arg, int ijob),
+    void *arg,
+    int   njobs
+)
+{
+    FFT_WORKERPOOL_BATCH batch;
+
+    if(njobs < 2)
+    {
+        if(njobs == 1)
+        {
+            jobfunc(arg, 0);
+        }
+        return RETURN_SUCCESS;
+    }
+
+    // pool_running stays set while workers are being stopped, so that
+    // jobs calling this function do not wait for pool_setmutex
+    if(__atomic_load_n(&pool_running, __ATOMIC_ACQUIRE) == 0)
+    {
+        pthread_mutex_lock(&pool_setmutex);
+        if(pool_running == 0)
+        {
+            fft_workerpool_start();
+        }
+        pthread_mutex_unlock(&pool_setmutex);
+    }
+
+    batch.jobfunc = jobfunc;
+    batch.arg = arg;
+    batch.njobs = njobs;
+    batch.next = 0;
+    batch.done = 0;
+
+    pthread_mutex_lock(&pool_mutex);
+    batch.nextbatch = pool_batchlist;
+    pool_batchlist = &batch;
+    pthread_cond_broadcast(&pool_workcond);
+
+    while(batch.next < batch.njobs)
+    {
+        int ijob = batch.next++;
+        pthread_mutex_unlock(&pool_mutex);
+
+        jobfunc(arg, ijob);
+
+        pthread_mutex_lock(&pool_mutex);
+        batch.done++;
+    }
+    while(batch.done < batch.njobs)
+    {
+        pthread_cond_wait(&pool_donecond, &pool_mutex);
+    }
+
+    // remove batch from list
+    FFT_WORKERPOOL_BATCH **pbatch = &pool_batchlist;
+    while(*pbatch != &batch)
+    {
+        pbatch = &(*pbatch)->nextbatch;
+    }
+    *pbatch = batch.nextbatch;
+    pthread_mutex_unlock(&pool_mutex);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+typedef struct
+{
+    void (*rangefunc)(void *arg, long i0, long i1);
+    void *arg;
+    long  n;
+    int   njobs;
+} FFT_WORKERPOOL_RANGE;
+
+
+static void fft_workerpool_rangejob(
+    void *ptr,
+    int   ijob
+)
+{
+    FFT_WORKERPOOL_RANGE *range = (FFT_WORKERPOOL_RANGE *) ptr;
+    long i0 = range->n * ijob / range->njobs;
+    long i1 = range->n * (ijob + 1) / range->njobs;
+
+    if(i1 > i0)
+    {
+        range->rangefunc(range->arg, i0, i1);
+    }
+}
+
+
+/**
+ * @brief Split loop 0 ... n-1 in contiguous ranges run on the pool
+ *
+ * rangefunc(arg, i0, i1) processes indices i0 to i1-1.
+ */
+errno_t fft_workerpool_parallelfor(
+    void (*rangefunc)(void *arg, long i0, long i1),
+    void *arg,
+    long  n
+)
+{
+    FFT_WORKERPOOL_RANGE range;
+
+    range.rangefunc = rangefunc;
+    range.arg = arg;
+    range.n = n;
+    range.njobs = fft_workerpool_nthreads();
+    if(range.njobs > n)
+    {
+        range.njobs = (int) n;
+    }
+
+    return fft_workerpool_run(fft_workerpool_rangejob, &range, range.njobs);
+}
+
+
+
+
+typedef struct
+{
+    void *(*work)(char *);
+    char  *jobdata;
+    size_t elsize;
+} FFT_WORKERPOOL_FFTWJOB;
+
+
+static void fft_workerpool_fftwjob(
+    void *ptr,
+    int   ijob
+)
+{
+    FFT_WORKERPOOL_FFTWJOB *job = (FFT_WORKERPOOL_FFTWJOB *) ptr;
+
+    job->work(job->jobdata + job->elsize * ijob);
+}
+
+
+/**
+ * @brief FFTW parallel loop callback: FFTW threads run on the pool
+ */
+void fft_workerpool_fftwloop(
+    void *(*work)(char *),
+    char  *jobdata,
+    size_t elsize,
+    int    njobs,
+    __attribute__((unused)) void *data
+)
+{
+    FFT_WORKERPOOL_FFTWJOB job;
+
+    job.work = work;
+    job.jobdata = jobdata;
+    job.elsize = elsize;
+
+    fft_workerpool_run(fft_workerpool_fftwjob, &job, njobs);
+}
+
+
+
+
+errno_t fft_workerpool_list()
+{
+    pthread_mutex_lock(&pool_setmutex);
+
+    printf("worker pool           : %d thread(s)%s, %s\n",
+           fft_workerpool_size(),
+           (pool_nthreads > 0) ? "" : " (auto)",
+           (pool_running == 1) ? "running" : "stopped");
+    if(pool_NBcpu > 0)
+    {
+        printf("    CPUs              :");
+        for(int i = 0; i < pool_NBcpu; i++)
+        {
+            printf(" %d", pool_cpulist[i]);
+        }
+        printf("\n");
+    }
+    else
+    {
+        printf("    CPUs              : not pinned\n");
+    }
+    if(pool_rtprio > 0)
+    {
+        printf("    scheduling        : SCHED_FIFO %d\n", pool_rtprio);
+    }
+    else
+    {
+        printf("    scheduling        : normal\n");
+    }
+    printf("    worker stacks     : %zu KiB%s\n", pool_stacksize / 1024,
+           (pool_mlock == 1) ? ", locked" : "");
+
+    pthread_mutex_unlock(&pool_setmutex);
+
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file    fft_workerpool.h
+ *
+ */
+
+#ifndef _FFT_WORKERPOOL_H
+#define _FFT_WORKERPOOL_H
+
+
+#define FFT_WORKERPOOL_MAXNB     256
+#define FFT_WORKERPOOL_STACKSIZE (256 * 1024)
+
+
+errno_t fft_workerpool_set(
+    long        nthreads,
+    const char *cpulist,
+    long        rtprio,
+    long        mlockstack,
+    long        stackKiB
+);
+
+int fft_workerpool_nthreads();
+
+errno_t fft_workerpool_run(
+    void (*jobfunc)(void *arg, int ijob),
+    void *arg,
+    int   njobs
+);
+
+errno_t fft_workerpool_parallelfor(
+    void (*rangefunc)(void *arg, long i0, long i1),
+    void *arg,
+    long  n
+);
+
+void fft_workerpool_fftwloop(
+    void *(*work)(char *),
+    char  *jobdata,
+    size_t elsize,
+    int    njobs,
+    void  *data
+);
+
+errno_t fft_workerpool_stop();
+
+errno_t fft_workerpool_list();
+
+#endif
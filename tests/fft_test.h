@@ -0,0 +1,169 @@
+/**
+ * @file    fft_test.h
+ * @brief   Helpers shared by the fft module tests
+ *
+ * Each test is a standalone executable run by ctest. It calls the
+ * array-level engines of the module (no milk image), compares them with
+ * direct sums computed here in double precision, and exits with
+ * EXIT_FAILURE if any check failed.
+ *
+ */
+
+#ifndef _FFT_TEST_H
+#define _FFT_TEST_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft_plancache.h"
+
+
+// relative tolerance of engine results against double precision sums
+#define FFT_TEST_TOL(precision) (((precision) == FFT_PRECISION_SINGLE) ? 1.0e-4 : 1.0e-10)
+
+
+static long fft_test_NBcheck = 0;
+static long fft_test_NBfail = 0;
+
+
+// count check, report failure and keep going
+#define FFT_TEST_CHECK(cond, ...)                               \
+    do                                                          \
+    {                                                           \
+        fft_test_NBcheck++;                                     \
+        if(!(cond))                                             \
+        {                                                       \
+            fft_test_NBfail++;                                  \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);         \
+            printf(__VA_ARGS__);                                \
+            printf("\n");                                       \
+        }                                                       \
+    } while(0)
+
+
+
+
+// summary line, exit status of the test
+static inline int fft_test_result(
+    const char *testname
+)
+{
+    printf("%s: %ld check(s), %ld failure(s)\n", testname, fft_test_NBcheck,
+           fft_test_NBfail);
+
+    return (fft_test_NBfail == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+
+
+// deterministic pseudo-random value in [-1, 1), sequence per thread
+static inline double fft_test_random()
+{
+    static __thread uint64_t state = 88172645463325252ULL;
+
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    return 2.0 * (state >> 11) / 9007199254740992.0 - 1.0;
+}
+
+
+
+
+// element i of a float or double array
+static inline double fft_test_get(
+    int         precision,
+    const void *array,
+    long        i
+)
+{
+    return (precision == FFT_PRECISION_SINGLE) ? ((const float *) array)[i] :
+           ((const double *) array)[i];
+}
+
+
+static inline void fft_test_set(
+    int    precision,
+    void  *array,
+    long   i,
+    double v
+)
+{
+    if(precision == FFT_PRECISION_SINGLE)
+    {
+        ((float *) array)[i] = (float) v;
+    }
+    else
+    {
+        ((double *) array)[i] = v;
+    }
+}
+
+
+
+
+// largest |a - ref| over n elements of a, relative to the largest |ref|
+static inline double fft_test_maxerr(
+    int           precision,
+    const void   *a,
+    const double *ref,
+    long          n
+)
+{
+    double errmax = 0.0;
+    double refmax = 0.0;
+
+    for(long i = 0; i < n; i++)
+    {
+        double err = fabs(fft_test_get(precision, a, i) - ref[i]);
+
+        errmax = (err > errmax) ? err : errmax;
+        refmax = (fabs(ref[i]) > refmax) ? fabs(ref[i]) : refmax;
+    }
+
+    return (refmax > 0.0) ? errmax / refmax : errmax;
+}
+
+
+
+
+// direct 2D DFT of interleaved complex n0 x n1 array, n0 fastest, unscaled
+static inline void fft_test_dft(
+    long          n0,
+    long          n1,
+    int           sign,
+    const double *in,
+    double       *out
+)
+{
+    for(long k1 = 0; k1 < n1; k1++)
+    {
+        for(long k0 = 0; k0 < n0; k0++)
+        {
+            double re = 0.0;
+            double im = 0.0;
+
+            for(long j1 = 0; j1 < n1; j1++)
+            {
+                for(long j0 = 0; j0 < n0; j0++)
+                {
+                    double ph = sign * 2.0 * M_PI * (1.0 * ((k0 * j0) % n0) / n0
+                                                     + 1.0 * ((k1 * j1) % n1) / n1);
+                    const double *z = in + 2 * (j1 * n0 + j0);
+
+                    re += z[0] * cos(ph) - z[1] * sin(ph);
+                    im += z[0] * sin(ph) + z[1] * cos(ph);
+                }
+            }
+            out[2 * (k1 * n0 + k0)] = re;
+            out[2 * (k1 * n0 + k0) + 1] = im;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,165 @@
+/**
+ * @file    fft_test_autocorrelation.c
+ * @brief   Fused autocorrelation against the direct sum
+ *
+ * out(m) = sum_n in(n) in(n + m) / sqrt(N), the result of the original
+ * autocorrelation (two transforms and |X|^2 through images):
+ * - circular, for odd and even sizes, both precisions
+ * - zero padded: linear autocorrelation on the 2 naxes0 x 2 naxes1 output
+ * - cubes: each slice gives the result of the same slice as a 2D image
+ *
+ */
+
+#include <string.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft_plancache.h"
+#include "fft_autocorrelation.h"
+#include "fft_test.h"
+
+
+
+
+// direct autocorrelation of a n0 x n1 array, on a m0 x m1 output
+// circular if m0 = n0 and m1 = n1, linear (zero padded) for twice the size
+static void fft_test_autocorrelation_direct(
+    const double *in,
+    long          n0,
+    long          n1,
+    long          m0,
+    long          m1,
+    double       *out
+)
+{
+    double scale = 1.0 / sqrt(1.0 * n0 * n1);
+
+    for(long l1 = 0; l1 < m1; l1++)
+    {
+        for(long l0 = 0; l0 < m0; l0++)
+        {
+            double sum = 0.0;
+
+            for(long j1 = 0; j1 < n1; j1++)
+            {
+                for(long j0 = 0; j0 < n0; j0++)
+                {
+                    long i0 = (j0 + l0) % m0;
+                    long i1 = (j1 + l1) % m1;
+
+                    if((i0 < n0) && (i1 < n1))
+                    {
+                        sum += in[j1 * n0 + j0] * in[i1 * n0 + i0];
+                    }
+                }
+            }
+            out[l1 * m0 + l0] = sum * scale;
+        }
+    }
+}
+
+
+
+
+static void fft_test_autocorrelation(
+    int  precision,
+    long n0,
+    long n1,
+    long nbslice,
+    int  zeropad
+)
+{
+    size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                          double);
+    long npix = n0 * n1;
+    long m0 = zeropad ? 2 * n0 : n0;
+    long m1 = zeropad ? 2 * n1 : n1;
+    double *in = (double *) malloc(sizeof(double) * npix * nbslice);
+    double *ref = (double *) malloc(sizeof(double) * m0 * m1 * nbslice);
+    void *inarray = fftw_malloc(realsize * npix * nbslice);
+    void *outarray = fftw_malloc(realsize * m0 * m1 * nbslice);
+    void *slicearray = fftw_malloc(realsize * m0 * m1);
+
+    for(long i = 0; i < npix * nbslice; i++)
+    {
+        in[i] = fft_test_random();
+        fft_test_set(precision, inarray, i, in[i]);
+    }
+    for(long k = 0; k < nbslice; k++)
+    {
+        fft_test_autocorrelation_direct(in + k * npix, n0, n1, m0, m1,
+                                        ref + k * m0 * m1);
+    }
+
+    fft_autocorrelation_array(precision, n0, n1, nbslice, inarray, outarray,
+                              zeropad);
+    FFT_TEST_CHECK(fft_test_maxerr(precision, outarray, ref,
+                                   m0 * m1 * nbslice) < FFT_TEST_TOL(precision),
+                   "%ld x %ld x %ld, precision %d, zeropad %d: wrong autocorrelation", n0, n1,
+                   nbslice, precision, zeropad);
+
+    // input not modified
+    for(long i = 0; i < npix * nbslice; i++)
+    {
+        if(fft_test_get(precision, inarray, i) != (precision == FFT_PRECISION_SINGLE ?
+                (float) in[i] : in[i]))
+        {
+            FFT_TEST_CHECK(0, "%ld x %ld x %ld, precision %d, zeropad %d: input modified",
+                           n0, n1, nbslice, precision, zeropad);
+            break;
+        }
+    }
+
+    // cube slice normalized as the 2D image
+    if(nbslice > 1)
+    {
+        fft_autocorrelation_array(precision, n0, n1, 1,
+                                  (char *) inarray + realsize * npix * (nbslice - 1), slicearray, zeropad);
+        FFT_TEST_CHECK(fft_test_maxerr(precision, slicearray,
+                                       ref + m0 * m1 * (nbslice - 1), m0 * m1) < FFT_TEST_TOL(precision),
+                       "%ld x %ld, precision %d, zeropad %d: 2D result differs from cube slice", n0,
+                       n1, precision, zeropad);
+    }
+
+    free(in);
+    free(ref);
+    fftw_free(inarray);
+    fftw_free(outarray);
+    fftw_free(slicearray);
+}
+
+
+
+
+int main()
+{
+    const long sizes[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 12};
+    const int NBsize = sizeof(sizes) / sizeof(sizes[0]);
+
+    for(int precision = FFT_PRECISION_SINGLE; precision <= FFT_PRECISION_DOUBLE;
+            precision++)
+    {
+        for(int i0 = 0; i0 < NBsize; i0++)
+        {
+            for(int i1 = 0; i1 < NBsize; i1++)
+            {
+                for(int zeropad = 0; zeropad < 2; zeropad++)
+                {
+                    fft_test_autocorrelation(precision, sizes[i0], sizes[i1], 1, zeropad);
+                }
+            }
+        }
+        for(int zeropad = 0; zeropad < 2; zeropad++)
+        {
+            fft_test_autocorrelation(precision, 8, 6, 3, zeropad);
+            fft_test_autocorrelation(precision, 7, 5, 3, zeropad);
+            fft_test_autocorrelation(precision, 6, 9, 2, zeropad);
+        }
+    }
+
+    fft_plancache_cleanupthreads();
+
+    return fft_test_result("fft_test_autocorrelation");
+}
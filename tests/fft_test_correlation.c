@@ -0,0 +1,179 @@
+/**
+ * @file    fft_test_correlation.c
+ * @brief   Fused correlation engine against the direct correlation sum
+ *
+ * out(m) = sum_n in1(n) in2(n + m) / sqrt(N), circular, through
+ * fft_correlation_rfft, fft_correlation_crossmult and fft_correlation_c2r:
+ * - centered (zero lag at (naxes0/2, naxes1/2)) and uncentered, for odd,
+ *   even and mixed sizes: even sizes take the modulated cross spectrum
+ *   path, others the fftshift after c2r
+ * - both precisions
+ * - cubes, with either input broadcast as a single reference slice
+ * - reference spectrum stored conjugated (conjugate = 0)
+ *
+ */
+
+#include <string.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft_plancache.h"
+#include "fft_correlation.h"
+#include "fft_test.h"
+
+
+
+
+// direct circular correlation of n0 x n1 arrays in1 and in2
+static void fft_test_correlation_direct(
+    const double *in1,
+    const double *in2,
+    long          n0,
+    long          n1,
+    int           centered,
+    double       *out
+)
+{
+    double scale = 1.0 / sqrt(1.0 * n0 * n1);
+
+    for(long m1 = 0; m1 < n1; m1++)
+    {
+        for(long m0 = 0; m0 < n0; m0++)
+        {
+            double sum = 0.0;
+            long o0 = centered ? (m0 + n0 / 2) % n0 : m0;
+            long o1 = centered ? (m1 + n1 / 2) % n1 : m1;
+
+            for(long j1 = 0; j1 < n1; j1++)
+            {
+                for(long j0 = 0; j0 < n0; j0++)
+                {
+                    sum += in1[j1 * n0 + j0] * in2[((j1 + m1) % n1) * n0 + (j0 + m0) % n0];
+                }
+            }
+            out[o1 * n0 + o0] = sum * scale;
+        }
+    }
+}
+
+
+
+
+static void fft_test_correlation(
+    int  precision,
+    long n0,
+    long n1,
+    long nbslice1,
+    long nbslice2,
+    int  centered,
+    int  conjugate
+)
+{
+    size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                          double);
+    long npix = n0 * n1;
+    long nbslice = (nbslice1 > nbslice2) ? nbslice1 : nbslice2;
+    size_t specsize = 2 * realsize * (n0 / 2 + 1) * n1;
+    double *in1 = (double *) malloc(sizeof(double) * npix * nbslice1);
+    double *in2 = (double *) malloc(sizeof(double) * npix * nbslice2);
+    double *ref = (double *) malloc(sizeof(double) * npix * nbslice);
+    void *array1 = fftw_malloc(realsize * npix * nbslice1);
+    void *array2 = fftw_malloc(realsize * npix * nbslice2);
+    void *spec1 = fftw_malloc(specsize * nbslice1);
+    void *spec2 = fftw_malloc(specsize * nbslice2);
+    void *out = fftw_malloc(realsize * npix * nbslice);
+    void *specout;
+
+    for(long i = 0; i < npix * nbslice1; i++)
+    {
+        in1[i] = fft_test_random();
+        fft_test_set(precision, array1, i, in1[i]);
+    }
+    for(long i = 0; i < npix * nbslice2; i++)
+    {
+        in2[i] = fft_test_random();
+        fft_test_set(precision, array2, i, in2[i]);
+    }
+    for(long k = 0; k < nbslice; k++)
+    {
+        fft_test_correlation_direct(in1 + ((nbslice1 > 1) ? k * npix : 0),
+                                    in2 + ((nbslice2 > 1) ? k * npix : 0), n0, n1, centered,
+                                    ref + k * npix);
+    }
+
+    fft_correlation_rfft(precision, n0, n1, nbslice1, array1, spec1);
+    fft_correlation_rfft(precision, n0, n1, nbslice2, array2, spec2);
+    if(conjugate == 0)
+    {
+        for(long i = 0; i < (n0 / 2 + 1) * n1 * nbslice1; i++)
+        {
+            fft_test_set(precision, spec1, 2 * i + 1, -fft_test_get(precision, spec1,
+                         2 * i + 1));
+        }
+    }
+
+    // in place in the spectrum holding all slices
+    specout = (nbslice1 == nbslice) ? spec1 : spec2;
+    fft_correlation_crossmult(precision, n0, n1, nbslice, spec1, nbslice1, spec2,
+                              nbslice2, specout, conjugate, centered);
+    fft_correlation_c2r(precision, n0, n1, nbslice, specout, out, centered);
+
+    FFT_TEST_CHECK(fft_test_maxerr(precision, out, ref,
+                                   npix * nbslice) < FFT_TEST_TOL(precision),
+                   "%ld x %ld, slices %ld/%ld, precision %d, centered %d, conjugate %d: wrong correlation",
+                   n0, n1, nbslice1, nbslice2, precision, centered, conjugate);
+
+    free(in1);
+    free(in2);
+    free(ref);
+    fftw_free(array1);
+    fftw_free(array2);
+    fftw_free(spec1);
+    fftw_free(spec2);
+    fftw_free(out);
+}
+
+
+
+
+int main()
+{
+    const long sizes[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 12};
+    const int NBsize = sizeof(sizes) / sizeof(sizes[0]);
+
+    for(int precision = FFT_PRECISION_SINGLE; precision <= FFT_PRECISION_DOUBLE;
+            precision++)
+    {
+        for(int i0 = 0; i0 < NBsize; i0++)
+        {
+            for(int i1 = 0; i1 < NBsize; i1++)
+            {
+                for(int centered = 0; centered < 2; centered++)
+                {
+                    fft_test_correlation(precision, sizes[i0], sizes[i1], 1, 1, centered, 1);
+                }
+            }
+        }
+
+        // cubes, odd and even sizes
+        for(int centered = 0; centered < 2; centered++)
+        {
+            fft_test_correlation(precision, 8, 6, 3, 3, centered, 1);
+            fft_test_correlation(precision, 7, 5, 3, 3, centered, 1);
+            fft_test_correlation(precision, 8, 6, 1, 4, centered, 1);
+            fft_test_correlation(precision, 9, 4, 1, 4, centered, 1);
+            fft_test_correlation(precision, 6, 6, 4, 1, centered, 1);
+            fft_test_correlation(precision, 5, 7, 4, 1, centered, 1);
+
+            // conjugated reference spectrum
+            fft_test_correlation(precision, 8, 8, 1, 3, centered, 0);
+            fft_test_correlation(precision, 7, 9, 1, 3, centered, 0);
+        }
+    }
+
+    fft_plancache_cleanupthreads();
+
+    return fft_test_result("fft_test_correlation");
+}
@@ -0,0 +1,124 @@
+/**
+ * @file    fft_test_do2dfft.c
+ * @brief   Centered complex 2D transform against the direct DFT
+ *
+ * FFT_do2dfft_array, the engine of do2dfft and do2dfft_centered:
+ * - uncentered: DFT of each slice, forward and backward
+ * - centered: fftshift(DFT(ifftshift(x))), the result of the original
+ *   permut / transform / permut sequence for even sizes; even sizes take
+ *   the modulated spectrum path, others the shifted copy
+ * - odd, even and mixed sizes, both precisions, cubes
+ *
+ */
+
+#include <string.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft.h"
+#include "fft_plancache.h"
+#include "fft_shift.h"
+#include "fft_test.h"
+
+
+
+
+static void fft_test_do2dfft(
+    int  precision,
+    long n0,
+    long n1,
+    long nbslice,
+    int  dir,
+    int  centered
+)
+{
+    size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                          double);
+    long npix = n0 * n1;
+    long size[2] = {n0, n1};
+    double *x = (double *) malloc(sizeof(double) * 2 * npix * nbslice);
+    double *xs = (double *) malloc(sizeof(double) * 2 * npix);
+    double *ref = (double *) malloc(sizeof(double) * 2 * npix * nbslice);
+    void *inarray = fftw_malloc(2 * realsize * npix * nbslice);
+    void *outarray = fftw_malloc(2 * realsize * npix * nbslice);
+
+    for(long i = 0; i < 2 * npix * nbslice; i++)
+    {
+        x[i] = fft_test_random();
+        fft_test_set(precision, inarray, i, x[i]);
+    }
+    for(long k = 0; k < nbslice; k++)
+    {
+        memcpy(xs, x + 2 * k * npix, sizeof(double) * 2 * npix);
+        if(centered)
+        {
+            fft_shift_axes(xs, 2 * sizeof(double), 2, size, 3, 1);
+        }
+        fft_test_dft(n0, n1, dir, xs, ref + 2 * k * npix);
+        if(centered)
+        {
+            fft_shift_axes(ref + 2 * k * npix, 2 * sizeof(double), 2, size, 3, 0);
+        }
+    }
+
+    FFT_do2dfft_array(precision, n0, n1, nbslice, inarray, outarray, dir,
+                      centered);
+    FFT_TEST_CHECK(fft_test_maxerr(precision, outarray, ref,
+                                   2 * npix * nbslice) < FFT_TEST_TOL(precision),
+                   "%ld x %ld x %ld, precision %d, dir %d, centered %d: wrong spectrum", n0, n1,
+                   nbslice, precision, dir, centered);
+
+    // input not modified
+    for(long i = 0; i < 2 * npix * nbslice; i++)
+    {
+        if(fft_test_get(precision, inarray, i) != (precision == FFT_PRECISION_SINGLE ?
+                (float) x[i] : x[i]))
+        {
+            FFT_TEST_CHECK(0, "%ld x %ld x %ld, precision %d, dir %d, centered %d: input modified",
+                           n0, n1, nbslice, precision, dir, centered);
+            break;
+        }
+    }
+
+    free(x);
+    free(xs);
+    free(ref);
+    fftw_free(inarray);
+    fftw_free(outarray);
+}
+
+
+
+
+int main()
+{
+    const long sizes[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 12};
+    const int NBsize = sizeof(sizes) / sizeof(sizes[0]);
+
+    for(int precision = FFT_PRECISION_SINGLE; precision <= FFT_PRECISION_DOUBLE;
+            precision++)
+    {
+        for(int dir = FFTW_FORWARD; dir <= FFTW_BACKWARD; dir += 2)
+        {
+            for(int centered = 0; centered < 2; centered++)
+            {
+                for(int i0 = 0; i0 < NBsize; i0++)
+                {
+                    for(int i1 = 0; i1 < NBsize; i1++)
+                    {
+                        fft_test_do2dfft(precision, sizes[i0], sizes[i1], 1, dir, centered);
+                    }
+                }
+                fft_test_do2dfft(precision, 8, 6, 3, dir, centered);
+                fft_test_do2dfft(precision, 7, 5, 3, dir, centered);
+                fft_test_do2dfft(precision, 6, 9, 2, dir, centered);
+            }
+        }
+    }
+
+    fft_plancache_cleanupthreads();
+
+    return fft_test_result("fft_test_do2dfft");
+}
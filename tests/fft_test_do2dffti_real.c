@@ -0,0 +1,127 @@
+/**
+ * @file    fft_test_do2dffti_real.c
+ * @brief   Real part of the inverse transform through Hermitian half rows
+ *
+ * FFT_do2dffti_real_array, the engine of do2dffti_real and
+ * do2dffti_real_centered, gives the result of the original do2dffti
+ * followed by mk_reim_from_complex:
+ * - spectrum not Hermitian: the imaginary part of the inverse is dropped
+ * - uncentered and centered, fftshift(Re(IDFT(ifftshift(X)))); even sizes
+ *   take the modulated half rows, others the shift after c2r
+ * - odd, even and mixed sizes, both precisions, cubes
+ *
+ */
+
+#include <string.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft.h"
+#include "fft_plancache.h"
+#include "fft_shift.h"
+#include "fft_test.h"
+
+
+
+
+static void fft_test_do2dffti_real(
+    int  precision,
+    long n0,
+    long n1,
+    long nbslice,
+    int  centered
+)
+{
+    size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                          double);
+    long npix = n0 * n1;
+    long size[2] = {n0, n1};
+    double *X = (double *) malloc(sizeof(double) * 2 * npix * nbslice);
+    double *Xs = (double *) malloc(sizeof(double) * 2 * npix);
+    double *x = (double *) malloc(sizeof(double) * 2 * npix);
+    double *ref = (double *) malloc(sizeof(double) * npix * nbslice);
+    void *inarray = fftw_malloc(2 * realsize * npix * nbslice);
+    void *outarray = fftw_malloc(realsize * npix * nbslice);
+
+    for(long i = 0; i < 2 * npix * nbslice; i++)
+    {
+        X[i] = fft_test_random();
+        fft_test_set(precision, inarray, i, X[i]);
+    }
+    for(long k = 0; k < nbslice; k++)
+    {
+        memcpy(Xs, X + 2 * k * npix, sizeof(double) * 2 * npix);
+        if(centered)
+        {
+            fft_shift_axes(Xs, 2 * sizeof(double), 2, size, 3, 1);
+        }
+        fft_test_dft(n0, n1, FFTW_BACKWARD, Xs, x);
+        if(centered)
+        {
+            fft_shift_axes(x, 2 * sizeof(double), 2, size, 3, 0);
+        }
+        for(long i = 0; i < npix; i++)
+        {
+            ref[k * npix + i] = x[2 * i];
+        }
+    }
+
+    FFT_do2dffti_real_array(precision, n0, n1, nbslice, inarray, outarray,
+                            centered);
+    FFT_TEST_CHECK(fft_test_maxerr(precision, outarray, ref,
+                                   npix * nbslice) < FFT_TEST_TOL(precision),
+                   "%ld x %ld x %ld, precision %d, centered %d: wrong real part", n0, n1,
+                   nbslice, precision, centered);
+
+    // input not modified
+    for(long i = 0; i < 2 * npix * nbslice; i++)
+    {
+        if(fft_test_get(precision, inarray, i) != (precision == FFT_PRECISION_SINGLE ?
+                (float) X[i] : X[i]))
+        {
+            FFT_TEST_CHECK(0, "%ld x %ld x %ld, precision %d, centered %d: input modified",
+                           n0, n1, nbslice, precision, centered);
+            break;
+        }
+    }
+
+    free(X);
+    free(Xs);
+    free(x);
+    free(ref);
+    fftw_free(inarray);
+    fftw_free(outarray);
+}
+
+
+
+
+int main()
+{
+    const long sizes[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 12};
+    const int NBsize = sizeof(sizes) / sizeof(sizes[0]);
+
+    for(int precision = FFT_PRECISION_SINGLE; precision <= FFT_PRECISION_DOUBLE;
+            precision++)
+    {
+        for(int centered = 0; centered < 2; centered++)
+        {
+            for(int i0 = 0; i0 < NBsize; i0++)
+            {
+                for(int i1 = 0; i1 < NBsize; i1++)
+                {
+                    fft_test_do2dffti_real(precision, sizes[i0], sizes[i1], 1, centered);
+                }
+            }
+            fft_test_do2dffti_real(precision, 8, 6, 3, centered);
+            fft_test_do2dffti_real(precision, 7, 5, 3, centered);
+            fft_test_do2dffti_real(precision, 6, 9, 2, centered);
+        }
+    }
+
+    fft_plancache_cleanupthreads();
+
+    return fft_test_result("fft_test_do2dffti_real");
+}
@@ -0,0 +1,148 @@
+/**
+ * @file    fft_test_do2drfft.c
+ * @brief   Real-to-complex 2D transform against the direct DFT
+ *
+ * FFT_do2drfft_array, the engine of do2drfft, do2drfft_centered and
+ * do2drfft_half:
+ * - half spectrum: the naxes0/2+1 first columns of the DFT
+ * - full spectrum expanded by Hermitian symmetry: the DFT of the real
+ *   input as a complex array, the result of the original expansion
+ * - centered full spectrum, fftshift(DFT(ifftshift(x))); even sizes take
+ *   the modulated expansion, others the shifted input copy
+ * - odd, even and mixed sizes, both precisions, cubes
+ * - centered half spectrum rejected
+ *
+ */
+
+#include <string.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft.h"
+#include "fft_plancache.h"
+#include "fft_shift.h"
+#include "fft_test.h"
+
+
+
+
+static void fft_test_do2drfft(
+    int  precision,
+    long n0,
+    long n1,
+    long nbslice,
+    int  half,
+    int  centered
+)
+{
+    size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                          double);
+    long npix = n0 * n1;
+    long m0 = half ? n0 / 2 + 1 : n0;
+    long size[2] = {n0, n1};
+    double *x = (double *) malloc(sizeof(double) * npix * nbslice);
+    double *xc = (double *) malloc(sizeof(double) * 2 * npix);
+    double *X = (double *) malloc(sizeof(double) * 2 * npix);
+    double *ref = (double *) malloc(sizeof(double) * 2 * m0 * n1 * nbslice);
+    void *inarray = fftw_malloc(realsize * npix * nbslice);
+    void *outarray = fftw_malloc(2 * realsize * m0 * n1 * nbslice);
+
+    for(long i = 0; i < npix * nbslice; i++)
+    {
+        x[i] = fft_test_random();
+        fft_test_set(precision, inarray, i, x[i]);
+    }
+    for(long k = 0; k < nbslice; k++)
+    {
+        for(long i = 0; i < npix; i++)
+        {
+            xc[2 * i] = x[k * npix + i];
+            xc[2 * i + 1] = 0.0;
+        }
+        if(centered)
+        {
+            fft_shift_axes(xc, 2 * sizeof(double), 2, size, 3, 1);
+        }
+        fft_test_dft(n0, n1, FFTW_FORWARD, xc, X);
+        if(centered)
+        {
+            fft_shift_axes(X, 2 * sizeof(double), 2, size, 3, 0);
+        }
+        for(long jj = 0; jj < n1; jj++)
+        {
+            memcpy(ref + 2 * ((k * n1 + jj) * m0), X + 2 * jj * n0,
+                   sizeof(double) * 2 * m0);
+        }
+    }
+
+    FFT_do2drfft_array(precision, n0, n1, nbslice, inarray, outarray, half,
+                       centered);
+    FFT_TEST_CHECK(fft_test_maxerr(precision, outarray, ref,
+                                   2 * m0 * n1 * nbslice) < FFT_TEST_TOL(precision),
+                   "%ld x %ld x %ld, precision %d, half %d, centered %d: wrong spectrum", n0,
+                   n1, nbslice, precision, half, centered);
+
+    // input not modified
+    for(long i = 0; i < npix * nbslice; i++)
+    {
+        if(fft_test_get(precision, inarray, i) != (precision == FFT_PRECISION_SINGLE ?
+                (float) x[i] : x[i]))
+        {
+            FFT_TEST_CHECK(0, "%ld x %ld x %ld, precision %d, half %d, centered %d: input modified",
+                           n0, n1, nbslice, precision, half, centered);
+            break;
+        }
+    }
+
+    free(x);
+    free(xc);
+    free(X);
+    free(ref);
+    fftw_free(inarray);
+    fftw_free(outarray);
+}
+
+
+
+
+int main()
+{
+    const long sizes[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 12};
+    const int NBsize = sizeof(sizes) / sizeof(sizes[0]);
+
+    for(int precision = FFT_PRECISION_SINGLE; precision <= FFT_PRECISION_DOUBLE;
+            precision++)
+    {
+        // half spectrum, full spectrum, centered full spectrum
+        for(int mode = 0; mode < 3; mode++)
+        {
+            int half = (mode == 0);
+            int centered = (mode == 2);
+
+            for(int i0 = 0; i0 < NBsize; i0++)
+            {
+                for(int i1 = 0; i1 < NBsize; i1++)
+                {
+                    fft_test_do2drfft(precision, sizes[i0], sizes[i1], 1, half, centered);
+                }
+            }
+            fft_test_do2drfft(precision, 8, 6, 3, half, centered);
+            fft_test_do2drfft(precision, 7, 5, 3, half, centered);
+            fft_test_do2drfft(precision, 6, 9, 2, half, centered);
+        }
+    }
+    {
+        double in[4] = {0.0};
+        complex_double out[6];
+
+        FFT_TEST_CHECK(FFT_do2drfft_array(FFT_PRECISION_DOUBLE, 2, 2, 1, in, out, 1,
+                                          1) == RETURN_FAILURE,
+                       "centered half spectrum accepted");
+    }
+
+    fft_plancache_cleanupthreads();
+
+    return fft_test_result("fft_test_do2drfft");
+}
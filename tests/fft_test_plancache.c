@@ -0,0 +1,290 @@
+/**
+ * @file    fft_test_plancache.c
+ * @brief   Plan cache: cached transforms, LRU eviction, flush
+ *
+ * - C2C and R2C transforms through the cache match the direct DFT, for odd
+ *   and even sizes and both precisions, on first (planning) and second
+ *   (cached) execution
+ * - with more geometries than FFT_PLANCACHE_MAXNB, the least recently used
+ *   plan is evicted, a plan kept in use is not, and evicted geometries are
+ *   planned again on their next execution
+ * - threads executing more geometries than the cache holds, so evicting
+ *   each other's plans, all get correct results
+ * - flush empties the cache, transforms are planned again afterwards
+ *
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft_plancache.h"
+#include "fft_test.h"
+
+
+#define FFT_TEST_PLANCACHE_NBTHREAD 4
+#define FFT_TEST_PLANCACHE_NBITER   200
+#define FFT_TEST_PLANCACHE_NBSIZE   (FFT_PLANCACHE_MAXNB + 32)
+
+
+
+
+static void fft_test_plancache_c2ckey(
+    FFT_PLANKEY *key,
+    int          precision,
+    long         n0,
+    long         n1
+)
+{
+    long size[2] = {n0, n1};
+
+    fft_plankey_init(key, precision, FFT_KIND_C2C, FFTW_FORWARD);
+    fft_plankey_addaxes(key, (n1 > 1) ? 2 : 1, size, (n1 > 1) ? 3 : 1);
+}
+
+
+
+
+// C2C n0 x n1 forward transform through the cache against direct DFT
+// returns relative error
+static double fft_test_plancache_c2c(
+    int  precision,
+    long n0,
+    long n1
+)
+{
+    size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                          double);
+    long n = n0 * n1;
+    FFT_PLANKEY key;
+    double *in = (double *) malloc(sizeof(double) * 2 * n);
+    double *ref = (double *) malloc(sizeof(double) * 2 * n);
+    void *a = fftw_malloc(2 * realsize * n);
+    void *b = fftw_malloc(2 * realsize * n);
+    double err;
+
+    for(long i = 0; i < 2 * n; i++)
+    {
+        in[i] = fft_test_random();
+        fft_test_set(precision, a, i, in[i]);
+    }
+    fft_test_dft(n0, n1, FFTW_FORWARD, in, ref);
+
+    fft_test_plancache_c2ckey(&key, precision, n0, n1);
+    if(fft_plancache_execute(&key, a, b) != RETURN_SUCCESS)
+    {
+        err = HUGE_VAL;
+    }
+    else
+    {
+        err = fft_test_maxerr(precision, b, ref, 2 * n);
+    }
+
+    free(in);
+    free(ref);
+    fftw_free(a);
+    fftw_free(b);
+
+    return err;
+}
+
+
+
+
+// whether the 1D C2C plan of size n on fftw_malloc'ed arrays is in cache
+static int fft_test_plancache_cached(
+    int  precision,
+    long n
+)
+{
+    size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                          double);
+    FFT_PLANKEY key;
+    void *a = fftw_malloc(2 * realsize * n);
+    void *b = fftw_malloc(2 * realsize * n);
+    int cached;
+
+    fft_test_plancache_c2ckey(&key, precision, n, 1);
+    cached = fft_plancache_cached(&key, a, b);
+    fftw_free(a);
+    fftw_free(b);
+
+    return cached;
+}
+
+
+
+
+static void fft_test_plancache_r2c(
+    int  precision,
+    long n0,
+    long n1
+)
+{
+    size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                          double);
+    long n = n0 * n1;
+    long n0h = n0 / 2 + 1;
+    long size[2] = {n0, n1};
+    FFT_PLANKEY key;
+    double *in = (double *) malloc(sizeof(double) * 2 * n);
+    double *ref = (double *) malloc(sizeof(double) * 2 * n);
+    double *refh = (double *) malloc(sizeof(double) * 2 * n0h * n1);
+    void *a = fftw_malloc(realsize * n);
+    void *b = fftw_malloc(2 * realsize * n0h * n1);
+
+    for(long i = 0; i < n; i++)
+    {
+        in[2 * i] = fft_test_random();
+        in[2 * i + 1] = 0.0;
+        fft_test_set(precision, a, i, in[2 * i]);
+    }
+    fft_test_dft(n0, n1, FFTW_FORWARD, in, ref);
+    for(long jj = 0; jj < n1; jj++)
+    {
+        memcpy(refh + 2 * jj * n0h, ref + 2 * jj * n0, sizeof(double) * 2 * n0h);
+    }
+
+    // first execution plans, second one runs the cached plan
+    for(int pass = 0; pass < 2; pass++)
+    {
+        fft_plankey_init(&key, precision, FFT_KIND_R2C, FFTW_FORWARD);
+        fft_plankey_addaxes(&key, 2, size, 3);
+        FFT_TEST_CHECK(fft_plancache_execute(&key, a, b) == RETURN_SUCCESS,
+                       "r2c %ld x %ld precision %d pass %d: execute", n0, n1, precision, pass);
+        FFT_TEST_CHECK(fft_test_maxerr(precision, b, refh,
+                                       2 * n0h * n1) < FFT_TEST_TOL(precision),
+                       "r2c %ld x %ld precision %d pass %d: wrong transform", n0, n1,
+                       precision, pass);
+    }
+
+    free(in);
+    free(ref);
+    free(refh);
+    fftw_free(a);
+    fftw_free(b);
+}
+
+
+
+
+// one thread: transforms of sizes spread over more geometries than cached
+static void *fft_test_plancache_thread(
+    void *ptr
+)
+{
+    long ithread = (long) ptr;
+    long *NBbad = (long *) malloc(sizeof(long));
+
+    *NBbad = 0;
+    for(long iter = 0; iter < FFT_TEST_PLANCACHE_NBITER; iter++)
+    {
+        long n = 1 + (iter * 37 + ithread * 101) % FFT_TEST_PLANCACHE_NBSIZE;
+        int precision = (iter % 2 == 0) ? FFT_PRECISION_SINGLE : FFT_PRECISION_DOUBLE;
+
+        if(!(fft_test_plancache_c2c(precision, n, 1) < FFT_TEST_TOL(precision)))
+        {
+            (*NBbad)++;
+        }
+    }
+
+    return NBbad;
+}
+
+
+
+
+int main()
+{
+    const long sizes[] = {1, 2, 3, 4, 5, 7, 8, 9, 12, 15};
+    const int NBsize = sizeof(sizes) / sizeof(sizes[0]);
+
+    // transforms, odd and even sizes, planned then cached
+    for(int precision = FFT_PRECISION_SINGLE; precision <= FFT_PRECISION_DOUBLE;
+            precision++)
+    {
+        for(int i0 = 0; i0 < NBsize; i0++)
+        {
+            for(int i1 = 0; i1 < NBsize; i1 += 3)
+            {
+                long n0 = sizes[i0];
+                long n1 = sizes[i1];
+
+                for(int pass = 0; pass < 2; pass++)
+                {
+                    FFT_TEST_CHECK(fft_test_plancache_c2c(precision, n0,
+                                                          n1) < FFT_TEST_TOL(precision),
+                                   "c2c %ld x %ld precision %d pass %d: wrong transform", n0, n1,
+                                   precision, pass);
+                }
+                fft_test_plancache_r2c(precision, n0, n1);
+            }
+        }
+    }
+
+
+    // LRU eviction: size 2 used after each new size, sizes from 3 on used once
+    fft_plancache_flush();
+    fft_test_plancache_c2c(FFT_PRECISION_DOUBLE, 2, 1);
+    for(long n = 3; n < FFT_PLANCACHE_MAXNB + 10; n++)
+    {
+        fft_test_plancache_c2c(FFT_PRECISION_DOUBLE, n, 1);
+        fft_test_plancache_c2c(FFT_PRECISION_DOUBLE, 2, 1);
+    }
+    FFT_TEST_CHECK(fft_test_plancache_cached(FFT_PRECISION_DOUBLE, 2) == 1,
+                   "plan in use evicted");
+    for(long n = 3; n < 11; n++)
+    {
+        FFT_TEST_CHECK(fft_test_plancache_cached(FFT_PRECISION_DOUBLE, n) == 0,
+                       "least recently used plan %ld not evicted", n);
+    }
+    for(long n = 11; n < FFT_PLANCACHE_MAXNB + 10; n++)
+    {
+        FFT_TEST_CHECK(fft_test_plancache_cached(FFT_PRECISION_DOUBLE, n) == 1,
+                       "recent plan %ld evicted", n);
+    }
+    FFT_TEST_CHECK(fft_test_plancache_cached(FFT_PRECISION_SINGLE, 2) == 0,
+                   "plan of other precision reported cached");
+
+    // evicted geometry planned again
+    FFT_TEST_CHECK(fft_test_plancache_c2c(FFT_PRECISION_DOUBLE, 3,
+                                          1) < FFT_TEST_TOL(FFT_PRECISION_DOUBLE),
+                   "evicted size 3: wrong transform");
+    FFT_TEST_CHECK(fft_test_plancache_cached(FFT_PRECISION_DOUBLE, 3) == 1,
+                   "evicted size 3 not cached again");
+
+
+    // concurrent transforms evicting each other's plans
+    {
+        pthread_t thread[FFT_TEST_PLANCACHE_NBTHREAD];
+
+        for(long t = 0; t < FFT_TEST_PLANCACHE_NBTHREAD; t++)
+        {
+            pthread_create(&thread[t], NULL, fft_test_plancache_thread, (void *) t);
+        }
+        for(long t = 0; t < FFT_TEST_PLANCACHE_NBTHREAD; t++)
+        {
+            long *NBbad;
+
+            pthread_join(thread[t], (void **) &NBbad);
+            FFT_TEST_CHECK(*NBbad == 0, "thread %ld: %ld wrong transform(s)", t, *NBbad);
+            free(NBbad);
+        }
+    }
+
+
+    // flush
+    fft_plancache_flush();
+    FFT_TEST_CHECK(fft_test_plancache_cached(FFT_PRECISION_DOUBLE, 2) == 0,
+                   "plan cached after flush");
+    FFT_TEST_CHECK(fft_test_plancache_c2c(FFT_PRECISION_DOUBLE, 6,
+                                          5) < FFT_TEST_TOL(FFT_PRECISION_DOUBLE),
+                   "6 x 5 after flush: wrong transform");
+
+    fft_plancache_cleanupthreads();
+
+    return fft_test_result("fft_test_plancache");
+}
@@ -0,0 +1,251 @@
+/**
+ * @file    fft_test_registration.c
+ * @brief   Registration of shifted images, odd and even sizes
+ *
+ * Reference spectrum and cross spectra are computed as fft_registration
+ * does, then fft_registration_spectrum is checked on cubes whose slices are
+ * shifted copies of the reference:
+ * - integer shifts, including wrapped negative ones, found exactly without
+ *   upsampling, with peak sum_n ref(n)^2
+ * - subpixel shifts of a band-limited reference found to 1/upsample
+ * - phase correlation of integer shifts of white noise: peak 1
+ *
+ */
+
+#include <string.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft_plancache.h"
+#include "fft_correlation.h"
+#include "fft_registration.h"
+#include "fft_test.h"
+
+
+#define FFT_TEST_REGISTRATION_NBFREQ  12
+#define FFT_TEST_REGISTRATION_NBSLICE 3
+// low frequencies only: single correlation peak, found by the coarse search
+#define FFT_TEST_REGISTRATION_FMAX    2
+
+
+// band-limited test image: sum of cosines of low spatial frequencies
+typedef struct
+{
+    long   f0[FFT_TEST_REGISTRATION_NBFREQ];
+    long   f1[FFT_TEST_REGISTRATION_NBFREQ];
+    double amp[FFT_TEST_REGISTRATION_NBFREQ];
+    double pha[FFT_TEST_REGISTRATION_NBFREQ];
+} FFT_TEST_REGISTRATION_IMAGE;
+
+
+
+
+// image shifted by (dx, dy): out(n) = image(n - (dx, dy))
+static void fft_test_registration_image(
+    const FFT_TEST_REGISTRATION_IMAGE *image,
+    long                               n0,
+    long                               n1,
+    double                             dx,
+    double                             dy,
+    double                            *out
+)
+{
+    for(long jj = 0; jj < n1; jj++)
+    {
+        for(long ii = 0; ii < n0; ii++)
+        {
+            double v = 0.0;
+
+            for(int f = 0; f < FFT_TEST_REGISTRATION_NBFREQ; f++)
+            {
+                v += image->amp[f] * cos(2.0 * M_PI * (image->f0[f] * (ii - dx) / n0
+                                                       + image->f1[f] * (jj - dy) / n1) + image->pha[f]);
+            }
+            out[jj * n0 + ii] = v;
+        }
+    }
+}
+
+
+
+
+// registration of slices in (nbslice x npix) on ref, result per slice
+static void fft_test_registration_run(
+    int           precision,
+    long          n0,
+    long          n1,
+    long          nbslice,
+    const double *ref,
+    const double *in,
+    long          upsample,
+    int           flags,
+    double       *result
+)
+{
+    size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                          double);
+    long npix = n0 * n1;
+    long nspec = (n0 / 2 + 1) * n1;
+    void *refarray = fftw_malloc(realsize * npix);
+    void *inarray = fftw_malloc(realsize * npix * nbslice);
+    void *refspec = fftw_malloc(2 * realsize * nspec);
+    void *spec = fftw_malloc(2 * realsize * nspec * nbslice);
+
+    for(long i = 0; i < npix; i++)
+    {
+        fft_test_set(precision, refarray, i, ref[i]);
+    }
+    for(long i = 0; i < npix * nbslice; i++)
+    {
+        fft_test_set(precision, inarray, i, in[i]);
+    }
+
+    // conjugated reference spectrum, as kept in correlation contexts
+    fft_correlation_rfft(precision, n0, n1, 1, refarray, refspec);
+    for(long i = 0; i < nspec; i++)
+    {
+        fft_test_set(precision, refspec, 2 * i + 1, -fft_test_get(precision, refspec,
+                     2 * i + 1));
+    }
+
+    fft_correlation_rfft(precision, n0, n1, nbslice, inarray, spec);
+    fft_correlation_crossmult(precision, n0, n1, nbslice, refspec, 1, spec,
+                              nbslice, spec, 0, 0);
+    fft_registration_spectrum(precision, n0, n1, nbslice, spec, upsample, flags,
+                              result);
+
+    fftw_free(refarray);
+    fftw_free(inarray);
+    fftw_free(refspec);
+    fftw_free(spec);
+}
+
+
+
+
+static void fft_test_registration(
+    int  precision,
+    long n0,
+    long n1
+)
+{
+    const double shift[FFT_TEST_REGISTRATION_NBSLICE][2] = {{0, 0}, {2, -3}, {-(n0 / 2 - 1), n1 / 2}};
+    const double subshift[FFT_TEST_REGISTRATION_NBSLICE][2] = {{0.25, -0.5}, {1.3, -2.6}, {-1.75, 0.85}};
+    long npix = n0 * n1;
+    FFT_TEST_REGISTRATION_IMAGE image;
+    double *ref = (double *) malloc(sizeof(double) * npix);
+    double *in = (double *) malloc(sizeof(double) * npix * FFT_TEST_REGISTRATION_NBSLICE);
+    double result[3 * FFT_TEST_REGISTRATION_NBSLICE];
+    double sumsq = 0.0;
+    long nf = FFT_TEST_REGISTRATION_FMAX + 1;
+
+    for(int f = 0; f < FFT_TEST_REGISTRATION_NBFREQ; f++)
+    {
+        image.f0[f] = (long)((fft_test_random() + 1.0) * 0.5 * nf) % nf;
+        image.f1[f] = (long)(fft_test_random() * nf) % nf;
+        image.amp[f] = 1.0 + fft_test_random();
+        image.pha[f] = M_PI * fft_test_random();
+    }
+    fft_test_registration_image(&image, n0, n1, 0.0, 0.0, ref);
+    for(long i = 0; i < npix; i++)
+    {
+        sumsq += ref[i] * ref[i];
+    }
+
+
+    // integer shifts
+    for(int k = 0; k < FFT_TEST_REGISTRATION_NBSLICE; k++)
+    {
+        fft_test_registration_image(&image, n0, n1, shift[k][0], shift[k][1],
+                                    in + k * npix);
+    }
+    fft_test_registration_run(precision, n0, n1, FFT_TEST_REGISTRATION_NBSLICE, ref,
+                              in, 1, 0, result);
+    for(int k = 0; k < FFT_TEST_REGISTRATION_NBSLICE; k++)
+    {
+        FFT_TEST_CHECK((result[3 * k] == shift[k][0]) && (result[3 * k + 1] == shift[k][1]),
+                       "%ld x %ld, precision %d: shift (%g, %g) found (%g, %g)", n0, n1, precision,
+                       shift[k][0], shift[k][1], result[3 * k], result[3 * k + 1]);
+        FFT_TEST_CHECK(fabs(result[3 * k + 2] - sumsq) < 10.0 * FFT_TEST_TOL(precision) * sumsq,
+                       "%ld x %ld, precision %d: peak %g, expected %g", n0, n1, precision,
+                       result[3 * k + 2], sumsq);
+    }
+
+
+    // subpixel shifts, on the 1/upsample grid
+    for(int k = 0; k < FFT_TEST_REGISTRATION_NBSLICE; k++)
+    {
+        fft_test_registration_image(&image, n0, n1, subshift[k][0], subshift[k][1],
+                                    in + k * npix);
+    }
+    fft_test_registration_run(precision, n0, n1, FFT_TEST_REGISTRATION_NBSLICE, ref,
+                              in, 20, 0, result);
+    for(int k = 0; k < FFT_TEST_REGISTRATION_NBSLICE; k++)
+    {
+        FFT_TEST_CHECK((fabs(result[3 * k] - subshift[k][0]) < 0.5 / 20)
+                       && (fabs(result[3 * k + 1] - subshift[k][1]) < 0.5 / 20),
+                       "%ld x %ld, precision %d: subpixel shift (%g, %g) found (%g, %g)", n0, n1,
+                       precision, subshift[k][0], subshift[k][1], result[3 * k], result[3 * k + 1]);
+    }
+
+
+    // phase correlation: white noise reference, circular integer shifts
+    for(long i = 0; i < npix; i++)
+    {
+        ref[i] = fft_test_random();
+    }
+    for(int k = 0; k < FFT_TEST_REGISTRATION_NBSLICE; k++)
+    {
+        long s0 = ((long) shift[k][0] + n0) % n0;
+        long s1 = ((long) shift[k][1] + n1) % n1;
+
+        for(long jj = 0; jj < n1; jj++)
+        {
+            for(long ii = 0; ii < n0; ii++)
+            {
+                in[k * npix + ((jj + s1) % n1) * n0 + (ii + s0) % n0] = ref[jj * n0 + ii];
+            }
+        }
+    }
+    for(long upsample = 1; upsample <= 4; upsample += 3)
+    {
+        fft_test_registration_run(precision, n0, n1, FFT_TEST_REGISTRATION_NBSLICE, ref,
+                                  in, upsample, FFT_REGISTRATION_PHASE, result);
+        for(int k = 0; k < FFT_TEST_REGISTRATION_NBSLICE; k++)
+        {
+            FFT_TEST_CHECK((fabs(result[3 * k] - shift[k][0]) < 1.0e-6)
+                           && (fabs(result[3 * k + 1] - shift[k][1]) < 1.0e-6)
+                           && (fabs(result[3 * k + 2] - 1.0) < 1.0e-3),
+                           "%ld x %ld, precision %d, upsample %ld: phase correlation of shift (%g, %g) found (%g, %g), peak %g",
+                           n0, n1, precision, upsample, shift[k][0], shift[k][1], result[3 * k],
+                           result[3 * k + 1], result[3 * k + 2]);
+        }
+    }
+
+    free(ref);
+    free(in);
+}
+
+
+
+
+int main()
+{
+    const long sizes[][2] = {{16, 12}, {15, 13}, {9, 10}, {12, 9}, {32, 32}};
+    const int NBsize = sizeof(sizes) / sizeof(sizes[0]);
+
+    for(int precision = FFT_PRECISION_SINGLE; precision <= FFT_PRECISION_DOUBLE;
+            precision++)
+    {
+        for(int is = 0; is < NBsize; is++)
+        {
+            fft_test_registration(precision, sizes[is][0], sizes[is][1]);
+        }
+    }
+
+    fft_plancache_cleanupthreads();
+
+    return fft_test_result("fft_test_registration");
+}
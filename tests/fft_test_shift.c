@@ -0,0 +1,390 @@
+/**
+ * @file    fft_test_shift.c
+ * @brief   Quadrant shift, exact fftshift and spectrum centering
+ *
+ * - fft_shift_quadrant gives the result of the original permut swap
+ *   loops, for odd and even sizes, 1D to 3D, all element sizes, on the
+ *   serial and the worker pool paths
+ * - fft_shift_quadrantcopy is the ifftshift along axes 0 and 1, and the
+ *   in-place quadrant result for even sizes
+ * - fft_shift_axes is the fftshift / ifftshift along any subset of axes
+ * - fft_shift_centerspectrum of FFT(x) is fftshift(FFT(ifftshift(x)))
+ *   for even sizes, and odd sizes are rejected
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft_plancache.h"
+#include "fft_shift.h"
+#include "fft_test.h"
+
+
+
+
+// element i holds its index, then bytes derived from it
+static void fft_test_shift_fill(
+    char  *array,
+    size_t eltsize,
+    long   nelem
+)
+{
+    for(long i = 0; i < nelem; i++)
+    {
+        uint32_t idx = (uint32_t) i;
+
+        for(size_t b = 0; b < eltsize; b++)
+        {
+            array[i * eltsize + b] = (char)(i * 7 + b * 13);
+        }
+        memcpy(array + i * eltsize, &idx, (eltsize < 4) ? eltsize : 4);
+    }
+}
+
+
+
+
+// number of elements of array that are not element src[i] of orig
+static long fft_test_shift_compare(
+    const char *array,
+    const char *orig,
+    const long *src,
+    size_t      eltsize,
+    long        nelem
+)
+{
+    long NBbad = 0;
+
+    for(long i = 0; i < nelem; i++)
+    {
+        if(memcmp(array + i * eltsize, orig + src[i] * eltsize, eltsize) != 0)
+        {
+            NBbad++;
+        }
+    }
+
+    return NBbad;
+}
+
+
+
+
+// source index of each element after the original permut swap loops
+static void fft_test_shift_permutsrc(
+    long *src,
+    long  naxes0,
+    long  naxes1,
+    long  naxes2
+)
+{
+    long xhalf = naxes0 / 2;
+    long yhalf = naxes1 / 2;
+
+    for(long i = 0; i < naxes0 * naxes1 * naxes2; i++)
+    {
+        src[i] = i;
+    }
+    for(long kk = 0; kk < naxes2; kk++)
+    {
+        long *s = src + kk * naxes0 * naxes1;
+
+        for(long jj = 0; jj < yhalf; jj++)
+        {
+            for(long ii = 0; ii < xhalf; ii++)
+            {
+                long a = jj * naxes0 + ii;
+                long b = (jj + yhalf) * naxes0 + ii + xhalf;
+                long tmp = s[a];
+
+                s[a] = s[b];
+                s[b] = tmp;
+            }
+        }
+        for(long jj = yhalf; jj < naxes1; jj++)
+        {
+            for(long ii = 0; ii < xhalf; ii++)
+            {
+                long a = jj * naxes0 + ii;
+                long b = (jj - yhalf) * naxes0 + ii + xhalf;
+                long tmp = s[a];
+
+                s[a] = s[b];
+                s[b] = tmp;
+            }
+        }
+    }
+}
+
+
+
+
+// source index of each element after fftshift (inverse = 0) or ifftshift
+// along the axes of axismask
+static void fft_test_shift_axessrc(
+    long       *src,
+    int         naxis,
+    const long *size,
+    int         axismask,
+    int         inverse
+)
+{
+    long nelem = 1;
+
+    for(int a = 0; a < naxis; a++)
+    {
+        nelem *= size[a];
+    }
+
+    for(long i = 0; i < nelem; i++)
+    {
+        long rem = i;
+        long s = 0;
+        long stride = 1;
+
+        for(int a = 0; a < naxis; a++)
+        {
+            long n = size[a];
+            long k = rem % n;
+
+            rem /= n;
+            if((axismask >> a) & 1)
+            {
+                // fftshift: out[(k + n/2) % n] = in[k]
+                k = inverse ? (k + n / 2) % n : (k + n - n / 2) % n;
+            }
+            s += k * stride;
+            stride *= n;
+        }
+        src[i] = s;
+    }
+}
+
+
+
+
+static void fft_test_shift_quadrant(
+    size_t eltsize,
+    long   naxes0,
+    long   naxes1,
+    long   naxes2
+)
+{
+    long nelem = naxes0 * naxes1 * naxes2;
+    char *orig = (char *) malloc(eltsize * nelem);
+    char *array = (char *) malloc(eltsize * nelem);
+    char *copy = (char *) malloc(eltsize * nelem);
+    long *src = (long *) malloc(sizeof(long) * nelem);
+    long size[3] = {naxes0, naxes1, naxes2};
+    long NBbad;
+
+    fft_test_shift_fill(orig, eltsize, nelem);
+
+    // in place: original permut
+    memcpy(array, orig, eltsize * nelem);
+    fft_shift_quadrant(array, eltsize, naxes0, naxes1, naxes2);
+    fft_test_shift_permutsrc(src, naxes0, naxes1, naxes2);
+    NBbad = fft_test_shift_compare(array, orig, src, eltsize, nelem);
+    FFT_TEST_CHECK(NBbad == 0, "quadrant %ld x %ld x %ld, %zu bytes: %ld bad element(s)",
+                   naxes0, naxes1, naxes2, eltsize, NBbad);
+
+    // out of place: ifftshift along axes 0 and 1
+    fft_shift_quadrantcopy(orig, copy, eltsize, naxes0, naxes1, naxes2);
+    fft_test_shift_axessrc(src, 3, size, 3, 1);
+    NBbad = fft_test_shift_compare(copy, orig, src, eltsize, nelem);
+    FFT_TEST_CHECK(NBbad == 0,
+                   "quadrantcopy %ld x %ld x %ld, %zu bytes: %ld bad element(s)",
+                   naxes0, naxes1, naxes2, eltsize, NBbad);
+
+    if((naxes0 % 2 == 0) && (naxes1 % 2 == 0))
+    {
+        FFT_TEST_CHECK(memcmp(array, copy, eltsize * nelem) == 0,
+                       "quadrant and quadrantcopy differ, %ld x %ld x %ld", naxes0, naxes1,
+                       naxes2);
+    }
+
+    free(orig);
+    free(array);
+    free(copy);
+    free(src);
+}
+
+
+
+
+static void fft_test_shift_axes(
+    size_t      eltsize,
+    int         naxis,
+    const long *size
+)
+{
+    long nelem = 1;
+
+    for(int a = 0; a < naxis; a++)
+    {
+        nelem *= size[a];
+    }
+
+    char *orig = (char *) malloc(eltsize * nelem);
+    char *array = (char *) malloc(eltsize * nelem);
+    long *src = (long *) malloc(sizeof(long) * nelem);
+
+    fft_test_shift_fill(orig, eltsize, nelem);
+
+    for(int axismask = 0; axismask < (1 << naxis); axismask++)
+    {
+        for(int inverse = 0; inverse < 2; inverse++)
+        {
+            long NBbad;
+
+            memcpy(array, orig, eltsize * nelem);
+            fft_shift_axes(array, eltsize, naxis, size, axismask, inverse);
+            // axismask = 0 selects all axes
+            fft_test_shift_axessrc(src, naxis, size,
+                                   (axismask == 0) ? (1 << naxis) - 1 : axismask, inverse);
+            NBbad = fft_test_shift_compare(array, orig, src, eltsize, nelem);
+            FFT_TEST_CHECK(NBbad == 0,
+                           "%s naxis %d size %ld x %ld, mask %d, %zu bytes: %ld bad element(s)",
+                           inverse ? "ifftshift" : "fftshift", naxis, size[0],
+                           (naxis > 1) ? size[1] : 1, axismask, eltsize, NBbad);
+
+            // shift then inverse shift restores the array
+            fft_shift_axes(array, eltsize, naxis, size, axismask, 1 - inverse);
+            FFT_TEST_CHECK(memcmp(array, orig, eltsize * nelem) == 0,
+                           "naxis %d size %ld, mask %d: shift not undone by inverse shift", naxis,
+                           size[0], axismask);
+        }
+    }
+
+    free(orig);
+    free(array);
+    free(src);
+}
+
+
+
+
+// centerspectrum(FFT(x)) against fftshift(FFT(ifftshift(x)))
+static void fft_test_shift_centerspectrum(
+    int  precision,
+    long naxes0,
+    long naxes1
+)
+{
+    size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                          double);
+    long n = naxes0 * naxes1;
+    long size[2] = {naxes0, naxes1};
+    double *x = (double *) malloc(sizeof(double) * 2 * n);
+    double *xs = (double *) malloc(sizeof(double) * 2 * n);
+    double *X = (double *) malloc(sizeof(double) * 2 * n);
+    double *ref = (double *) malloc(sizeof(double) * 2 * n);
+    void *spec = malloc(2 * realsize * n);
+
+    for(long i = 0; i < 2 * n; i++)
+    {
+        x[i] = fft_test_random();
+    }
+
+    for(int sign = FFTW_FORWARD; sign <= FFTW_BACKWARD; sign += 2)
+    {
+        fft_test_dft(naxes0, naxes1, sign, x, X);
+        for(long i = 0; i < 2 * n; i++)
+        {
+            fft_test_set(precision, spec, i, X[i]);
+        }
+        FFT_TEST_CHECK(fft_shift_centerspectrum(spec, precision, naxes0, naxes1,
+                                                1) == RETURN_SUCCESS,
+                       "centerspectrum %ld x %ld rejected", naxes0, naxes1);
+
+        memcpy(xs, x, sizeof(double) * 2 * n);
+        fft_shift_axes(xs, 2 * sizeof(double), 2, size, 3, 1);
+        fft_test_dft(naxes0, naxes1, sign, xs, ref);
+        fft_shift_axes(ref, 2 * sizeof(double), 2, size, 3, 0);
+
+        FFT_TEST_CHECK(fft_test_maxerr(precision, spec, ref,
+                                       2 * n) < FFT_TEST_TOL(precision),
+                       "centerspectrum %ld x %ld, precision %d, sign %d: wrong spectrum", naxes0,
+                       naxes1, precision, sign);
+    }
+
+    free(x);
+    free(xs);
+    free(X);
+    free(ref);
+    free(spec);
+}
+
+
+
+
+int main()
+{
+    const size_t eltsizes[] = {sizeof(float), sizeof(double), sizeof(complex_float), sizeof(complex_double)};
+
+    for(int ie = 0; ie < 4; ie++)
+    {
+        size_t eltsize = eltsizes[ie];
+
+        // odd and even sizes, 1D (naxes1 = 1) to 3D
+        for(long n0 = 1; n0 <= 9; n0++)
+        {
+            for(long n1 = 1; n1 <= 9; n1++)
+            {
+                fft_test_shift_quadrant(eltsize, n0, n1, 1);
+                fft_test_shift_quadrant(eltsize, n0, n1, 3);
+            }
+        }
+        // rows longer than the vector block, worker pool path
+        fft_test_shift_quadrant(eltsize, 130, 67, 2);
+        fft_test_shift_quadrant(eltsize, 255, 257, 1);
+        fft_test_shift_quadrant(eltsize, 256, 256, 2);
+
+        for(long n0 = 1; n0 <= 7; n0++)
+        {
+            long size1[1] = {n0};
+
+            fft_test_shift_axes(eltsize, 1, size1);
+            for(long n1 = 1; n1 <= 7; n1++)
+            {
+                long size3[3] = {n0, n1, 3};
+
+                fft_test_shift_axes(eltsize, 3, size3);
+            }
+        }
+        {
+            long size4[4] = {5, 4, 3, 2};
+            long sizebig[2] = {301, 257};
+
+            fft_test_shift_axes(eltsize, 4, size4);
+            // lines longer than FFT_SHIFT_CHUNK, worker pool path
+            fft_test_shift_axes(eltsize, 2, sizebig);
+        }
+    }
+
+    for(int precision = FFT_PRECISION_SINGLE; precision <= FFT_PRECISION_DOUBLE;
+            precision++)
+    {
+        for(long n0 = 2; n0 <= 8; n0 += 2)
+        {
+            fft_test_shift_centerspectrum(precision, n0, 1);
+            for(long n1 = 2; n1 <= 8; n1 += 2)
+            {
+                fft_test_shift_centerspectrum(precision, n0, n1);
+            }
+        }
+    }
+    {
+        complex_double spec[15];
+
+        FFT_TEST_CHECK(fft_shift_centerspectrum(spec, FFT_PRECISION_DOUBLE, 5, 3,
+                                                1) == RETURN_FAILURE,
+                       "centerspectrum of odd size accepted");
+    }
+
+    return fft_test_result("fft_test_shift");
+}
@@ -0,0 +1,190 @@
+/**
+ * @file    fft_test_structure_function.c
+ * @brief   Fused structure function against the direct mean
+ *
+ * D(r) = < (in(n + r) - in(n))^2 >, circular, averaged over pixels and
+ * cube slices, which for a single image is the result of the original
+ * autocorrelation-based structure function:
+ * - odd and even sizes, both precisions
+ * - cubes of more slices than transformed per batch
+ *   (FFT_STRUCTURE_FUNCTION_NBSLICE), with a partial last batch
+ * - radial profile: mean of D over annuli of unit width, wrapped lags
+ *
+ */
+
+#include <string.h>
+
+#include <fftw3.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft_plancache.h"
+#include "fft_structure_function.h"
+#include "fft_test.h"
+
+
+
+
+// direct ensemble averaged structure function of n0 x n1 x nbslice array
+static void fft_test_structure_function_direct(
+    const double *in,
+    long          n0,
+    long          n1,
+    long          nbslice,
+    double       *D
+)
+{
+    for(long r1 = 0; r1 < n1; r1++)
+    {
+        for(long r0 = 0; r0 < n0; r0++)
+        {
+            double sum = 0.0;
+
+            for(long k = 0; k < nbslice; k++)
+            {
+                const double *s = in + k * n0 * n1;
+
+                for(long j1 = 0; j1 < n1; j1++)
+                {
+                    for(long j0 = 0; j0 < n0; j0++)
+                    {
+                        double d = s[((j1 + r1) % n1) * n0 + (j0 + r0) % n0] - s[j1 * n0 + j0];
+
+                        sum += d * d;
+                    }
+                }
+            }
+            D[r1 * n0 + r0] = sum / (nbslice * n0 * n1);
+        }
+    }
+}
+
+
+
+
+// radial profile of D, lags wrapped to [-n/2, n/2)
+static void fft_test_structure_function_profile(
+    const double *D,
+    long          n0,
+    long          n1,
+    double       *profile,
+    long          nbbin
+)
+{
+    long *count = (long *) calloc(nbbin, sizeof(long));
+
+    memset(profile, 0, sizeof(double) * nbbin);
+    for(long jj = 0; jj < n1; jj++)
+    {
+        for(long ii = 0; ii < n0; ii++)
+        {
+            double x = (2 * ii < n0) ? ii : ii - n0;
+            double y = (2 * jj < n1) ? jj : jj - n1;
+            long bin = lround(sqrt(x * x + y * y));
+
+            if(bin < nbbin)
+            {
+                profile[bin] += D[jj * n0 + ii];
+                count[bin]++;
+            }
+        }
+    }
+    for(long bin = 0; bin < nbbin; bin++)
+    {
+        profile[bin] = (count[bin] > 0) ? profile[bin] / count[bin] : 0.0;
+    }
+
+    free(count);
+}
+
+
+
+
+static void fft_test_structure_function(
+    int  precision,
+    long n0,
+    long n1,
+    long nbslice
+)
+{
+    size_t realsize = (precision == FFT_PRECISION_SINGLE) ? sizeof(float) : sizeof(
+                          double);
+    long npix = n0 * n1;
+    long nbbin = FFT_STRUCTURE_FUNCTION_NBBIN(n0, n1);
+    double *in = (double *) malloc(sizeof(double) * npix * nbslice);
+    double *D = (double *) malloc(sizeof(double) * npix);
+    double *profile = (double *) malloc(sizeof(double) * nbbin);
+    void *inarray = fftw_malloc(realsize * npix * nbslice);
+    void *outarray = fftw_malloc(realsize * npix);
+    // guard elements after the profile: radial output must stay in bounds
+    void *profilearray = malloc(realsize * (nbbin + 4));
+
+    for(long i = 0; i < npix * nbslice; i++)
+    {
+        in[i] = fft_test_random();
+        fft_test_set(precision, inarray, i, in[i]);
+    }
+    fft_test_structure_function_direct(in, n0, n1, nbslice, D);
+    fft_test_structure_function_profile(D, n0, n1, profile, nbbin);
+
+    fft_structure_function_array(precision, n0, n1, nbslice, inarray, outarray, 0);
+    FFT_TEST_CHECK(fft_test_maxerr(precision, outarray, D,
+                                   npix) < FFT_TEST_TOL(precision),
+                   "%ld x %ld x %ld, precision %d: wrong structure function", n0, n1, nbslice,
+                   precision);
+
+    for(long i = 0; i < nbbin + 4; i++)
+    {
+        fft_test_set(precision, profilearray, i, -1.0);
+    }
+    fft_structure_function_array(precision, n0, n1, nbslice, inarray, profilearray,
+                                 1);
+    FFT_TEST_CHECK(fft_test_maxerr(precision, profilearray, profile,
+                                   nbbin) < FFT_TEST_TOL(precision),
+                   "%ld x %ld x %ld, precision %d: wrong radial profile", n0, n1, nbslice,
+                   precision);
+    for(long i = nbbin; i < nbbin + 4; i++)
+    {
+        FFT_TEST_CHECK(fft_test_get(precision, profilearray, i) == -1.0,
+                       "%ld x %ld, precision %d: radial profile written past %ld bins", n0, n1,
+                       precision, nbbin);
+    }
+
+    free(in);
+    free(D);
+    free(profile);
+    fftw_free(inarray);
+    fftw_free(outarray);
+    free(profilearray);
+}
+
+
+
+
+int main()
+{
+    const long sizes[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 12};
+    const int NBsize = sizeof(sizes) / sizeof(sizes[0]);
+
+    for(int precision = FFT_PRECISION_SINGLE; precision <= FFT_PRECISION_DOUBLE;
+            precision++)
+    {
+        for(int i0 = 0; i0 < NBsize; i0++)
+        {
+            for(int i1 = 0; i1 < NBsize; i1++)
+            {
+                fft_test_structure_function(precision, sizes[i0], sizes[i1], 1);
+            }
+        }
+
+        fft_test_structure_function(precision, 8, 6, 3);
+        fft_test_structure_function(precision, 7, 9, 3);
+        fft_test_structure_function(precision, 6, 5, FFT_STRUCTURE_FUNCTION_NBSLICE);
+        fft_test_structure_function(precision, 5, 4, 2 * FFT_STRUCTURE_FUNCTION_NBSLICE + 5);
+        fft_test_structure_function(precision, 4, 10, 2 * FFT_STRUCTURE_FUNCTION_NBSLICE + 5);
+    }
+
+    fft_plancache_cleanupthreads();
+
+    return fft_test_result("fft_test_structure_function");
+}
@@ -0,0 +1,289 @@
+/**
+ * @file    fft_test_workerpool.c
+ * @brief   Worker pool: job coverage, nesting, concurrent stop and resize
+ *
+ * - fft_workerpool_run runs each job once, fft_workerpool_parallelfor
+ *   covers each index once, for pool sizes 1 to 8 and any loop length
+ * - jobs can submit nested loops
+ * - loops keep completing while other threads stop and resize the pool;
+ *   jobs query the pool size meanwhile, which must not wait for the stop
+ * - small and locked worker stacks
+ *
+ * A deadlock ends the test through SIGALRM.
+ *
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "fft_workerpool.h"
+#include "fft_test.h"
+
+
+#define FFT_TEST_WORKERPOOL_TIMEOUT 120   // [sec]
+#define FFT_TEST_WORKERPOOL_NBLOOP  2000
+#define FFT_TEST_WORKERPOOL_NMAX    1000
+
+
+typedef struct
+{
+    long *count;      // number of visits of each index
+    long  ninner;     // > 0: each index runs a nested loop of this length
+    long *innercount;
+} FFT_TEST_WORKERPOOL_LOOP;
+
+
+
+
+static void fft_test_workerpool_job(
+    void *ptr,
+    int   ijob
+)
+{
+    long *count = (long *) ptr;
+
+    __sync_fetch_and_add(&count[ijob], 1);
+}
+
+
+
+
+static void fft_test_workerpool_innerrange(
+    void *ptr,
+    long  i0,
+    long  i1
+)
+{
+    long *count = (long *) ptr;
+
+    for(long i = i0; i < i1; i++)
+    {
+        __sync_fetch_and_add(&count[i], 1);
+    }
+}
+
+
+
+
+static void fft_test_workerpool_range(
+    void *ptr,
+    long  i0,
+    long  i1
+)
+{
+    FFT_TEST_WORKERPOOL_LOOP *loop = (FFT_TEST_WORKERPOOL_LOOP *) ptr;
+
+    // pool size queried from jobs, possibly while another thread stops the pool
+    if(fft_workerpool_nthreads() < 1)
+    {
+        // counted as a bad index
+        __sync_fetch_and_add(&loop->count[i0], 1);
+    }
+
+    for(long i = i0; i < i1; i++)
+    {
+        __sync_fetch_and_add(&loop->count[i], 1);
+        if(loop->ninner > 0)
+        {
+            fft_workerpool_parallelfor(fft_test_workerpool_innerrange,
+                                       loop->innercount + i * loop->ninner, loop->ninner);
+        }
+    }
+}
+
+
+
+
+// parallelfor of length n, nested loops of length ninner
+// returns number of indices not visited exactly once
+static long fft_test_workerpool_loop(
+    long n,
+    long ninner
+)
+{
+    FFT_TEST_WORKERPOOL_LOOP loop;
+    long NBbad = 0;
+
+    loop.count = (long *) calloc(n + 1, sizeof(long));
+    loop.ninner = ninner;
+    loop.innercount = (long *) calloc(n * ninner + 1, sizeof(long));
+
+    fft_workerpool_parallelfor(fft_test_workerpool_range, &loop, n);
+
+    for(long i = 0; i < n; i++)
+    {
+        NBbad += (loop.count[i] != 1) ? 1 : 0;
+    }
+    for(long i = 0; i < n * ninner; i++)
+    {
+        NBbad += (loop.innercount[i] != 1) ? 1 : 0;
+    }
+
+    free(loop.count);
+    free(loop.innercount);
+
+    return NBbad;
+}
+
+
+
+
+// loops run while the main thread stops and resizes the pool
+static void *fft_test_workerpool_thread(
+    void *ptr
+)
+{
+    long ithread = (long) ptr;
+    long *NBbad = (long *) malloc(sizeof(long));
+
+    *NBbad = 0;
+    for(long iloop = 0; iloop < FFT_TEST_WORKERPOOL_NBLOOP; iloop++)
+    {
+        long n = 1 + (iloop * 13 + ithread * 7) % 200;
+
+        *NBbad += fft_test_workerpool_loop(n, (iloop % 4 == 0) ? 5 : 0);
+    }
+
+    return NBbad;
+}
+
+
+
+
+// job touching a large local array: needs the requested stack
+static void fft_test_workerpool_stackjob(
+    void *ptr,
+    int   ijob
+)
+{
+    long *count = (long *) ptr;
+    volatile char buffer[32 * 1024];
+
+    memset((char *) buffer, ijob, sizeof(buffer));
+    __sync_fetch_and_add(&count[ijob], buffer[ijob] == (char) ijob);
+}
+
+
+
+
+int main()
+{
+    const long lengths[] = {0, 1, 2, 3, 7, 64, 100, FFT_TEST_WORKERPOOL_NMAX};
+    const int NBlength = sizeof(lengths) / sizeof(lengths[0]);
+
+    alarm(FFT_TEST_WORKERPOOL_TIMEOUT);
+
+    // coverage, for several pool sizes
+    for(long nthreads = 1; nthreads <= 8; nthreads++)
+    {
+        fft_workerpool_set(nthreads, "-", 0, 0, 0);
+        FFT_TEST_CHECK(fft_workerpool_nthreads() == nthreads,
+                       "pool size %d, expected %ld", fft_workerpool_nthreads(), nthreads);
+
+        for(int njobs = 0; njobs <= 64; njobs += (njobs < 4) ? 1 : 20)
+        {
+            long *count = (long *) calloc(njobs + 1, sizeof(long));
+            long NBbad = 0;
+
+            fft_workerpool_run(fft_test_workerpool_job, count, njobs);
+            for(int ijob = 0; ijob < njobs; ijob++)
+            {
+                NBbad += (count[ijob] != 1) ? 1 : 0;
+            }
+            FFT_TEST_CHECK(NBbad == 0, "%ld thread(s), %d jobs: %ld job(s) not run once",
+                           nthreads, njobs, NBbad);
+            free(count);
+        }
+
+        for(int il = 0; il < NBlength; il++)
+        {
+            long NBbad = fft_test_workerpool_loop(lengths[il], 0);
+
+            FFT_TEST_CHECK(NBbad == 0,
+                           "%ld thread(s), loop %ld: %ld index(es) not visited once",
+                           nthreads, lengths[il], NBbad);
+        }
+
+        // nested loops
+        {
+            long NBbad = fft_test_workerpool_loop(16, 100);
+
+            FFT_TEST_CHECK(NBbad == 0, "%ld thread(s), nested loops: %ld bad index(es)",
+                           nthreads, NBbad);
+        }
+    }
+
+
+    // stop and resize while loops are running
+    {
+        pthread_t thread[3];
+
+        fft_workerpool_set(4, "-", 0, 0, 0);
+        for(long t = 0; t < 3; t++)
+        {
+            pthread_create(&thread[t], NULL, fft_test_workerpool_thread, (void *) t);
+        }
+        for(long iter = 0; iter < 200; iter++)
+        {
+            if(iter % 2 == 0)
+            {
+                fft_workerpool_stop();
+            }
+            else
+            {
+                fft_workerpool_set(1 + iter % 6, "-", 0, 0, 0);
+            }
+            usleep(500);
+        }
+        for(long t = 0; t < 3; t++)
+        {
+            long *NBbad;
+
+            pthread_join(thread[t], (void **) &NBbad);
+            FFT_TEST_CHECK(*NBbad == 0,
+                           "thread %ld: %ld bad index(es) with concurrent stop/resize", t, *NBbad);
+            free(NBbad);
+        }
+    }
+
+
+    // worker stacks: below PTHREAD_STACK_MIN, default, locked
+    {
+        const long stackKiB[] = {1, 0, 64, 128};
+
+        for(int is = 0; is < 4; is++)
+        {
+            long count[16] = {0};
+            long NBbad = 0;
+
+            FFT_TEST_CHECK(fft_workerpool_set(4, "-", 0, (is == 3) ? 1 : 0,
+                                              stackKiB[is]) == RETURN_SUCCESS,
+                           "stack %ld KiB rejected", stackKiB[is]);
+            if(stackKiB[is] == 1)
+            {
+                // rounded up to PTHREAD_STACK_MIN: no deep job there
+                fft_workerpool_run(fft_test_workerpool_job, count, 16);
+            }
+            else
+            {
+                fft_workerpool_run(fft_test_workerpool_stackjob, count, 16);
+            }
+            for(int ijob = 0; ijob < 16; ijob++)
+            {
+                NBbad += (count[ijob] != 1) ? 1 : 0;
+            }
+            FFT_TEST_CHECK(NBbad == 0, "stack %ld KiB: %ld job(s) failed", stackKiB[is],
+                           NBbad);
+        }
+    }
+
+    FFT_TEST_CHECK(fft_workerpool_set(2, "1-x", 0, 0, 0) == RETURN_FAILURE,
+                   "invalid CPU list accepted");
+
+    fft_workerpool_stop();
+
+    return fft_test_result("fft_test_workerpool");
+}